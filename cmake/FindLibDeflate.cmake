@@ -0,0 +1,35 @@
+# - Try to find libdeflate
+#
+# Defines the following variables:
+#
+# LIBDEFLATE_FOUND - system has libdeflate
+# LIBDEFLATE_INCLUDE_DIR - the libdeflate include directory
+# LIBDEFLATE_LIBRARIES - Link these to use libdeflate
+# LIBDEFLATE_VERSION_STRING - the version of libdeflate found
+
+# Find the header and library
+find_path(LIBDEFLATE_INCLUDE_DIR NAMES libdeflate.h)
+find_library(LIBDEFLATE_LIBRARY NAMES deflate libdeflate)
+
+# Found the header, read version
+if(LIBDEFLATE_INCLUDE_DIR AND EXISTS "${LIBDEFLATE_INCLUDE_DIR}/libdeflate.h")
+	file(READ "${LIBDEFLATE_INCLUDE_DIR}/libdeflate.h" LIBDEFLATE_H)
+	if(LIBDEFLATE_H)
+		string(REGEX REPLACE ".*#define[\t ]+LIBDEFLATE_VERSION_STRING[\t ]+\"([^\"]*)\".*" "\\1" LIBDEFLATE_VERSION_STRING "${LIBDEFLATE_H}")
+	endif()
+	unset(LIBDEFLATE_H)
+endif()
+
+# Handle the QUIETLY and REQUIRED arguments and set LIBDEFLATE_FOUND
+# to TRUE if all listed variables are TRUE
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibDeflate REQUIRED_VARS LIBDEFLATE_INCLUDE_DIR LIBDEFLATE_LIBRARY)
+
+# Hide advanced variables
+mark_as_advanced(LIBDEFLATE_INCLUDE_DIR LIBDEFLATE_LIBRARY)
+
+# Set standard variables
+if(LIBDEFLATE_FOUND)
+	set(LIBDEFLATE_LIBRARIES ${LIBDEFLATE_LIBRARY})
+	set(LIBDEFLATE_INCLUDE_DIRS ${LIBDEFLATE_INCLUDE_DIR})
+endif()
@@ -1,4 +1,5 @@
 include(SanitizeInput)
+include(CheckSymbolExists)
 
 # Fall back to the previous cmake configuration, "USE_BUNDLED_ZLIB"
 if(NOT USE_COMPRESSION AND USE_BUNDLED_ZLIB)
@@ -32,6 +33,25 @@ elseif(USE_COMPRESSION STREQUAL "zlib")
 	endif()
 
 	set(GIT_COMPRESSION_ZLIB 1)
+elseif(USE_COMPRESSION STREQUAL "zlib-ng")
+	find_package(ZLIB)
+
+	if(NOT ZLIB_FOUND)
+		message(FATAL_ERROR "zlib-ng was requested but not found")
+	endif()
+
+	# zlib-ng must be built with ZLIB_COMPAT so that it provides
+	# the zlib API; it identifies itself with ZLIBNG_VERSION.
+	set(CMAKE_REQUIRED_INCLUDES ${ZLIB_INCLUDE_DIRS})
+	check_symbol_exists(ZLIBNG_VERSION "zlib.h" HAVE_ZLIBNG_COMPAT)
+	unset(CMAKE_REQUIRED_INCLUDES)
+
+	if(NOT HAVE_ZLIBNG_COMPAT)
+		message(FATAL_ERROR "zlib-ng was requested but the zlib found is not zlib-ng in compatibility mode")
+	endif()
+
+	set(GIT_COMPRESSION_ZLIB 1)
+	set(GIT_COMPRESSION_ZLIB_NG 1)
 elseif(USE_COMPRESSION STREQUAL "builtin")
 	set(GIT_COMPRESSION_BUILTIN 1)
 endif()
@@ -44,7 +64,11 @@ if(GIT_COMPRESSION_ZLIB)
 	else()
 		list(APPEND LIBGIT2_PC_REQUIRES "zlib")
 	endif()
-	add_feature_info("Compression" ON "using system zlib")
+	if(GIT_COMPRESSION_ZLIB_NG)
+		add_feature_info("Compression" ON "using system zlib-ng")
+	else()
+		add_feature_info("Compression" ON "using system zlib")
+	endif()
 elseif(GIT_COMPRESSION_BUILTIN)
 	add_subdirectory("${PROJECT_SOURCE_DIR}/deps/zlib" "${PROJECT_BINARY_DIR}/deps/zlib")
 	list(APPEND LIBGIT2_DEPENDENCY_INCLUDES "${PROJECT_SOURCE_DIR}/deps/zlib")
@@ -53,3 +77,21 @@ elseif(GIT_COMPRESSION_BUILTIN)
 else()
 	message(FATAL_ERROR "unknown compression backend")
 endif()
+
+# Optional one-shot decompression for buffers of known size
+
+if(USE_LIBDEFLATE)
+	find_package(LibDeflate)
+
+	if(NOT LIBDEFLATE_FOUND)
+		message(FATAL_ERROR "libdeflate was requested but not found")
+	endif()
+
+	list(APPEND LIBGIT2_SYSTEM_INCLUDES ${LIBDEFLATE_INCLUDE_DIRS})
+	list(APPEND LIBGIT2_SYSTEM_LIBS ${LIBDEFLATE_LIBRARIES})
+	list(APPEND LIBGIT2_PC_REQUIRES "libdeflate")
+	set(GIT_COMPRESSION_LIBDEFLATE 1)
+	add_feature_info("Decompression" ON "using libdeflate for whole buffers")
+else()
+	add_feature_info("Decompression" OFF "libdeflate is not enabled")
+endif()
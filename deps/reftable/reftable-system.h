@@ -30,4 +30,10 @@
 
 #define inline GIT_INLINE_KEYWORD
 
+/*
+ * Set up the process-wide cache of table mappings that backs
+ * `reftable_mmap()`.
+ */
+int git_reftable_map_cache_global_init(void);
+
 #endif
@@ -1,6 +1,10 @@
 #include "system.h"
 #include "basics.h"
+#include "futils.h"
+#include "hashmap.h"
 #include "rand.h"
+#include "runtime.h"
+#include "thread.h"
 #include "reftable-error.h"
 
 uint32_t reftable_rand(void)
@@ -229,31 +233,269 @@ uint64_t reftable_time_ms(void)
 	return git_time_monotonic();
 }
 
+/*
+ * Tables are never modified once they have been written, so a mapping of
+ * a table can be shared by every stack that reads it, even across
+ * repository instances.  Mappings are keyed by the identity of the file
+ * they map (device, inode, size and modification time).  Once the last
+ * reader of a table goes away its mapping is kept around on an LRU list
+ * of idle mappings, bounded both in number and in mapped bytes, so that
+ * repositories which are opened over and over do not have to map their
+ * tables again.
+ */
+
+/*
+ * On Windows, a mapping keeps the file from being deleted, which would
+ * keep compaction from removing tables; so we never keep idle mappings.
+ */
+#ifdef GIT_WIN32
+# define REFTABLE_MAP_CACHE_IDLE_MAX 0
+#else
+# define REFTABLE_MAP_CACHE_IDLE_MAX 64
+#endif
+#define REFTABLE_MAP_CACHE_IDLE_BYTES (32 * 1024 * 1024)
+
+struct reftable_map_cache_key {
+	dev_t dev;
+	git_futils_filestamp stamp;
+	size_t len;
+};
+
+struct reftable_map_cache_entry {
+	struct reftable_map_cache_key key;
+	git_map map;
+	size_t refcount;
+
+	struct reftable_map_cache_entry *idle_prev, *idle_next;
+};
+
+GIT_INLINE(uint32_t) map_cache_key_hash(const struct reftable_map_cache_key *key)
+{
+	uint64_t hash = (uint64_t)key->stamp.ino ^
+		((uint64_t)key->dev << 32) ^
+		(uint64_t)key->stamp.mtime.tv_sec ^
+		((uint64_t)key->stamp.mtime.tv_nsec << 16) ^
+		(uint64_t)key->len;
+
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+GIT_INLINE(bool) map_cache_key_equal(
+	const struct reftable_map_cache_key *a,
+	const struct reftable_map_cache_key *b)
+{
+	return a->dev == b->dev &&
+	       a->len == b->len &&
+	       a->stamp.ino == b->stamp.ino &&
+	       a->stamp.size == b->stamp.size &&
+	       a->stamp.mtime.tv_sec == b->stamp.mtime.tv_sec &&
+	       a->stamp.mtime.tv_nsec == b->stamp.mtime.tv_nsec;
+}
+
+GIT_HASHMAP_SETUP(reftable_map_cache_map, const struct reftable_map_cache_key *, struct reftable_map_cache_entry *, map_cache_key_hash, map_cache_key_equal);
+
+static git_mutex reftable_map_cache_lock;
+static reftable_map_cache_map reftable_map_cache;
+static struct reftable_map_cache_entry *reftable_map_cache_idle_head;
+static struct reftable_map_cache_entry *reftable_map_cache_idle_tail;
+static size_t reftable_map_cache_idle_count;
+static size_t reftable_map_cache_idle_bytes;
+
+static void map_cache_idle_remove(struct reftable_map_cache_entry *entry)
+{
+	if (entry->idle_prev)
+		entry->idle_prev->idle_next = entry->idle_next;
+	else
+		reftable_map_cache_idle_head = entry->idle_next;
+
+	if (entry->idle_next)
+		entry->idle_next->idle_prev = entry->idle_prev;
+	else
+		reftable_map_cache_idle_tail = entry->idle_prev;
+
+	entry->idle_prev = entry->idle_next = NULL;
+
+	reftable_map_cache_idle_count--;
+	reftable_map_cache_idle_bytes -= entry->map.len;
+}
+
+static void map_cache_idle_push(struct reftable_map_cache_entry *entry)
+{
+	entry->idle_prev = NULL;
+	entry->idle_next = reftable_map_cache_idle_head;
+
+	if (reftable_map_cache_idle_head)
+		reftable_map_cache_idle_head->idle_prev = entry;
+	else
+		reftable_map_cache_idle_tail = entry;
+
+	reftable_map_cache_idle_head = entry;
+
+	reftable_map_cache_idle_count++;
+	reftable_map_cache_idle_bytes += entry->map.len;
+}
+
+static void map_cache_entry_free(struct reftable_map_cache_entry *entry)
+{
+	p_munmap(&entry->map);
+	git__free(entry);
+}
+
+/*
+ * Takes the least recently used idle mappings out of the cache until it
+ * is within the given bounds, and returns them (linked through their
+ * idle list) so that they can be unmapped without holding the lock.
+ */
+static struct reftable_map_cache_entry *map_cache_evict(size_t max_count, size_t max_bytes)
+{
+	struct reftable_map_cache_entry *evicted = NULL, *entry;
+
+	while (reftable_map_cache_idle_tail &&
+	       (reftable_map_cache_idle_count > max_count ||
+	        reftable_map_cache_idle_bytes > max_bytes)) {
+		entry = reftable_map_cache_idle_tail;
+
+		map_cache_idle_remove(entry);
+		reftable_map_cache_map_remove(&reftable_map_cache, &entry->key);
+
+		entry->idle_next = evicted;
+		evicted = entry;
+	}
+
+	return evicted;
+}
+
+static void map_cache_free_evicted(struct reftable_map_cache_entry *evicted)
+{
+	struct reftable_map_cache_entry *next;
+
+	for (; evicted; evicted = next) {
+		next = evicted->idle_next;
+		map_cache_entry_free(evicted);
+	}
+}
+
+static void git_reftable_map_cache_global_shutdown(void)
+{
+	struct reftable_map_cache_entry *evicted;
+
+	if (git_mutex_lock(&reftable_map_cache_lock) < 0)
+		return;
+
+	evicted = map_cache_evict(0, 0);
+	reftable_map_cache_map_dispose(&reftable_map_cache);
+
+	git_mutex_unlock(&reftable_map_cache_lock);
+	git_mutex_free(&reftable_map_cache_lock);
+
+	map_cache_free_evicted(evicted);
+}
+
+int git_reftable_map_cache_global_init(void)
+{
+	if (git_mutex_init(&reftable_map_cache_lock)) {
+		git_error_set(GIT_ERROR_OS, "failed to initialize reftable map cache lock");
+		return -1;
+	}
+
+	return git_runtime_shutdown_register(git_reftable_map_cache_global_shutdown);
+}
+
+/*
+ * Looks up the mapping for the given key and takes a reference to it;
+ * the cache lock must be held.
+ */
+static struct reftable_map_cache_entry *map_cache_get(const struct reftable_map_cache_key *key)
+{
+	struct reftable_map_cache_entry *entry;
+
+	if (reftable_map_cache_map_get(&entry, &reftable_map_cache, key) != 0)
+		return NULL;
+
+	if (entry->refcount++ == 0)
+		map_cache_idle_remove(entry);
+
+	return entry;
+}
+
 int reftable_mmap(struct reftable_mmap *out, int fd, size_t len)
 {
-	git_map *mmap;
+	struct reftable_map_cache_entry *entry, *existing;
+	struct reftable_map_cache_key key = {0};
+	struct stat st;
+	int error = 0;
+
+	if (p_fstat(fd, &st) < 0)
+		return REFTABLE_IO_ERROR;
 
-	mmap = git__malloc(sizeof(*mmap));
-	if (!mmap)
+	key.dev = st.st_dev;
+	key.len = len;
+	git_futils_filestamp_set_from_stat(&key.stamp, &st);
+
+	if (git_mutex_lock(&reftable_map_cache_lock) < 0)
+		return REFTABLE_IO_ERROR;
+
+	entry = map_cache_get(&key);
+	git_mutex_unlock(&reftable_map_cache_lock);
+
+	if (entry)
+		goto done;
+
+	/* map the table without holding the lock */
+	if ((entry = git__calloc(1, sizeof(*entry))) == NULL)
 		return REFTABLE_OUT_OF_MEMORY_ERROR;
 
-	if (p_mmap(mmap, len, GIT_PROT_READ, GIT_MAP_PRIVATE, fd, 0) < 0)
+	if (p_mmap(&entry->map, len, GIT_PROT_READ, GIT_MAP_PRIVATE, fd, 0) < 0) {
+		git__free(entry);
 		return REFTABLE_IO_ERROR;
+	}
+
+	memcpy(&entry->key, &key, sizeof(key));
+	entry->refcount = 1;
+
+	if (git_mutex_lock(&reftable_map_cache_lock) < 0) {
+		map_cache_entry_free(entry);
+		return REFTABLE_IO_ERROR;
+	}
 
-	out->priv = mmap;
-	out->data = mmap->data;
-	out->size = mmap->len;
+	/* another reader may have mapped the same table in the meantime */
+	if ((existing = map_cache_get(&key)) == NULL &&
+	    reftable_map_cache_map_put(&reftable_map_cache, &entry->key, entry) < 0)
+		error = REFTABLE_OUT_OF_MEMORY_ERROR;
+
+	git_mutex_unlock(&reftable_map_cache_lock);
+
+	if (existing || error) {
+		map_cache_entry_free(entry);
+		entry = existing;
+
+		if (error)
+			return error;
+	}
 
+done:
+	out->priv = entry;
+	out->data = entry->map.data;
+	out->size = entry->map.len;
 	return 0;
 }
 
 int reftable_munmap(struct reftable_mmap *mmap)
 {
-	git_map *map = mmap->priv;
+	struct reftable_map_cache_entry *entry = mmap->priv, *evicted = NULL;
 
-	if (p_munmap(map) < 0)
+	if (git_mutex_lock(&reftable_map_cache_lock) < 0)
 		return REFTABLE_IO_ERROR;
-	git__free(map);
+
+	if (--entry->refcount == 0) {
+		map_cache_idle_push(entry);
+		evicted = map_cache_evict(REFTABLE_MAP_CACHE_IDLE_MAX, REFTABLE_MAP_CACHE_IDLE_BYTES);
+	}
+
+	git_mutex_unlock(&reftable_map_cache_lock);
+
+	map_cache_free_evicted(evicted);
+
 	memset(mmap, 0, sizeof(*mmap));
 	return 0;
 }
@@ -257,7 +257,8 @@ typedef enum {
 	GIT_OPT_GET_SERVER_TIMEOUT,
 	GIT_OPT_SET_USER_AGENT_PRODUCT,
 	GIT_OPT_GET_USER_AGENT_PRODUCT,
-	GIT_OPT_ADD_SSL_X509_CERT
+	GIT_OPT_ADD_SSL_X509_CERT,
+	GIT_OPT_ENABLE_REFTABLE_BACKGROUND_COMPACTION
 } git_libgit2_opt_t;
 
 /**
@@ -563,6 +564,13 @@ typedef enum {
  *      > Sets the timeout (in milliseconds) for reading from and writing
  *      > to a remote server. Set to 0 to use the system default.
  *
+ *   opts(GIT_OPT_ENABLE_REFTABLE_BACKGROUND_COMPACTION, int enabled)
+ *      > Enable or disable compacting reftable stacks in a background
+ *      > thread, instead of as part of the write that makes compaction
+ *      > necessary.  This applies to reftable databases that are opened
+ *      > afterwards, and has no effect when libgit2 is built without
+ *      > thread support.  This is disabled by default.
+ *
  * @param option Option key
  * @return 0 on success, <0 on failure
  */
@@ -162,6 +162,9 @@ typedef enum {
 	 */
 	GIT_DIFF_SHOW_UNMODIFIED = (1u << 26),
 
+	/** Use the "histogram diff" algorithm */
+	GIT_DIFF_HISTOGRAM = (1u << 27),
+
 	/** Use the "patience diff" algorithm */
 	GIT_DIFF_PATIENCE = (1u << 28),
 	/** Take extra time to find minimal diff */
@@ -468,6 +471,21 @@ typedef struct {
 	 * Defaults to "b".
 	 */
 	const char *new_prefix;
+
+	/**
+	 * The number of worker threads used to generate the patches when
+	 * iterating over (or printing) the diff.  The file contents are
+	 * loaded and diffed on the workers, but the callbacks are still
+	 * invoked on the calling thread, in delta order.  Note that any
+	 * custom filters may be invoked on the worker threads.
+	 *
+	 * `git_diff_find_similar` also uses these threads to calculate the
+	 * similarity signatures of the built-in metric.
+	 *
+	 * Defaults to 0, which (like 1) generates all the patches on the
+	 * calling thread.
+	 */
+	unsigned int threads;
 } git_diff_options;
 
 /** The current version of the diff options structure */
@@ -477,7 +495,7 @@ typedef struct {
  * `git_diff_options_init` programmatic initialization.
  */
 #define GIT_DIFF_OPTIONS_INIT \
-	{GIT_DIFF_OPTIONS_VERSION, 0, GIT_SUBMODULE_IGNORE_UNSPECIFIED, {NULL,0}, NULL, NULL, NULL, 3, 0, (git_oid_t)0, 0, 0, NULL, NULL}
+	{GIT_DIFF_OPTIONS_VERSION, 0, GIT_SUBMODULE_IGNORE_UNSPECIFIED, {NULL,0}, NULL, NULL, NULL, 3, 0, (git_oid_t)0, 0, 0, NULL, NULL, 0}
 
 /**
  * Initialize git_diff_options structure
@@ -810,6 +828,8 @@ typedef struct {
 	 *
 	 * This is a little different from the `-l` option from Git because we
 	 * will still process up to this many matches before abandoning the search.
+	 * With the built-in similarity metric, only the candidates that could
+	 * be similar enough to a file count towards this limit.
 	 * Defaults to 1000.
 	 */
 	size_t rename_limit;
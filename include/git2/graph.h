@@ -37,6 +37,33 @@ GIT_BEGIN_DECL
  */
 GIT_EXTERN(int) git_graph_ahead_behind(size_t *ahead, size_t *behind, git_repository *repo, const git_oid *local, const git_oid *upstream);
 
+/**
+ * Count the number of unique commits between each of a number of
+ * commits and a single upstream commit
+ *
+ * This computes the same values as calling `git_graph_ahead_behind`
+ * for each of the `locals` against `upstream`, but shares a single
+ * walk of the history between all of them, so that each commit is
+ * only read once.
+ *
+ * @param ahead array of `length` counts, which are set to the number of
+ *        commits in each of `locals` that are not in `upstream`
+ * @param behind array of `length` counts, which are set to the number of
+ *        commits in `upstream` that are not in each of `locals`
+ * @param repo the repository where the commits exist
+ * @param locals the commits for the locals
+ * @param length the number of commits in `locals`
+ * @param upstream the commit for upstream
+ * @return 0 or an error code.
+ */
+GIT_EXTERN(int) git_graph_ahead_behind_many(
+	size_t *ahead,
+	size_t *behind,
+	git_repository *repo,
+	const git_oid locals[],
+	size_t length,
+	const git_oid *upstream);
+
 
 /**
  * Determine if a commit is the descendant of another commit.
@@ -72,6 +99,33 @@ GIT_EXTERN(int) git_graph_reachable_from_any(
 	const git_oid descendant_array[],
 	size_t length);
 
+/**
+ * Determine, for each of a list of commits, whether a commit is reachable
+ * from it by following parent edges.
+ *
+ * This answers the same question as `git_graph_reachable_from_any` for
+ * each of the commits on its own (like `git tag --contains`), but in a
+ * single walk of the history that remembers which commits it has already
+ * found to (not) reach the given commit, and that is pruned by the
+ * generation numbers in the commit-graph, when there is one.  As with
+ * `git_graph_reachable_from_any`, a commit is reachable from itself.
+ *
+ * @param out array of `length` results, each of which is set to 1 if the
+ *        given commit is reachable from the corresponding commit in
+ *        `descendant_array`, or 0 if not
+ * @param repo the repository where the commits exist
+ * @param commit the commit to look for
+ * @param descendant_array oids of the commits
+ * @param length the number of commits in the provided `descendant_array`
+ * @return 0 or an error code.
+ */
+GIT_EXTERN(int) git_graph_reachable_from_each(
+	int *out,
+	git_repository *repo,
+	const git_oid *commit,
+	const git_oid descendant_array[],
+	size_t length);
+
 /** @} */
 GIT_END_DECL
 
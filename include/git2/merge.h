@@ -320,6 +320,19 @@ typedef struct {
 
 	/** see `git_merge_file_flag_t` above */
 	uint32_t file_flags;
+
+	/**
+	 * The number of worker threads used to merge the contents of the
+	 * conflicting files.  The merge drivers are looked up, and the
+	 * results are recorded, on the calling thread in the order of the
+	 * conflicts, so the resulting index does not depend on the number
+	 * of threads.  Only the built-in drivers are applied on the worker
+	 * threads; custom drivers are always applied on the calling thread.
+	 *
+	 * Defaults to 0, which (like 1) merges all the files on the calling
+	 * thread.
+	 */
+	unsigned int threads;
 } git_merge_options;
 
 /** Current version for the `git_merge_options` structure */
@@ -620,6 +633,38 @@ GIT_EXTERN(int) git_merge_trees(
 	const git_tree *their_tree,
 	const git_merge_options *opts);
 
+/**
+ * Merge two trees, writing the result of the merge directly as a tree,
+ * without building an index.  Subtrees that need no merging are taken
+ * from the inputs as they are, without being read.  (Without
+ * `GIT_MERGE_FIND_RENAMES`, this includes subtrees that only one side
+ * changed.)
+ *
+ * A tree cannot represent a conflict, so a path that is in conflict
+ * keeps our side of the conflict (or is left out, if we do not have it);
+ * the conflicting paths are returned in `conflicts`.  With
+ * `GIT_MERGE_FAIL_ON_CONFLICT`, a conflict instead stops the merge with
+ * `GIT_EMERGECONFLICT`.
+ *
+ * @param out pointer to store the id of the resulting tree in
+ * @param conflicts pointer to store the (sorted) paths that are in
+ *        conflict in, or NULL; it must be freed with `git_strarray_dispose`
+ * @param repo repository that contains the given trees
+ * @param ancestor_tree the common ancestor between the trees (or null if none)
+ * @param our_tree the tree that reflects the destination tree
+ * @param their_tree the tree to merge in to `our_tree`
+ * @param opts the merge tree options (or null for defaults)
+ * @return 0 on success or error code
+ */
+GIT_EXTERN(int) git_merge_trees_to_tree(
+	git_oid *out,
+	git_strarray *conflicts,
+	git_repository *repo,
+	const git_tree *ancestor_tree,
+	const git_tree *our_tree,
+	const git_tree *their_tree,
+	const git_merge_options *opts);
+
 /**
  * Merge two commits, producing a `git_index` that reflects the result of
  * the merge.  The index may be written as-is to the working directory
@@ -642,6 +687,28 @@ GIT_EXTERN(int) git_merge_commits(
 	const git_commit *their_commit,
 	const git_merge_options *opts);
 
+/**
+ * Merge two commits, writing the result of the merge directly as a
+ * tree, without building an index.  See `git_merge_trees_to_tree` for
+ * how conflicts are handled.
+ *
+ * @param out pointer to store the id of the resulting tree in
+ * @param conflicts pointer to store the (sorted) paths that are in
+ *        conflict in, or NULL; it must be freed with `git_strarray_dispose`
+ * @param repo repository that contains the given commits
+ * @param our_commit the commit that reflects the destination tree
+ * @param their_commit the commit to merge in to `our_commit`
+ * @param opts the merge tree options (or null for defaults)
+ * @return 0 on success or error code
+ */
+GIT_EXTERN(int) git_merge_commits_to_tree(
+	git_oid *out,
+	git_strarray *conflicts,
+	git_repository *repo,
+	const git_commit *our_commit,
+	const git_commit *their_commit,
+	const git_merge_options *opts);
+
 /**
  * Merges the given commit(s) into HEAD, writing the results into the working
  * directory.  Any changes are staged for commit and any conflicts are written
@@ -460,6 +460,43 @@ GIT_EXTERN(int) git_odb_open_rstream(
 	git_odb *db,
 	const git_oid *oid);
 
+/**
+ * Begin a bulk checkin on the object database.
+ *
+ * Writing many objects individually is expensive: each loose object is
+ * written to its own temporary file, optionally synced to disk, and then
+ * moved into place.  During a bulk checkin, objects written to the ODB
+ * are instead appended to a single temporary file, which is turned into
+ * a packfile (with its index) by `git_odb_bulk_checkin_commit`, with
+ * only a single sync to disk.
+ *
+ * Objects written during a bulk checkin can be read back immediately.
+ * The object database must be backed by an objects directory on disk
+ * (for example, a repository's object database).
+ *
+ * @param db object database to begin the bulk checkin in
+ * @return 0 or an error code.
+ */
+GIT_EXTERN(int) git_odb_bulk_checkin_begin(git_odb *db);
+
+/**
+ * Complete a bulk checkin, writing all the objects that were written
+ * since `git_odb_bulk_checkin_begin` into a new packfile.
+ *
+ * @param db object database with a bulk checkin in progress
+ * @return 0 or an error code.
+ */
+GIT_EXTERN(int) git_odb_bulk_checkin_commit(git_odb *db);
+
+/**
+ * Abandon a bulk checkin, discarding all the objects that were written
+ * since `git_odb_bulk_checkin_begin`.
+ *
+ * @param db object database with a bulk checkin in progress
+ * @return 0 or an error code.
+ */
+GIT_EXTERN(int) git_odb_bulk_checkin_abort(git_odb *db);
+
 /**
  * Open a stream for writing a pack file to the ODB.
  *
@@ -69,6 +69,44 @@ typedef enum {
 	GIT_REFDB_BACKEND_INIT_FORCE_HEAD = (1u << 1)
 } git_refdb_backend_init_flag_t;
 
+/**
+ * A single reference update that is handed to a backend's `unlock_many`
+ * callback.  The fields have the same meaning as the arguments of the
+ * `unlock` callback.
+ */
+typedef struct {
+	/** The payload returned by `lock`. */
+	void *payload;
+
+	/**
+	 * `1` if the reference should be updated, `2` if it should be
+	 * deleted, `0` if the lock must be discarded.
+	 */
+	int success;
+
+	/** `1` in case the reflog should be updated, `0` otherwise. */
+	int update_reflog;
+
+	/** The reference which should be unlocked. */
+	const git_reference *ref;
+
+	/** The person updating the reference. */
+	const git_signature *sig;
+
+	/** The message detailing the reference update. */
+	const char *message;
+} git_refdb_backend_unlock_entry;
+
+/**
+ * Callback for a backend's `reflog_foreach` function.
+ *
+ * @param entry The reflog entry; it is only valid during the callback.
+ * @param payload The payload passed to `reflog_foreach`.
+ * @return `0` to continue with the next (older) entry, non-zero to stop.
+ */
+typedef int GIT_CALLBACK(git_refdb_backend_reflog_foreach_cb)(
+	const git_reflog_entry *entry, void *payload);
+
 /** An instance for a custom backend */
 struct git_refdb_backend {
 	unsigned int version; /**< The backend API version */
@@ -348,6 +386,45 @@ struct git_refdb_backend {
 	 */
 	int GIT_CALLBACK(unlock)(git_refdb_backend *backend, void *payload, int success, int update_reflog,
 		      const git_reference *ref, const git_signature *sig, const char *message);
+
+	/**
+	 * Unlock a set of references at once, applying their updates as a
+	 * single batch.
+	 *
+	 * This allows a backend to apply the updates of a transaction in
+	 * one pass rather than one reference at a time.  The backend must
+	 * release every lock in `entries`, even when it fails.
+	 *
+	 * A refdb implementation may provide this function; if it is not
+	 * provided, `unlock` will be called for each entry instead.
+	 *
+	 * @param entries The references that shall be unlocked.
+	 * @param len The number of entries.
+	 * @return `0` on success, a negative error code otherwise
+	 */
+	int GIT_CALLBACK(unlock_many)(git_refdb_backend *backend,
+		git_refdb_backend_unlock_entry *entries, size_t len);
+
+	/**
+	 * Iterate over the entries of a reflog, starting with the most recent
+	 * one.
+	 *
+	 * This allows callers that are only interested in the latest entries
+	 * to stop early, without the backend reading the complete reflog.
+	 * Iteration stops when the callback returns non-zero, and that value
+	 * is returned.  A reference without a reflog has no entries.
+	 *
+	 * A refdb implementation may provide this function; if it is not
+	 * provided, the reflog will be read with `reflog_read` instead.
+	 *
+	 * @param name The name of the reference whose reflog shall be read.
+	 * @param cb The callback to call for each entry.
+	 * @param payload Payload passed to the callback.
+	 * @return `0` on success, the callback's non-zero return value, or a
+	 *         negative error code
+	 */
+	int GIT_CALLBACK(reflog_foreach)(git_refdb_backend *backend,
+		const char *name, git_refdb_backend_reflog_foreach_cb cb, void *payload);
 };
 
 /** Current version for the `git_refdb_backend_options` structure */
@@ -398,6 +475,22 @@ GIT_EXTERN(int) git_refdb_backend_reftable(
 	git_refdb_backend **backend_out,
 	git_repository *repo);
 
+/**
+ * Constructor for an in-memory refdb backend
+ *
+ * References and reflogs are kept in memory only, and are lost when the
+ * backend is freed.  Together with the mempack object database backend
+ * (see `git_mempack_new`), this allows working with a repository that
+ * never touches the filesystem.  The backend supports transactions.
+ *
+ * @param backend_out Output pointer to the git_refdb_backend object
+ * @param repo Git repository to access
+ * @return 0 on success, <0 error code on failure
+ */
+GIT_EXTERN(int) git_refdb_backend_memory(
+	git_refdb_backend **backend_out,
+	git_repository *repo);
+
 /**
  * Sets the custom backend to an existing reference DB
  *
@@ -627,6 +627,106 @@ static void release_attr_files(git_vector *files)
 	git_vector_dispose(files);
 }
 
+/*
+ * Within a session, the attribute files that apply to a path depend only
+ * on its directory (and on the lookup flags), so the stack of files that
+ * we collected for one path can be reused for its siblings.  Files are
+ * checked against their stamps once per session, when they are first
+ * collected; a stack is only reused while all of its files carry this
+ * session's key.  Lookups against a particular commit are not cached.
+ */
+static int session_stack_key(
+	git_str *out,
+	git_attr_session *attr_session,
+	git_attr_options *opts,
+	const char *dir)
+{
+	unsigned int flags = opts ? opts->flags : 0;
+
+	if (!attr_session || (flags & GIT_ATTR_CHECK_INCLUDE_COMMIT) != 0)
+		return GIT_ENOTFOUND;
+
+	return git_str_printf(out, "%x:%s", flags, dir);
+}
+
+static int session_stack_lookup(
+	git_attr_session *attr_session,
+	const char *key,
+	git_vector *files)
+{
+	git_vector *stack;
+	git_attr_file *file;
+	size_t i;
+	int error;
+
+	if (git_attr_session_stackmap_get(&stack, &attr_session->stacks, key) != 0)
+		return GIT_ENOTFOUND;
+
+	/* a file that was checked in another session must be checked again */
+	git_vector_foreach(stack, i, file) {
+		if (file->session_key != attr_session->key)
+			return GIT_ENOTFOUND;
+	}
+
+	if ((error = git_vector_init(files, stack->length, NULL)) < 0)
+		return error;
+
+	git_vector_foreach(stack, i, file) {
+		GIT_REFCOUNT_INC(file);
+
+		if ((error = git_vector_insert(files, file)) < 0) {
+			git_attr_file__free(file);
+			release_attr_files(files);
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+static int session_stack_store(
+	git_attr_session *attr_session,
+	const char *key,
+	git_vector *files)
+{
+	git_vector *stack, *existing;
+	git_attr_file *file;
+	char *stack_key;
+	size_t i;
+	int error;
+
+	stack = git__calloc(1, sizeof(git_vector));
+	GIT_ERROR_CHECK_ALLOC(stack);
+
+	if ((error = git_vector_dup(stack, files, NULL)) < 0) {
+		git__free(stack);
+		return error;
+	}
+
+	git_vector_foreach(stack, i, file)
+		GIT_REFCOUNT_INC(file);
+
+	if (git_attr_session_stackmap_get(&existing, &attr_session->stacks, key) == 0) {
+		/* replace a stack that had gone out of date */
+		git_vector_swap(existing, stack);
+		release_attr_files(stack);
+		git__free(stack);
+		return 0;
+	}
+
+	stack_key = git__strdup(key);
+
+	if (!stack_key ||
+	    (error = git_attr_session_stackmap_put(&attr_session->stacks, stack_key, stack)) < 0) {
+		release_attr_files(stack);
+		git__free(stack);
+		git__free(stack_key);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int collect_attr_files(
 	git_repository *repo,
 	git_attr_session *attr_session,
@@ -635,7 +735,7 @@ static int collect_attr_files(
 	git_vector *files)
 {
 	int error = 0;
-	git_str dir = GIT_STR_INIT, attrfile = GIT_STR_INIT;
+	git_str dir = GIT_STR_INIT, attrfile = GIT_STR_INIT, key = GIT_STR_INIT;
 	const char *workdir = git_repository_workdir(repo);
 	git_attr_cache *attrcache;
 	const char *attr_cfg_file = NULL;
@@ -658,6 +758,14 @@ static int collect_attr_files(
 	if (error < 0)
 		goto cleanup;
 
+	if ((error = session_stack_key(&key, attr_session, opts, dir.ptr)) == 0)
+		error = session_stack_lookup(attr_session, key.ptr, files);
+
+	if (error != GIT_ENOTFOUND)
+		goto cleanup;
+
+	error = 0;
+
 	/* in precedence order highest to lowest:
 	 * - $GIT_DIR/info/attributes
 	 * - path components with .gitattributes
@@ -707,10 +815,14 @@ static int collect_attr_files(
 			error = 0;
 	}
 
+	if (!error && key.size)
+		error = session_stack_store(attr_session, key.ptr, files);
+
  cleanup:
 	if (error < 0)
 		release_attr_files(files);
 	git_str_dispose(&attrfile);
+	git_str_dispose(&key);
 	git_str_dispose(&dir);
 
 	return error;
@@ -13,6 +13,7 @@
 #include "git2/blob.h"
 #include "git2/tree.h"
 #include "blob.h"
+#include "hashmap.h"
 #include "index.h"
 #include "wildmatch.h"
 #include <ctype.h>
@@ -57,6 +58,343 @@ on_error:
 	return -1;
 }
 
+/*
+ * Files with many rules are compiled into buckets, so that a path is only
+ * tested (with wildmatch) against the rules that could match it: rules
+ * with a literal basename are bucketed by that name, `*.ext` rules by
+ * their extension and full path rules by their literal leading directory.
+ * Every other rule is a candidate for every path.
+ */
+
+#define ATTR_FILE_COMPILE_MIN_RULES 16
+
+#define ATTR_FILE_MATCHER_SPECIAL "*?[\\"
+
+typedef enum {
+	ATTR_FILE_BUCKET_NAME = 0,
+	ATTR_FILE_BUCKET_EXTENSION,
+	ATTR_FILE_BUCKET_DIRECTORY,
+	ATTR_FILE_BUCKET_COUNT,
+	ATTR_FILE_BUCKET_NONE = ATTR_FILE_BUCKET_COUNT
+} attr_file_bucket_t;
+
+typedef struct {
+	const char *ptr;
+	size_t len;
+} attr_file_bucket_key;
+
+typedef git_array_t(size_t) attr_file_bucket;
+
+GIT_INLINE(uint32_t) attr_file_bucket_key_hash(attr_file_bucket_key key)
+{
+	uint32_t h = 5381;
+	size_t i;
+
+	/* fold case, so the same hash serves case-insensitive buckets */
+	for (i = 0; i < key.len; i++)
+		h = ((h << 5) + h) + (uint32_t)git__tolower(key.ptr[i]);
+
+	return h;
+}
+
+GIT_INLINE(bool) attr_file_bucket_key_equal(attr_file_bucket_key a, attr_file_bucket_key b)
+{
+	return a.len == b.len && memcmp(a.ptr, b.ptr, a.len) == 0;
+}
+
+GIT_INLINE(bool) attr_file_bucket_key_equal_icase(attr_file_bucket_key a, attr_file_bucket_key b)
+{
+	return a.len == b.len && git__strncasecmp(a.ptr, b.ptr, a.len) == 0;
+}
+
+GIT_HASHMAP_SETUP(git_attr_file_bucketmap, attr_file_bucket_key, attr_file_bucket *,
+	attr_file_bucket_key_hash, attr_file_bucket_key_equal);
+GIT_HASHMAP_SETUP(git_attr_file_bucketmap_icase, attr_file_bucket_key, attr_file_bucket *,
+	attr_file_bucket_key_hash, attr_file_bucket_key_equal_icase);
+
+struct git_attr_file_matcher {
+	/* the directory that all bucketed rules are relative to */
+	const char *containing_dir;
+
+	git_attr_file_bucketmap buckets[ATTR_FILE_BUCKET_COUNT];
+	git_attr_file_bucketmap_icase icase_buckets[ATTR_FILE_BUCKET_COUNT];
+
+	/* rules that may match any path */
+	attr_file_bucket always;
+
+	/* directory rules, which may also match the full path of files */
+	attr_file_bucket directories;
+};
+
+static void attr_file_matcher_free(git_attr_file_matcher *matcher)
+{
+	git_hashmap_iter_t iter;
+	attr_file_bucket *bucket;
+	size_t i;
+
+	if (!matcher)
+		return;
+
+	for (i = 0; i < ATTR_FILE_BUCKET_COUNT; i++) {
+		iter = GIT_HASHMAP_ITER_INIT;
+		while (git_attr_file_bucketmap_iterate(&iter, NULL, &bucket, &matcher->buckets[i]) == 0) {
+			git_array_clear(*bucket);
+			git__free(bucket);
+		}
+		git_attr_file_bucketmap_dispose(&matcher->buckets[i]);
+
+		iter = GIT_HASHMAP_ITER_INIT;
+		while (git_attr_file_bucketmap_icase_iterate(&iter, NULL, &bucket, &matcher->icase_buckets[i]) == 0) {
+			git_array_clear(*bucket);
+			git__free(bucket);
+		}
+		git_attr_file_bucketmap_icase_dispose(&matcher->icase_buckets[i]);
+	}
+
+	git_array_clear(matcher->always);
+	git_array_clear(matcher->directories);
+	git__free(matcher);
+}
+
+static int attr_file_bucket_add(attr_file_bucket *bucket, size_t idx)
+{
+	size_t *slot = git_array_alloc(*bucket);
+	GIT_ERROR_CHECK_ALLOC(slot);
+
+	*slot = idx;
+	return 0;
+}
+
+static int attr_file_matcher_add(
+	git_attr_file_matcher *matcher,
+	attr_file_bucket_t type,
+	attr_file_bucket_key key,
+	bool icase,
+	size_t idx)
+{
+	attr_file_bucket *bucket;
+	int error;
+
+	if (icase)
+		error = git_attr_file_bucketmap_icase_get(&bucket, &matcher->icase_buckets[type], key);
+	else
+		error = git_attr_file_bucketmap_get(&bucket, &matcher->buckets[type], key);
+
+	if (error != 0) {
+		bucket = git__calloc(1, sizeof(attr_file_bucket));
+		GIT_ERROR_CHECK_ALLOC(bucket);
+
+		if (icase)
+			error = git_attr_file_bucketmap_icase_put(&matcher->icase_buckets[type], key, bucket);
+		else
+			error = git_attr_file_bucketmap_put(&matcher->buckets[type], key, bucket);
+
+		if (error < 0) {
+			git__free(bucket);
+			return error;
+		}
+	}
+
+	return attr_file_bucket_add(bucket, idx);
+}
+
+static attr_file_bucket_t attr_file_matcher_classify(
+	attr_file_bucket_key *key,
+	git_attr_file_matcher *matcher,
+	git_attr_fnmatch *match)
+{
+	const char *pattern = match->pattern;
+
+	/* negative attribute rules match the paths that the pattern doesn't */
+	if ((match->flags & (GIT_ATTR_FNMATCH_NEGATIVE | GIT_ATTR_FNMATCH_MATCH_ALL | GIT_ATTR_FNMATCH_MACRO)) != 0)
+		return ATTR_FILE_BUCKET_NONE;
+
+	if (!match->containing_dir != !matcher->containing_dir ||
+	    (match->containing_dir && strcmp(match->containing_dir, matcher->containing_dir) != 0))
+		return ATTR_FILE_BUCKET_NONE;
+
+	if (match->flags & GIT_ATTR_FNMATCH_FULLPATH) {
+		key->ptr = pattern;
+		key->len = strcspn(pattern, "/");
+
+		if (!key->len || strcspn(pattern, ATTR_FILE_MATCHER_SPECIAL) < key->len)
+			return ATTR_FILE_BUCKET_NONE;
+
+		return ATTR_FILE_BUCKET_DIRECTORY;
+	}
+
+	if (!pattern[strcspn(pattern, ATTR_FILE_MATCHER_SPECIAL)]) {
+		key->ptr = pattern;
+		key->len = strlen(pattern);
+		return ATTR_FILE_BUCKET_NAME;
+	}
+
+	if (pattern[0] == '*' && pattern[1] == '.' &&
+	    !pattern[1 + strcspn(pattern + 1, ATTR_FILE_MATCHER_SPECIAL "/")]) {
+		key->ptr = pattern + 1;
+		key->len = strlen(key->ptr);
+		return ATTR_FILE_BUCKET_EXTENSION;
+	}
+
+	return ATTR_FILE_BUCKET_NONE;
+}
+
+int git_attr_file__compile(git_attr_file *file)
+{
+	git_attr_file_matcher *matcher;
+	git_attr_fnmatch *match;
+	attr_file_bucket_key key;
+	attr_file_bucket_t type;
+	size_t i;
+	int error = 0;
+
+	attr_file_matcher_free(file->matcher);
+	file->matcher = NULL;
+
+	if (file->rules.length < ATTR_FILE_COMPILE_MIN_RULES)
+		return 0;
+
+	matcher = git__calloc(1, sizeof(git_attr_file_matcher));
+	GIT_ERROR_CHECK_ALLOC(matcher);
+
+	/* rules (attribute rules start with a match) share their directory */
+	match = git_vector_get(&file->rules, 0);
+	matcher->containing_dir = match->containing_dir;
+
+	git_vector_foreach(&file->rules, i, match) {
+		type = attr_file_matcher_classify(&key, matcher, match);
+
+		if (type == ATTR_FILE_BUCKET_NONE)
+			error = attr_file_bucket_add(&matcher->always, i);
+		else
+			error = attr_file_matcher_add(matcher, type, key,
+				(match->flags & GIT_ATTR_FNMATCH_ICASE) != 0, i);
+
+		if (!error && type != ATTR_FILE_BUCKET_NONE &&
+		    (match->flags & GIT_ATTR_FNMATCH_DIRECTORY))
+			error = attr_file_bucket_add(&matcher->directories, i);
+
+		if (error < 0) {
+			attr_file_matcher_free(matcher);
+			return error;
+		}
+	}
+
+	file->matcher = matcher;
+	return 0;
+}
+
+static int attr_file_candidates_add(git_attr_path *path, attr_file_bucket *bucket)
+{
+	size_t i, *idx, *slot;
+
+	git_array_foreach(*bucket, i, idx) {
+		slot = git_array_alloc(path->candidates);
+		GIT_ERROR_CHECK_ALLOC(slot);
+
+		*slot = *idx;
+	}
+
+	return 0;
+}
+
+static int attr_file_candidates_lookup(
+	git_attr_path *path,
+	git_attr_file_matcher *matcher,
+	attr_file_bucket_t type,
+	attr_file_bucket_key key)
+{
+	attr_file_bucket *bucket;
+	int error = 0;
+
+	if (git_attr_file_bucketmap_get(&bucket, &matcher->buckets[type], key) == 0)
+		error = attr_file_candidates_add(path, bucket);
+
+	if (!error && git_attr_file_bucketmap_icase_get(&bucket, &matcher->icase_buckets[type], key) == 0)
+		error = attr_file_candidates_add(path, bucket);
+
+	return error;
+}
+
+static int attr_file_candidate_cmp(const void *a, const void *b)
+{
+	size_t one = *(const size_t *)a, two = *(const size_t *)b;
+
+	return (one < two) ? -1 : (one > two) ? 1 : 0;
+}
+
+static int attr_file_candidates_collect(git_attr_path *path, git_attr_file_matcher *matcher)
+{
+	attr_file_bucket_key key;
+	const char *relpath = path->path, *ext;
+	size_t i, unique;
+	int error;
+
+	path->candidates.size = 0;
+
+	if ((error = attr_file_candidates_add(path, &matcher->always)) < 0 ||
+	    (!path->is_dir && (error = attr_file_candidates_add(path, &matcher->directories)) < 0))
+		return error;
+
+	/* no bucketed rule matches paths outside of their directory */
+	if (matcher->containing_dir) {
+		if (git__prefixcmp_icase(relpath, matcher->containing_dir) != 0)
+			goto done;
+
+		relpath += strlen(matcher->containing_dir);
+	}
+
+	key.ptr = path->basename;
+	key.len = strlen(path->basename);
+
+	if ((error = attr_file_candidates_lookup(path, matcher, ATTR_FILE_BUCKET_NAME, key)) < 0)
+		return error;
+
+	for (ext = strchr(path->basename, '.'); ext; ext = strchr(ext + 1, '.')) {
+		key.ptr = ext;
+		key.len = strlen(ext);
+
+		if ((error = attr_file_candidates_lookup(path, matcher, ATTR_FILE_BUCKET_EXTENSION, key)) < 0)
+			return error;
+	}
+
+	key.ptr = relpath;
+	key.len = strcspn(relpath, "/");
+
+	if ((error = attr_file_candidates_lookup(path, matcher, ATTR_FILE_BUCKET_DIRECTORY, key)) < 0)
+		return error;
+
+done:
+	qsort(path->candidates.ptr, path->candidates.size, sizeof(size_t), attr_file_candidate_cmp);
+
+	for (i = 0, unique = 0; i < path->candidates.size; i++) {
+		if (unique && path->candidates.ptr[unique - 1] == path->candidates.ptr[i])
+			continue;
+
+		path->candidates.ptr[unique++] = path->candidates.ptr[i];
+	}
+
+	path->candidates.size = unique;
+	return 0;
+}
+
+size_t git_attr_file__candidates(git_attr_file *file, git_attr_path *path)
+{
+	path->use_candidates = false;
+
+	if (!file->matcher)
+		return file->rules.length;
+
+	/* if we can't narrow the rules down, simply test all of them */
+	if (attr_file_candidates_collect(path, file->matcher) < 0) {
+		git_error_clear();
+		return file->rules.length;
+	}
+
+	path->use_candidates = true;
+	return path->candidates.size;
+}
+
 int git_attr_file__clear_rules(git_attr_file *file, bool need_lock)
 {
 	unsigned int i;
@@ -67,6 +405,9 @@ int git_attr_file__clear_rules(git_attr_file *file, bool need_lock)
 		return -1;
 	}
 
+	attr_file_matcher_free(file->matcher);
+	file->matcher = NULL;
+
 	git_vector_foreach(&file->rules, i, rule)
 		git_attr_rule__free(rule);
 	git_vector_dispose(&file->rules);
@@ -398,6 +739,8 @@ int git_attr_file__parse_buffer(
 		rule = NULL;
 	}
 
+	error = git_attr_file__compile(attrs);
+
 out:
 	git_mutex_unlock(&attrs->lock);
 	git_attr_rule__free(rule);
@@ -571,6 +914,8 @@ int git_attr_path__init(
 
 	/* build full path as best we can */
 	git_str_init(&info->full, 0);
+	git_array_init(info->candidates);
+	info->use_candidates = false;
 
 	if (git_fs_path_join_unrooted(&info->full, path, base, &root) < 0)
 		return -1;
@@ -618,6 +963,7 @@ int git_attr_path__init(
 void git_attr_path__free(git_attr_path *info)
 {
 	git_str_dispose(&info->full);
+	git_array_clear(info->candidates);
 	info->path = NULL;
 	info->basename = NULL;
 }
@@ -1017,6 +1363,8 @@ void git_attr_rule__free(git_attr_rule *rule)
 	git__free(rule);
 }
 
+GIT_HASHMAP_STR_FUNCTIONS(git_attr_session_stackmap, , git_vector *);
+
 int git_attr_session__init(git_attr_session *session, git_repository *repo)
 {
 	GIT_ASSERT_ARG(repo);
@@ -1029,9 +1377,26 @@ int git_attr_session__init(git_attr_session *session, git_repository *repo)
 
 void git_attr_session__free(git_attr_session *session)
 {
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	const char *key;
+	git_vector *files;
+	git_attr_file *file;
+	size_t i;
+
 	if (!session)
 		return;
 
+	while (git_attr_session_stackmap_iterate(&iter, &key, &files, &session->stacks) == 0) {
+		git_vector_foreach(files, i, file)
+			git_attr_file__free(file);
+
+		git_vector_dispose(files);
+		git__free(files);
+		git__free((char *)key);
+	}
+
+	git_attr_session_stackmap_dispose(&session->stacks);
+
 	git_str_dispose(&session->sysdir);
 	git_str_dispose(&session->tmp);
 
@@ -11,10 +11,12 @@
 
 #include "git2/oid.h"
 #include "git2/attr.h"
+#include "array.h"
 #include "vector.h"
 #include "pool.h"
 #include "str.h"
 #include "futils.h"
+#include "hashmap_str.h"
 
 #define GIT_ATTR_FILE			".gitattributes"
 #define GIT_ATTR_FILE_INREPO	"attributes"
@@ -97,6 +99,7 @@ typedef struct {
 } git_attr_assignment;
 
 typedef struct git_attr_file_entry git_attr_file_entry;
+typedef struct git_attr_file_matcher git_attr_file_matcher;
 
 typedef struct {
 	git_refcount rc;
@@ -104,6 +107,7 @@ typedef struct {
 	git_attr_file_entry *entry;
 	git_attr_file_source source;
 	git_vector rules;			/* vector of <rule*> or <fnmatch*> */
+	git_attr_file_matcher *matcher;		/* rules bucketed by literal parts */
 	git_pool pool;
 	unsigned int nonexistent:1;
 	int session_key;
@@ -124,18 +128,31 @@ typedef struct {
 	char    *path;
 	char    *basename;
 	int      is_dir;
+
+	/* indices of the rules of a compiled file that may match the path */
+	git_array_t(size_t) candidates;
+	bool     use_candidates;
 } git_attr_path;
 
 /* A git_attr_session can provide an "instance" of reading, to prevent cache
  * invalidation during a single operation instance (like checkout).
  */
 
+GIT_HASHMAP_STR_STRUCT(git_attr_session_stackmap, git_vector *);
+GIT_HASHMAP_STR_PROTOTYPES(git_attr_session_stackmap, git_vector *);
+
 typedef struct {
 	int key;
 	unsigned int init_setup:1,
 		init_sysdir:1;
 	git_str sysdir;
 	git_str tmp;
+
+	/* the attribute files that apply to each directory, keyed by the
+	 * lookup flags and the directory; these are reused for every path
+	 * in that directory that is looked up during the session.
+	 */
+	git_attr_session_stackmap stacks;
 } git_attr_session;
 
 extern int git_attr_session__init(git_attr_session *attr_session, git_repository *repo);
@@ -188,6 +205,30 @@ int git_attr_file__parse_buffer(
 int git_attr_file__clear_rules(
 	git_attr_file *file, bool need_lock);
 
+/*
+ * Bucket the rules of a file (that has many rules) by their literal
+ * basename, extension or leading directory, so that only the rules that
+ * may match a path need to be tested.  Must be called with the file
+ * locked, whenever its rules change.
+ */
+int git_attr_file__compile(git_attr_file *file);
+
+/*
+ * Prepare to test the rules of the file that may match the path, returning
+ * their number; `git_attr_file__candidate` returns each of them, in the
+ * order that they appear in the file.
+ */
+size_t git_attr_file__candidates(git_attr_file *file, git_attr_path *path);
+
+GIT_INLINE(void *) git_attr_file__candidate(
+	git_attr_file *file, git_attr_path *path, size_t i)
+{
+	if (path->use_candidates)
+		i = path->candidates.ptr[i];
+
+	return git_vector_get(&file->rules, i);
+}
+
 int git_attr_file__lookup_one(
 	git_attr_file *file,
 	git_attr_path *path,
@@ -196,7 +237,8 @@ int git_attr_file__lookup_one(
 
 /* loop over rules in file from bottom to top */
 #define git_attr_file__foreach_matching_rule(file, path, iter, rule)	\
-	git_vector_rforeach(&(file)->rules, (iter), (rule)) \
+	for ((iter) = git_attr_file__candidates((file), (path)); \
+	     (iter) > 0 && ((rule) = git_attr_file__candidate((file), (path), --(iter))) != NULL; ) \
 		if (git_attr_rule__match((rule), (path)))
 
 uint32_t git_attr_file__name_hash(const char *name);
@@ -271,6 +271,9 @@ int git_attr_cache__get(
 		error = git_attr_file__load(&updated, repo, attr_session,
 		                            entry, source, parser,
 		                            allow_macros);
+	/* an up-to-date file need not be checked again during this session */
+	else if (!error && attr_session)
+		file->session_key = attr_session->key;
 
 	/* if we loaded the file, insert into and/or update cache */
 	if (updated) {
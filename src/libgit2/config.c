@@ -12,6 +12,8 @@
 
 #include "buf.h"
 #include "config_backend.h"
+#include "config_list.h"
+#include "hashmap_str.h"
 #include "regexp.h"
 #include "sysdir.h"
 #include "transaction.h"
@@ -68,11 +70,211 @@ static void backend_instance_free(backend_instance *instance)
 	git__free(instance);
 }
 
+/*
+ * Read-only configurations (eg, snapshots) never change, so lookups that
+ * would otherwise walk every entry of every backend (multivars and globs)
+ * are served from a view that is compiled on first use: all the entries,
+ * in the order that iteration yields them, and a map from each name to
+ * its values, in the same order.
+ *
+ * The view is refcounted, and holds a reference to each backend whose
+ * entries it contains, so that iterators using it stay valid when the
+ * configuration's backends change underneath them.
+ */
+
+typedef struct {
+	git_array_t(git_config_backend_entry *) entries;
+} config_view_var;
+
+GIT_HASHMAP_STR_SETUP(git_config_view_varmap, config_view_var *);
+
+struct git_config_view {
+	git_refcount rc;
+
+	/* false when the backends' entries can't be held on to */
+	bool supported;
+
+	git_vector instances;
+	git_vector entries;
+	git_config_view_varmap vars;
+};
+
+static void config_view_free(git_config_view *view)
+{
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	backend_instance *instance;
+	config_view_var *var;
+	size_t i;
+
+	if (!view)
+		return;
+
+	git_vector_foreach(&view->instances, i, instance)
+		GIT_REFCOUNT_DEC(instance, backend_instance_free);
+
+	while (git_config_view_varmap_iterate(&iter, NULL, &var, &view->vars) == 0) {
+		git_array_clear(var->entries);
+		git__free(var);
+	}
+
+	git_config_view_varmap_dispose(&view->vars);
+	git_vector_dispose(&view->instances);
+	git_vector_dispose(&view->entries);
+	git__free(view);
+}
+
+static void config_view_release(git_config_view *view)
+{
+	if (view)
+		GIT_REFCOUNT_DEC(view, config_view_free);
+}
+
+static void config_view_clear(git_config *config)
+{
+	config_view_release(config->view);
+	config->view = NULL;
+}
+
+static bool config_is_compilable(const git_config *config)
+{
+	backend_entry *entry;
+	size_t i;
+
+	/* read-only backends never change their entries */
+	git_vector_foreach(&config->readers, i, entry) {
+		if (!entry->instance->backend->readonly)
+			return false;
+	}
+
+	return true;
+}
+
+static int config_view_add(git_config_view *view, git_config_backend_entry *be)
+{
+	config_view_var *var;
+	git_config_backend_entry **slot;
+
+	if (git_config_view_varmap_get(&var, &view->vars, be->entry.name) != 0) {
+		var = git__calloc(1, sizeof(config_view_var));
+		GIT_ERROR_CHECK_ALLOC(var);
+
+		if (git_config_view_varmap_put(&view->vars, be->entry.name, var) < 0) {
+			git__free(var);
+			return -1;
+		}
+	}
+
+	slot = git_array_alloc(var->entries);
+	GIT_ERROR_CHECK_ALLOC(slot);
+	*slot = be;
+
+	return git_vector_insert(&view->entries, be);
+}
+
+static int config_view_compile(git_config_view **out, const git_config *config)
+{
+	git_config_view *view;
+	git_config_iterator *iter = NULL;
+	git_config_backend_entry *be;
+	backend_entry *entry;
+	size_t i;
+	int error;
+
+	view = git__calloc(1, sizeof(git_config_view));
+	GIT_ERROR_CHECK_ALLOC(view);
+
+	GIT_REFCOUNT_INC(view);
+	view->supported = true;
+
+	if ((error = git_vector_init(&view->instances, config->readers.length, NULL)) < 0 ||
+	    (error = git_vector_init(&view->entries, 0, NULL)) < 0)
+		goto done;
+
+	git_vector_foreach(&config->readers, i, entry) {
+		if ((error = git_vector_insert(&view->instances, entry->instance)) < 0)
+			goto done;
+
+		GIT_REFCOUNT_INC(entry->instance);
+	}
+
+	if ((error = git_config_iterator_new(&iter, config)) < 0)
+		goto done;
+
+	while ((error = iter->next(&be, iter)) == 0) {
+		/*
+		 * Entries from config lists live as long as the (read-only)
+		 * backend that returned them; we know nothing about the
+		 * lifetime of other backends' entries.
+		 */
+		if (be->free != git_config_list_entry_free) {
+			view->supported = false;
+			break;
+		}
+
+		if ((error = config_view_add(view, be)) < 0)
+			goto done;
+	}
+
+	if (error == GIT_ITEROVER || !view->supported)
+		error = 0;
+
+done:
+	git_config_iterator_free(iter);
+
+	if (error < 0) {
+		config_view_free(view);
+		return error;
+	}
+
+	*out = view;
+	return 0;
+}
+
+/*
+ * Get the compiled view of the configuration, compiling it if necessary
+ * and `compile` is set.  `out` is set to NULL when there's no (usable)
+ * view; otherwise the caller must release it with `config_view_release`.
+ */
+static int config_view_get(git_config_view **out, const git_config *cfg, bool compile)
+{
+	git_config *config = (git_config *)cfg;
+	git_config_view *view, *existing;
+	int error;
+
+	*out = NULL;
+
+	if (!config_is_compilable(config))
+		return 0;
+
+	if ((view = git_atomic_load(config->view)) == NULL) {
+		if (!compile)
+			return 0;
+
+		if ((error = config_view_compile(&view, config)) < 0)
+			return error;
+
+		/* another thread may have beaten us to it */
+		if ((existing = git_atomic_compare_and_swap(&config->view, NULL, view)) != NULL) {
+			config_view_release(view);
+			view = existing;
+		}
+	}
+
+	if (view->supported) {
+		GIT_REFCOUNT_INC(view);
+		*out = view;
+	}
+
+	return 0;
+}
+
 static void config_free(git_config *config)
 {
 	size_t i;
 	backend_entry *entry;
 
+	config_view_release(config->view);
+
 	git_vector_foreach(&config->readers, i, entry) {
 		GIT_REFCOUNT_DEC(entry->instance, backend_instance_free);
 		git__free(entry);
@@ -276,6 +478,8 @@ static void try_remove_existing_backend(
 	if (!found)
 		return;
 
+	config_view_clear(config);
+
 	git_vector_foreach(&config->writers, i, entry) {
 		if (entry->level == level) {
 			git_vector_remove(&config->writers, i);
@@ -316,6 +520,7 @@ static int git_config__add_instance(
 	}
 
 	GIT_REFCOUNT_INC(entry->instance);
+	config_view_clear(config);
 
 	return 0;
 }
@@ -429,6 +634,7 @@ typedef struct {
 	git_config_iterator parent;
 	git_config_iterator *current;
 	const git_config *config;
+	git_config_view *view;
 	git_regexp regex;
 	size_t i;
 } all_iter;
@@ -443,6 +649,14 @@ static int all_iter_next(
 	git_config_backend_entry *be;
 	int error = 0;
 
+	if (iter->view) {
+		if (iter->i == iter->view->entries.length)
+			return GIT_ITEROVER;
+
+		*out = git_vector_get(&iter->view->entries, iter->i++);
+		return 0;
+	}
+
 	if (iter->current != NULL &&
 	    (error = iter->current->next(&be, iter->current)) == 0) {
 		*out = be;
@@ -520,6 +734,7 @@ static void all_iter_free(git_config_iterator *_iter)
 	if (iter->current)
 		iter->current->free(iter->current);
 
+	config_view_release(iter->view);
 	git__free(iter);
 }
 
@@ -544,6 +759,15 @@ int git_config_iterator_new(git_config_iterator **out, const git_config *config)
 	iter->i = config->readers.length;
 	iter->config = config;
 
+	/* Use the compiled view, if there is one, but don't compile it */
+	if (config_view_get(&iter->view, config, false) < 0) {
+		git__free(iter);
+		return -1;
+	}
+
+	if (iter->view)
+		iter->i = 0;
+
 	*out = (git_config_iterator *) iter;
 
 	return 0;
@@ -570,6 +794,15 @@ int git_config_iterator_glob_new(git_config_iterator **out, const git_config *co
 	iter->i = config->readers.length;
 	iter->config = config;
 
+	if (config_view_get(&iter->view, config, true) < 0) {
+		git_regexp_dispose(&iter->regex);
+		git__free(iter);
+		return -1;
+	}
+
+	if (iter->view)
+		iter->i = 0;
+
 	*out = (git_config_iterator *) iter;
 
 	return 0;
@@ -787,6 +1020,8 @@ static int get_entry(
 	backend_entry *entry;
 	git_config_backend *backend;
 	git_config_backend_entry *be;
+	git_config_view *view;
+	config_view_var *var;
 	int res = GIT_ENOTFOUND;
 	const char *key = name;
 	char *normalized = NULL;
@@ -800,6 +1035,27 @@ static int get_entry(
 		key = normalized;
 	}
 
+	res = GIT_ENOTFOUND;
+
+	if ((res = config_view_get(&view, config, false)) < 0)
+		goto cleanup;
+
+	if (view) {
+		res = GIT_ENOTFOUND;
+
+		if (git_config_view_varmap_get(&var, &view->vars, key) == 0) {
+			/* the last value has the highest priority */
+			be = var->entries.ptr[var->entries.size - 1];
+			git_config_list_incref(((git_config_list_entry *)be)->config_list);
+
+			*out = &be->entry;
+			res = 0;
+		}
+
+		config_view_release(view);
+		goto done;
+	}
+
 	res = GIT_ENOTFOUND;
 	git_vector_foreach(&config->readers, i, entry) {
 		GIT_ASSERT(entry->instance && entry->instance->backend);
@@ -813,6 +1069,7 @@ static int get_entry(
 		}
 	}
 
+done:
 	git__free(normalized);
 
 cleanup:
@@ -1088,11 +1345,33 @@ int git_config_get_multivar_foreach(
 typedef struct {
 	git_config_iterator parent;
 	git_config_iterator *iter;
+	git_config_view *view;
+	config_view_var *var;
+	size_t i;
 	char *name;
 	git_regexp regex;
 	int have_regex;
 } multivar_iter;
 
+static int multivar_iter_view_next(
+	git_config_backend_entry **entry,
+	git_config_iterator *_iter)
+{
+	multivar_iter *iter = (multivar_iter *) _iter;
+
+	while (iter->var && iter->i < git_array_size(iter->var->entries)) {
+		*entry = iter->var->entries.ptr[iter->i++];
+
+		if (!iter->have_regex)
+			return 0;
+
+		if (git_regexp_match(&iter->regex, (*entry)->entry.value) == 0)
+			return 0;
+	}
+
+	return GIT_ITEROVER;
+}
+
 static int multivar_iter_next(
 	git_config_backend_entry **entry,
 	git_config_iterator *_iter)
@@ -1118,7 +1397,8 @@ static void multivar_iter_free(git_config_iterator *_iter)
 {
 	multivar_iter *iter = (multivar_iter *) _iter;
 
-	iter->iter->free(iter->iter);
+	git_config_iterator_free(iter->iter);
+	config_view_release(iter->view);
 
 	git__free(iter->name);
 	if (iter->have_regex)
@@ -1132,9 +1412,6 @@ int git_config_multivar_iterator_new(git_config_iterator **out, const git_config
 	git_config_iterator *inner = NULL;
 	int error;
 
-	if ((error = git_config_iterator_new(&inner, config)) < 0)
-		return error;
-
 	iter = git__calloc(1, sizeof(multivar_iter));
 	GIT_ERROR_CHECK_ALLOC(iter);
 
@@ -1148,17 +1425,32 @@ int git_config_multivar_iterator_new(git_config_iterator **out, const git_config
 		iter->have_regex = 1;
 	}
 
-	iter->iter = inner;
+	if ((error = config_view_get(&iter->view, config, true)) < 0)
+		goto on_error;
+
+	if (iter->view) {
+		if (git_config_view_varmap_get(&iter->var, &iter->view->vars, iter->name) != 0)
+			iter->var = NULL;
+
+		iter->parent.next = multivar_iter_view_next;
+	} else {
+		if ((error = git_config_iterator_new(&inner, config)) < 0)
+			goto on_error;
+
+		iter->iter = inner;
+		iter->parent.next = multivar_iter_next;
+	}
+
 	iter->parent.free = multivar_iter_free;
-	iter->parent.next = multivar_iter_next;
 
 	*out = (git_config_iterator *) iter;
 
 	return 0;
 
 on_error:
-
-	inner->free(inner);
+	if (iter->have_regex)
+		git_regexp_dispose(&iter->regex);
+	git__free(iter->name);
 	git__free(iter);
 	return error;
 }
@@ -22,10 +22,15 @@
 #define GIT_CONFIG_FILENAME_INREPO "config"
 #define GIT_CONFIG_FILE_MODE 0666
 
+typedef struct git_config_view git_config_view;
+
 struct git_config {
 	git_refcount rc;
 	git_vector readers;
 	git_vector writers;
+
+	/* compiled lookups for read-only configurations; built lazily */
+	git_config_view *view;
 };
 
 extern int git_config__global_location(git_str *buf);
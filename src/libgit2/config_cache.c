@@ -70,6 +70,10 @@ static git_configmap _configmap_abbrev[] = {
 	{GIT_CONFIGMAP_STRING, "auto", GIT_ABBREV_DEFAULT}
 };
 
+static git_configmap _configmap_int[] = {
+	{GIT_CONFIGMAP_INT32, NULL, 0}
+};
+
 static struct map_data _configmaps[] = {
 	{"core.autocrlf", _configmap_autocrlf, ARRAY_SIZE(_configmap_autocrlf), GIT_AUTO_CRLF_DEFAULT},
 	{"core.eol", _configmap_eol, ARRAY_SIZE(_configmap_eol), GIT_EOL_DEFAULT},
@@ -86,6 +90,10 @@ static struct map_data _configmaps[] = {
 	{"core.protectntfs", NULL, 0, GIT_PROTECTNTFS_DEFAULT },
 	{"core.fsyncobjectfiles", NULL, 0, GIT_FSYNCOBJECTFILES_DEFAULT },
 	{"core.longpaths", NULL, 0, GIT_LONGPATHS_DEFAULT },
+	{"reftable.autocompaction", NULL, 0, GIT_REFTABLE_AUTOCOMPACTION_DEFAULT },
+	{"reftable.geometricfactor", _configmap_int, ARRAY_SIZE(_configmap_int), GIT_REFTABLE_GEOMETRICFACTOR_DEFAULT },
+	{"core.hashsigcache", NULL, 0, GIT_HASHSIGCACHE_DEFAULT },
+	{"core.mergebasecache", NULL, 0, GIT_MERGEBASECACHE_DEFAULT },
 };
 
 int git_config__configmap_lookup(int *out, git_config *config, git_configmap_item item)
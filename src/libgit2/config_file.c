@@ -16,8 +16,10 @@
 #include "config_list.h"
 #include "config_parse.h"
 #include "filebuf.h"
+#include "hashmap_str.h"
 #include "refdb.h"
 #include "regexp.h"
+#include "runtime.h"
 #include "sysdir.h"
 #include "wildmatch.h"
 #include "hash.h"
@@ -27,11 +29,17 @@
 
 #define CONFIG_FILE_TYPE "file"
 
+/* Max number of parsed files kept in the process-wide cache */
+#define CONFIG_FILE_CACHE_MAX 256
+
 typedef struct config_file {
 	git_futils_filestamp stamp;
 	unsigned char checksum[GIT_HASH_SHA256_SIZE];
 	char *path;
 	git_array_t(struct config_file) includes;
+
+	/* the contents depend on the repository or the environment */
+	unsigned int volatile_includes : 1;
 } config_file;
 
 typedef struct {
@@ -101,6 +109,329 @@ static void config_file_clear(config_file *file)
 	git__free(file->path);
 }
 
+/*
+ * Parsed configuration files are cached process-wide, so that opening
+ * many repositories that share the same system and global configuration
+ * parses those files only once.  The cached lists are immutable and
+ * refcounted; every backend (and every snapshot) that opens an unchanged
+ * file shares the same list.  A cache entry is validated by the stat data
+ * of the file and of all the files it includes.
+ */
+typedef struct config_file_cache_entry {
+	char *key;
+	git_config_list *config_list;
+	config_file file;
+	struct config_file_cache_entry *prev, *next;
+} config_file_cache_entry;
+
+GIT_HASHMAP_STR_SETUP(git_config_file_cachemap, config_file_cache_entry *);
+
+static git_mutex config_file_cache_lock;
+static git_config_file_cachemap config_file_cache;
+static config_file_cache_entry *config_file_cache_head, *config_file_cache_tail;
+
+/* Copy the stamps, checksums and includes (but not the path) of a file */
+static int config_file_copy_state(config_file *out, const config_file *src)
+{
+	const config_file *include;
+	config_file *copy;
+	uint32_t i;
+	int error;
+
+	git_futils_filestamp_set(&out->stamp, &src->stamp);
+	memcpy(out->checksum, src->checksum, GIT_HASH_SHA256_SIZE);
+	out->volatile_includes = src->volatile_includes;
+
+	git_array_foreach(src->includes, i, include) {
+		copy = git_array_alloc(out->includes);
+		GIT_ERROR_CHECK_ALLOC(copy);
+		memset(copy, 0, sizeof(*copy));
+		git_array_init(copy->includes);
+
+		copy->path = git__strdup(include->path);
+		GIT_ERROR_CHECK_ALLOC(copy->path);
+
+		if ((error = config_file_copy_state(copy, include)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+static bool config_file_is_cacheable(const config_file *file, time_t now)
+{
+	const config_file *include;
+	uint32_t i;
+
+	if (file->volatile_includes)
+		return false;
+
+	/*
+	 * A file that was modified within the last second may be modified
+	 * again without its stat data changing; don't trust it until it
+	 * has settled.
+	 */
+	if (file->stamp.mtime.tv_sec >= now - 1)
+		return false;
+
+	git_array_foreach(file->includes, i, include) {
+		if (!config_file_is_cacheable(include, now))
+			return false;
+	}
+
+	return true;
+}
+
+static bool config_file_is_unchanged(const config_file *file)
+{
+	const config_file *include;
+	git_futils_filestamp stamp;
+	uint32_t i;
+	int error;
+
+	git_futils_filestamp_set(&stamp, &file->stamp);
+	error = git_futils_filestamp_check(&stamp, file->path);
+
+	/* An include that didn't exist is unchanged while it still doesn't */
+	if (error == GIT_ENOTFOUND)
+		error = file->stamp.mtime.tv_sec ? 1 : 0;
+
+	if (error)
+		return false;
+
+	git_array_foreach(file->includes, i, include) {
+		if (!config_file_is_unchanged(include))
+			return false;
+	}
+
+	return true;
+}
+
+static int config_file_cache_key(git_str *out, const config_file *file, git_config_level_t level)
+{
+	/* Relative paths depend on the working directory */
+	if (!git_fs_path_is_absolute(file->path))
+		return GIT_ENOTFOUND;
+
+	return git_str_printf(out, "%d:%s", (int)level, file->path);
+}
+
+static void config_file_cache_unlink(config_file_cache_entry *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		config_file_cache_head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		config_file_cache_tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+static void config_file_cache_link(config_file_cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = config_file_cache_head;
+
+	if (config_file_cache_head)
+		config_file_cache_head->prev = entry;
+	else
+		config_file_cache_tail = entry;
+
+	config_file_cache_head = entry;
+}
+
+static void config_file_cache_entry_free(config_file_cache_entry *entry)
+{
+	if (!entry)
+		return;
+
+	config_file_clear(&entry->file);
+	git_config_list_free(entry->config_list);
+	git__free(entry->key);
+	git__free(entry);
+}
+
+static void config_file_cache_remove(config_file_cache_entry *entry)
+{
+	git_config_file_cachemap_remove(&config_file_cache, entry->key);
+	config_file_cache_unlink(entry);
+	config_file_cache_entry_free(entry);
+}
+
+/*
+ * Look up the parsed contents of the file in the cache.  On success,
+ * the shared list is returned and the stamps and includes of the cached
+ * file are copied into `file`.
+ */
+static int config_file_cache_get(
+	git_config_list **out,
+	config_file *file,
+	git_config_level_t level)
+{
+	config_file_cache_entry *entry;
+	git_config_list *config_list = NULL;
+	git_str key = GIT_STR_INIT;
+	int error;
+
+	if ((error = config_file_cache_key(&key, file, level)) < 0)
+		goto done;
+
+	if ((error = git_mutex_lock(&config_file_cache_lock)) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to lock config file cache");
+		goto done;
+	}
+
+	if (git_config_file_cachemap_get(&entry, &config_file_cache, key.ptr) == 0 &&
+	    (error = config_file_copy_state(file, &entry->file)) == 0) {
+		config_list = entry->config_list;
+		git_config_list_incref(config_list);
+
+		config_file_cache_unlink(entry);
+		config_file_cache_link(entry);
+	}
+
+	git_mutex_unlock(&config_file_cache_lock);
+
+	if (error < 0 || !config_list) {
+		error = (error < 0) ? error : GIT_ENOTFOUND;
+		goto done;
+	}
+
+	/* Stat the files outside of the lock; drop the entry if it's stale */
+	if (!config_file_is_unchanged(file)) {
+		if (git_mutex_lock(&config_file_cache_lock) == 0) {
+			if (git_config_file_cachemap_get(&entry, &config_file_cache, key.ptr) == 0 &&
+			    entry->config_list == config_list)
+				config_file_cache_remove(entry);
+
+			git_mutex_unlock(&config_file_cache_lock);
+		}
+
+		git_config_list_free(config_list);
+		error = GIT_ENOTFOUND;
+		goto done;
+	}
+
+	*out = config_list;
+
+done:
+	git_str_dispose(&key);
+	return error;
+}
+
+static int config_file_cache_put(
+	const config_file *file,
+	git_config_level_t level,
+	git_config_list *config_list)
+{
+	config_file_cache_entry *entry, *existing;
+	git_str key = GIT_STR_INIT;
+	int error;
+
+	if (!config_file_is_cacheable(file, time(NULL)))
+		return 0;
+
+	if ((error = config_file_cache_key(&key, file, level)) < 0)
+		return (error == GIT_ENOTFOUND) ? 0 : error;
+
+	entry = git__calloc(1, sizeof(config_file_cache_entry));
+	GIT_ERROR_CHECK_ALLOC(entry);
+
+	entry->key = git_str_detach(&key);
+	git_array_init(entry->file.includes);
+
+	if ((error = config_file_copy_state(&entry->file, file)) < 0)
+		goto done;
+
+	if ((error = git_mutex_lock(&config_file_cache_lock)) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to lock config file cache");
+		goto done;
+	}
+
+	if (git_config_file_cachemap_get(&existing, &config_file_cache, entry->key) == 0)
+		config_file_cache_remove(existing);
+
+	if ((error = git_config_file_cachemap_put(&config_file_cache, entry->key, entry)) == 0) {
+		git_config_list_incref(config_list);
+		entry->config_list = config_list;
+
+		config_file_cache_link(entry);
+		entry = NULL;
+
+		while (git_config_file_cachemap_size(&config_file_cache) > CONFIG_FILE_CACHE_MAX)
+			config_file_cache_remove(config_file_cache_tail);
+	}
+
+	git_mutex_unlock(&config_file_cache_lock);
+
+done:
+	config_file_cache_entry_free(entry);
+	return error;
+}
+
+static void config_file_cache_global_shutdown(void)
+{
+	while (config_file_cache_head)
+		config_file_cache_remove(config_file_cache_head);
+
+	git_config_file_cachemap_dispose(&config_file_cache);
+	git_mutex_free(&config_file_cache_lock);
+}
+
+int git_config_file_global_init(void)
+{
+	int error;
+
+	if ((error = git_mutex_init(&config_file_cache_lock)) < 0)
+		return error;
+
+	return git_runtime_shutdown_register(config_file_cache_global_shutdown);
+}
+
+static void config_file_clear_includes(config_file_backend *cfg)
+{
+	config_file *include;
+	uint32_t i;
+
+	git_array_foreach(cfg->file.includes, i, include)
+		config_file_clear(include);
+	git_array_clear(cfg->file.includes);
+}
+
+/*
+ * Read the file (and its includes) into a new list, or share the list
+ * of an earlier read of the same, unchanged file.
+ */
+static int config_file_read_cached(git_config_list **out, config_file_backend *b)
+{
+	git_config_list *config_list = NULL;
+	int error;
+
+	config_file_clear_includes(b);
+
+	if ((error = config_file_cache_get(out, &b->file, b->level)) != GIT_ENOTFOUND)
+		return error;
+
+	config_file_clear_includes(b);
+
+	if ((error = git_config_list_new(&config_list)) < 0 ||
+	    (error = config_file_read(config_list, b->repo, &b->file, b->level, 0)) < 0) {
+		git_config_list_free(config_list);
+		return error;
+	}
+
+	/* Failing to cache the file is not fatal */
+	if (config_file_cache_put(&b->file, b->level, config_list) < 0)
+		git_error_clear();
+
+	*out = config_list;
+	return 0;
+}
+
 static int config_file_open(git_config_backend *cfg, git_config_level_t level, const git_repository *repo)
 {
 	config_file_backend *b = GIT_CONTAINER_OF(cfg, config_file_backend, parent);
@@ -109,11 +440,8 @@ static int config_file_open(git_config_backend *cfg, git_config_level_t level, c
 	b->level = level;
 	b->repo = repo;
 
-	if ((res = git_config_list_new(&b->config_list)) < 0)
-		return res;
-
 	if (!git_fs_path_exists(b->file.path))
-		return 0;
+		return git_config_list_new(&b->config_list);
 
 	/*
 	 * git silently ignores configuration files that are not
@@ -121,15 +449,14 @@ static int config_file_open(git_config_backend *cfg, git_config_level_t level, c
 	 * important for sandboxed applications on macOS where the
 	 * git configuration files may not be readable.
 	 */
-	if (p_access(b->file.path, R_OK) < 0)
-		return GIT_ENOTFOUND;
+	if (p_access(b->file.path, R_OK) < 0) {
+		if ((res = git_config_list_new(&b->config_list)) < 0)
+			return res;
 
-	if (res < 0 || (res = config_file_read(b->config_list, repo, &b->file, level, 0)) < 0) {
-		git_config_list_free(b->config_list);
-		b->config_list = NULL;
+		return GIT_ENOTFOUND;
 	}
 
-	return res;
+	return config_file_read_cached(&b->config_list, b);
 }
 
 static int config_file_is_modified(int *modified, config_file *file)
@@ -168,16 +495,6 @@ out:
 	return error;
 }
 
-static void config_file_clear_includes(config_file_backend *cfg)
-{
-	config_file *include;
-	uint32_t i;
-
-	git_array_foreach(cfg->file.includes, i, include)
-		config_file_clear(include);
-	git_array_clear(cfg->file.includes);
-}
-
 static int config_file_set_entries(git_config_backend *cfg, git_config_list *config_list)
 {
 	config_file_backend *b = GIT_CONTAINER_OF(cfg, config_file_backend, parent);
@@ -239,10 +556,7 @@ static int config_file_refresh(git_config_backend *cfg)
 	if (!modified)
 		return 0;
 
-	config_file_clear_includes(b);
-
-	if ((error = git_config_list_new(&config_list)) < 0 ||
-	    (error = config_file_read(config_list, b->repo, &b->file, b->level, 0)) < 0 ||
+	if ((error = config_file_read_cached(&config_list, b)) < 0 ||
 	    (error = config_file_set_entries(cfg, config_list)) < 0)
 		goto out;
 
@@ -271,25 +585,38 @@ static int config_file_iterator(
 	struct git_config_backend *backend)
 {
 	config_file_backend *b = GIT_CONTAINER_OF(backend, config_file_backend, parent);
-	git_config_list *dupped = NULL, *config_list = NULL;
+	git_config_list *config_list = NULL;
 	int error;
 
+	/*
+	 * Lists are never modified once read (writes replace the list),
+	 * so the iterator can simply hold on to the current one.
+	 */
 	if ((error = config_file_refresh(backend)) < 0 ||
 	    (error = config_file_take_list(&config_list, b)) < 0 ||
-	    (error = git_config_list_dup(&dupped, config_list)) < 0 ||
-	    (error = git_config_list_iterator_new(iter, dupped)) < 0)
+	    (error = git_config_list_iterator_new(iter, config_list)) < 0)
 		goto out;
 
 out:
-	/* Let iterator delete duplicated config_list when it's done */
 	git_config_list_free(config_list);
-	git_config_list_free(dupped);
 	return error;
 }
 
 static int config_file_snapshot(git_config_backend **out, git_config_backend *backend)
 {
-	return git_config_backend_snapshot(out, backend);
+	config_file_backend *b = GIT_CONTAINER_OF(backend, config_file_backend, parent);
+	git_config_list *config_list = NULL;
+	int error;
+
+	if ((error = config_file_refresh(backend)) < 0 ||
+	    (error = config_file_take_list(&config_list, b)) < 0)
+		goto out;
+
+	error = git_config_backend_snapshot_from_list(out, config_list);
+
+out:
+	git_config_list_free(config_list);
+	return error;
 }
 
 static int config_file_set(git_config_backend *cfg, const char *name, const char *value)
@@ -572,6 +899,9 @@ static int parse_include(config_file_parse_data *parse_data, const char *file)
 	if (!file)
 		return 0;
 
+	if (file[0] == '~')
+		parse_data->file->volatile_includes = 1;
+
 	if ((result = git_fs_path_dirname_r(&path, parse_data->file->path)) < 0)
 		return result;
 
@@ -735,6 +1065,9 @@ static int parse_conditional_include(config_file_parse_data *parse_data, const c
 	size_t section_len, i;
 	int error = 0, matches;
 
+	/* Whether the file is included depends on the repository */
+	parse_data->file->volatile_includes = 1;
+
 	if (!parse_data->repo || !file)
 		return 0;
 
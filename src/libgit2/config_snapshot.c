@@ -28,17 +28,16 @@ static int config_snapshot_iterator(
 	struct git_config_backend *backend)
 {
 	config_snapshot_backend *b = GIT_CONTAINER_OF(backend, config_snapshot_backend, parent);
-	git_config_list *config_list = NULL;
-	int error;
 
-	if ((error = git_config_list_dup(&config_list, b->config_list)) < 0 ||
-	    (error = git_config_list_iterator_new(iter, config_list)) < 0)
-		goto out;
+	/* The list is immutable; the iterator just keeps a reference */
+	return git_config_list_iterator_new(iter, b->config_list);
+}
 
-out:
-	/* Let iterator delete duplicated config_list when it's done */
-	git_config_list_free(config_list);
-	return error;
+static int config_snapshot_snapshot(git_config_backend **out, git_config_backend *backend)
+{
+	config_snapshot_backend *b = GIT_CONTAINER_OF(backend, config_snapshot_backend, parent);
+
+	return git_config_backend_snapshot_from_list(out, b->config_list);
 }
 
 static int config_snapshot_get(
@@ -145,6 +144,10 @@ static int config_snapshot_open(git_config_backend *cfg, git_config_level_t leve
 	GIT_UNUSED(level);
 	GIT_UNUSED(repo);
 
+	/* Snapshots of a list share it rather than copying it */
+	if (b->config_list)
+		return 0;
+
 	if ((error = git_config_list_new(&config_list)) < 0 ||
 	    (error = b->source->iterator(&it, b->source)) < 0)
 		goto out;
@@ -186,7 +189,7 @@ int git_config_backend_snapshot(git_config_backend **out, git_config_backend *so
 	backend->parent.get = config_snapshot_get;
 	backend->parent.set = config_snapshot_set;
 	backend->parent.set_multivar = config_snapshot_set_multivar;
-	backend->parent.snapshot = git_config_backend_snapshot;
+	backend->parent.snapshot = config_snapshot_snapshot;
 	backend->parent.del = config_snapshot_delete;
 	backend->parent.del_multivar = config_snapshot_delete_multivar;
 	backend->parent.iterator = config_snapshot_iterator;
@@ -198,3 +201,19 @@ int git_config_backend_snapshot(git_config_backend **out, git_config_backend *so
 
 	return 0;
 }
+
+int git_config_backend_snapshot_from_list(git_config_backend **out, git_config_list *config_list)
+{
+	config_snapshot_backend *backend;
+	int error;
+
+	if ((error = git_config_backend_snapshot(out, NULL)) < 0)
+		return error;
+
+	backend = GIT_CONTAINER_OF(*out, config_snapshot_backend, parent);
+
+	git_config_list_incref(config_list);
+	backend->config_list = config_list;
+
+	return 0;
+}
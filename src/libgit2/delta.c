@@ -630,3 +630,212 @@ fail:
 	git_error_set(GIT_ERROR_INVALID, "failed to apply delta");
 	return -1;
 }
+
+/*
+ * Streaming delta application
+ */
+
+static int delta_stream_error(void)
+{
+	git_error_set(GIT_ERROR_INVALID, "failed to apply delta");
+	return -1;
+}
+
+/* returns the number of buffered delta bytes, reading more if needed */
+static ssize_t delta_stream_fill(git_delta_stream *stream)
+{
+	ssize_t read;
+
+	if (stream->in_pos < stream->in_len || stream->in_eof)
+		return (ssize_t)(stream->in_len - stream->in_pos);
+
+	if ((read = stream->read_cb(stream->in, sizeof(stream->in), stream->payload)) < 0)
+		return read;
+
+	stream->in_pos = 0;
+	stream->in_len = (size_t)read;
+	stream->in_eof = (read == 0);
+
+	return read;
+}
+
+static int delta_stream_getc(unsigned char *out, git_delta_stream *stream)
+{
+	ssize_t available;
+
+	if ((available = delta_stream_fill(stream)) < 0)
+		return (int)available;
+	else if (!available)
+		return delta_stream_error();
+
+	*out = stream->in[stream->in_pos++];
+	return 0;
+}
+
+static int delta_stream_hdr_sz(size_t *size, git_delta_stream *stream)
+{
+	unsigned char c = 0;
+	unsigned shift = 0;
+	size_t r = 0;
+	int error;
+
+	do {
+		if ((error = delta_stream_getc(&c, stream)) < 0)
+			return error;
+		if (shift >= sizeof(size_t) * 8)
+			return delta_stream_error();
+		r |= (((size_t)c) & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	*size = r;
+	return 0;
+}
+
+int git_delta_stream_init(
+	git_delta_stream *stream,
+	const unsigned char *base,
+	size_t base_len,
+	git_delta_stream_read_cb read_cb,
+	void *payload)
+{
+	size_t base_sz;
+	int error;
+
+	GIT_ASSERT_ARG(stream);
+	GIT_ASSERT_ARG(base || !base_len);
+	GIT_ASSERT_ARG(read_cb);
+
+	memset(stream, 0, sizeof(git_delta_stream));
+	stream->base = base;
+	stream->base_len = base_len;
+	stream->read_cb = read_cb;
+	stream->payload = payload;
+
+	/*
+	 * Check that the base size matches the data we were given;
+	 * if not we would underflow while accessing data from the
+	 * base object, resulting in data corruption or segfault.
+	 */
+	if ((error = delta_stream_hdr_sz(&base_sz, stream)) < 0 ||
+	    base_sz != base_len) {
+		git_error_set(GIT_ERROR_INVALID, "failed to apply delta: base size does not match given data");
+		return -1;
+	}
+
+	if ((error = delta_stream_hdr_sz(&stream->res_len, stream)) < 0)
+		return error;
+
+	stream->res_remain = stream->res_len;
+	return 0;
+}
+
+static int delta_stream_next_op(git_delta_stream *stream)
+{
+	unsigned char cmd, c = 0;
+	int error;
+
+	if ((error = delta_stream_getc(&cmd, stream)) < 0)
+		return error;
+
+	if (cmd & 0x80) {
+		/* cmd is a copy instruction; copy from the base. */
+		size_t off = 0, len = 0, end;
+
+#define ADD_DELTA(o, shift) { if ((error = delta_stream_getc(&c, stream)) < 0) return error; (o) |= ((unsigned) c << shift); }
+		if (cmd & 0x01) ADD_DELTA(off, 0UL);
+		if (cmd & 0x02) ADD_DELTA(off, 8UL);
+		if (cmd & 0x04) ADD_DELTA(off, 16UL);
+		if (cmd & 0x08) ADD_DELTA(off, 24UL);
+
+		if (cmd & 0x10) ADD_DELTA(len, 0UL);
+		if (cmd & 0x20) ADD_DELTA(len, 8UL);
+		if (cmd & 0x40) ADD_DELTA(len, 16UL);
+		if (!len)       len = 0x10000;
+#undef ADD_DELTA
+
+		if (GIT_ADD_SIZET_OVERFLOW(&end, off, len) ||
+		    stream->base_len < end || stream->res_remain < len)
+			return delta_stream_error();
+
+		stream->copy_src = stream->base + off;
+		stream->op_remain = len;
+	} else if (cmd) {
+		/*
+		 * cmd is a literal insert instruction; copy from
+		 * the delta stream itself.
+		 */
+		if (stream->res_remain < cmd)
+			return delta_stream_error();
+
+		stream->copy_src = NULL;
+		stream->op_remain = cmd;
+	} else {
+		/* cmd == 0 is reserved for future encodings. */
+		return delta_stream_error();
+	}
+
+	return 0;
+}
+
+ssize_t git_delta_stream_read(
+	git_delta_stream *stream,
+	void *out,
+	size_t out_len)
+{
+	unsigned char *out_ptr = out;
+	size_t total = 0;
+	ssize_t available;
+	int error;
+
+	GIT_ASSERT_ARG(stream);
+	GIT_ASSERT_ARG(out || !out_len);
+
+	if (out_len > SSIZE_MAX)
+		out_len = SSIZE_MAX;
+
+	while (out_len && !stream->done) {
+		size_t chunk;
+
+		if (!stream->op_remain) {
+			if (!stream->res_remain) {
+				/* the delta must not have any trailing data */
+				if ((available = delta_stream_fill(stream)) < 0)
+					return available;
+				else if (available)
+					return delta_stream_error();
+
+				stream->done = 1;
+				break;
+			}
+
+			if ((error = delta_stream_next_op(stream)) < 0)
+				return error;
+		}
+
+		chunk = min(stream->op_remain, out_len);
+
+		if (stream->copy_src) {
+			memcpy(out_ptr, stream->copy_src, chunk);
+			stream->copy_src += chunk;
+		} else {
+			if ((available = delta_stream_fill(stream)) < 0)
+				return available;
+			else if (!available)
+				return delta_stream_error();
+
+			chunk = min(chunk, (size_t)available);
+			memcpy(out_ptr, stream->in + stream->in_pos, chunk);
+			stream->in_pos += chunk;
+		}
+
+		out_ptr += chunk;
+		out_len -= chunk;
+		total += chunk;
+
+		stream->op_remain -= chunk;
+		stream->res_remain -= chunk;
+	}
+
+	return (ssize_t)total;
+}
@@ -133,4 +133,74 @@ extern int git_delta_read_header_fromstream(
 	size_t *result_out,
 	git_packfile_stream *stream);
 
+/**
+ * Callback used by a streaming delta applier to read more of the delta.
+ * Returns the number of bytes read into `buf` (0 at the end of the
+ * delta), or an error code.
+ */
+typedef ssize_t (*git_delta_stream_read_cb)(
+	void *buf,
+	size_t len,
+	void *payload);
+
+#define GIT_DELTA_STREAM_BUFSIZE 4096
+
+/**
+ * A streaming delta applier.  Rather than requiring the entire delta
+ * and producing the entire result, it reads the copy and insert
+ * instructions incrementally and produces output on demand, so that
+ * only the base needs to be in memory.
+ */
+typedef struct {
+	const unsigned char *base;
+	size_t base_len;
+
+	/** the size of the result, as specified in the delta header */
+	size_t res_len;
+	size_t res_remain;
+
+	git_delta_stream_read_cb read_cb;
+	void *payload;
+
+	/* the buffered delta input */
+	unsigned char in[GIT_DELTA_STREAM_BUFSIZE];
+	size_t in_pos;
+	size_t in_len;
+	unsigned int in_eof : 1,
+	             done : 1;
+
+	/* the instruction currently being applied; `copy_src` is NULL for inserts */
+	const unsigned char *copy_src;
+	size_t op_remain;
+} git_delta_stream;
+
+/**
+ * Initialize a streaming delta applier and read the delta header.
+ *
+ * @param stream the stream to initialize
+ * @param base the base to copy from during copy instructions; it must
+ *        remain valid for the lifetime of the stream.
+ * @param base_len number of bytes available at base.
+ * @param read_cb the callback to read the delta data.
+ * @param payload the payload for the read callback.
+ * @return 0 on success or an error code
+ */
+extern int git_delta_stream_init(
+	git_delta_stream *stream,
+	const unsigned char *base,
+	size_t base_len,
+	git_delta_stream_read_cb read_cb,
+	void *payload);
+
+/**
+ * Apply the delta to produce up to `out_len` bytes of the result.
+ *
+ * @return the number of bytes written to `out` (0 once the entire
+ *         result has been produced), or an error code.
+ */
+extern ssize_t git_delta_stream_read(
+	git_delta_stream *stream,
+	void *out,
+	size_t out_len);
+
 #endif
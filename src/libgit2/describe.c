@@ -5,7 +5,7 @@
  * a Linking Exception. For full terms see the included COPYING file.
  */
 
-#include "common.h"
+#include "describe.h"
 
 #include "git2/describe.h"
 #include "git2/diff.h"
@@ -13,6 +13,7 @@
 
 #include "buf.h"
 #include "commit.h"
+#include "commit_graph.h"
 #include "commit_list.h"
 #include "refs.h"
 #include "repository.h"
@@ -136,6 +137,7 @@ static int retrieve_peeled_tag_or_object_oid(
 	git_oid *peeled_out,
 	git_oid *ref_target_out,
 	git_repository *repo,
+	git_peel_cache *peel_cache,
 	const char *refname)
 {
 	git_reference *ref;
@@ -145,11 +147,18 @@ static int retrieve_peeled_tag_or_object_oid(
 	if ((error = git_reference_lookup_resolved(&ref, repo, refname, -1)) < 0)
 		return error;
 
-	if ((error = git_reference_peel(&peeled, ref, GIT_OBJECT_ANY)) < 0)
-		goto cleanup;
-
 	git_oid_cpy(ref_target_out, git_reference_target(ref));
-	git_oid_cpy(peeled_out, git_object_id(peeled));
+
+	/* tags that we have peeled before needn't be loaded again */
+	if ((error = git_peel_cache_lookup(peeled_out, peel_cache, ref_target_out)) == GIT_ENOTFOUND) {
+		if ((error = git_reference_peel(&peeled, ref, GIT_OBJECT_ANY)) < 0 ||
+		    (error = git_peel_cache_add(peel_cache, ref_target_out, git_object_id(peeled))) < 0)
+			goto cleanup;
+
+		git_oid_cpy(peeled_out, git_object_id(peeled));
+	} else if (error < 0) {
+		goto cleanup;
+	}
 
 	if (git_oid_cmp(ref_target_out, peeled_out) != 0)
 		error = 1; /* The reference was pointing to a annotated tag */
@@ -176,6 +185,7 @@ struct get_name_data
 {
 	git_describe_options *opts;
 	git_repository *repo;
+	git_peel_cache *peel_cache;
 	git_describe_oidmap names;
 	git_describe_result *result;
 };
@@ -224,7 +234,7 @@ static int get_name(const char *refname, void *payload)
 
 	/* Is it annotated? */
 	if ((error = retrieve_peeled_tag_or_object_oid(
-		&peeled, &sha1, data->repo, refname)) < 0)
+		&peeled, &sha1, data->repo, data->peel_cache, refname)) < 0)
 		return error;
 
 	is_annotated = error;
@@ -418,6 +428,65 @@ static int show_suffix(
 
 #define MAX_CANDIDATES_TAGS FLAG_BITS - 1
 
+/*
+ * Finds the lowest generation of the commits that are named, so that a
+ * walk that has found no names can stop once everything that is left to
+ * walk is below it.  This is 0 (no bound) when there is no commit-graph,
+ * or when a named commit is not in it.
+ */
+static int min_name_generation(uint32_t *out, struct get_name_data *data)
+{
+	git_odb *odb;
+	git_commit_graph_file *cgraph_file = NULL;
+	git_commit_graph_entry e;
+	git_hashmap_iter_t iter = GIT_HASHMAP_INIT;
+	struct commit_name *name;
+	git_object_t type;
+	size_t size, min = SIZE_MAX;
+	int error;
+
+	*out = 0;
+
+	if ((error = git_repository_odb__weakptr(&odb, data->repo)) < 0)
+		return error;
+
+	if (git_odb__get_commit_graph_file(&cgraph_file, odb) < 0) {
+		git_error_clear();
+		return 0;
+	}
+
+	while (git_describe_oidmap_iterate(&iter, NULL, &name, &data->names) == 0) {
+		if (git_commit_graph_entry_find(&e, cgraph_file, &name->peeled,
+				git_oid_hexsize(data->repo->oid_type)) == 0) {
+			min = min(min, e.generation);
+			continue;
+		}
+
+		git_error_clear();
+
+		/* names of other objects are never reached by the walk */
+		if ((error = git_odb_read_header(&size, &type, odb, &name->peeled)) < 0)
+			return error;
+
+		if (type == GIT_OBJECT_COMMIT)
+			return 0;
+	}
+
+	if (min != SIZE_MAX && git__is_uint32(min))
+		*out = (uint32_t)min;
+
+	return 0;
+}
+
+/*
+ * Whether a commit, or any of its ancestors, may be named: anything
+ * below the lowest named generation cannot be.
+ */
+GIT_INLINE(bool) may_reach_name(git_commit_list_node *c, uint32_t min_generation)
+{
+	return !min_generation || !c->generation || c->generation >= min_generation;
+}
+
 static int describe_not_found(const git_oid *oid, const char *message_format) {
 	char oid_str[GIT_OID_MAX_HEXSIZE + 1];
 	git_oid_tostr(oid_str, sizeof(oid_str), oid);
@@ -428,18 +497,20 @@ static int describe_not_found(const git_oid *oid, const char *message_format) {
 
 static int describe(
 	struct get_name_data *data,
+	git_revwalk *walk,
 	git_commit *commit)
 {
 	struct commit_name *n;
 	struct possible_tag *best;
 	bool all, tags;
-	git_revwalk *walk = NULL;
 	git_pqueue list;
 	git_commit_list_node *cmit, *gave_up_on = NULL;
 	git_vector all_matches = GIT_VECTOR_INIT;
 	unsigned int match_cnt = 0, annotated_cnt = 0, cur_match;
 	unsigned long seen_commits = 0;	/* TODO: Check long */
 	unsigned int unannotated_cnt = 0;
+	uint32_t min_generation;
+	size_t hopeful_cnt = 0;
 	int error;
 
 	if (git_vector_init(&all_matches, MAX_CANDIDATES_TAGS, compare_pt) < 0)
@@ -473,7 +544,7 @@ static int describe(
 		goto cleanup;
 	}
 
-	if ((error = git_revwalk_new(&walk, git_commit_owner(commit))) < 0)
+	if ((error = min_name_generation(&min_generation, data)) < 0)
 		goto cleanup;
 
 	if ((cmit = git_revwalk__commit_lookup(walk, git_commit_id(commit))) == NULL)
@@ -487,6 +558,9 @@ static int describe(
 	if ((error = git_pqueue_insert(&list, cmit)) < 0)
 		goto cleanup;
 
+	if (may_reach_name(cmit, min_generation))
+		hopeful_cnt++;
+
 	while (git_pqueue_size(&list) > 0)
 	{
 		int i;
@@ -494,6 +568,9 @@ static int describe(
 		git_commit_list_node *c = (git_commit_list_node *)git_pqueue_pop(&list);
 		seen_commits++;
 
+		if (may_reach_name(c, min_generation))
+			hopeful_cnt--;
+
 		n = find_commit_name(&data->names, &c->oid);
 
 		if (n) {
@@ -542,14 +619,25 @@ static int describe(
 			git_commit_list_node *p = c->parents[i];
 			if ((error = git_commit_list_parse(walk, p)) < 0)
 				goto cleanup;
-			if (!(p->flags & SEEN))
+			if (!(p->flags & SEEN)) {
 				if ((error = git_pqueue_insert(&list, p)) < 0)
 					goto cleanup;
+
+				if (may_reach_name(p, min_generation))
+					hopeful_cnt++;
+			}
 			p->flags |= c->flags;
 
 			if (data->opts->only_follow_first_parent)
 				break;
 		}
+
+		/*
+		 * Without any candidates, the walk only looks for names, and
+		 * there are none left to find.
+		 */
+		if (!match_cnt && !hopeful_cnt)
+			break;
 	}
 
 	if (!match_cnt) {
@@ -631,7 +719,6 @@ cleanup:
 	}
 	git_vector_dispose(&all_matches);
 	git_pqueue_free(&list);
-	git_revwalk_free(walk);
 	return error;
 }
 
@@ -650,19 +737,21 @@ static int normalize_options(
 	return 0;
 }
 
-int git_describe_commit(
+int git_describe__commit(
 	git_describe_result **result,
+	git_revwalk *walk,
 	git_object *committish,
 	git_describe_options *opts)
 {
 	struct get_name_data data = {0};
 	struct commit_name *name;
-	git_commit *commit;
+	git_commit *commit = NULL;
 	git_describe_options normalized;
 	git_hashmap_iter_t iter = GIT_HASHMAP_INIT;
 	int error = -1;
 
 	GIT_ASSERT_ARG(result);
+	GIT_ASSERT_ARG(walk);
 	GIT_ASSERT_ARG(committish);
 
 	data.result = git__calloc(1, sizeof(git_describe_result));
@@ -682,7 +771,8 @@ int git_describe_commit(
 
 	/** TODO: contains to be implemented */
 
-	if ((error = git_object_peel((git_object **)(&commit), committish, GIT_OBJECT_COMMIT)) < 0)
+	if ((error = git_object_peel((git_object **)(&commit), committish, GIT_OBJECT_COMMIT)) < 0 ||
+	    (error = git_repository__peel_cache(&data.peel_cache, data.repo)) < 0)
 		goto cleanup;
 
 	if ((error = git_reference_foreach_name(
@@ -697,7 +787,7 @@ int git_describe_commit(
 		goto cleanup;
 	}
 
-	if ((error = describe(&data, commit)) < 0)
+	if ((error = describe(&data, walk, commit)) < 0)
 		goto cleanup;
 
 cleanup:
@@ -719,6 +809,26 @@ cleanup:
 	return error;
 }
 
+int git_describe_commit(
+	git_describe_result **result,
+	git_object *committish,
+	git_describe_options *opts)
+{
+	git_revwalk *walk;
+	int error;
+
+	GIT_ASSERT_ARG(result);
+	GIT_ASSERT_ARG(committish);
+
+	if ((error = git_revwalk_new(&walk, git_object_owner(committish))) < 0)
+		return error;
+
+	error = git_describe__commit(result, walk, committish, opts);
+
+	git_revwalk_free(walk);
+	return error;
+}
+
 int git_describe_workdir(
 	git_describe_result **out,
 	git_repository *repo,
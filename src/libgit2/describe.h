@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_describe_h__
+#define INCLUDE_describe_h__
+
+#include "common.h"
+
+#include "git2/describe.h"
+#include "revwalk.h"
+
+/*
+ * Like `git_describe_commit`, but walks (and leaves behind the commits
+ * that it parsed in) the given revision walk.
+ */
+extern int git_describe__commit(
+	git_describe_result **result,
+	git_revwalk *walk,
+	git_object *committish,
+	git_describe_options *opts);
+
+#endif
@@ -14,6 +14,7 @@
 #include "commit.h"
 #include "index.h"
 #include "diff_generate.h"
+#include "patch_generate.h"
 
 #include "git2/version.h"
 #include "git2/sys/email.h"
@@ -122,6 +123,22 @@ int git_diff_get_perfdata(git_diff_perfdata *out, const git_diff *diff)
 	return 0;
 }
 
+typedef struct {
+	git_diff_file_cb file_cb;
+	git_diff_binary_cb binary_cb;
+	git_diff_hunk_cb hunk_cb;
+	git_diff_line_cb data_cb;
+	void *payload;
+} diff_foreach_data;
+
+static int diff_foreach_patch(git_patch_generated *patch, void *payload)
+{
+	diff_foreach_data *data = payload;
+
+	return git_patch__invoke_callbacks(&patch->base, data->file_cb,
+		data->binary_cb, data->hunk_cb, data->data_cb, data->payload);
+}
+
 int git_diff_foreach(
 	git_diff *diff,
 	git_diff_file_cb file_cb,
@@ -136,6 +153,15 @@ int git_diff_foreach(
 
 	GIT_ASSERT_ARG(diff);
 
+	if (diff->type == GIT_DIFF_TYPE_GENERATED && diff->opts.threads > 1) {
+		diff_foreach_data data = {
+			file_cb, binary_cb, hunk_cb, data_cb, payload
+		};
+
+		return git_patch_generated_foreach(diff, NULL,
+			diff_foreach_patch, &data, diff->opts.threads);
+	}
+
 	git_vector_foreach(&diff->deltas, idx, delta) {
 		git_patch *patch;
 
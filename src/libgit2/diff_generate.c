@@ -17,6 +17,7 @@
 #include "index.h"
 #include "odb.h"
 #include "submodule.h"
+#include "tree.h"
 
 #define DIFF_FLAG_IS_SET(DIFF,FLAG) \
 	(((DIFF)->base.opts.flags & (FLAG)) != 0)
@@ -440,15 +441,14 @@ static void diff_generated_free(git_diff *d)
 
 static git_diff_generated *diff_generated_alloc(
 	git_repository *repo,
-	git_iterator *old_iter,
-	git_iterator *new_iter)
+	git_iterator_t old_src,
+	git_iterator_t new_src,
+	bool ignore_case)
 {
 	git_diff_generated *diff;
 	git_diff_options dflt = GIT_DIFF_OPTIONS_INIT;
 
 	GIT_ASSERT_ARG_WITH_RETVAL(repo, NULL);
-	GIT_ASSERT_ARG_WITH_RETVAL(old_iter, NULL);
-	GIT_ASSERT_ARG_WITH_RETVAL(new_iter, NULL);
 
 	if ((diff = git__calloc(1, sizeof(git_diff_generated))) == NULL)
 		return NULL;
@@ -456,8 +456,8 @@ static git_diff_generated *diff_generated_alloc(
 	GIT_REFCOUNT_INC(&diff->base);
 	diff->base.type = GIT_DIFF_TYPE_GENERATED;
 	diff->base.repo = repo;
-	diff->base.old_src = old_iter->type;
-	diff->base.new_src = new_iter->type;
+	diff->base.old_src = old_src;
+	diff->base.new_src = new_src;
 	diff->base.patch_fn = git_patch_generated_from_diff;
 	diff->base.free_fn = diff_generated_free;
 	git_attr_session__init(&diff->base.attrsession, repo);
@@ -469,12 +469,7 @@ static git_diff_generated *diff_generated_alloc(
 		return NULL;
 	}
 
-	/* Use case-insensitive compare if either iterator has
-	 * the ignore_case bit set */
-	diff_set_ignore_case(
-		&diff->base,
-		git_iterator_ignore_case(old_iter) ||
-		git_iterator_ignore_case(new_iter));
+	diff_set_ignore_case(&diff->base, ignore_case);
 
 	return diff;
 }
@@ -1269,7 +1264,14 @@ int git_diff__from_iterators(
 
 	*out = NULL;
 
-	diff = diff_generated_alloc(repo, old_iter, new_iter);
+	GIT_ASSERT_ARG(old_iter);
+	GIT_ASSERT_ARG(new_iter);
+
+	/* Use case-insensitive compare if either iterator has
+	 * the ignore_case bit set */
+	diff = diff_generated_alloc(repo, old_iter->type, new_iter->type,
+		git_iterator_ignore_case(old_iter) ||
+		git_iterator_ignore_case(new_iter));
 	GIT_ERROR_CHECK_ALLOC(diff);
 
 	info.repo = repo;
@@ -1364,6 +1366,257 @@ static int diff_prepare_iterator_opts(char **prefix, git_iterator_options *a, in
 	return 0;
 }
 
+/*
+ * Diffing two trees does not need the generality of the iterators: the
+ * entries of two trees can be walked in lockstep, subtrees with the same
+ * id can be skipped without being read, and only the entries that differ
+ * need a full path.  This produces the same deltas, in the same order, as
+ * iterating over both trees; options that depend on the iteration itself
+ * (case folding, unmodified or tree typechange records, progress and
+ * prefiltered pathspecs) use the iterators instead.
+ */
+static bool diff_trees_is_simple(const git_diff_options *opts)
+{
+	if (!opts)
+		return true;
+
+	if ((opts->flags & (GIT_DIFF_IGNORE_CASE |
+	                    GIT_DIFF_INCLUDE_UNMODIFIED |
+	                    GIT_DIFF_INCLUDE_TYPECHANGE_TREES)) != 0)
+		return false;
+
+	if ((opts->flags & GIT_DIFF_DISABLE_PATHSPEC_MATCH) != 0 &&
+	    opts->pathspec.count)
+		return false;
+
+	return !opts->progress_cb;
+}
+
+GIT_INLINE(void) diff_trees_entry(
+	git_index_entry *out,
+	const git_tree_entry *entry,
+	const char *path)
+{
+	memset(out, 0, sizeof(git_index_entry));
+
+	out->mode = entry->attr;
+	out->path = path;
+	git_oid_cpy(&out->id, &entry->oid);
+}
+
+static int diff_trees(
+	git_diff_generated *diff,
+	git_str *path,
+	const char *prefix,
+	const git_tree *old_tree,
+	const git_tree *new_tree);
+
+static int diff_trees_one_side(
+	git_diff_generated *diff,
+	git_str *path,
+	const char *prefix,
+	const git_tree_entry *entry,
+	bool is_old)
+{
+	git_index_entry item;
+	git_tree *tree;
+	int error;
+
+	if (!git_tree_entry__is_tree(entry)) {
+		diff_trees_entry(&item, entry, path->ptr);
+
+		return is_old ?
+			diff_delta__from_one(diff, GIT_DELTA_DELETED, &item, NULL) :
+			diff_delta__from_one(diff, GIT_DELTA_ADDED, NULL, &item);
+	}
+
+	if ((error = git_tree_lookup(&tree, diff->base.repo, &entry->oid)) < 0 ||
+	    (error = git_str_putc(path, '/')) < 0)
+		return error;
+
+	error = is_old ?
+		diff_trees(diff, path, prefix, tree, NULL) :
+		diff_trees(diff, path, prefix, NULL, tree);
+
+	git_tree_free(tree);
+	return error;
+}
+
+static int diff_trees_matched(
+	git_diff_generated *diff,
+	git_str *path,
+	const char *prefix,
+	const git_tree_entry *old_entry,
+	const git_tree_entry *new_entry)
+{
+	git_index_entry oitem, nitem;
+	git_tree *old_tree = NULL, *new_tree = NULL;
+	const char *matched_pathspec;
+	git_delta_t status = GIT_DELTA_MODIFIED;
+	int error;
+
+	if (git_tree_entry__is_tree(old_entry)) {
+		if ((error = git_tree_lookup(&old_tree, diff->base.repo, &old_entry->oid)) == 0 &&
+		    (error = git_tree_lookup(&new_tree, diff->base.repo, &new_entry->oid)) == 0 &&
+		    (error = git_str_putc(path, '/')) == 0)
+			error = diff_trees(diff, path, prefix, old_tree, new_tree);
+
+		git_tree_free(old_tree);
+		git_tree_free(new_tree);
+		return error;
+	}
+
+	diff_trees_entry(&oitem, old_entry, path->ptr);
+	diff_trees_entry(&nitem, new_entry, path->ptr);
+
+	if (!diff_pathspec_match(&matched_pathspec, diff, &oitem))
+		return 0;
+
+	/* if basic type of file changed, then split into delete and add */
+	if (GIT_MODE_TYPE(oitem.mode) != GIT_MODE_TYPE(nitem.mode)) {
+		if (DIFF_FLAG_IS_SET(diff, GIT_DIFF_INCLUDE_TYPECHANGE)) {
+			status = GIT_DELTA_TYPECHANGE;
+		} else {
+			if (!(error = diff_delta__from_one(diff, GIT_DELTA_DELETED, &oitem, NULL)))
+				error = diff_delta__from_one(diff, GIT_DELTA_ADDED, NULL, &nitem);
+			return error;
+		}
+	}
+
+	/* if mode is GITLINK and submodules are ignored, then skip */
+	else if (S_ISGITLINK(nitem.mode) &&
+	         DIFF_FLAG_IS_SET(diff, GIT_DIFF_IGNORE_SUBMODULES)) {
+		return 0;
+	}
+
+	return diff_delta__from_two(diff, status, &oitem, oitem.mode,
+		&nitem, nitem.mode, NULL, matched_pathspec);
+}
+
+/*
+ * A subtree only needs to be walked when it can contain paths that match
+ * the pathspec: when it lies on the way to the pathspec's literal prefix,
+ * or within it.
+ */
+static bool diff_trees_in_prefix(const char *prefix, const git_str *path)
+{
+	size_t prefix_len;
+
+	if (!prefix)
+		return true;
+
+	prefix_len = strlen(prefix);
+
+	if (prefix_len <= path->size)
+		return strncmp(path->ptr, prefix, prefix_len) == 0;
+
+	return strncmp(prefix, path->ptr, path->size) == 0 &&
+	       prefix[path->size] == '/';
+}
+
+static int diff_trees(
+	git_diff_generated *diff,
+	git_str *path,
+	const char *prefix,
+	const git_tree *old_tree,
+	const git_tree *new_tree)
+{
+	size_t old_count = old_tree ? git_array_size(old_tree->entries) : 0,
+	       new_count = new_tree ? git_array_size(new_tree->entries) : 0,
+	       oi = 0, ni = 0, path_len = path->size;
+	const git_tree_entry *old_entry, *new_entry;
+	int cmp, error = 0;
+
+	while (!error && (oi < old_count || ni < new_count)) {
+		old_entry = oi < old_count ? &old_tree->entries.ptr[oi] : NULL;
+		new_entry = ni < new_count ? &new_tree->entries.ptr[ni] : NULL;
+
+		cmp = old_entry ?
+			(new_entry ? git_tree_entry_cmp(old_entry, new_entry) : -1) : 1;
+
+		/* identical files and subtrees produce no deltas */
+		if (cmp == 0 && old_entry->attr == new_entry->attr &&
+		    git_oid_equal(&old_entry->oid, &new_entry->oid)) {
+			oi++;
+			ni++;
+			continue;
+		}
+
+		git_str_truncate(path, path_len);
+
+		if (cmp < 0)
+			git_str_put(path, old_entry->filename, old_entry->filename_len);
+		else
+			git_str_put(path, new_entry->filename, new_entry->filename_len);
+
+		if (git_str_oom(path))
+			return -1;
+
+		/* entries with the same name are either both trees or neither */
+		if (git_tree_entry__is_tree(cmp < 0 ? old_entry : new_entry) &&
+		    !diff_trees_in_prefix(prefix, path)) {
+			if (cmp <= 0)
+				oi++;
+			if (cmp >= 0)
+				ni++;
+
+			continue;
+		}
+
+		if (cmp < 0) {
+			error = diff_trees_one_side(diff, path, prefix, old_entry, true);
+			oi++;
+		} else if (cmp > 0) {
+			error = diff_trees_one_side(diff, path, prefix, new_entry, false);
+			ni++;
+		} else {
+			error = diff_trees_matched(diff, path, prefix, old_entry, new_entry);
+			oi++;
+			ni++;
+		}
+	}
+
+	git_str_truncate(path, path_len);
+	return error;
+}
+
+static int diff_tree_to_tree_simple(
+	git_diff **out,
+	git_repository *repo,
+	git_tree *old_tree,
+	git_tree *new_tree,
+	const git_diff_options *opts)
+{
+	git_diff_generated *diff;
+	git_str path = GIT_STR_INIT;
+	char *prefix = NULL;
+	int error;
+
+	GIT_ERROR_CHECK_VERSION(opts, GIT_DIFF_OPTIONS_VERSION, "git_diff_options");
+
+	diff = diff_generated_alloc(repo,
+		old_tree ? GIT_ITERATOR_TREE : GIT_ITERATOR_EMPTY,
+		new_tree ? GIT_ITERATOR_TREE : GIT_ITERATOR_EMPTY,
+		false);
+	GIT_ERROR_CHECK_ALLOC(diff);
+
+	/* like the iterators, only walk the trees within the pathspec's prefix */
+	if (opts)
+		prefix = git_pathspec_prefix(&opts->pathspec);
+
+	if ((error = diff_generated_apply_options(diff, opts)) == 0)
+		error = diff_trees(diff, &path, prefix, old_tree, new_tree);
+
+	if (!error)
+		*out = &diff->base;
+	else
+		git_diff_free(&diff->base);
+
+	git_str_dispose(&path);
+	git__free(prefix);
+	return error;
+}
+
 int git_diff_tree_to_tree(
 	git_diff **out,
 	git_repository *repo,
@@ -1384,6 +1637,9 @@ int git_diff_tree_to_tree(
 
 	*out = NULL;
 
+	if (diff_trees_is_simple(opts))
+		return diff_tree_to_tree_simple(out, repo, old_tree, new_tree, opts);
+
 	/* for tree to tree diff, be case sensitive even if the index is
 	 * currently case insensitive, unless the user explicitly asked
 	 * for case insensitivity
@@ -174,12 +174,116 @@ static int diff_file_stats_summary_to_buf(
 	return 0;
 }
 
+static void diff_stats_accumulate(
+	git_diff_stats *stats,
+	const git_diff_delta *delta,
+	size_t add,
+	size_t remove)
+{
+	size_t namelen;
+
+	/* Length calculation for renames mirrors the actual presentation format
+	 * generated in diff_file_stats_full_to_buf; namelen is the full length of
+	 * what will be printed, taking into account renames and common prefixes.
+	 */
+	namelen = strlen(delta->new_file.path);
+	if (delta->old_file.path &&
+	    strcmp(delta->old_file.path, delta->new_file.path) != 0) {
+		size_t common_dirlen;
+		if ((common_dirlen = git_fs_path_common_dirlen(delta->old_file.path, delta->new_file.path)) &&
+		    common_dirlen <= INT_MAX) {
+			namelen += strlen(delta->old_file.path) + 2 +
+			           strlen(DIFF_RENAME_FILE_SEPARATOR) - common_dirlen;
+		} else {
+			namelen += strlen(delta->old_file.path) +
+			           strlen(DIFF_RENAME_FILE_SEPARATOR);
+		}
+	}
+
+	stats->insertions += add;
+	stats->deletions += remove;
+
+	if (stats->max_name < namelen)
+		stats->max_name = namelen;
+	if (stats->max_filestat < add + remove)
+		stats->max_filestat = add + remove;
+}
+
+static int diff_stats_count_line(
+	const git_diff_delta *delta,
+	const git_diff_hunk *hunk,
+	const git_diff_line *line,
+	void *payload)
+{
+	diff_file_stats *filestat = payload;
+
+	GIT_UNUSED(delta);
+	GIT_UNUSED(hunk);
+
+	if (line->origin == GIT_DIFF_LINE_ADDITION)
+		filestat->insertions++;
+	else if (line->origin == GIT_DIFF_LINE_DELETION)
+		filestat->deletions++;
+
+	return 0;
+}
+
+/*
+ * Counts the lines of a generated patch as xdiff produces them, without
+ * storing the hunks and lines; this may run on a worker thread.
+ */
+static int diff_stats_count(git_patch_generated *patch, void *payload)
+{
+	git_diff_stats *stats = payload;
+	diff_file_stats *filestat = &stats->filestats[patch->delta_index];
+
+	memset(filestat, 0, sizeof(*filestat));
+
+	return git_patch_generated_diff_lines(patch,
+		diff_stats_count_line, filestat);
+}
+
+static int diff_stats_counted(git_patch_generated *patch, void *payload)
+{
+	git_diff_stats *stats = payload;
+	diff_file_stats *filestat = &stats->filestats[patch->delta_index];
+
+	diff_stats_accumulate(stats, patch->base.delta,
+		filestat->insertions, filestat->deletions);
+
+	return 0;
+}
+
+static int diff_stats_from_patches(git_diff_stats *stats, git_diff *diff)
+{
+	size_t i, deltas = git_diff_num_deltas(diff);
+	int error = 0;
+
+	for (i = 0; i < deltas && !error; ++i) {
+		git_patch *patch = NULL;
+		size_t add = 0, remove = 0;
+
+		if ((error = git_patch_from_diff(&patch, diff, i)) < 0)
+			break;
+
+		error = git_patch_line_stats(NULL, &add, &remove, patch);
+
+		stats->filestats[i].insertions = add;
+		stats->filestats[i].deletions = remove;
+
+		diff_stats_accumulate(stats, patch->delta, add, remove);
+
+		git_patch_free(patch);
+	}
+
+	return error;
+}
+
 int git_diff_get_stats(
 	git_diff_stats **out,
 	git_diff *diff)
 {
-	size_t i, deltas;
-	size_t total_insertions = 0, total_deletions = 0;
+	size_t deltas;
 	git_diff_stats *stats = NULL;
 	int error = 0;
 
@@ -200,53 +304,17 @@ int git_diff_get_stats(
 	stats->diff = diff;
 	GIT_REFCOUNT_INC(diff);
 
-	for (i = 0; i < deltas && !error; ++i) {
-		git_patch *patch = NULL;
-		size_t add = 0, remove = 0, namelen;
-		const git_diff_delta *delta;
-
-		if ((error = git_patch_from_diff(&patch, diff, i)) < 0)
-			break;
-
-		/* Length calculation for renames mirrors the actual presentation format
-		 * generated in diff_file_stats_full_to_buf; namelen is the full length of
-		 * what will be printed, taking into account renames and common prefixes.
-		 */
-		delta = patch->delta;
-		namelen = strlen(delta->new_file.path);
-		if (delta->old_file.path &&
-		    strcmp(delta->old_file.path, delta->new_file.path) != 0) {
-			size_t common_dirlen;
-			if ((common_dirlen = git_fs_path_common_dirlen(delta->old_file.path, delta->new_file.path)) &&
-			    common_dirlen <= INT_MAX) {
-				namelen += strlen(delta->old_file.path) + 2 +
-				           strlen(DIFF_RENAME_FILE_SEPARATOR) - common_dirlen;
-			} else {
-				namelen += strlen(delta->old_file.path) +
-				           strlen(DIFF_RENAME_FILE_SEPARATOR);
-			}
-		}
-
-		/* and, of course, count the line stats */
-		error = git_patch_line_stats(NULL, &add, &remove, patch);
-
-		git_patch_free(patch);
-
-		stats->filestats[i].insertions = add;
-		stats->filestats[i].deletions = remove;
-
-		total_insertions += add;
-		total_deletions += remove;
-
-		if (stats->max_name < namelen)
-			stats->max_name = namelen;
-		if (stats->max_filestat < add + remove)
-			stats->max_filestat = add + remove;
-	}
+	/*
+	 * Only the line counts are needed, so a generated diff does not
+	 * need to build (and keep) the hunks and lines of each patch.
+	 */
+	if (diff->type == GIT_DIFF_TYPE_GENERATED)
+		error = git_patch_generated_foreach(diff, diff_stats_count,
+			diff_stats_counted, stats, diff->opts.threads);
+	else
+		error = diff_stats_from_patches(stats, diff);
 
 	stats->files_changed = deltas;
-	stats->insertions = total_insertions;
-	stats->deletions = total_deletions;
 	stats->max_digits = digits_for_value(stats->max_filestat + 1);
 
 	if (error < 0) {
@@ -16,6 +16,7 @@
 #include "fs_path.h"
 #include "futils.h"
 #include "config.h"
+#include "hashsig.h"
 
 git_diff_delta *git_diff__delta_dup(
 	const git_diff_delta *d, git_pool *pool)
@@ -239,6 +240,19 @@ int git_diff_find_similar__calc_similarity(
 	return 0;
 }
 
+int git_diff_find_similar__hashsig_cache(
+	git_hashsig_cache **out,
+	git_repository *repo,
+	const git_diff_similarity_metric *metric)
+{
+	*out = NULL;
+
+	if (!repo || metric->buffer_signature != git_diff_find_similar__hashsig_for_buf)
+		return 0;
+
+	return git_repository__hashsig_cache(out, repo);
+}
+
 #define DEFAULT_THRESHOLD 50
 #define DEFAULT_BREAK_REWRITE_THRESHOLD 60
 #define DEFAULT_RENAME_LIMIT 1000
@@ -496,6 +510,18 @@ static int similarity_sig(
 		/* if we didn't initially know the size, we might have an odb_obj
 		 * around from earlier, so convert that, otherwise load the blob now
 		 */
+		git_hashsig_cache *hashsigs;
+
+		if ((error = git_diff_find_similar__hashsig_cache(&hashsigs,
+				info->repo, opts->metric)) < 0)
+			return error;
+
+		if (hashsigs && !git_oid_is_zero(&file->id) &&
+		    (error = git_hashsig_cache_lookup(
+				(git_hashsig **)&cache[info->idx], hashsigs, &file->id,
+				GIT_DIFF_FIND_SIMILAR__HASHSIG_OPTS(opts->metric))) != GIT_ENOTFOUND)
+			return error;
+
 		if (info->odb_obj != NULL)
 			error = git_object__from_odb_object(
 				(git_object **)&info->blob, info->repo,
@@ -518,6 +544,10 @@ static int similarity_sig(
 			error = opts->metric->buffer_signature(
 				&cache[info->idx], info->file,
 				git_blob_rawcontent(info->blob), sz, opts->metric->payload);
+
+			if (!error && hashsigs && cache[info->idx] &&
+			    !git_oid_is_zero(&file->id))
+				error = git_hashsig_cache_add(hashsigs, &file->id, cache[info->idx]);
 		}
 	}
 
@@ -628,6 +658,240 @@ cleanup:
 	return error;
 }
 
+static int similarity_calc(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache,
+	size_t file_idx)
+{
+	similarity_info info;
+	int error;
+
+	if (cache[file_idx])
+		return 0;
+
+	memset(&info, 0, sizeof(info));
+
+	if ((error = similarity_init(&info, diff, file_idx)) == 0)
+		error = similarity_sig(&info, opts, cache);
+
+	similarity_unload(&info);
+	return error;
+}
+
+/* Don't bother spawning a thread for fewer signatures than this. */
+#define SIMILARITY_SIGS_MIN_PER_THREAD 16
+
+#ifdef GIT_THREADS
+
+typedef struct {
+	git_diff *diff;
+	const git_diff_find_options *opts;
+	void **cache;
+	const size_t *files;
+	int files_len;
+	git_atomic32 next;
+	git_atomic32 failed;
+} similarity_sigs_state;
+
+static void *similarity_sigs_worker(void *arg)
+{
+	similarity_sigs_state *state = arg;
+	int i;
+
+	while (!git_atomic32_get(&state->failed) &&
+	       (i = git_atomic32_inc(&state->next) - 1) < state->files_len) {
+		if (similarity_calc(state->diff, state->opts,
+				state->cache, state->files[i]) < 0)
+			git_atomic32_set(&state->failed, 1);
+	}
+
+	return NULL;
+}
+
+static void similarity_sigs_threaded(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache,
+	const size_t *files,
+	size_t files_len,
+	unsigned int nr_threads)
+{
+	similarity_sigs_state state = { 0 };
+	git_thread *threads;
+	size_t i, started = 0;
+
+	if ((threads = git__calloc(nr_threads, sizeof(git_thread))) == NULL) {
+		git_error_clear();
+		return;
+	}
+
+	state.diff = diff;
+	state.opts = opts;
+	state.cache = cache;
+	state.files = files;
+	state.files_len = (int)files_len;
+
+	for (i = 0; i < nr_threads; i++) {
+		if (git_thread_create(&threads[i], similarity_sigs_worker, &state) != 0)
+			break;
+
+		started++;
+	}
+
+	for (i = 0; i < started; i++)
+		git_thread_join(&threads[i], NULL);
+
+	git__free(threads);
+}
+
+#endif
+
+/*
+ * Calculates the signatures of all the rename sources and targets up
+ * front, on `diff->opts.threads` worker threads.  The built-in metric is
+ * safe to run concurrently (a custom one may not be); any signature that
+ * a worker failed to calculate is left for the calling thread, so that
+ * the caller sees its error.
+ */
+static int similarity_sigs(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache)
+{
+	git_array_t(size_t) files = GIT_ARRAY_INIT;
+	git_diff_delta *delta;
+	size_t i, *file;
+	unsigned int nr_threads = diff->opts.threads;
+	int error = 0;
+
+	git_vector_foreach(&diff->deltas, i, delta) {
+		if ((delta->flags & GIT_DIFF_FLAG__IS_RENAME_SOURCE) != 0) {
+			file = git_array_alloc(files);
+			GIT_ERROR_CHECK_ALLOC(file);
+			*file = 2 * i;
+		}
+
+		if ((delta->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) != 0) {
+			file = git_array_alloc(files);
+			GIT_ERROR_CHECK_ALLOC(file);
+			*file = 2 * i + 1;
+		}
+	}
+
+#ifdef GIT_THREADS
+	if (nr_threads > files.size / SIMILARITY_SIGS_MIN_PER_THREAD)
+		nr_threads = (unsigned int)(files.size / SIMILARITY_SIGS_MIN_PER_THREAD);
+
+	if (nr_threads > 1 && files.size <= INT32_MAX)
+		similarity_sigs_threaded(diff, opts, cache,
+			files.ptr, files.size, nr_threads);
+#else
+	GIT_UNUSED(nr_threads);
+#endif
+
+	git_array_foreach(files, i, file) {
+		if ((error = similarity_calc(diff, opts, cache, *file)) < 0)
+			break;
+	}
+
+	git_array_clear(files);
+	return error;
+}
+
+/*
+ * The built-in metric's signatures can be indexed, so that each rename
+ * target is only compared with the sources that could be similar enough
+ * to it, instead of with every source.
+ */
+static int similarity_index(
+	git_hashsig_index **out,
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache)
+{
+	git_hashsig_index *index;
+	git_diff_delta *delta;
+	size_t i;
+	int error;
+
+	*out = NULL;
+
+	if ((error = similarity_sigs(diff, opts, cache)) < 0 ||
+	    (error = git_hashsig_index_new(&index)) < 0)
+		return error;
+
+	git_vector_foreach(&diff->deltas, i, delta) {
+		if ((delta->flags & GIT_DIFF_FLAG__IS_RENAME_SOURCE) != 0 &&
+		    cache[2 * i] != NULL &&
+		    (error = git_hashsig_index_add(index, cache[2 * i], i)) < 0) {
+			git_hashsig_index_free(index);
+			return error;
+		}
+	}
+
+	*out = index;
+	return 0;
+}
+
+typedef git_array_t(size_t) similarity_candidates;
+
+/*
+ * Finds the rename sources that have no signature: they are not in the
+ * signature index, but they may still be exact matches for a target.
+ */
+static int similarity_unsigned_sources(
+	similarity_candidates *out,
+	git_diff *diff,
+	void **cache)
+{
+	git_diff_delta *delta;
+	size_t i, *idx;
+
+	git_vector_foreach(&diff->deltas, i, delta) {
+		if ((delta->flags & GIT_DIFF_FLAG__IS_RENAME_SOURCE) != 0 &&
+		    cache[2 * i] == NULL) {
+			idx = git_array_alloc(*out);
+			GIT_ERROR_CHECK_ALLOC(idx);
+			*idx = i;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Adds the unsigned rename sources to the candidates that were found in
+ * the signature index, keeping them in delta order, so that ties between
+ * equally similar sources are broken as they would be without the index.
+ */
+static int similarity_add_unsigned(
+	const size_t **candidates,
+	size_t *num_candidates,
+	similarity_candidates *merged,
+	const similarity_candidates *unsigned_srcs)
+{
+	const size_t *found = *candidates;
+	size_t found_len = *num_candidates, i = 0, j = 0, *idx;
+
+	merged->size = 0;
+
+	while (i < found_len || j < unsigned_srcs->size) {
+		idx = git_array_alloc(*merged);
+		GIT_ERROR_CHECK_ALLOC(idx);
+
+		if (j == unsigned_srcs->size ||
+		    (i < found_len && found[i] < unsigned_srcs->ptr[j]))
+			*idx = found[i++];
+		else
+			*idx = unsigned_srcs->ptr[j++];
+	}
+
+	*candidates = merged->ptr;
+	*num_candidates = merged->size;
+	return 0;
+}
+
 static int calc_self_similarity(
 	git_diff *diff,
 	const git_diff_find_options *opts,
@@ -829,8 +1093,14 @@ int git_diff_find_similar(
 	size_t tried_srcs = 0, tried_tgts = 0;
 	size_t num_rewrites = 0, num_updates = 0, num_bumped = 0,
 	       num_to_delete = 0;
-	size_t sigcache_size;
+	size_t sigcache_size, c, num_candidates;
 	void **sigcache = NULL; /* cache of similarity metric file signatures */
+	git_hashsig_index *sigindex = NULL;
+	git_hashsig_cache *hashsigs;
+	const size_t *candidates;
+	similarity_candidates unsigned_srcs = GIT_ARRAY_INIT,
+		merged_candidates = GIT_ARRAY_INIT;
+	int min_threshold;
 	diff_find_match *tgt2src = NULL;
 	diff_find_match *src2tgt = NULL;
 	diff_find_match *tgt2src_copy = NULL;
@@ -891,6 +1161,18 @@ int git_diff_find_similar(
 		GIT_ERROR_CHECK_ALLOC(tgt2src_copy);
 	}
 
+	/* pairs below every threshold in use can never be paired up */
+	min_threshold = min(opts.rename_threshold, opts.rename_from_rewrite_threshold);
+
+	if (FLAG_SET(&opts, GIT_DIFF_FIND_COPIES))
+		min_threshold = min(min_threshold, opts.copy_threshold);
+
+	if ((!given_opts || !given_opts->metric) &&
+	    !FLAG_SET(&opts, GIT_DIFF_FIND_EXACT_MATCH_ONLY) &&
+	    ((error = similarity_index(&sigindex, diff, &opts, sigcache)) < 0 ||
+	     (error = similarity_unsigned_sources(&unsigned_srcs, diff, sigcache)) < 0))
+		goto cleanup;
+
 	/*
 	 * Find best-fit matches for rename / copy candidates
 	 */
@@ -905,7 +1187,26 @@ find_best_matches:
 
 		tried_srcs = 0;
 
-		git_vector_foreach(&diff->deltas, s, src) {
+		if (!sigindex) {
+			candidates = NULL;
+			num_candidates = num_deltas;
+		} else if (!sigcache[2 * t + 1]) {
+			/* a target without a signature can still match exactly */
+			candidates = NULL;
+			num_candidates = num_deltas;
+		} else if ((error = git_hashsig_index_lookup(&candidates,
+				&num_candidates, sigindex, sigcache[2 * t + 1],
+				min_threshold)) < 0 ||
+			   (unsigned_srcs.size &&
+			    (error = similarity_add_unsigned(&candidates, &num_candidates,
+				&merged_candidates, &unsigned_srcs)) < 0)) {
+			goto cleanup;
+		}
+
+		for (c = 0; c < num_candidates; c++) {
+			s = candidates ? candidates[c] : c;
+			src = GIT_VECTOR_GET(&diff->deltas, s);
+
 			/* skip things that are not rename sources */
 			if ((src->flags & GIT_DIFF_FLAG__IS_RENAME_SOURCE) == 0)
 				continue;
@@ -1132,6 +1433,15 @@ split_and_delete:
 	}
 
 cleanup:
+	/* the signature cache is only an optimization; don't fail over it */
+	if (!error &&
+	    (git_diff_find_similar__hashsig_cache(&hashsigs, diff->repo, opts.metric) < 0 ||
+	     (hashsigs && git_hashsig_cache_write(hashsigs) < 0)))
+		git_error_clear();
+
+	git_hashsig_index_free(sigindex);
+	git_array_clear(unsigned_srcs);
+	git_array_clear(merged_candidates);
 	git__free(tgt2src);
 	git__free(src2tgt);
 	git__free(tgt2src_copy);
@@ -10,6 +10,7 @@
 #include "common.h"
 
 #include "diff_file.h"
+#include "hashsig_cache.h"
 
 extern int git_diff_find_similar__hashsig_for_file(
 	void **out, const git_diff_file *f, const char *path, void *p);
@@ -22,4 +23,16 @@ extern void git_diff_find_similar__hashsig_free(void *sig, void *payload);
 extern int git_diff_find_similar__calc_similarity(
 	int *score, void *siga, void *sigb, void *payload);
 
+/*
+ * Looks up the repository's signature cache for the given metric; this
+ * is NULL unless the cache is enabled and the metric is the built-in one.
+ */
+extern int git_diff_find_similar__hashsig_cache(
+	git_hashsig_cache **out,
+	git_repository *repo,
+	const git_diff_similarity_metric *metric);
+
+#define GIT_DIFF_FIND_SIMILAR__HASHSIG_OPTS(metric) \
+	((git_hashsig_option_t)(intptr_t)(metric)->payload)
+
 #endif
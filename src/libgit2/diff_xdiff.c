@@ -251,6 +251,8 @@ void git_xdiff_init(git_xdiff_output *xo, const git_diff_options *opts)
 
 	if (flags & GIT_DIFF_PATIENCE)
 		xo->params.flags |= XDF_PATIENCE_DIFF;
+	else if (flags & GIT_DIFF_HISTOGRAM)
+		xo->params.flags |= XDF_HISTOGRAM_DIFF;
 	if (flags & GIT_DIFF_MINIMAL)
 		xo->params.flags |= XDF_NEED_MINIMAL;
 
@@ -5,10 +5,12 @@
  * a Linking Exception. For full terms see the included COPYING file.
  */
 
-#include "common.h"
+#include "graph.h"
 
 #include "revwalk.h"
 #include "merge.h"
+#include "pool.h"
+#include "hashmap_oid.h"
 #include "git2/graph.h"
 
 static int interesting(git_pqueue *list, git_commit_list *roots)
@@ -174,6 +176,251 @@ on_error:
 	return -1;
 }
 
+/*
+ * The number of local commits that are compared to the upstream in a
+ * single walk.  Each commit that the walk visits carries a bit for each
+ * of them, and one for the upstream.
+ */
+#define AHEAD_BEHIND_BATCH_SIZE 255
+#define AHEAD_BEHIND_WORDS ((AHEAD_BEHIND_BATCH_SIZE + 1 + 63) / 64)
+
+GIT_HASHMAP_OID_SETUP(ahead_behind_bitmap, uint64_t *);
+
+typedef struct {
+	git_revwalk *walk;
+	git_pqueue queue;
+	git_pool pool;
+
+	/* the bits of each commit that has been visited */
+	ahead_behind_bitmap bits;
+	git_vector visited;
+
+	/* the bits of a commit that is reachable from every tip */
+	uint64_t full[AHEAD_BEHIND_WORDS];
+
+	/* the number of queued commits that are not yet STALE */
+	size_t interesting;
+} ahead_behind_state;
+
+/*
+ * Adds the given bits to the commit, and queues the commit if that
+ * changed them; a commit that is reachable from every tip is STALE.
+ */
+static int ahead_behind_mark(
+	ahead_behind_state *state,
+	git_commit_list_node *commit,
+	const uint64_t *bits)
+{
+	uint64_t *commit_bits;
+	bool changed = false, full = true;
+	size_t i;
+
+	if (ahead_behind_bitmap_get(&commit_bits, &state->bits, &commit->oid) != 0) {
+		commit_bits = git_pool_mallocz(&state->pool, AHEAD_BEHIND_WORDS);
+		GIT_ERROR_CHECK_ALLOC(commit_bits);
+
+		if (ahead_behind_bitmap_put(&state->bits, &commit->oid, commit_bits) < 0 ||
+		    git_vector_insert(&state->visited, commit) < 0)
+			return -1;
+	}
+
+	for (i = 0; i < AHEAD_BEHIND_WORDS; i++) {
+		if ((commit_bits[i] | bits[i]) != commit_bits[i]) {
+			commit_bits[i] |= bits[i];
+			changed = true;
+		}
+
+		if (commit_bits[i] != state->full[i])
+			full = false;
+	}
+
+	if (!changed)
+		return 0;
+
+	if (full && !(commit->flags & STALE)) {
+		commit->flags |= STALE;
+
+		if (commit->flags & RESULT)
+			state->interesting--;
+	}
+
+	/* RESULT marks the commits that are in the queue */
+	if (!(commit->flags & RESULT)) {
+		if (git_pqueue_insert(&state->queue, commit) < 0)
+			return -1;
+
+		commit->flags |= RESULT;
+
+		if (!(commit->flags & STALE))
+			state->interesting++;
+	}
+
+	return 0;
+}
+
+GIT_INLINE(void) ahead_behind_bit(uint64_t *bits, size_t bit)
+{
+	memset(bits, 0, sizeof(uint64_t) * AHEAD_BEHIND_WORDS);
+	bits[bit / 64] = (uint64_t)1 << (bit % 64);
+}
+
+GIT_INLINE(bool) ahead_behind_has_bit(const uint64_t *bits, size_t bit)
+{
+	return (bits[bit / 64] & ((uint64_t)1 << (bit % 64))) != 0;
+}
+
+/*
+ * Compares up to AHEAD_BEHIND_BATCH_SIZE local commits to the upstream:
+ * bit 0 is the upstream, and bit `i + 1` is the local commit `i`.  The
+ * commits are painted in generation order until every commit that is
+ * left to walk is reachable from all of the tips, and then each commit
+ * that is not counts against the tips that it is (or is not) reachable
+ * from.
+ */
+static int ahead_behind_batch(
+	size_t *ahead,
+	size_t *behind,
+	ahead_behind_state *state,
+	git_commit_list_node *upstream,
+	git_commit_list_node **locals,
+	size_t length)
+{
+	git_commit_list_node *commit;
+	uint64_t bits[AHEAD_BEHIND_WORDS], *commit_bits;
+	size_t i, j;
+	int error = 0;
+
+	memset(state->full, 0, sizeof(state->full));
+
+	for (i = 0; i <= length; i++)
+		state->full[i / 64] |= (uint64_t)1 << (i % 64);
+
+	ahead_behind_bit(bits, 0);
+
+	if ((error = ahead_behind_mark(state, upstream, bits)) < 0)
+		goto done;
+
+	for (i = 0; i < length; i++) {
+		ahead_behind_bit(bits, i + 1);
+
+		if ((error = ahead_behind_mark(state, locals[i], bits)) < 0)
+			goto done;
+	}
+
+	while (state->interesting) {
+		if ((commit = git_pqueue_pop(&state->queue)) == NULL)
+			break;
+
+		commit->flags &= ~RESULT;
+
+		if (!(commit->flags & STALE))
+			state->interesting--;
+
+		if ((error = git_commit_list_parse(state->walk, commit)) < 0)
+			goto done;
+
+		if ((error = ahead_behind_bitmap_get(&commit_bits, &state->bits, &commit->oid)) < 0)
+			goto done;
+
+		for (i = 0; i < commit->out_degree; i++) {
+			if ((error = ahead_behind_mark(state, commit->parents[i], commit_bits)) < 0)
+				goto done;
+		}
+	}
+
+	git_vector_foreach(&state->visited, i, commit) {
+		if (commit->flags & STALE)
+			continue;
+
+		if ((error = ahead_behind_bitmap_get(&commit_bits, &state->bits, &commit->oid)) < 0)
+			goto done;
+
+		for (j = 0; j < length; j++) {
+			bool in_upstream = ahead_behind_has_bit(commit_bits, 0);
+			bool in_local = ahead_behind_has_bit(commit_bits, j + 1);
+
+			if (in_local && !in_upstream)
+				ahead[j]++;
+			else if (in_upstream && !in_local)
+				behind[j]++;
+		}
+	}
+
+done:
+	git_vector_foreach(&state->visited, i, commit)
+		commit->flags &= ~(RESULT | STALE);
+
+	git_vector_clear(&state->visited);
+	ahead_behind_bitmap_clear(&state->bits);
+	git_pqueue_clear(&state->queue);
+	git_pool_clear(&state->pool);
+	state->interesting = 0;
+
+	return error;
+}
+
+int git_graph_ahead_behind_many(
+	size_t *ahead,
+	size_t *behind,
+	git_repository *repo,
+	const git_oid locals[],
+	size_t length,
+	const git_oid *upstream)
+{
+	ahead_behind_state state = {0};
+	git_commit_list_node *upstream_commit;
+	git_commit_list_node *batch[AHEAD_BEHIND_BATCH_SIZE];
+	size_t i, j, batch_size;
+	int error;
+
+	GIT_ASSERT_ARG(ahead);
+	GIT_ASSERT_ARG(behind);
+	GIT_ASSERT_ARG(repo);
+	GIT_ASSERT_ARG(locals || !length);
+	GIT_ASSERT_ARG(upstream);
+
+	memset(ahead, 0, length * sizeof(size_t));
+	memset(behind, 0, length * sizeof(size_t));
+
+	if ((error = git_revwalk_new(&state.walk, repo)) < 0 ||
+	    (error = git_pqueue_init(&state.queue, 0, 64, git_commit_list_generation_cmp)) < 0 ||
+	    (error = git_pool_init(&state.pool, sizeof(uint64_t))) < 0 ||
+	    (error = git_vector_init(&state.visited, 64, NULL)) < 0)
+		goto done;
+
+	if ((upstream_commit = git_revwalk__commit_lookup(state.walk, upstream)) == NULL) {
+		error = -1;
+		goto done;
+	}
+
+	/*
+	 * The commits are parsed once, into the revision walk, and only
+	 * their paint is reset for each batch of local commits.
+	 */
+	for (i = 0; i < length; i += batch_size) {
+		batch_size = min(length - i, AHEAD_BEHIND_BATCH_SIZE);
+
+		for (j = 0; j < batch_size; j++) {
+			if ((batch[j] = git_revwalk__commit_lookup(state.walk, &locals[i + j])) == NULL) {
+				error = -1;
+				goto done;
+			}
+		}
+
+		if ((error = ahead_behind_batch(ahead + i, behind + i,
+				&state, upstream_commit, batch, batch_size)) < 0)
+			goto done;
+	}
+
+done:
+	ahead_behind_bitmap_dispose(&state.bits);
+	git_vector_dispose(&state.visited);
+	git_pqueue_free(&state.queue);
+	git_pool_clear(&state.pool);
+	git_revwalk_free(state.walk);
+	return error;
+}
+
 int git_graph_descendant_of(git_repository *repo, const git_oid *commit, const git_oid *ancestor)
 {
 	if (git_oid_equal(commit, ancestor))
@@ -247,3 +494,186 @@ done:
 	git_revwalk_free(walk);
 	return error;
 }
+
+/*
+ * The paint of a commit in a `contains` walk: PARENT1 marks the commits
+ * that contain the target commit, and STALE marks those that do not.
+ */
+#define CONTAINS_YES PARENT1
+#define CONTAINS_NO  STALE
+
+static int contains_test(
+	git_commit_list_node *commit,
+	git_commit_list_node *target)
+{
+	if (commit == target)
+		return CONTAINS_YES;
+
+	if (commit->flags & (CONTAINS_YES | CONTAINS_NO))
+		return commit->flags & (CONTAINS_YES | CONTAINS_NO);
+
+	/* a commit cannot contain any commit of a greater generation */
+	if (commit->generation && target->generation &&
+	    commit->generation < target->generation)
+		return CONTAINS_NO;
+
+	return 0;
+}
+
+typedef struct {
+	git_commit_list_node *commit;
+	size_t parent;
+} contains_frame;
+
+typedef git_array_t(contains_frame) contains_stack;
+
+/*
+ * Parses the commit and pushes it onto the stack, unless it is below the
+ * target's generation, in which case it cannot contain the target and
+ * there is no need to walk it.
+ */
+static int contains_push(
+	contains_stack *stack,
+	git_revwalk *walk,
+	git_commit_list_node *commit,
+	git_commit_list_node *target)
+{
+	contains_frame *frame;
+	int error;
+
+	if ((error = git_commit_list_parse(walk, commit)) < 0)
+		return error;
+
+	if (contains_test(commit, target) == CONTAINS_NO) {
+		commit->flags |= CONTAINS_NO;
+		return 0;
+	}
+
+	frame = git_array_alloc(*stack);
+	GIT_ERROR_CHECK_ALLOC(frame);
+
+	frame->commit = commit;
+	frame->parent = 0;
+	return 0;
+}
+
+/*
+ * Determines whether the tip contains the target, with a depth-first
+ * walk that paints every commit that it finishes, so that later walks
+ * (from other tips) stop as soon as they reach a commit that has been
+ * painted.
+ */
+static int contains(
+	int *out,
+	contains_stack *stack,
+	git_revwalk *walk,
+	git_commit_list_node *tip,
+	git_commit_list_node *target)
+{
+	contains_frame *frame;
+	int result, error;
+
+	if ((result = contains_test(tip, target)) != 0) {
+		*out = (result == CONTAINS_YES);
+		return 0;
+	}
+
+	stack->size = 0;
+
+	if ((error = contains_push(stack, walk, tip, target)) < 0)
+		return error;
+
+	while ((frame = git_array_last(*stack)) != NULL) {
+		git_commit_list_node *commit = frame->commit;
+
+		if (frame->parent == commit->out_degree) {
+			commit->flags |= CONTAINS_NO;
+			git_array_pop(*stack);
+			continue;
+		}
+
+		/*
+		 * If we just popped the parent off of the stack (or pruned
+		 * it), then it is painted, and the test is conclusive.
+		 */
+		switch (contains_test(commit->parents[frame->parent], target)) {
+		case CONTAINS_YES:
+			commit->flags |= CONTAINS_YES;
+			git_array_pop(*stack);
+			break;
+		case CONTAINS_NO:
+			frame->parent++;
+			break;
+		default:
+			if ((error = contains_push(stack, walk,
+					commit->parents[frame->parent], target)) < 0)
+				return error;
+		}
+	}
+
+	*out = ((tip->flags & CONTAINS_YES) != 0);
+	return 0;
+}
+
+int git_graph__reachable_from_each(
+	int *out,
+	git_revwalk *walk,
+	const git_oid *commit_id,
+	const git_oid descendant_array[],
+	size_t length)
+{
+	git_commit_list_node *target, *tip;
+	contains_stack stack = GIT_ARRAY_INIT;
+	size_t i;
+	int error = 0;
+
+	/* the target's generation is needed to prune the walk */
+	if ((target = git_revwalk__commit_lookup(walk, commit_id)) == NULL)
+		return -1;
+
+	if ((error = git_commit_list_parse(walk, target)) < 0)
+		return error;
+
+	for (i = 0; i < length; i++) {
+		if ((tip = git_revwalk__commit_lookup(walk, &descendant_array[i])) == NULL) {
+			error = -1;
+			goto done;
+		}
+
+		if ((error = git_commit_list_parse(walk, tip)) < 0 ||
+		    (error = contains(&out[i], &stack, walk, tip, target)) < 0)
+			goto done;
+	}
+
+done:
+	git_array_clear(stack);
+	return error;
+}
+
+int git_graph_reachable_from_each(
+	int *out,
+	git_repository *repo,
+	const git_oid *commit_id,
+	const git_oid descendant_array[],
+	size_t length)
+{
+	git_revwalk *walk = NULL;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+	GIT_ASSERT_ARG(commit_id);
+	GIT_ASSERT_ARG(descendant_array || !length);
+
+	if (!length)
+		return 0;
+
+	if ((error = git_revwalk_new(&walk, repo)) < 0)
+		return error;
+
+	error = git_graph__reachable_from_each(out, walk,
+		commit_id, descendant_array, length);
+
+	git_revwalk_free(walk);
+	return error;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_graph_h__
+#define INCLUDE_graph_h__
+
+#include "common.h"
+
+#include "git2/graph.h"
+#include "revwalk.h"
+
+/*
+ * Like `git_graph_reachable_from_each`, but walks (and leaves behind the
+ * commits that it parsed in) the given revision walk.
+ */
+extern int git_graph__reachable_from_each(
+	int *out,
+	git_revwalk *walk,
+	const git_oid *commit_id,
+	const git_oid descendant_array[],
+	size_t length);
+
+#endif
@@ -7,8 +7,11 @@
 
 #include "common.h"
 
-#include "git2/sys/hashsig.h"
+#include "hashsig.h"
+#include "array.h"
 #include "futils.h"
+#include "hashmap.h"
+#include "pool.h"
 #include "util.h"
 
 typedef uint32_t hashsig_t;
@@ -320,6 +323,12 @@ void git_hashsig_free(git_hashsig *sig)
 	git__free(sig);
 }
 
+GIT_INLINE(int) hashsig_heap_score(
+	const hashsig_heap *a, const hashsig_heap *b, int matches)
+{
+	return HASHSIG_SCALE * (matches * 2) / (a->size + b->size);
+}
+
 static int hashsig_heap_compare(const hashsig_heap *a, const hashsig_heap *b)
 {
 	int matches = 0, i, j, cmp;
@@ -340,22 +349,26 @@ static int hashsig_heap_compare(const hashsig_heap *a, const hashsig_heap *b)
 		}
 	}
 
-	return HASHSIG_SCALE * (matches * 2) / (a->size + b->size);
+	return hashsig_heap_score(a, b, matches);
 }
 
-int git_hashsig_compare(const git_hashsig *a, const git_hashsig *b)
+static int hashsig_compare_empty(const git_hashsig *a, const git_hashsig *b)
 {
 	/* if we have no elements in either file then each file is either
 	 * empty or blank.  if we're ignoring whitespace then the files are
 	 * similar, otherwise they're dissimilar.
 	 */
-	if (a->mins.size == 0 && b->mins.size == 0) {
-		if ((!a->lines && !b->lines) ||
-			(a->opt & GIT_HASHSIG_IGNORE_WHITESPACE))
-			return HASHSIG_SCALE;
-		else
-			return 0;
-	}
+	if ((!a->lines && !b->lines) ||
+		(a->opt & GIT_HASHSIG_IGNORE_WHITESPACE))
+		return HASHSIG_SCALE;
+	else
+		return 0;
+}
+
+int git_hashsig_compare(const git_hashsig *a, const git_hashsig *b)
+{
+	if (a->mins.size == 0 && b->mins.size == 0)
+		return hashsig_compare_empty(a, b);
 
 	/* if we have fewer than the maximum number of elements, then just use
 	 * one array since the two arrays will be the same
@@ -373,3 +386,392 @@ int git_hashsig_compare(const git_hashsig *a, const git_hashsig *b)
 		return (mins + maxs) / 2;
 	}
 }
+
+GIT_INLINE(void) hashsig_put32(unsigned char *out, uint32_t value)
+{
+	value = htonl(value);
+	memcpy(out, &value, sizeof(value));
+}
+
+GIT_INLINE(uint32_t) hashsig_get32(const unsigned char *data)
+{
+	uint32_t value;
+
+	memcpy(&value, data, sizeof(value));
+	return ntohl(value);
+}
+
+GIT_INLINE(void) hashsig_put16(unsigned char *out, uint16_t value)
+{
+	value = htons(value);
+	memcpy(out, &value, sizeof(value));
+}
+
+GIT_INLINE(uint16_t) hashsig_get16(const unsigned char *data)
+{
+	uint16_t value;
+
+	memcpy(&value, data, sizeof(value));
+	return ntohs(value);
+}
+
+void git_hashsig__serialize(unsigned char *out, const git_hashsig *sig)
+{
+	unsigned char *values = out + 12;
+	int i;
+
+	memset(out, 0, GIT_HASHSIG_SERIALIZED_SIZE);
+
+	hashsig_put32(out, (uint32_t)sig->opt);
+	hashsig_put32(out + 4, (uint32_t)min(sig->lines, (size_t)UINT32_MAX));
+	hashsig_put16(out + 8, (uint16_t)sig->mins.size);
+	hashsig_put16(out + 10, (uint16_t)sig->maxs.size);
+
+	for (i = 0; i < sig->mins.size; i++)
+		hashsig_put32(values + (i * 4), sig->mins.values[i]);
+
+	values += HASHSIG_HEAP_SIZE * 4;
+
+	for (i = 0; i < sig->maxs.size; i++)
+		hashsig_put32(values + (i * 4), sig->maxs.values[i]);
+}
+
+int git_hashsig__deserialize(git_hashsig **out, const unsigned char *data)
+{
+	const unsigned char *values = data + 12;
+	git_hashsig *sig;
+	int i;
+
+	GIT_ASSERT(GIT_HASHSIG_SERIALIZED_SIZE == 12 + (2 * HASHSIG_HEAP_SIZE * 4));
+
+	sig = hashsig_alloc((git_hashsig_option_t)hashsig_get32(data));
+	GIT_ERROR_CHECK_ALLOC(sig);
+
+	sig->lines = hashsig_get32(data + 4);
+	sig->mins.size = hashsig_get16(data + 8);
+	sig->maxs.size = hashsig_get16(data + 10);
+
+	if (sig->mins.size > HASHSIG_HEAP_SIZE || sig->maxs.size > HASHSIG_HEAP_SIZE) {
+		git_error_set(GIT_ERROR_INVALID, "invalid serialized similarity signature");
+		git_hashsig_free(sig);
+		return -1;
+	}
+
+	for (i = 0; i < sig->mins.size; i++)
+		sig->mins.values[i] = hashsig_get32(values + (i * 4));
+
+	values += HASHSIG_HEAP_SIZE * 4;
+
+	for (i = 0; i < sig->maxs.size; i++)
+		sig->maxs.values[i] = hashsig_get32(values + (i * 4));
+
+	*out = sig;
+	return 0;
+}
+
+/*
+ * The index keeps a posting list for each hash that is retained by any
+ * of its signatures.  Looking up a signature walks the posting lists of
+ * its own hashes, which counts exactly the matches that the (sorted)
+ * heap comparison would find for every indexed signature that shares a
+ * hash with it; the signatures that share none have a similarity of 0
+ * and are never visited.
+ */
+
+typedef struct {
+	uint32_t sig;   /* the signature's position in the index */
+	uint32_t count; /* the number of times the hash occurs in its heap */
+} hashsig_posting;
+
+typedef git_array_t(hashsig_posting) hashsig_postings;
+
+GIT_INLINE(uint32_t) hashsig_value_hash(hashsig_t value)
+{
+	return value;
+}
+
+GIT_INLINE(bool) hashsig_value_equal(hashsig_t a, hashsig_t b)
+{
+	return a == b;
+}
+
+GIT_HASHMAP_SETUP(git_hashsig_postingmap, hashsig_t, hashsig_postings *,
+	hashsig_value_hash, hashsig_value_equal);
+
+typedef struct {
+	const git_hashsig *sig;
+	size_t id;
+} hashsig_index_entry;
+
+struct git_hashsig_index {
+	git_array_t(hashsig_index_entry) entries;
+
+	git_pool postings_pool;
+	git_hashsig_postingmap mins;
+	git_hashsig_postingmap maxs;
+
+	/* signatures without any hashes (empty or blank files) */
+	git_array_t(uint32_t) empty;
+
+	/* scratch space for lookups */
+	uint32_t *min_matches;
+	uint32_t *max_matches;
+	size_t matches_size;
+	git_array_t(uint32_t) touched;
+	git_array_t(size_t) found;
+};
+
+int git_hashsig_index_new(git_hashsig_index **out)
+{
+	git_hashsig_index *index;
+
+	GIT_ASSERT_ARG(out);
+
+	index = git__calloc(1, sizeof(git_hashsig_index));
+	GIT_ERROR_CHECK_ALLOC(index);
+
+	if (git_pool_init(&index->postings_pool, sizeof(hashsig_postings)) < 0) {
+		git__free(index);
+		return -1;
+	}
+
+	*out = index;
+	return 0;
+}
+
+static int hashsig_index_post(
+	git_hashsig_index *index,
+	git_hashsig_postingmap *map,
+	const hashsig_heap *heap,
+	uint32_t sig)
+{
+	hashsig_postings *postings;
+	hashsig_posting *posting;
+	int i, j;
+
+	/* the heap is sorted, so any duplicate hashes are adjacent */
+	for (i = 0; i < heap->size; i = j) {
+		for (j = i + 1; j < heap->size && heap->values[j] == heap->values[i]; j++)
+			/* count the duplicates */;
+
+		if (git_hashsig_postingmap_get(&postings, map, heap->values[i]) != 0) {
+			postings = git_pool_mallocz(&index->postings_pool, 1);
+			GIT_ERROR_CHECK_ALLOC(postings);
+
+			if (git_hashsig_postingmap_put(map, heap->values[i], postings) < 0)
+				return -1;
+		}
+
+		posting = git_array_alloc(*postings);
+		GIT_ERROR_CHECK_ALLOC(posting);
+
+		posting->sig = sig;
+		posting->count = (uint32_t)(j - i);
+	}
+
+	return 0;
+}
+
+int git_hashsig_index_add(
+	git_hashsig_index *index,
+	const git_hashsig *sig,
+	size_t id)
+{
+	hashsig_index_entry *entry;
+	uint32_t *empty, pos;
+
+	GIT_ASSERT_ARG(index);
+	GIT_ASSERT_ARG(sig);
+
+	if (index->entries.size >= UINT32_MAX) {
+		git_error_set(GIT_ERROR_INVALID, "too many similarity signatures to index");
+		return -1;
+	}
+
+	pos = (uint32_t)index->entries.size;
+
+	entry = git_array_alloc(index->entries);
+	GIT_ERROR_CHECK_ALLOC(entry);
+
+	entry->sig = sig;
+	entry->id = id;
+
+	if (sig->mins.size == 0) {
+		empty = git_array_alloc(index->empty);
+		GIT_ERROR_CHECK_ALLOC(empty);
+
+		*empty = pos;
+		return 0;
+	}
+
+	/* the max heap only takes part in comparisons once the min heap is full */
+	if (hashsig_index_post(index, &index->mins, &sig->mins, pos) < 0 ||
+	    (sig->mins.size == HASHSIG_HEAP_SIZE &&
+	     hashsig_index_post(index, &index->maxs, &sig->maxs, pos) < 0))
+		return -1;
+
+	return 0;
+}
+
+static int hashsig_index_count(
+	git_hashsig_index *index,
+	git_hashsig_postingmap *map,
+	const hashsig_heap *heap,
+	uint32_t *matches)
+{
+	hashsig_postings *postings;
+	hashsig_posting *posting;
+	uint32_t *touched;
+	size_t k;
+	int i, j;
+
+	for (i = 0; i < heap->size; i = j) {
+		for (j = i + 1; j < heap->size && heap->values[j] == heap->values[i]; j++)
+			/* count the duplicates */;
+
+		if (git_hashsig_postingmap_get(&postings, map, heap->values[i]) != 0)
+			continue;
+
+		git_array_foreach(*postings, k, posting) {
+			if (!index->min_matches[posting->sig] &&
+			    !index->max_matches[posting->sig]) {
+				touched = git_array_alloc(index->touched);
+				GIT_ERROR_CHECK_ALLOC(touched);
+
+				*touched = posting->sig;
+			}
+
+			matches[posting->sig] += min(posting->count, (uint32_t)(j - i));
+		}
+	}
+
+	return 0;
+}
+
+static int hashsig_index_found(git_hashsig_index *index, size_t id)
+{
+	size_t *found = git_array_alloc(index->found);
+	GIT_ERROR_CHECK_ALLOC(found);
+
+	*found = id;
+	return 0;
+}
+
+static int hashsig_index_cmp_id(const void *a, const void *b)
+{
+	size_t av = *(const size_t *)a, bv = *(const size_t *)b;
+	return (av < bv) ? -1 : (av > bv) ? 1 : 0;
+}
+
+int git_hashsig_index_lookup(
+	const size_t **out,
+	size_t *out_len,
+	git_hashsig_index *index,
+	const git_hashsig *sig,
+	int threshold)
+{
+	const hashsig_index_entry *entry;
+	const git_hashsig *a;
+	uint32_t *pos;
+	size_t i;
+	int score, error = 0;
+
+	GIT_ASSERT_ARG(out && out_len);
+	GIT_ASSERT_ARG(index);
+	GIT_ASSERT_ARG(sig);
+
+	index->found.size = 0;
+
+	if (sig->mins.size == 0) {
+		git_array_foreach(index->empty, i, pos) {
+			entry = git_array_get(index->entries, *pos);
+
+			if (hashsig_compare_empty(entry->sig, sig) >= threshold &&
+			    (error = hashsig_index_found(index, entry->id)) < 0)
+				return error;
+		}
+
+		goto done;
+	}
+
+	if (index->matches_size < index->entries.size) {
+		git__free(index->min_matches);
+		git__free(index->max_matches);
+		index->matches_size = 0;
+
+		index->min_matches = git__calloc(index->entries.size, sizeof(uint32_t));
+		index->max_matches = git__calloc(index->entries.size, sizeof(uint32_t));
+		GIT_ERROR_CHECK_ALLOC(index->min_matches);
+		GIT_ERROR_CHECK_ALLOC(index->max_matches);
+
+		index->matches_size = index->entries.size;
+	}
+
+	if ((error = hashsig_index_count(index, &index->mins, &sig->mins, index->min_matches)) < 0 ||
+	    (error = hashsig_index_count(index, &index->maxs, &sig->maxs, index->max_matches)) < 0)
+		goto cleanup;
+
+	/* this mirrors git_hashsig_compare, with the indexed signature as `a` */
+	git_array_foreach(index->touched, i, pos) {
+		entry = git_array_get(index->entries, *pos);
+		a = entry->sig;
+
+		score = hashsig_heap_score(&a->mins, &sig->mins,
+			(int)index->min_matches[*pos]);
+
+		if (a->mins.size == HASHSIG_HEAP_SIZE)
+			score = (score + hashsig_heap_score(&a->maxs, &sig->maxs,
+				(int)index->max_matches[*pos])) / 2;
+
+		if (score >= threshold &&
+		    (error = hashsig_index_found(index, entry->id)) < 0)
+			goto cleanup;
+	}
+
+cleanup:
+	git_array_foreach(index->touched, i, pos) {
+		index->min_matches[*pos] = 0;
+		index->max_matches[*pos] = 0;
+	}
+
+	index->touched.size = 0;
+
+	if (error < 0)
+		return error;
+
+done:
+	qsort(index->found.ptr, index->found.size, sizeof(size_t),
+		hashsig_index_cmp_id);
+
+	*out = index->found.ptr;
+	*out_len = index->found.size;
+	return 0;
+}
+
+void git_hashsig_index_free(git_hashsig_index *index)
+{
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	hashsig_postings *postings;
+
+	if (!index)
+		return;
+
+	while (git_hashsig_postingmap_iterate(&iter, NULL, &postings, &index->mins) == 0)
+		git_array_clear(*postings);
+
+	iter = GIT_HASHMAP_ITER_INIT;
+	while (git_hashsig_postingmap_iterate(&iter, NULL, &postings, &index->maxs) == 0)
+		git_array_clear(*postings);
+
+	git_hashsig_postingmap_dispose(&index->mins);
+	git_hashsig_postingmap_dispose(&index->maxs);
+	git_pool_clear(&index->postings_pool);
+
+	git_array_clear(index->entries);
+	git_array_clear(index->empty);
+	git_array_clear(index->touched);
+	git_array_clear(index->found);
+	git__free(index->min_matches);
+	git__free(index->max_matches);
+	git__free(index);
+}
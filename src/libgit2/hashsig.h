@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_hashsig_h__
+#define INCLUDE_hashsig_h__
+
+#include "common.h"
+
+#include "git2/sys/hashsig.h"
+
+/*
+ * An index of similarity signatures, keyed by the hashes that they
+ * retain, which finds the signatures that are similar to a given one
+ * without comparing it to every signature in the index.
+ */
+typedef struct git_hashsig_index git_hashsig_index;
+
+extern int git_hashsig_index_new(git_hashsig_index **out);
+
+/*
+ * Adds a signature to the index under the given id.  The signature is
+ * not copied, and must outlive the index.
+ */
+extern int git_hashsig_index_add(
+	git_hashsig_index *index,
+	const git_hashsig *sig,
+	size_t id);
+
+/*
+ * Looks up the ids of the indexed signatures whose similarity to the
+ * given signature (as `git_hashsig_compare(indexed, sig)` would compute
+ * it) is at least `threshold`.  The ids are returned in ascending order,
+ * in a buffer that is owned by the index and is only valid until the
+ * next lookup.
+ */
+extern int git_hashsig_index_lookup(
+	const size_t **out,
+	size_t *out_len,
+	git_hashsig_index *index,
+	const git_hashsig *sig,
+	int threshold);
+
+extern void git_hashsig_index_free(git_hashsig_index *index);
+
+/*
+ * The size of a signature in its serialized form: its options, its line
+ * count, the sizes of both heaps, and the (fixed-size) heaps themselves.
+ */
+#define GIT_HASHSIG_SERIALIZED_SIZE (4 + 4 + 2 + 2 + (2 * 127 * 4))
+
+/*
+ * Serializes a signature, in network byte order, into the given buffer
+ * of GIT_HASHSIG_SERIALIZED_SIZE bytes.  The serialization begins with
+ * the signature's options.
+ */
+extern void git_hashsig__serialize(unsigned char *out, const git_hashsig *sig);
+
+extern int git_hashsig__deserialize(git_hashsig **out, const unsigned char *data);
+
+#endif
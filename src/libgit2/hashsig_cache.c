@@ -0,0 +1,575 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "hashsig_cache.h"
+
+#include "filebuf.h"
+#include "futils.h"
+#include "hashmap_oid.h"
+#include "hashsig.h"
+#include "map.h"
+#include "repository.h"
+
+/*
+ * The cache file is a header followed by fixed-size records, which are
+ * sorted by their key (the blob id followed by the signature options,
+ * which begin the serialized signature) so that they can be searched
+ * in place:
+ *
+ *   4 bytes   signature ("HSIG")
+ *   4 bytes   version (1)
+ *   4 bytes   object id type
+ *   4 bytes   number of records
+ *   records   the raw blob id, followed by the serialized signature
+ *
+ * The file is only ever replaced as a whole, through a lock file, so it
+ * is not checksummed.
+ *
+ * Once the cache is full, writing new signatures starts a new generation:
+ * the records that were not used since the cache was loaded are dropped,
+ * and the new file holds the ones that were, plus the new signatures.
+ */
+
+#define HASHSIG_CACHE_FILE "hashsigs"
+#define HASHSIG_CACHE_SIGNATURE "HSIG"
+#define HASHSIG_CACHE_VERSION 1
+#define HASHSIG_CACHE_HEADER_SIZE 16
+
+/* The cache holds at most this many signatures (about 17MB of them). */
+#define HASHSIG_CACHE_MAX_RECORDS (1 << 14)
+
+typedef struct {
+	git_oid id;
+	uint32_t opts;
+} hashsig_cache_key;
+
+/* A signature that has been added, but not yet written. */
+typedef struct {
+	hashsig_cache_key key;
+	unsigned char record[GIT_FLEX_ARRAY];
+} hashsig_cache_pending;
+
+GIT_INLINE(uint32_t) hashsig_cache_key_hash(const hashsig_cache_key *key)
+{
+	return git_hashmap_oid_hashcode(&key->id) ^ key->opts;
+}
+
+GIT_INLINE(bool) hashsig_cache_key_equal(
+	const hashsig_cache_key *a,
+	const hashsig_cache_key *b)
+{
+	return a->opts == b->opts && git_oid_equal(&a->id, &b->id);
+}
+
+GIT_HASHMAP_SETUP(git_hashsig_cache_pendingmap, const hashsig_cache_key *, hashsig_cache_pending *, hashsig_cache_key_hash, hashsig_cache_key_equal);
+GIT_HASHSET_SETUP(git_hashsig_cache_keyset, const hashsig_cache_key *, hashsig_cache_key_hash, hashsig_cache_key_equal);
+
+struct git_hashsig_cache {
+	git_mutex lock;
+	git_str path;
+	git_oid_t oid_type;
+	size_t key_size;
+	size_t record_size;
+	size_t max_records;
+
+	git_map map;
+	const unsigned char *records;
+	size_t nr_records;
+
+	git_hashsig_cache_pendingmap pending;
+
+	/* the keys of the records on disk that have been looked up */
+	git_hashsig_cache_keyset used;
+};
+
+static void hashsig_cache_unload(git_hashsig_cache *cache)
+{
+	if (cache->map.data)
+		git_futils_mmap_free(&cache->map);
+
+	memset(&cache->map, 0, sizeof(cache->map));
+	cache->records = NULL;
+	cache->nr_records = 0;
+}
+
+/*
+ * Maps the cache file, if there is one; a file that is not a cache that
+ * we understand is simply ignored (and will be replaced when we write).
+ */
+static int hashsig_cache_load(git_hashsig_cache *cache)
+{
+	const unsigned char *data;
+	uint64_t size;
+	uint32_t version, oid_type, nr_records;
+	git_file fd;
+	int error;
+
+	hashsig_cache_unload(cache);
+
+	if ((fd = git_futils_open_ro(cache->path.ptr)) < 0) {
+		if (fd == GIT_ENOTFOUND) {
+			git_error_clear();
+			return 0;
+		}
+
+		return fd;
+	}
+
+	if ((error = git_futils_filesize(&size, fd)) < 0 ||
+	    size < HASHSIG_CACHE_HEADER_SIZE ||
+	    !git__is_sizet(size) ||
+	    (error = git_futils_mmap_ro(&cache->map, fd, 0, (size_t)size)) < 0)
+		goto done;
+
+	data = cache->map.data;
+
+	memcpy(&version, data + 4, sizeof(uint32_t));
+	memcpy(&oid_type, data + 8, sizeof(uint32_t));
+	memcpy(&nr_records, data + 12, sizeof(uint32_t));
+
+	version = ntohl(version);
+	oid_type = ntohl(oid_type);
+	nr_records = ntohl(nr_records);
+
+	if (memcmp(data, HASHSIG_CACHE_SIGNATURE, 4) != 0 ||
+	    version != HASHSIG_CACHE_VERSION ||
+	    oid_type != (uint32_t)cache->oid_type ||
+	    (size - HASHSIG_CACHE_HEADER_SIZE) / cache->record_size != nr_records ||
+	    (size - HASHSIG_CACHE_HEADER_SIZE) % cache->record_size != 0) {
+		hashsig_cache_unload(cache);
+		goto done;
+	}
+
+	cache->records = data + HASHSIG_CACHE_HEADER_SIZE;
+	cache->nr_records = nr_records;
+
+done:
+	p_close(fd);
+	return error;
+}
+
+static void hashsig_cache_raw_key(
+	unsigned char *out,
+	const git_oid *id,
+	git_hashsig_option_t opts,
+	size_t oid_size)
+{
+	uint32_t opt = htonl((uint32_t)opts);
+
+	memcpy(out, id->id, oid_size);
+	memcpy(out + oid_size, &opt, sizeof(opt));
+}
+
+static void hashsig_cache_key_from_record(
+	hashsig_cache_key *out,
+	git_hashsig_cache *cache,
+	const unsigned char *record)
+{
+	size_t oid_size = git_oid_size(cache->oid_type);
+	uint32_t opt;
+
+	git_oid_from_raw(&out->id, record, cache->oid_type);
+	memcpy(&opt, record + oid_size, sizeof(opt));
+	out->opts = ntohl(opt);
+}
+
+static void hashsig_cache_clear(git_hashsig_cache *cache)
+{
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	hashsig_cache_pending *pending;
+	const hashsig_cache_key *key;
+
+	while (git_hashsig_cache_pendingmap_iterate(&iter, NULL, &pending, &cache->pending) == 0)
+		git__free(pending);
+
+	iter = GIT_HASHMAP_ITER_INIT;
+
+	while (git_hashsig_cache_keyset_iterate(&iter, &key, &cache->used) == 0)
+		git__free((hashsig_cache_key *)key);
+
+	git_hashsig_cache_pendingmap_clear(&cache->pending);
+	git_hashsig_cache_keyset_clear(&cache->used);
+}
+
+static const unsigned char *hashsig_cache_find(
+	git_hashsig_cache *cache,
+	const unsigned char *key)
+{
+	size_t lo = 0, hi = cache->nr_records, mid;
+	const unsigned char *record;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		record = cache->records + (mid * cache->record_size);
+
+		if ((cmp = memcmp(key, record, cache->key_size)) == 0)
+			return record;
+		else if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+static int hashsig_cache_new(
+	git_hashsig_cache **out,
+	git_repository *repo)
+{
+	git_hashsig_cache *cache;
+	int error;
+
+	cache = git__calloc(1, sizeof(git_hashsig_cache));
+	GIT_ERROR_CHECK_ALLOC(cache);
+
+	cache->oid_type = repo->oid_type;
+	cache->key_size = git_oid_size(repo->oid_type) + sizeof(uint32_t);
+	cache->record_size = git_oid_size(repo->oid_type) + GIT_HASHSIG_SERIALIZED_SIZE;
+	cache->max_records = HASHSIG_CACHE_MAX_RECORDS;
+
+	if ((error = git_str_joinpath(&cache->path, repo->commondir, HASHSIG_CACHE_FILE)) < 0 ||
+	    (error = hashsig_cache_load(cache)) < 0) {
+		hashsig_cache_unload(cache);
+		git_str_dispose(&cache->path);
+		git__free(cache);
+		return error;
+	}
+
+	if (git_mutex_init(&cache->lock)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize lock for signature cache");
+		hashsig_cache_unload(cache);
+		git_str_dispose(&cache->path);
+		git__free(cache);
+		return -1;
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_repository__hashsig_cache(
+	git_hashsig_cache **out,
+	git_repository *repo)
+{
+	git_hashsig_cache *cache, *newcache;
+	int enabled, error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	*out = NULL;
+
+	if (!repo->commondir)
+		return 0;
+
+	if ((error = git_repository__configmap_lookup(&enabled, repo, GIT_CONFIGMAP_HASHSIGCACHE)) < 0)
+		return error;
+
+	if (!enabled)
+		return 0;
+
+	if ((cache = git_atomic_load(repo->hashsig_cache)) == NULL) {
+		if ((error = hashsig_cache_new(&newcache, repo)) < 0)
+			return error;
+
+		/* if we race, free losing allocation */
+		if ((cache = git_atomic_compare_and_swap(&repo->hashsig_cache, NULL, newcache)) == NULL)
+			cache = newcache;
+		else
+			git_hashsig_cache_free(newcache);
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_hashsig_cache_lookup(
+	git_hashsig **out,
+	git_hashsig_cache *cache,
+	const git_oid *id,
+	git_hashsig_option_t opts)
+{
+	unsigned char key[GIT_OID_MAX_SIZE + sizeof(uint32_t)];
+	hashsig_cache_key lookup, *used;
+	hashsig_cache_pending *pending;
+	const unsigned char *record;
+	int error = GIT_ENOTFOUND;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(id);
+
+	hashsig_cache_raw_key(key, id, opts, git_oid_size(cache->oid_type));
+	git_oid_cpy(&lookup.id, id);
+	lookup.opts = (uint32_t)opts;
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock signature cache");
+		return -1;
+	}
+
+	if ((record = hashsig_cache_find(cache, key)) != NULL) {
+		/* remember that it was used, so that it survives a new generation */
+		if (!git_hashsig_cache_keyset_contains(&cache->used, &lookup)) {
+			if ((used = git__malloc(sizeof(hashsig_cache_key))) == NULL) {
+				error = -1;
+				goto done;
+			}
+
+			memcpy(used, &lookup, sizeof(hashsig_cache_key));
+
+			if ((error = git_hashsig_cache_keyset_add(&cache->used, used)) < 0) {
+				git__free(used);
+				goto done;
+			}
+		}
+	} else if (git_hashsig_cache_pendingmap_get(&pending, &cache->pending, &lookup) == 0) {
+		record = pending->record;
+	}
+
+	if (record)
+		error = git_hashsig__deserialize(out,
+			record + git_oid_size(cache->oid_type));
+
+done:
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+int git_hashsig_cache_add(
+	git_hashsig_cache *cache,
+	const git_oid *id,
+	const git_hashsig *sig)
+{
+	hashsig_cache_pending *pending;
+	size_t oid_size, alloc_size;
+	int error = 0;
+
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(id);
+	GIT_ASSERT_ARG(sig);
+
+	oid_size = git_oid_size(cache->oid_type);
+
+	GIT_ERROR_CHECK_ALLOC_ADD(&alloc_size, sizeof(hashsig_cache_pending), cache->record_size);
+	pending = git__malloc(alloc_size);
+	GIT_ERROR_CHECK_ALLOC(pending);
+
+	memcpy(pending->record, id->id, oid_size);
+	git_hashsig__serialize(pending->record + oid_size, sig);
+	hashsig_cache_key_from_record(&pending->key, cache, pending->record);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock signature cache");
+		git__free(pending);
+		return -1;
+	}
+
+	/* there's no point in holding more than could ever be written */
+	if (git_hashsig_cache_pendingmap_size(&cache->pending) >= cache->max_records ||
+	    git_hashsig_cache_pendingmap_contains(&cache->pending, &pending->key) ||
+	    hashsig_cache_find(cache, pending->record) != NULL) {
+		git__free(pending);
+		goto done;
+	}
+
+	if ((error = git_hashsig_cache_pendingmap_put(&cache->pending, &pending->key, pending)) < 0)
+		git__free(pending);
+
+done:
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+void git_hashsig_cache__set_max_records(
+	git_hashsig_cache *cache,
+	size_t max_records)
+{
+	cache->max_records = max_records;
+}
+
+static int hashsig_cache_cmp(const void *a, const void *b, void *payload)
+{
+	size_t key_size = *(size_t *)payload;
+	return memcmp(a, b, key_size);
+}
+
+static bool hashsig_cache_used(git_hashsig_cache *cache, const unsigned char *record)
+{
+	hashsig_cache_key key;
+
+	hashsig_cache_key_from_record(&key, cache, record);
+	return git_hashsig_cache_keyset_contains(&cache->used, &key);
+}
+
+/*
+ * Counts the records on disk that have been used since the cache was
+ * loaded.
+ */
+static size_t hashsig_cache_count_used(git_hashsig_cache *cache)
+{
+	unsigned char key[GIT_OID_MAX_SIZE + sizeof(uint32_t)];
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	const hashsig_cache_key *used;
+	size_t count = 0;
+
+	while (git_hashsig_cache_keyset_iterate(&iter, &used, &cache->used) == 0) {
+		hashsig_cache_raw_key(key, &used->id, used->opts, git_oid_size(cache->oid_type));
+
+		if (hashsig_cache_find(cache, key) != NULL)
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * Writes the (sorted) new records merged into the (sorted) records on
+ * disk.  When `rollover` is set, only the records on disk that have been
+ * used are kept.
+ */
+static int hashsig_cache_merge(
+	git_hashsig_cache *cache,
+	git_filebuf *file,
+	const unsigned char *new_records,
+	size_t nr_new,
+	bool rollover)
+{
+	const unsigned char *existing = cache->records;
+	const unsigned char *existing_end = cache->records + (cache->nr_records * cache->record_size);
+	const unsigned char *pending = new_records;
+	const unsigned char *pending_end = new_records + (nr_new * cache->record_size);
+	const unsigned char *next;
+	int error;
+
+	while (existing < existing_end || pending < pending_end) {
+		if (pending >= pending_end ||
+		    (existing < existing_end &&
+		     memcmp(existing, pending, cache->key_size) < 0)) {
+			next = existing;
+			existing += cache->record_size;
+
+			if (rollover && !hashsig_cache_used(cache, next))
+				continue;
+		} else {
+			next = pending;
+			pending += cache->record_size;
+		}
+
+		if ((error = git_filebuf_write(file, next, cache->record_size)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+int git_hashsig_cache_write(git_hashsig_cache *cache)
+{
+	git_filebuf file = GIT_FILEBUF_INIT;
+	git_str new_records = GIT_STR_INIT;
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	hashsig_cache_pending *pending;
+	unsigned char header[HASHSIG_CACHE_HEADER_SIZE];
+	uint32_t value;
+	size_t nr_new, nr_kept;
+	bool rollover = false;
+	int error;
+
+	GIT_ASSERT_ARG(cache);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock signature cache");
+		return -1;
+	}
+
+	if (!git_hashsig_cache_pendingmap_size(&cache->pending)) {
+		error = 0;
+		goto done;
+	}
+
+	if ((error = git_filebuf_open(&file, cache->path.ptr, 0, 0644)) < 0) {
+		/* somebody else is writing the cache; it's only a cache */
+		if (error == GIT_ELOCKED) {
+			git_error_clear();
+			error = 0;
+		}
+
+		goto done;
+	}
+
+	/* pick up whatever has been written since we loaded the cache */
+	if ((error = hashsig_cache_load(cache)) < 0)
+		goto done;
+
+	while (git_hashsig_cache_pendingmap_iterate(&iter, NULL, &pending, &cache->pending) == 0) {
+		if (hashsig_cache_find(cache, pending->record) == NULL &&
+		    (error = git_str_put(&new_records, (const char *)pending->record, cache->record_size)) < 0)
+			goto done;
+	}
+
+	nr_new = new_records.size / cache->record_size;
+	nr_kept = cache->nr_records;
+
+	/* once the cache is full, start a new generation */
+	if (nr_kept + nr_new > cache->max_records) {
+		rollover = true;
+		nr_kept = hashsig_cache_count_used(cache);
+
+		if (nr_kept + nr_new > cache->max_records)
+			nr_new = cache->max_records > nr_kept ? cache->max_records - nr_kept : 0;
+	}
+
+	/* don't rewrite the cache when none of the new signatures are kept */
+	if (!nr_new)
+		goto done;
+
+	git__qsort_r(new_records.ptr, new_records.size / cache->record_size,
+		cache->record_size, hashsig_cache_cmp, &cache->key_size);
+
+	memcpy(header, HASHSIG_CACHE_SIGNATURE, 4);
+	value = htonl(HASHSIG_CACHE_VERSION);
+	memcpy(header + 4, &value, sizeof(value));
+	value = htonl((uint32_t)cache->oid_type);
+	memcpy(header + 8, &value, sizeof(value));
+	value = htonl((uint32_t)(nr_kept + nr_new));
+	memcpy(header + 12, &value, sizeof(value));
+
+	if ((error = git_filebuf_write(&file, header, sizeof(header))) < 0 ||
+	    (error = hashsig_cache_merge(cache, &file,
+			(const unsigned char *)new_records.ptr, nr_new, rollover)) < 0)
+		goto done;
+
+	hashsig_cache_unload(cache);
+
+	if ((error = git_filebuf_commit(&file)) < 0)
+		goto done;
+
+	error = hashsig_cache_load(cache);
+
+done:
+	hashsig_cache_clear(cache);
+	git_str_dispose(&new_records);
+	git_filebuf_cleanup(&file);
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+void git_hashsig_cache_free(git_hashsig_cache *cache)
+{
+	if (!cache)
+		return;
+
+	hashsig_cache_unload(cache);
+	hashsig_cache_clear(cache);
+	git_hashsig_cache_pendingmap_dispose(&cache->pending);
+	git_hashsig_cache_keyset_dispose(&cache->used);
+	git_str_dispose(&cache->path);
+	git_mutex_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_hashsig_cache_h__
+#define INCLUDE_hashsig_cache_h__
+
+#include "common.h"
+
+#include "git2/oid.h"
+#include "git2/types.h"
+#include "git2/sys/hashsig.h"
+
+/*
+ * A cache of the similarity signatures of blobs, keyed by the blob id
+ * and the signature options, which is kept in `$GIT_COMMON_DIR/hashsigs`
+ * when `core.hashsigCache` is enabled.  Signatures that are added to it
+ * can be looked up right away, but are only written out by
+ * `git_hashsig_cache_write`.
+ */
+typedef struct git_hashsig_cache git_hashsig_cache;
+
+/*
+ * Looks up the repository's signature cache; `*out` is set to NULL when
+ * the cache is not enabled.
+ */
+extern int git_repository__hashsig_cache(
+	git_hashsig_cache **out,
+	git_repository *repo);
+
+/* Returns GIT_ENOTFOUND if there is no such signature in the cache. */
+extern int git_hashsig_cache_lookup(
+	git_hashsig **out,
+	git_hashsig_cache *cache,
+	const git_oid *id,
+	git_hashsig_option_t opts);
+
+extern int git_hashsig_cache_add(
+	git_hashsig_cache *cache,
+	const git_oid *id,
+	const git_hashsig *sig);
+
+/*
+ * Writes the signatures that were added to the cache out to disk,
+ * merging them with the ones that are already there.  If another process
+ * is writing the cache at the same time, the new signatures are dropped.
+ * When the cache is full, only the signatures on disk that were looked up
+ * since it was loaded are kept alongside the new ones; nothing is written
+ * if none of the new signatures would be kept.
+ */
+extern int git_hashsig_cache_write(git_hashsig_cache *cache);
+
+/* Limits the number of signatures that the cache holds; for testing. */
+extern void git_hashsig_cache__set_max_records(
+	git_hashsig_cache *cache,
+	size_t max_records);
+
+extern void git_hashsig_cache_free(git_hashsig_cache *cache);
+
+#endif
@@ -236,6 +236,9 @@ static int parse_ignore_file(
 		}
 	}
 
+	if (!error)
+		error = git_attr_file__compile(attrs);
+
 	git_mutex_unlock(&attrs->lock);
 	git__free(match);
 
@@ -449,7 +452,9 @@ static bool ignore_lookup_in_rules(
 	size_t j;
 	git_attr_fnmatch *match;
 
-	git_vector_rforeach(&file->rules, j, match) {
+	for (j = git_attr_file__candidates(file, path); j > 0; ) {
+		match = git_attr_file__candidate(file, path, --j);
+
 		if (match->flags & GIT_ATTR_FNMATCH_DIRECTORY &&
 		    path->is_dir == GIT_DIR_FLAG_FALSE)
 			continue;
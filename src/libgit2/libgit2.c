@@ -9,6 +9,7 @@
 #include "alloc.h"
 #include "buf.h"
 #include "common.h"
+#include "config_backend.h"
 #include "filter.h"
 #include "hash.h"
 #include "merge_driver.h"
@@ -21,6 +22,7 @@
 #include "settings.h"
 #include "sysdir.h"
 #include "thread.h"
+#include "zstream.h"
 #include "git2/global.h"
 #include "streams/registry.h"
 #include "streams/mbedtls.h"
@@ -55,7 +57,9 @@ int git_libgit2_init(void)
 		git_mwindow_global_init,
 		git_pool_global_init,
 		git_settings_global_init,
-		git_reftable_global_init
+		git_config_file_global_init,
+		git_reftable_global_init,
+		git_zstream_global_init
 	};
 
 	return git_runtime_init(init_fns, ARRAY_SIZE(init_fns));
@@ -226,7 +230,9 @@ const char *git_libgit2_feature_backend(git_feature_t feature)
 		break;
 
 	case GIT_FEATURE_COMPRESSION:
-#if defined(GIT_COMPRESSION_ZLIB)
+#if defined(GIT_COMPRESSION_ZLIB_NG)
+		return "zlib-ng";
+#elif defined(GIT_COMPRESSION_ZLIB)
 		return "zlib";
 #elif defined(GIT_COMPRESSION_BUILTIN)
 		return "builtin";
@@ -265,16 +265,42 @@ on_error:
 int git_merge_base(git_oid *out, git_repository *repo, const git_oid *one, const git_oid *two)
 {
 	int error;
+	git_merge_base_cache *cache;
 	git_revwalk *walk;
 	git_commit_list *result;
+	bool found;
+
+	if ((error = git_repository__merge_base_cache(&cache, repo)) < 0)
+		return error;
+
+	if (cache) {
+		if ((error = git_merge_base_cache_lookup(out, &found, cache, one, two)) == 0) {
+			if (found)
+				return 0;
+
+			git_error_set(GIT_ERROR_MERGE, "no merge base found");
+			return GIT_ENOTFOUND;
+		} else if (error != GIT_ENOTFOUND) {
+			return error;
+		}
+	}
+
+	if ((error = merge_bases(&result, &walk, repo, one, two)) < 0) {
+		/* remember that there is no merge base, but not other failures */
+		if (cache && error == GIT_ENOTFOUND &&
+		    git_merge_base_cache_add(cache, one, two, NULL) < 0)
+			return -1;
 
-	if ((error = merge_bases(&result, &walk, repo, one, two)) < 0)
 		return error;
+	}
 
 	git_oid_cpy(out, &result->item->oid);
 	git_commit_list_free(&result);
 	git_revwalk_free(walk);
 
+	if (cache && (error = git_merge_base_cache_add(cache, one, two, out)) < 0)
+		return error;
+
 	return 0;
 }
 
@@ -884,45 +910,127 @@ static bool merge_conflict_can_resolve_contents(
 	return true;
 }
 
-static int merge_conflict_invoke_driver(
-	git_index_entry **out,
-	const char *name,
-	git_merge_driver *driver,
+/*
+ * The content merge of a conflict.  The merge driver is looked up first
+ * (through the attributes), then applied; applying the driver loads the
+ * blobs, merges them and writes the result to the object database.
+ */
+typedef struct {
+	const git_merge_diff *conflict;
+	git_merge_driver_source source;
+	git_merge_driver *driver;
+	const char *name;
+
+	/* the result of applying the driver */
+	git_oid id;
+	const char *path;
+	uint32_t mode;
+	size_t size;
+	int error;
+	unsigned int applied : 1;
+} merge_content;
+
+/*
+ * Prepares the content merge of the given conflict, looking up its
+ * driver; the driver is left NULL when the contents cannot be merged.
+ */
+static int merge_content_prepare(
+	merge_content *content,
 	git_merge_diff_list *diff_list,
-	git_merge_driver_source *src)
+	const git_merge_diff *conflict,
+	const git_merge_options *merge_opts,
+	const git_merge_file_options *file_opts)
+{
+	int error;
+
+	memset(content, 0, sizeof(merge_content));
+	content->conflict = conflict;
+
+	if (!merge_conflict_can_resolve_contents(conflict))
+		return 0;
+
+	content->source.repo = diff_list->repo;
+	content->source.default_driver = merge_opts->default_driver;
+	content->source.file_opts = file_opts;
+	content->source.ancestor = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->ancestor_entry) ?
+		&conflict->ancestor_entry : NULL;
+	content->source.ours = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->our_entry) ?
+		&conflict->our_entry : NULL;
+	content->source.theirs = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->their_entry) ?
+		&conflict->their_entry : NULL;
+
+	/*
+	 * If the user requested a particular type of resolution (via the
+	 * favor flag) then let that override the gitattributes and use the
+	 * builtin text driver, which honors the favor in the file options.
+	 */
+	if (file_opts->favor == GIT_MERGE_FILE_FAVOR_NORMAL &&
+	    (error = git_merge_driver_for_source(&content->name,
+			&content->driver, &content->source)) < 0)
+		return error;
+
+	if (!content->driver) {
+		content->name = "text";
+		content->driver = &git_merge_driver__text.base;
+	}
+
+	return 0;
+}
+
+static int merge_content_apply(merge_content *content, git_odb *odb)
 {
-	git_index_entry *result;
 	git_buf buf = {0};
-	const char *path;
-	uint32_t mode;
-	git_odb *odb = NULL;
-	git_oid oid;
 	int error;
 
-	*out = NULL;
+	content->applied = 1;
 
-	if ((error = driver->apply(driver, &path, &mode, &buf, name, src)) < 0 ||
-		(error = git_repository_odb(&odb, src->repo)) < 0 ||
-		(error = git_odb_write(&oid, odb, buf.ptr, buf.size, GIT_OBJECT_BLOB)) < 0)
-		goto done;
+	error = content->driver->apply(content->driver, &content->path,
+		&content->mode, &buf, content->name, &content->source);
+
+	if (error == GIT_PASSTHROUGH)
+		error = git_merge_driver__text.base.apply(
+			&git_merge_driver__text.base, &content->path,
+			&content->mode, &buf, "text", &content->source);
+
+	if (!error) {
+		content->size = buf.size;
+		error = git_odb_write(&content->id, odb,
+			buf.ptr, buf.size, GIT_OBJECT_BLOB);
+	}
+
+	git_buf_dispose(&buf);
+	return (content->error = error);
+}
+
+static int merge_content_finish(
+	int *resolved,
+	git_merge_diff_list *diff_list,
+	merge_content *content)
+{
+	git_index_entry *result;
+
+	*resolved = 0;
+
+	if (content->error == GIT_EMERGECONFLICT)
+		return 0;
+	else if (content->error < 0)
+		return content->error;
 
 	result = git_pool_mallocz(&diff_list->pool, sizeof(git_index_entry));
 	GIT_ERROR_CHECK_ALLOC(result);
 
-	git_oid_cpy(&result->id, &oid);
-	result->mode = mode;
-	result->file_size = (uint32_t)buf.size;
+	git_oid_cpy(&result->id, &content->id);
+	result->mode = content->mode;
+	result->file_size = (uint32_t)content->size;
 
-	result->path = git_pool_strdup(&diff_list->pool, path);
+	result->path = git_pool_strdup(&diff_list->pool, content->path);
 	GIT_ERROR_CHECK_ALLOC(result->path);
 
-	*out = result;
-
-done:
-	git_buf_dispose(&buf);
-	git_odb_free(odb);
+	git_vector_insert(&diff_list->staged, result);
+	git_vector_insert(&diff_list->resolved, (git_merge_diff *)content->conflict);
 
-	return error;
+	*resolved = 1;
+	return 0;
 }
 
 static int merge_conflict_resolve_contents(
@@ -932,14 +1040,8 @@ static int merge_conflict_resolve_contents(
 	const git_merge_options *merge_opts,
 	const git_merge_file_options *file_opts)
 {
-	git_merge_driver_source source = {0};
-	git_merge_file_result result = {0};
-	git_merge_driver *driver;
-	git_merge_driver__builtin builtin = {{0}};
-	git_index_entry *merge_result = NULL;
-	git_odb *odb = NULL;
-	const char *name;
-	bool fallback = false;
+	merge_content content;
+	git_odb *odb;
 	int error;
 
 	GIT_ASSERT_ARG(resolved);
@@ -948,67 +1050,45 @@ static int merge_conflict_resolve_contents(
 
 	*resolved = 0;
 
-	if (!merge_conflict_can_resolve_contents(conflict))
-		return 0;
-
-	source.repo = diff_list->repo;
-	source.default_driver = merge_opts->default_driver;
-	source.file_opts = file_opts;
-	source.ancestor = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->ancestor_entry) ?
-		&conflict->ancestor_entry : NULL;
-	source.ours = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->our_entry) ?
-		&conflict->our_entry : NULL;
-	source.theirs = GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->their_entry) ?
-		&conflict->their_entry : NULL;
-
-	if (file_opts->favor != GIT_MERGE_FILE_FAVOR_NORMAL) {
-		/* if the user requested a particular type of resolution (via the
-		 * favor flag) then let that override the gitattributes and use
-		 * the builtin driver.
-		 */
-		name = "text";
-		builtin.base.apply = git_merge_driver__builtin_apply;
-		builtin.favor = file_opts->favor;
+	if ((error = merge_content_prepare(&content, diff_list, conflict,
+			merge_opts, file_opts)) < 0 ||
+	    !content.driver)
+		return error;
 
-		driver = &builtin.base;
-	} else {
-		/* find the merge driver for this file */
-		if ((error = git_merge_driver_for_source(&name, &driver, &source)) < 0)
-			goto done;
+	if ((error = git_repository_odb__weakptr(&odb, diff_list->repo)) < 0)
+		return error;
 
-		if (driver == NULL)
-			fallback = true;
-	}
+	merge_content_apply(&content, odb);
 
-	if (driver) {
-		error = merge_conflict_invoke_driver(&merge_result, name, driver,
-			diff_list, &source);
+	return merge_content_finish(resolved, diff_list, &content);
+}
 
-		if (error == GIT_PASSTHROUGH)
-			fallback = true;
-	}
+/* Resolves the conflicts that do not need their contents merged. */
+static int merge_conflict_resolve_entries(
+	int *out,
+	git_merge_diff_list *diff_list,
+	const git_merge_diff *conflict)
+{
+	int resolved = 0;
+	int error = 0;
 
-	if (fallback) {
-		error = merge_conflict_invoke_driver(&merge_result, "text",
-			&git_merge_driver__text.base, diff_list, &source);
-	}
+	*out = 0;
 
-	if (error < 0) {
-		if (error == GIT_EMERGECONFLICT)
-			error = 0;
+	if ((error = merge_conflict_resolve_trivial(
+			&resolved, diff_list, conflict)) < 0)
+		goto done;
 
+	if (!resolved && (error = merge_conflict_resolve_one_removed(
+			&resolved, diff_list, conflict)) < 0)
 		goto done;
-	}
 
-	git_vector_insert(&diff_list->staged, merge_result);
-	git_vector_insert(&diff_list->resolved, (git_merge_diff *)conflict);
+	if (!resolved && (error = merge_conflict_resolve_one_renamed(
+			&resolved, diff_list, conflict)) < 0)
+		goto done;
 
-	*resolved = 1;
+	*out = resolved;
 
 done:
-	git_merge_file_result_free(&result);
-	git_odb_free(odb);
-
 	return error;
 }
 
@@ -1024,15 +1104,7 @@ static int merge_conflict_resolve(
 
 	*out = 0;
 
-	if ((error = merge_conflict_resolve_trivial(
-			&resolved, diff_list, conflict)) < 0)
-		goto done;
-
-	if (!resolved && (error = merge_conflict_resolve_one_removed(
-			&resolved, diff_list, conflict)) < 0)
-		goto done;
-
-	if (!resolved && (error = merge_conflict_resolve_one_renamed(
+	if ((error = merge_conflict_resolve_entries(
 			&resolved, diff_list, conflict)) < 0)
 		goto done;
 
@@ -1046,6 +1118,193 @@ done:
 	return error;
 }
 
+static int merge_conflict_unresolved(
+	git_merge_diff_list *diff_list,
+	git_merge_diff *conflict,
+	const git_merge_options *merge_opts)
+{
+	if ((merge_opts->flags & GIT_MERGE_FAIL_ON_CONFLICT)) {
+		git_error_set(GIT_ERROR_MERGE, "merge conflicts exist");
+		return GIT_EMERGECONFLICT;
+	}
+
+	return git_vector_insert(&diff_list->conflicts, conflict);
+}
+
+static int merge_conflicts_resolve(
+	git_merge_diff_list *diff_list,
+	git_vector *changes,
+	const git_merge_options *merge_opts,
+	const git_merge_file_options *file_opts)
+{
+	git_merge_diff *conflict;
+	size_t i;
+	int error = 0;
+
+	git_vector_foreach(changes, i, conflict) {
+		int resolved = 0;
+
+		if ((error = merge_conflict_resolve(
+			&resolved, diff_list, conflict, merge_opts, file_opts)) < 0)
+			return error;
+
+		if (!resolved &&
+		    (error = merge_conflict_unresolved(diff_list, conflict, merge_opts)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+#ifdef GIT_THREADS
+
+/*
+ * Resolving the conflicts on worker threads: the calling thread resolves
+ * the conflicts that do not need their contents merged, and looks up the
+ * merge driver for the rest (which reads the attributes, and that is not
+ * thread-safe).  The workers apply the built-in drivers, and the calling
+ * thread then records the results in the order of the conflicts.  Custom
+ * drivers, which may not be thread-safe, are applied on the calling
+ * thread as their results are recorded.
+ */
+
+#define MERGE_CONTENTS_MIN_PER_THREAD 4
+
+typedef struct {
+	merge_content *contents;
+	const size_t *pending;
+	int pending_len;
+	git_odb *odb;
+	git_atomic32 next;
+} merge_contents_state;
+
+static void *merge_contents_worker(void *arg)
+{
+	merge_contents_state *state = arg;
+	int i;
+
+	while ((i = git_atomic32_inc(&state->next) - 1) < state->pending_len)
+		merge_content_apply(&state->contents[state->pending[i]], state->odb);
+
+	return NULL;
+}
+
+static bool merge_content_is_builtin(const merge_content *content)
+{
+	return (content->driver == &git_merge_driver__text.base ||
+	        content->driver == &git_merge_driver__union.base ||
+	        content->driver == &git_merge_driver__binary);
+}
+
+static int merge_conflicts_resolve_threaded(
+	git_merge_diff_list *diff_list,
+	git_vector *changes,
+	const git_merge_options *merge_opts,
+	const git_merge_file_options *file_opts)
+{
+	merge_contents_state state = { 0 };
+	merge_content *contents, *content;
+	git_array_t(size_t) pending = GIT_ARRAY_INIT;
+	git_merge_diff *conflict;
+	git_thread *threads = NULL;
+	git_odb *odb;
+	unsigned int nr_threads = merge_opts->threads;
+	size_t i, started = 0, *idx;
+	int resolved, error = 0;
+
+	if ((error = git_repository_odb__weakptr(&odb, diff_list->repo)) < 0)
+		return error;
+
+	contents = git__calloc(changes->length, sizeof(merge_content));
+	GIT_ERROR_CHECK_ALLOC(contents);
+
+	git_vector_foreach(changes, i, conflict) {
+		if ((error = merge_conflict_resolve_entries(
+				&resolved, diff_list, conflict)) < 0)
+			goto done;
+
+		if (resolved)
+			continue;
+
+		if ((error = merge_content_prepare(&contents[i], diff_list,
+				conflict, merge_opts, file_opts)) < 0)
+			goto done;
+
+		if (contents[i].driver && merge_content_is_builtin(&contents[i])) {
+			if ((idx = git_array_alloc(pending)) == NULL) {
+				error = -1;
+				goto done;
+			}
+
+			*idx = i;
+		}
+	}
+
+	if (nr_threads > pending.size / MERGE_CONTENTS_MIN_PER_THREAD)
+		nr_threads = (unsigned int)(pending.size / MERGE_CONTENTS_MIN_PER_THREAD);
+
+	if (nr_threads > 1 && pending.size <= INT32_MAX) {
+		state.contents = contents;
+		state.pending = pending.ptr;
+		state.pending_len = (int)pending.size;
+		state.odb = odb;
+
+		if ((threads = git__calloc(nr_threads - 1, sizeof(git_thread))) == NULL) {
+			error = -1;
+			goto done;
+		}
+
+		for (i = 0; i < nr_threads - 1; i++) {
+			if (git_thread_create(&threads[i], merge_contents_worker, &state) != 0)
+				break;
+
+			started++;
+		}
+
+		/* this thread works through the contents with the others */
+		merge_contents_worker(&state);
+
+		for (i = 0; i < started; i++)
+			git_thread_join(&threads[i], NULL);
+	}
+
+	git_vector_foreach(changes, i, conflict) {
+		content = &contents[i];
+		resolved = 0;
+
+		/* resolved without merging its contents */
+		if (!content->conflict)
+			continue;
+
+		if (content->driver) {
+			/*
+			 * Custom drivers are applied here.  Error messages are
+			 * thread-local, so contents that a worker failed to
+			 * merge are merged again, for the caller to see the
+			 * worker's error.
+			 */
+			if (!content->applied ||
+			    (content->error < 0 && content->error != GIT_EMERGECONFLICT))
+				merge_content_apply(content, odb);
+
+			if ((error = merge_content_finish(&resolved, diff_list, content)) < 0)
+				goto done;
+		}
+
+		if (!resolved &&
+		    (error = merge_conflict_unresolved(diff_list, conflict, merge_opts)) < 0)
+			goto done;
+	}
+
+done:
+	git_array_clear(pending);
+	git__free(threads);
+	git__free(contents);
+	return error;
+}
+
+#endif
+
 /* Rename detection and coalescing */
 
 struct merge_diff_similarity {
@@ -1062,6 +1321,7 @@ static int index_entry_similarity_calc(
 	git_blob *blob;
 	git_diff_file diff_file;
 	git_object_size_t blobsize;
+	git_hashsig_cache *hashsigs;
 	int error;
 
 	if (*out || *out == &cache_invalid_marker)
@@ -1069,6 +1329,14 @@ static int index_entry_similarity_calc(
 
 	*out = NULL;
 
+	if ((error = git_diff_find_similar__hashsig_cache(&hashsigs, repo, opts->metric)) < 0)
+		return error;
+
+	if (hashsigs &&
+	    (error = git_hashsig_cache_lookup((git_hashsig **)out, hashsigs, &entry->id,
+			GIT_DIFF_FIND_SIMILAR__HASHSIG_OPTS(opts->metric))) != GIT_ENOTFOUND)
+		return error;
+
 	git_oid_clear(&diff_file.id, repo->oid_type);
 
 	if ((error = git_blob_lookup(&blob, repo, &entry->id)) < 0)
@@ -1091,6 +1359,8 @@ static int index_entry_similarity_calc(
 		opts->metric->payload);
 	if (error == GIT_EBUFS)
 		*out = &cache_invalid_marker;
+	else if (!error && hashsigs && *out)
+		error = git_hashsig_cache_add(hashsigs, &entry->id, *out);
 
 	git_blob_free(blob);
 
@@ -1548,6 +1818,7 @@ int git_merge_diff_list__find_renames(
 	const git_merge_options *opts)
 {
 	struct merge_diff_similarity *similarity_ours, *similarity_theirs;
+	git_hashsig_cache *hashsigs;
 	void **cache = NULL;
 	size_t cache_size = 0;
 	size_t src_count, tgt_count, i;
@@ -1587,6 +1858,11 @@ int git_merge_diff_list__find_renames(
 			if ((error = merge_diff_mark_similarity_inexact(
 				repo, diff_list, similarity_ours, similarity_theirs, cache, opts)) < 0)
 				goto done;
+
+			/* the signature cache is only an optimization; don't fail over it */
+			if (git_diff_find_similar__hashsig_cache(&hashsigs, repo, opts->metric) < 0 ||
+			    (hashsigs && git_hashsig_cache_write(hashsigs) < 0))
+				git_error_clear();
 		}
 	}
 
@@ -1839,38 +2115,171 @@ int git_merge_diff_list__find_differences(
 	return git_iterator_walk(iterators, 3, queue_difference, &find_data);
 }
 
-git_merge_diff_list *git_merge_diff_list__alloc(git_repository *repo)
+/*
+ * Decides what to do with a directory that is a tree on (some of) the
+ * sides of the merge: a tree that is the same on every side is taken as
+ * a whole, without looking at its contents.  Without rename detection,
+ * a tree that only one side changed (or that both sides changed in the
+ * same way) can be taken as a whole as well.  Rename detection needs to
+ * see every file that either side added or removed, so with it, any
+ * other tree is descended into.
+ */
+static int merge_diff_list_insert_tree(
+	bool *descend,
+	git_merge_diff_list *diff_list,
+	const git_index_entry *tree_items[3],
+	bool find_renames)
 {
-	git_merge_diff_list *diff_list = git__calloc(1, sizeof(git_merge_diff_list));
+	const git_index_entry *ancestor = tree_items[TREE_IDX_ANCESTOR],
+		*ours = tree_items[TREE_IDX_OURS],
+		*theirs = tree_items[TREE_IDX_THEIRS],
+		*result = NULL;
+	git_index_entry *entry;
+	size_t path_len;
+
+	if (ancestor && ours && theirs &&
+	    git_oid_equal(&ancestor->id, &ours->id) &&
+	    git_oid_equal(&ancestor->id, &theirs->id))
+		result = ours;
+	else if (!find_renames && ours && theirs && git_oid_equal(&ours->id, &theirs->id))
+		result = ours;
+	else if (!find_renames && ancestor && ours && theirs &&
+	         git_oid_equal(&ancestor->id, &ours->id))
+		result = theirs;
+	else if (!find_renames && ancestor && ours && theirs &&
+	         git_oid_equal(&ancestor->id, &theirs->id))
+		result = ours;
+
+	if ((*descend = (result == NULL)))
+		return 0;
 
-	if (diff_list == NULL)
-		return NULL;
+	entry = git_pool_mallocz(&diff_list->pool, sizeof(git_index_entry));
+	GIT_ERROR_CHECK_ALLOC(entry);
 
-	diff_list->repo = repo;
+	/* trees are given with a trailing slash */
+	path_len = strlen(result->path);
 
+	if (path_len && result->path[path_len - 1] == '/')
+		path_len--;
 
-	if (git_pool_init(&diff_list->pool, 1) < 0 ||
-	    git_vector_init(&diff_list->staged, 0, NULL) < 0 ||
-	    git_vector_init(&diff_list->conflicts, 0, NULL) < 0 ||
-	    git_vector_init(&diff_list->resolved, 0, NULL) < 0) {
-	    git_merge_diff_list__free(diff_list);
-		return NULL;
-	}
+	entry->mode = GIT_FILEMODE_TREE;
+	git_oid_cpy(&entry->id, &result->id);
 
-	return diff_list;
+	entry->path = git_pool_strndup(&diff_list->pool, result->path, path_len);
+	GIT_ERROR_CHECK_ALLOC(entry->path);
+
+	return git_vector_insert(&diff_list->staged, entry);
 }
 
-void git_merge_diff_list__free(git_merge_diff_list *diff_list)
+/*
+ * Like `git_merge_diff_list__find_differences`, but the iterators may
+ * return trees (without expanding them), and the trees that need no
+ * merging are staged as a whole, instead of file by file.
+ */
+static int merge_diff_list_find_tree_differences(
+	git_merge_diff_list *diff_list,
+	git_iterator *iterators[3],
+	bool find_renames)
 {
-	if (!diff_list)
-		return;
+	struct merge_diff_find_data find_data = { diff_list };
+	const git_index_entry *items[3], *cur_items[3], *first_match;
+	bool descend;
+	size_t i;
+	int cmp = 0, error;
 
-	git_vector_dispose(&diff_list->staged);
-	git_vector_dispose(&diff_list->conflicts);
-	git_vector_dispose(&diff_list->resolved);
-	git_pool_clear(&diff_list->pool);
-	git__free(diff_list);
-}
+	for (i = 0; i < 3; i++) {
+		if ((error = git_iterator_current(&items[i], iterators[i])) < 0 &&
+		    error != GIT_ITEROVER)
+			return error;
+	}
+
+	while (true) {
+		first_match = NULL;
+
+		for (i = 0; i < 3; i++) {
+			cur_items[i] = NULL;
+
+			if (items[i] == NULL)
+				continue;
+
+			if (first_match == NULL ||
+			    (cmp = git_index_entry_cmp(items[i], first_match)) < 0) {
+				memset(cur_items, 0, sizeof(cur_items));
+				first_match = items[i];
+				cur_items[i] = items[i];
+			} else if (cmp == 0) {
+				cur_items[i] = items[i];
+			}
+		}
+
+		if (first_match == NULL)
+			break;
+
+		descend = false;
+
+		/* trees sort by their path with a trailing slash */
+		if (S_ISDIR(first_match->mode))
+			error = merge_diff_list_insert_tree(&descend,
+				diff_list, cur_items, find_renames);
+		else
+			error = queue_difference(cur_items, &find_data);
+
+		if (error < 0)
+			return error;
+
+		for (i = 0; i < 3; i++) {
+			if (cur_items[i] == NULL)
+				continue;
+
+			if (descend)
+				error = git_iterator_advance_into(&items[i], iterators[i]);
+			else
+				error = git_iterator_advance(&items[i], iterators[i]);
+
+			if (error == GIT_ITEROVER) {
+				items[i] = NULL;
+				error = 0;
+			} else if (error < 0) {
+				return error;
+			}
+		}
+	}
+
+	return 0;
+}
+
+git_merge_diff_list *git_merge_diff_list__alloc(git_repository *repo)
+{
+	git_merge_diff_list *diff_list = git__calloc(1, sizeof(git_merge_diff_list));
+
+	if (diff_list == NULL)
+		return NULL;
+
+	diff_list->repo = repo;
+
+
+	if (git_pool_init(&diff_list->pool, 1) < 0 ||
+	    git_vector_init(&diff_list->staged, 0, NULL) < 0 ||
+	    git_vector_init(&diff_list->conflicts, 0, NULL) < 0 ||
+	    git_vector_init(&diff_list->resolved, 0, NULL) < 0) {
+	    git_merge_diff_list__free(diff_list);
+		return NULL;
+	}
+
+	return diff_list;
+}
+
+void git_merge_diff_list__free(git_merge_diff_list *diff_list)
+{
+	if (!diff_list)
+		return;
+
+	git_vector_dispose(&diff_list->staged);
+	git_vector_dispose(&diff_list->conflicts);
+	git_vector_dispose(&diff_list->resolved);
+	git_pool_clear(&diff_list->pool);
+	git__free(diff_list);
+}
 
 static int merge_normalize_opts(
 	git_repository *repo,
@@ -2096,34 +2505,33 @@ static git_iterator *iterator_given_or_empty(git_iterator **empty, git_iterator
 	return *empty;
 }
 
-int git_merge__iterators(
-	git_index **out,
-	git_repository *repo,
+/*
+ * Merges the given iterators into the diff list: the list's staged
+ * entries are then the merged entries, and its conflicts are the ones
+ * that could not be resolved.  When `tree_differences` is set, the
+ * iterators may return trees without expanding them, and the trees that
+ * need no merging are staged as a whole.
+ */
+static int merge_iterators(
+	git_merge_diff_list *diff_list,
 	git_iterator *ancestor_iter,
 	git_iterator *our_iter,
 	git_iterator *theirs_iter,
-	const git_merge_options *given_opts)
+	const git_merge_options *given_opts,
+	bool tree_differences)
 {
 	git_iterator *empty_ancestor = NULL,
 		*empty_ours = NULL,
 		*empty_theirs = NULL;
-	git_merge_diff_list *diff_list;
 	git_merge_options opts;
 	git_merge_file_options file_opts = GIT_MERGE_FILE_OPTIONS_INIT;
-	git_merge_diff *conflict;
 	git_vector changes;
-	size_t i;
 	int error = 0;
 
-	GIT_ASSERT_ARG(out);
-	GIT_ASSERT_ARG(repo);
-
-	*out = NULL;
-
 	GIT_ERROR_CHECK_VERSION(
 		given_opts, GIT_MERGE_OPTIONS_VERSION, "git_merge_options");
 
-	if ((error = merge_normalize_opts(repo, &opts, given_opts)) < 0)
+	if ((error = merge_normalize_opts(diff_list->repo, &opts, given_opts)) < 0)
 		return error;
 
 	file_opts.favor = opts.file_favor;
@@ -2138,53 +2546,299 @@ int git_merge__iterators(
 		file_opts.marker_size = GIT_MERGE_CONFLICT_MARKER_SIZE + 2;
 	}
 
-	diff_list = git_merge_diff_list__alloc(repo);
-	GIT_ERROR_CHECK_ALLOC(diff_list);
-
 	ancestor_iter = iterator_given_or_empty(&empty_ancestor, ancestor_iter);
 	our_iter = iterator_given_or_empty(&empty_ours, our_iter);
 	theirs_iter = iterator_given_or_empty(&empty_theirs, theirs_iter);
 
-	if ((error = git_merge_diff_list__find_differences(
-			diff_list, ancestor_iter, our_iter, theirs_iter)) < 0 ||
-		(error = git_merge_diff_list__find_renames(repo, diff_list, &opts)) < 0)
+	if (tree_differences) {
+		git_iterator *iterators[3] = { ancestor_iter, our_iter, theirs_iter };
+
+		error = merge_diff_list_find_tree_differences(diff_list,
+			iterators, (opts.flags & GIT_MERGE_FIND_RENAMES));
+	} else {
+		error = git_merge_diff_list__find_differences(diff_list,
+			ancestor_iter, our_iter, theirs_iter);
+	}
+
+	if (error < 0 ||
+	    (error = git_merge_diff_list__find_renames(diff_list->repo, diff_list, &opts)) < 0)
 		goto done;
 
 	memcpy(&changes, &diff_list->conflicts, sizeof(git_vector));
 	git_vector_clear(&diff_list->conflicts);
 
-	git_vector_foreach(&changes, i, conflict) {
-		int resolved = 0;
+#ifdef GIT_THREADS
+	if (opts.threads > 1)
+		error = merge_conflicts_resolve_threaded(diff_list, &changes, &opts, &file_opts);
+	else
+#endif
+		error = merge_conflicts_resolve(diff_list, &changes, &opts, &file_opts);
 
-		if ((error = merge_conflict_resolve(
-			&resolved, diff_list, conflict, &opts, &file_opts)) < 0)
+done:
+	if (!given_opts || !given_opts->metric)
+		git__free(opts.metric);
+
+	git__free((char *)opts.default_driver);
+
+	git_iterator_free(empty_ancestor);
+	git_iterator_free(empty_ours);
+	git_iterator_free(empty_theirs);
+
+	return error;
+}
+
+int git_merge__iterators(
+	git_index **out,
+	git_repository *repo,
+	git_iterator *ancestor_iter,
+	git_iterator *our_iter,
+	git_iterator *theirs_iter,
+	const git_merge_options *given_opts)
+{
+	git_merge_diff_list *diff_list;
+	int error = 0;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	*out = NULL;
+
+	diff_list = git_merge_diff_list__alloc(repo);
+	GIT_ERROR_CHECK_ALLOC(diff_list);
+
+	if ((error = merge_iterators(diff_list, ancestor_iter, our_iter,
+			theirs_iter, given_opts, false)) == 0)
+		error = index_from_diff_list(out, diff_list, repo->oid_type,
+			(given_opts && (given_opts->flags & GIT_MERGE_SKIP_REUC)));
+
+	git_merge_diff_list__free(diff_list);
+	return error;
+}
+
+/* Merging to a tree */
+
+static int merge_tree_entry_cmp(const void *a, const void *b)
+{
+	const git_index_entry *entry_a = a, *entry_b = b;
+	return strcmp(entry_a->path, entry_b->path);
+}
+
+typedef struct {
+	git_treebuilder *builder;
+	size_t dir_len;
+} merge_tree_frame;
+
+typedef git_array_t(merge_tree_frame) merge_tree_stack;
+
+static int merge_tree_pop(
+	git_oid *out,
+	merge_tree_stack *stack,
+	git_str *dir)
+{
+	merge_tree_frame *frame = git_array_pop(*stack), *parent;
+	git_oid tree_id;
+	int error;
+
+	if ((error = git_treebuilder_write(&tree_id, frame->builder)) < 0)
+		goto done;
+
+	if ((parent = git_array_last(*stack)) == NULL) {
+		git_oid_cpy(out, &tree_id);
+		goto done;
+	}
+
+	/* the directory's name, without its trailing slash */
+	dir->ptr[dir->size - 1] = '\0';
+
+	error = git_treebuilder_insert(NULL, parent->builder,
+		dir->ptr + parent->dir_len, &tree_id, GIT_FILEMODE_TREE);
+
+	git_str_truncate(dir, parent->dir_len);
+
+done:
+	git_treebuilder_free(frame->builder);
+	return error;
+}
+
+static int merge_tree_push(
+	merge_tree_stack *stack,
+	git_repository *repo,
+	git_str *dir)
+{
+	merge_tree_frame *frame = git_array_alloc(*stack);
+	GIT_ERROR_CHECK_ALLOC(frame);
+
+	frame->dir_len = dir->size;
+	return git_treebuilder_new(&frame->builder, repo, NULL);
+}
+
+/*
+ * Writes the tree of the given entries, which are sorted by their path;
+ * the entries may themselves be trees.  Only the first of the entries
+ * with the same path is written.
+ */
+static int merge_write_tree(
+	git_oid *out,
+	git_repository *repo,
+	git_vector *entries)
+{
+	merge_tree_stack stack = GIT_ARRAY_INIT;
+	git_str dir = GIT_STR_INIT;
+	const git_index_entry *entry, *last = NULL;
+	merge_tree_frame *frame;
+	const char *name, *slash;
+	git_oid root_id;
+	size_t i;
+	int error;
+
+	if ((error = merge_tree_push(&stack, repo, &dir)) < 0)
+		goto done;
+
+	git_vector_foreach(entries, i, entry) {
+		if (last && strcmp(last->path, entry->path) == 0)
+			continue;
+
+		last = entry;
+
+		/* leave the directories that this entry is not in */
+		while (stack.size > 1 &&
+		       strncmp(entry->path, dir.ptr, dir.size) != 0) {
+			if ((error = merge_tree_pop(&root_id, &stack, &dir)) < 0)
+				goto done;
+		}
+
+		/* and enter the ones that it is in */
+		name = entry->path + dir.size;
+
+		while ((slash = strchr(name, '/')) != NULL) {
+			if ((error = git_str_put(&dir, name, (slash - name) + 1)) < 0 ||
+			    (error = merge_tree_push(&stack, repo, &dir)) < 0)
+				goto done;
+
+			name = slash + 1;
+		}
+
+		frame = git_array_last(stack);
+
+		if ((error = git_treebuilder_insert(NULL, frame->builder,
+				name, &entry->id, entry->mode)) < 0)
 			goto done;
+	}
+
+	while (stack.size > 0) {
+		if ((error = merge_tree_pop(&root_id, &stack, &dir)) < 0)
+			goto done;
+	}
+
+	git_oid_cpy(out, &root_id);
+
+done:
+	while ((frame = git_array_pop(stack)) != NULL)
+		git_treebuilder_free(frame->builder);
+
+	git_array_clear(stack);
+	git_str_dispose(&dir);
+	return error;
+}
 
-		if (!resolved) {
-			if ((opts.flags & GIT_MERGE_FAIL_ON_CONFLICT)) {
-				git_error_set(GIT_ERROR_MERGE, "merge conflicts exist");
-				error = GIT_EMERGECONFLICT;
+static int merge_conflict_paths(
+	git_strarray *out,
+	git_merge_diff_list *diff_list)
+{
+	git_vector paths = GIT_VECTOR_INIT;
+	const git_merge_diff *conflict;
+	const git_index_entry *entries[3];
+	char *path;
+	size_t i, j;
+	int error = 0;
+
+	paths._cmp = git__strcmp_cb;
+
+	git_vector_foreach(&diff_list->conflicts, i, conflict) {
+		entries[0] = &conflict->ancestor_entry;
+		entries[1] = &conflict->our_entry;
+		entries[2] = &conflict->their_entry;
+
+		for (j = 0; j < 3; j++) {
+			if (!GIT_MERGE_INDEX_ENTRY_EXISTS(*entries[j]))
+				continue;
+
+			if ((path = git__strdup(entries[j]->path)) == NULL ||
+			    (error = git_vector_insert(&paths, path)) < 0) {
+				git__free(path);
+				error = -1;
 				goto done;
 			}
-
-			git_vector_insert(&diff_list->conflicts, conflict);
 		}
 	}
 
-	error = index_from_diff_list(out, diff_list, repo->oid_type,
-		(opts.flags & GIT_MERGE_SKIP_REUC));
+	git_vector_sort(&paths);
+	git_vector_uniq(&paths, git__free);
+
+	out->strings = (char **)git_vector_detach(&out->count, NULL, &paths);
 
 done:
-	if (!given_opts || !given_opts->metric)
-		git__free(opts.metric);
+	git_vector_foreach(&paths, i, path)
+		git__free(path);
 
-	git__free((char *)opts.default_driver);
+	git_vector_dispose(&paths);
+	return error;
+}
 
-	git_merge_diff_list__free(diff_list);
-	git_iterator_free(empty_ancestor);
-	git_iterator_free(empty_ours);
-	git_iterator_free(empty_theirs);
+/*
+ * Merges the given iterators (which may return trees without expanding
+ * them) and writes the result as a tree.  Paths that are in conflict
+ * keep our side of the conflict (if we have one).
+ */
+static int merge_iterators_to_tree(
+	git_oid *out,
+	git_strarray *conflicts,
+	git_repository *repo,
+	git_iterator *ancestor_iter,
+	git_iterator *our_iter,
+	git_iterator *theirs_iter,
+	const git_merge_options *opts)
+{
+	git_merge_diff_list *diff_list;
+	git_vector entries = GIT_VECTOR_INIT;
+	const git_merge_diff *conflict;
+	const git_index_entry *entry;
+	size_t i;
+	int error;
+
+	diff_list = git_merge_diff_list__alloc(repo);
+	GIT_ERROR_CHECK_ALLOC(diff_list);
+
+	if ((error = merge_iterators(diff_list, ancestor_iter, our_iter,
+			theirs_iter, opts, true)) < 0 ||
+	    (error = git_vector_init(&entries, diff_list->staged.length,
+			merge_tree_entry_cmp)) < 0)
+		goto done;
 
+	git_vector_foreach(&diff_list->staged, i, entry) {
+		if ((error = git_vector_insert(&entries, (void *)entry)) < 0)
+			goto done;
+	}
+
+	git_vector_foreach(&diff_list->conflicts, i, conflict) {
+		if (GIT_MERGE_INDEX_ENTRY_EXISTS(conflict->our_entry) &&
+		    (error = git_vector_insert(&entries,
+				(void *)&conflict->our_entry)) < 0)
+			goto done;
+	}
+
+	/* the sort is stable, so the merged entries win over conflicts */
+	git_vector_sort(&entries);
+
+	if ((error = merge_write_tree(out, repo, &entries)) < 0)
+		goto done;
+
+	if (conflicts)
+		error = merge_conflict_paths(conflicts, diff_list);
+
+done:
+	git_vector_dispose(&entries);
+	git_merge_diff_list__free(diff_list);
 	return error;
 }
 
@@ -2243,6 +2897,65 @@ done:
 	return error;
 }
 
+int git_merge_trees_to_tree(
+	git_oid *out,
+	git_strarray *conflicts,
+	git_repository *repo,
+	const git_tree *ancestor_tree,
+	const git_tree *our_tree,
+	const git_tree *their_tree,
+	const git_merge_options *merge_opts)
+{
+	git_iterator *ancestor_iter = NULL, *our_iter = NULL, *their_iter = NULL;
+	git_iterator_options iter_opts = GIT_ITERATOR_OPTIONS_INIT;
+	const git_tree *result = NULL;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	if (conflicts) {
+		conflicts->strings = NULL;
+		conflicts->count = 0;
+	}
+
+	/* if one side is treesame to the ancestor, take the other side */
+	if (our_tree && their_tree) {
+		if (!git_oid_cmp(git_tree_id(our_tree), git_tree_id(their_tree)))
+			result = our_tree;
+		else if (ancestor_tree && !git_oid_cmp(git_tree_id(ancestor_tree), git_tree_id(our_tree)))
+			result = their_tree;
+		else if (ancestor_tree && !git_oid_cmp(git_tree_id(ancestor_tree), git_tree_id(their_tree)))
+			result = our_tree;
+
+		if (result) {
+			git_oid_cpy(out, git_tree_id(result));
+			return 0;
+		}
+	}
+
+	iter_opts.flags = GIT_ITERATOR_DONT_IGNORE_CASE |
+		GIT_ITERATOR_DONT_AUTOEXPAND;
+
+	if ((error = git_iterator_for_tree(
+			&ancestor_iter, (git_tree *)ancestor_tree, &iter_opts)) < 0 ||
+		(error = git_iterator_for_tree(
+			&our_iter, (git_tree *)our_tree, &iter_opts)) < 0 ||
+		(error = git_iterator_for_tree(
+			&their_iter, (git_tree *)their_tree, &iter_opts)) < 0)
+		goto done;
+
+	error = merge_iterators_to_tree(out, conflicts, repo,
+		ancestor_iter, our_iter, their_iter, merge_opts);
+
+done:
+	git_iterator_free(ancestor_iter);
+	git_iterator_free(our_iter);
+	git_iterator_free(their_iter);
+
+	return error;
+}
+
 static int merge_annotated_commits(
 	git_index **index_out,
 	git_annotated_commit **base_out,
@@ -2480,6 +3193,78 @@ done:
 	return error;
 }
 
+/*
+ * Like `iterator_for_annotated_commit`, but the trees of real commits are
+ * not expanded, so that they can be merged as a whole.
+ */
+static int tree_iterator_for_annotated_commit(
+	git_iterator **out,
+	git_annotated_commit *commit)
+{
+	git_iterator_options opts = GIT_ITERATOR_OPTIONS_INIT;
+	int error;
+
+	if (commit == NULL || commit->type == GIT_ANNOTATED_COMMIT_VIRTUAL)
+		return iterator_for_annotated_commit(out, commit);
+
+	if (!commit->tree &&
+	    (error = git_commit_tree(&commit->tree, commit->commit)) < 0)
+		return error;
+
+	opts.flags = GIT_ITERATOR_DONT_IGNORE_CASE | GIT_ITERATOR_DONT_AUTOEXPAND;
+
+	return git_iterator_for_tree(out, commit->tree, &opts);
+}
+
+int git_merge_commits_to_tree(
+	git_oid *out,
+	git_strarray *conflicts,
+	git_repository *repo,
+	const git_commit *our_commit,
+	const git_commit *their_commit,
+	const git_merge_options *opts)
+{
+	git_annotated_commit *ours = NULL, *theirs = NULL, *base = NULL;
+	git_iterator *base_iter = NULL, *our_iter = NULL, *their_iter = NULL;
+	int error = 0;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	if (conflicts) {
+		conflicts->strings = NULL;
+		conflicts->count = 0;
+	}
+
+	if ((error = git_annotated_commit_from_commit(&ours, (git_commit *)our_commit)) < 0 ||
+		(error = git_annotated_commit_from_commit(&theirs, (git_commit *)their_commit)) < 0)
+		goto done;
+
+	if ((error = compute_base(&base, repo, ours, theirs, opts, 0)) < 0) {
+		if (error != GIT_ENOTFOUND)
+			goto done;
+
+		git_error_clear();
+	}
+
+	if ((error = tree_iterator_for_annotated_commit(&base_iter, base)) < 0 ||
+		(error = tree_iterator_for_annotated_commit(&our_iter, ours)) < 0 ||
+		(error = tree_iterator_for_annotated_commit(&their_iter, theirs)) < 0)
+		goto done;
+
+	error = merge_iterators_to_tree(out, conflicts, repo,
+		base_iter, our_iter, their_iter, opts);
+
+done:
+	git_iterator_free(base_iter);
+	git_iterator_free(our_iter);
+	git_iterator_free(their_iter);
+	git_annotated_commit_free(ours);
+	git_annotated_commit_free(theirs);
+	git_annotated_commit_free(base);
+	return error;
+}
+
 /* Merge setup / cleanup */
 
 static int write_merge_head(
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "merge_base_cache.h"
+
+#include "hashmap.h"
+#include "hashmap_oid.h"
+#include "repository.h"
+
+/* The cache is emptied once it holds this many merge bases. */
+#define MERGE_BASE_CACHE_MAX_ENTRIES (1 << 16)
+
+typedef struct {
+	git_oid one;
+	git_oid two;
+} merge_base_cache_key;
+
+typedef struct {
+	git_oid base;
+	bool found;
+} merge_base_cache_entry;
+
+GIT_INLINE(uint32_t) merge_base_cache_key_hash(merge_base_cache_key key)
+{
+	return git_hashmap_oid_hashcode(&key.one) * 31 +
+	       git_hashmap_oid_hashcode(&key.two);
+}
+
+GIT_INLINE(bool) merge_base_cache_key_equal(
+	merge_base_cache_key a,
+	merge_base_cache_key b)
+{
+	return git_oid_equal(&a.one, &b.one) && git_oid_equal(&a.two, &b.two);
+}
+
+GIT_HASHMAP_SETUP(git_merge_base_cachemap, merge_base_cache_key,
+	merge_base_cache_entry, merge_base_cache_key_hash,
+	merge_base_cache_key_equal);
+
+struct git_merge_base_cache {
+	git_mutex lock;
+	git_merge_base_cachemap map;
+};
+
+/*
+ * The merge base of two commits doesn't depend on their order, so the
+ * pair is ordered to keep a single entry for it.
+ */
+static void merge_base_cache_key_init(
+	merge_base_cache_key *key,
+	const git_oid *one,
+	const git_oid *two)
+{
+	if (git_oid_cmp(one, two) > 0) {
+		const git_oid *tmp = one;
+		one = two;
+		two = tmp;
+	}
+
+	memset(key, 0, sizeof(merge_base_cache_key));
+	git_oid_cpy(&key->one, one);
+	git_oid_cpy(&key->two, two);
+}
+
+int git_repository__merge_base_cache(
+	git_merge_base_cache **out,
+	git_repository *repo)
+{
+	git_merge_base_cache *cache, *newcache;
+	int enabled, error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	*out = NULL;
+
+	if ((error = git_repository__configmap_lookup(&enabled, repo, GIT_CONFIGMAP_MERGEBASECACHE)) < 0)
+		return error;
+
+	if (!enabled)
+		return 0;
+
+	if ((cache = git_atomic_load(repo->merge_base_cache)) == NULL) {
+		newcache = git__calloc(1, sizeof(git_merge_base_cache));
+		GIT_ERROR_CHECK_ALLOC(newcache);
+
+		if (git_mutex_init(&newcache->lock)) {
+			git_error_set(GIT_ERROR_OS, "unable to initialize lock for merge base cache");
+			git__free(newcache);
+			return -1;
+		}
+
+		/* if we race, free losing allocation */
+		if ((cache = git_atomic_compare_and_swap(&repo->merge_base_cache, NULL, newcache)) == NULL)
+			cache = newcache;
+		else
+			git_merge_base_cache_free(newcache);
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_merge_base_cache_lookup(
+	git_oid *out,
+	bool *found,
+	git_merge_base_cache *cache,
+	const git_oid *one,
+	const git_oid *two)
+{
+	merge_base_cache_key key;
+	merge_base_cache_entry entry;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(found);
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(one);
+	GIT_ASSERT_ARG(two);
+
+	merge_base_cache_key_init(&key, one, two);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock merge base cache");
+		return -1;
+	}
+
+	if ((error = git_merge_base_cachemap_get(&entry, &cache->map, key)) == 0) {
+		*found = entry.found;
+
+		if (entry.found)
+			git_oid_cpy(out, &entry.base);
+	}
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+int git_merge_base_cache_add(
+	git_merge_base_cache *cache,
+	const git_oid *one,
+	const git_oid *two,
+	const git_oid *base)
+{
+	merge_base_cache_key key;
+	merge_base_cache_entry entry = {{{0}}};
+	int error;
+
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(one);
+	GIT_ASSERT_ARG(two);
+
+	merge_base_cache_key_init(&key, one, two);
+
+	if ((entry.found = (base != NULL)))
+		git_oid_cpy(&entry.base, base);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock merge base cache");
+		return -1;
+	}
+
+	if (git_merge_base_cachemap_size(&cache->map) >= MERGE_BASE_CACHE_MAX_ENTRIES)
+		git_merge_base_cachemap_clear(&cache->map);
+
+	error = git_merge_base_cachemap_put(&cache->map, key, entry);
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+void git_merge_base_cache_free(git_merge_base_cache *cache)
+{
+	if (!cache)
+		return;
+
+	git_merge_base_cachemap_dispose(&cache->map);
+	git_mutex_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_merge_base_cache_h__
+#define INCLUDE_merge_base_cache_h__
+
+#include "common.h"
+
+#include "git2/oid.h"
+#include "git2/types.h"
+
+/*
+ * A cache of the merge bases of pairs of commits, which is kept for the
+ * lifetime of the repository when `core.mergeBaseCache` is enabled.
+ * Commits are immutable, so the merge base of two commits never changes
+ * (unless the repository's grafts do), and the cache never needs to be
+ * invalidated when references move.
+ */
+typedef struct git_merge_base_cache git_merge_base_cache;
+
+/*
+ * Looks up the repository's merge base cache; `*out` is set to NULL when
+ * the cache is not enabled.
+ */
+extern int git_repository__merge_base_cache(
+	git_merge_base_cache **out,
+	git_repository *repo);
+
+/*
+ * Looks up the merge base of the given commits.  Returns GIT_ENOTFOUND
+ * if it is not in the cache; otherwise `*found` is set to whether the
+ * commits have a merge base at all, and `out` to the merge base if they
+ * do.
+ */
+extern int git_merge_base_cache_lookup(
+	git_oid *out,
+	bool *found,
+	git_merge_base_cache *cache,
+	const git_oid *one,
+	const git_oid *two);
+
+/* Adds the merge base of the given commits, or NULL if there is none. */
+extern int git_merge_base_cache_add(
+	git_merge_base_cache *cache,
+	const git_oid *one,
+	const git_oid *two,
+	const git_oid *base);
+
+extern void git_merge_base_cache_free(git_merge_base_cache *cache);
+
+#endif
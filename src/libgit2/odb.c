@@ -514,6 +514,11 @@ int git_odb__add_default_backends(
 		git_mutex_unlock(&db->lock);
 		return -1;
 	}
+	if (!as_alternates && !db->objects_dir &&
+	    (db->objects_dir = git__strdup(objects_dir)) == NULL) {
+		git_mutex_unlock(&db->lock);
+		return -1;
+	}
 	git_mutex_unlock(&db->lock);
 
 	return load_alternates(db, objects_dir, alternate_depth);
@@ -659,6 +664,7 @@ static void odb_free(git_odb *db)
 		git_mutex_unlock(&db->lock);
 
 	git_commit_graph_free(db->cgraph);
+	git__free(db->objects_dir);
 	git_vector_dispose(&db->backends);
 	git_cache_dispose(&db->own_cache);
 	git_mutex_free(&db->lock);
@@ -1599,6 +1605,99 @@ int git_odb_open_rstream(
 	return error;
 }
 
+int git_odb_bulk_checkin_begin(git_odb *db)
+{
+	git_odb_backend *bulk = NULL;
+	backend_internal *internal;
+	int priority = 0;
+	size_t i;
+
+	GIT_ASSERT_ARG(db);
+
+	if (db->bulk) {
+		git_error_set(GIT_ERROR_ODB, "a bulk checkin is already in progress");
+		return -1;
+	}
+
+	if (!db->objects_dir) {
+		git_error_set(GIT_ERROR_ODB, "bulk checkin requires an on-disk object database");
+		return -1;
+	}
+
+	if (git_odb__bulk_backend_new(&bulk, db->objects_dir, db->options.oid_type) < 0)
+		return -1;
+
+	/* all writes must go to the bulk backend, so it must come first */
+	if (git_mutex_lock(&db->lock) < 0) {
+		git_error_set(GIT_ERROR_ODB, "failed to acquire the odb lock");
+		bulk->free(bulk);
+		return -1;
+	}
+	git_vector_foreach(&db->backends, i, internal) {
+		if (i == 0 || internal->priority >= priority)
+			priority = internal->priority + 1;
+	}
+	git_mutex_unlock(&db->lock);
+
+	if (add_backend_internal(db, bulk, priority, false, 0) < 0) {
+		bulk->free(bulk);
+		return -1;
+	}
+
+	db->bulk = bulk;
+	return 0;
+}
+
+static int bulk_checkin_end(git_odb *db, bool commit)
+{
+	git_odb_backend *bulk;
+	backend_internal *internal;
+	size_t i;
+	int error = 0;
+
+	GIT_ASSERT_ARG(db);
+
+	if ((bulk = db->bulk) == NULL) {
+		git_error_set(GIT_ERROR_ODB, "no bulk checkin is in progress");
+		return -1;
+	}
+
+	/*
+	 * The bulk backend must be able to serve reads while the objects
+	 * are indexed, so keep it until the new packfile is in place.
+	 */
+	if (commit && (error = git_odb__bulk_backend_commit(bulk, db)) < 0)
+		return error;
+
+	if (git_mutex_lock(&db->lock) < 0) {
+		git_error_set(GIT_ERROR_ODB, "failed to acquire the odb lock");
+		return -1;
+	}
+	git_vector_foreach(&db->backends, i, internal) {
+		if (internal->backend == bulk) {
+			git_vector_remove(&db->backends, i);
+			git__free(internal);
+			break;
+		}
+	}
+	git_mutex_unlock(&db->lock);
+
+	db->bulk = NULL;
+	bulk->free(bulk);
+
+	return error;
+}
+
+int git_odb_bulk_checkin_commit(git_odb *db)
+{
+	return bulk_checkin_end(db, true);
+}
+
+int git_odb_bulk_checkin_abort(git_odb *db)
+{
+	return bulk_checkin_end(db, false);
+}
+
 int git_odb_write_pack(struct git_odb_writepack **out, git_odb *db, git_indexer_progress_cb progress_cb, void *progress_payload)
 {
 	size_t i, writes = 0;
@@ -51,6 +51,8 @@ struct git_odb {
 	git_vector backends;
 	git_cache own_cache;
 	git_commit_graph *cgraph;
+	char *objects_dir;
+	git_odb_backend *bulk;
 	unsigned int do_fsync :1;
 };
 
@@ -63,6 +65,21 @@ typedef enum {
  */
 int git_odb__set_caps(git_odb *odb, int caps);
 
+/*
+ * Create a backend that queues written objects in a temporary packfile
+ * in the given objects directory, for a bulk checkin.
+ */
+int git_odb__bulk_backend_new(
+	git_odb_backend **out,
+	const char *objects_dir,
+	git_oid_t oid_type);
+
+/*
+ * Write the objects queued in a bulk checkin backend into a new packfile
+ * (with its index) in the given object database.
+ */
+int git_odb__bulk_backend_commit(git_odb_backend *backend, git_odb *odb);
+
 /*
  * Add the default loose and packed backends for a database.
  */
@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+
+#include "filebuf.h"
+#include "futils.h"
+#include "hash.h"
+#include "hashmap_oid.h"
+#include "odb.h"
+#include "pack.h"
+#include "pool.h"
+#include "repository.h"
+#include "vector.h"
+#include "zstream.h"
+
+#include "git2/odb_backend.h"
+#include "git2/sys/odb_backend.h"
+
+/*
+ * The bulk checkin backend appends every object that is written to it
+ * to a single temporary packfile, which begins with a placeholder header.
+ * Until the bulk checkin is committed, reads are served from that file.
+ * To commit it, the header is filled in, the trailer is appended, and the
+ * packfile is moved into place; its index is written directly from the
+ * entries that were recorded as the objects were appended, so that the
+ * packfile is never copied or parsed again.  It is synced to disk once.
+ */
+
+#define BULK_COPY_BUFFER_SIZE (64 * 1024)
+
+struct bulk_object {
+	git_oid oid;
+	git_object_t type;
+	size_t size;
+
+	/* the position of the entry in the packfile */
+	off64_t entry_offset;
+	uint32_t crc;
+
+	/* the position (and length) of the deflated data in the packfile */
+	off64_t offset;
+	size_t compressed_len;
+};
+
+GIT_HASHMAP_OID_SETUP(git_odb_bulk_oidmap, struct bulk_object *);
+
+struct bulk_backend {
+	git_odb_backend parent;
+	git_oid_t oid_type;
+
+	/* protects the packfile's size, the objects and the entry count */
+	git_mutex lock;
+
+	git_str path;
+	int fd;
+	off64_t size;
+	bool committed;
+
+	git_pool objects_pool;
+	git_odb_bulk_oidmap objects;
+	uint32_t entries;
+};
+
+static int bulk_write_at(struct bulk_backend *backend, const void *data, size_t len, off64_t offset)
+{
+	const char *in = data;
+	ssize_t ret;
+
+	while (len > 0) {
+		HANDLE_EINTR(ret, p_pwrite(backend->fd, in, len, offset));
+
+		if (ret <= 0) {
+			git_error_set(GIT_ERROR_OS, "could not write to bulk checkin file '%s'", backend->path.ptr);
+			return -1;
+		}
+
+		in += ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+static int bulk_append(struct bulk_backend *backend, const void *data, size_t len)
+{
+	if (bulk_write_at(backend, data, len, backend->size) < 0)
+		return -1;
+
+	backend->size += len;
+	return 0;
+}
+
+static int bulk_read_at(struct bulk_backend *backend, void *data, size_t len, off64_t offset)
+{
+	char *out = data;
+	ssize_t ret;
+
+	while (len > 0) {
+		if ((ret = p_pread(backend->fd, out, len, offset)) <= 0) {
+			git_error_set(GIT_ERROR_OS, "could not read from bulk checkin file '%s'", backend->path.ptr);
+			return -1;
+		}
+
+		out += ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+static int bulk_lock(struct bulk_backend *backend)
+{
+	if (git_mutex_lock(&backend->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to lock bulk checkin");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int bulk_backend__write(
+	git_odb_backend *_backend,
+	const git_oid *oid,
+	const void *data,
+	size_t len,
+	git_object_t type)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+	struct bulk_object *obj;
+	git_str deflated = GIT_STR_INIT;
+	unsigned char hdr[16];
+	size_t hdr_len;
+	off64_t start;
+	uint32_t crc;
+	bool exists;
+	int error;
+
+	if (bulk_lock(backend) < 0)
+		return -1;
+
+	exists = git_odb_bulk_oidmap_contains(&backend->objects, oid);
+	git_mutex_unlock(&backend->lock);
+
+	if (exists)
+		return 0;
+
+	/* compress outside of the lock, so that writers can run in parallel */
+	if ((error = git_packfile__object_header(&hdr_len, hdr, len, type)) < 0 ||
+	    (error = git_zstream_deflatebuf(&deflated, data, len)) < 0)
+		goto done;
+
+	crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, hdr, (uInt)hdr_len);
+	crc = crc32(crc, (const unsigned char *)deflated.ptr, (uInt)deflated.size);
+
+	if ((error = bulk_lock(backend)) < 0)
+		goto done;
+
+	/* another thread may have written it in the meantime */
+	if (git_odb_bulk_oidmap_contains(&backend->objects, oid))
+		goto unlock;
+
+	if (backend->entries == UINT32_MAX) {
+		git_error_set(GIT_ERROR_ODB, "too many objects in bulk checkin");
+		error = -1;
+		goto unlock;
+	}
+
+	if ((obj = git_pool_mallocz(&backend->objects_pool, 1)) == NULL) {
+		error = -1;
+		goto unlock;
+	}
+
+	start = backend->size;
+
+	git_oid_cpy(&obj->oid, oid);
+	obj->type = type;
+	obj->size = len;
+	obj->entry_offset = start;
+	obj->crc = crc;
+	obj->offset = start + hdr_len;
+	obj->compressed_len = deflated.size;
+
+	if ((error = bulk_append(backend, hdr, hdr_len)) < 0 ||
+	    (error = bulk_append(backend, deflated.ptr, deflated.size)) < 0 ||
+	    (error = git_odb_bulk_oidmap_put(&backend->objects, &obj->oid, obj)) < 0) {
+		/* don't leave data behind that no index entry covers */
+		backend->size = start;
+		p_ftruncate(backend->fd, start);
+		goto unlock;
+	}
+
+	backend->entries++;
+
+unlock:
+	git_mutex_unlock(&backend->lock);
+done:
+	git_str_dispose(&deflated);
+	return error;
+}
+
+static int bulk_lookup(
+	struct bulk_object *out,
+	struct bulk_backend *backend,
+	const git_oid *oid)
+{
+	struct bulk_object *obj;
+	int error = 0;
+
+	if (bulk_lock(backend) < 0)
+		return -1;
+
+	if (git_odb_bulk_oidmap_get(&obj, &backend->objects, oid) == 0)
+		memcpy(out, obj, sizeof(struct bulk_object));
+	else
+		error = GIT_ENOTFOUND;
+
+	git_mutex_unlock(&backend->lock);
+	return error;
+}
+
+static int bulk_backend__read(
+	void **buffer_p,
+	size_t *len_p,
+	git_object_t *type_p,
+	git_odb_backend *_backend,
+	const git_oid *oid)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+	struct bulk_object obj;
+	char *compressed = NULL, *data = NULL;
+	size_t alloc_len;
+	int error;
+
+	if ((error = bulk_lookup(&obj, backend, oid)) < 0)
+		return error;
+
+	GIT_ERROR_CHECK_ALLOC_ADD(&alloc_len, obj.size, 1);
+
+	if ((compressed = git__malloc(obj.compressed_len)) == NULL ||
+	    (data = git_odb_backend_data_alloc(_backend, alloc_len)) == NULL) {
+		error = -1;
+		goto done;
+	}
+
+	if ((error = bulk_read_at(backend, compressed, obj.compressed_len, obj.offset)) < 0)
+		goto done;
+
+	if ((error = git_zstream_inflate_oneshot(data, obj.size, NULL,
+			compressed, obj.compressed_len)) < 0) {
+		if (error == GIT_EBUFS) {
+			git_error_set(GIT_ERROR_ZLIB, "failed to inflate bulk checkin object");
+			error = -1;
+		}
+
+		goto done;
+	}
+
+	data[obj.size] = '\0';
+
+	*buffer_p = data;
+	*len_p = obj.size;
+	*type_p = obj.type;
+
+done:
+	if (error < 0 && data)
+		git_odb_backend_data_free(_backend, data);
+
+	git__free(compressed);
+	return error;
+}
+
+static int bulk_backend__read_header(
+	size_t *len_p,
+	git_object_t *type_p,
+	git_odb_backend *_backend,
+	const git_oid *oid)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+	struct bulk_object obj;
+	int error;
+
+	if ((error = bulk_lookup(&obj, backend, oid)) < 0)
+		return error;
+
+	*len_p = obj.size;
+	*type_p = obj.type;
+	return 0;
+}
+
+static int bulk_backend__exists(git_odb_backend *_backend, const git_oid *oid)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+	bool exists;
+
+	if (bulk_lock(backend) < 0)
+		return -1;
+
+	exists = git_odb_bulk_oidmap_contains(&backend->objects, oid);
+
+	git_mutex_unlock(&backend->lock);
+	return exists;
+}
+
+static void bulk_backend__free(git_odb_backend *_backend)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+
+	if (!backend)
+		return;
+
+	if (backend->fd >= 0) {
+		p_close(backend->fd);
+
+		if (!backend->committed)
+			p_unlink(backend->path.ptr);
+	}
+
+	git_odb_bulk_oidmap_dispose(&backend->objects);
+	git_pool_clear(&backend->objects_pool);
+	git_str_dispose(&backend->path);
+	git_mutex_free(&backend->lock);
+	git__free(backend);
+}
+
+int git_odb__bulk_backend_new(
+	git_odb_backend **out,
+	const char *objects_dir,
+	git_oid_t oid_type)
+{
+	struct bulk_backend *backend;
+	struct git_pack_header hdr = { 0 };
+	git_str template = GIT_STR_INIT;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(objects_dir);
+
+	backend = git__calloc(1, sizeof(struct bulk_backend));
+	GIT_ERROR_CHECK_ALLOC(backend);
+
+	if (git_mutex_init(&backend->lock)) {
+		git_error_set(GIT_ERROR_OS, "failed to initialize bulk checkin lock");
+		git__free(backend);
+		return -1;
+	}
+
+	backend->fd = -1;
+	backend->oid_type = oid_type;
+
+	/* the number of entries is filled in when the checkin is committed */
+	hdr.hdr_signature = htonl(PACK_SIGNATURE);
+	hdr.hdr_version = htonl(PACK_VERSION);
+
+	if ((error = git_pool_init(&backend->objects_pool, sizeof(struct bulk_object))) < 0 ||
+	    (error = git_str_joinpath(&template, objects_dir, "pack/tmp_bulk_")) < 0 ||
+	    (error = git_futils_mkpath2file(template.ptr, GIT_OBJECT_DIR_MODE)) < 0 ||
+	    (error = backend->fd = git_futils_mktmp(&backend->path, template.ptr, 0600)) < 0 ||
+	    (error = bulk_append(backend, &hdr, sizeof(hdr))) < 0)
+		goto done;
+
+	backend->parent.version = GIT_ODB_BACKEND_VERSION;
+	backend->parent.read = &bulk_backend__read;
+	backend->parent.read_header = &bulk_backend__read_header;
+	backend->parent.write = &bulk_backend__write;
+	backend->parent.exists = &bulk_backend__exists;
+	backend->parent.free = &bulk_backend__free;
+
+	*out = (git_odb_backend *)backend;
+	error = 0;
+
+done:
+	if (error < 0)
+		bulk_backend__free((git_odb_backend *)backend);
+
+	git_str_dispose(&template);
+	return error;
+}
+
+/*
+ * Fills in the number of entries in the packfile's header and appends
+ * its trailer, the hash of everything before it.
+ */
+static int bulk_finish_pack(unsigned char *checksum, struct bulk_backend *backend)
+{
+	struct git_pack_header hdr;
+	git_hash_ctx trailer;
+	char *buf;
+	off64_t offset = 0;
+	int error;
+
+	hdr.hdr_signature = htonl(PACK_SIGNATURE);
+	hdr.hdr_version = htonl(PACK_VERSION);
+	hdr.hdr_entries = htonl(backend->entries);
+
+	if ((error = bulk_write_at(backend, &hdr, sizeof(hdr), 0)) < 0)
+		return error;
+
+	buf = git__malloc(BULK_COPY_BUFFER_SIZE);
+	GIT_ERROR_CHECK_ALLOC(buf);
+
+	if ((error = git_hash_ctx_init(&trailer, git_oid_algorithm(backend->oid_type))) < 0) {
+		git__free(buf);
+		return error;
+	}
+
+	while (offset < backend->size) {
+		size_t chunk = (size_t)min(backend->size - offset, BULK_COPY_BUFFER_SIZE);
+
+		if ((error = bulk_read_at(backend, buf, chunk, offset)) < 0 ||
+		    (error = git_hash_update(&trailer, buf, chunk)) < 0)
+			goto done;
+
+		offset += chunk;
+	}
+
+	if ((error = git_hash_final(checksum, &trailer)) < 0)
+		goto done;
+
+	error = bulk_append(backend, checksum, git_oid_size(backend->oid_type));
+
+done:
+	git_hash_ctx_cleanup(&trailer);
+	git__free(buf);
+	return error;
+}
+
+static int bulk_object_cmp(const void *a, const void *b)
+{
+	const struct bulk_object *one = a, *two = b;
+	return git_oid_cmp(&one->oid, &two->oid);
+}
+
+/* Writes the (version 2) index of the packfile. */
+static int bulk_write_index(
+	struct bulk_backend *backend,
+	const char *path,
+	const unsigned char *checksum,
+	bool do_fsync)
+{
+	git_filebuf index_file = GIT_FILEBUF_INIT;
+	git_vector objects = GIT_VECTOR_INIT;
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	struct git_pack_idx_header hdr;
+	struct bulk_object *obj;
+	unsigned char idx_checksum[GIT_HASH_MAX_SIZE];
+	uint32_t fanout[256] = { 0 }, long_offsets = 0, n, split[2];
+	size_t checksum_size = git_oid_size(backend->oid_type), i;
+	int error;
+
+	if ((error = git_vector_init(&objects, backend->entries, bulk_object_cmp)) < 0)
+		return error;
+
+	while (git_odb_bulk_oidmap_iterate(&iter, NULL, &obj, &backend->objects) == 0) {
+		if ((error = git_vector_insert(&objects, obj)) < 0)
+			goto done;
+
+		fanout[obj->oid.id[0]]++;
+	}
+
+	git_vector_sort(&objects);
+
+	for (i = 1; i < 256; i++)
+		fanout[i] += fanout[i - 1];
+
+	if ((error = git_filebuf_open(&index_file, path,
+			git_filebuf_hash_flags(git_oid_algorithm(backend->oid_type)) |
+			(do_fsync ? GIT_FILEBUF_FSYNC : 0),
+			GIT_PACK_FILE_MODE)) < 0)
+		goto done;
+
+	hdr.idx_signature = htonl(PACK_IDX_SIGNATURE);
+	hdr.idx_version = htonl(2);
+	git_filebuf_write(&index_file, &hdr, sizeof(hdr));
+
+	for (i = 0; i < 256; i++) {
+		n = htonl(fanout[i]);
+		git_filebuf_write(&index_file, &n, sizeof(n));
+	}
+
+	git_vector_foreach(&objects, i, obj)
+		git_filebuf_write(&index_file, obj->oid.id, checksum_size);
+
+	git_vector_foreach(&objects, i, obj) {
+		n = htonl(obj->crc);
+		git_filebuf_write(&index_file, &n, sizeof(n));
+	}
+
+	git_vector_foreach(&objects, i, obj) {
+		if (obj->entry_offset > 0x7fffffff)
+			n = htonl(0x80000000 | long_offsets++);
+		else
+			n = htonl((uint32_t)obj->entry_offset);
+
+		git_filebuf_write(&index_file, &n, sizeof(n));
+	}
+
+	git_vector_foreach(&objects, i, obj) {
+		if (obj->entry_offset <= 0x7fffffff)
+			continue;
+
+		split[0] = htonl((uint32_t)(obj->entry_offset >> 32));
+		split[1] = htonl((uint32_t)(obj->entry_offset & 0xffffffff));
+		git_filebuf_write(&index_file, split, sizeof(split));
+	}
+
+	if ((error = git_filebuf_write(&index_file, checksum, checksum_size)) < 0 ||
+	    (error = git_filebuf_hash(idx_checksum, &index_file)) < 0 ||
+	    (error = git_filebuf_write(&index_file, idx_checksum, checksum_size)) < 0)
+		goto done;
+
+	error = git_filebuf_commit(&index_file);
+
+done:
+	git_filebuf_cleanup(&index_file);
+	git_vector_dispose(&objects);
+	return error;
+}
+
+static int bulk_pack_path(
+	git_str *out,
+	struct bulk_backend *backend,
+	const char *name,
+	const char *suffix)
+{
+	git_str_clear(out);
+
+	if (git_fs_path_dirname_r(out, backend->path.ptr) < 0 ||
+	    git_str_putc(out, '/') < 0 ||
+	    git_str_printf(out, "pack-%s%s", name, suffix) < 0)
+		return -1;
+
+	return 0;
+}
+
+int git_odb__bulk_backend_commit(git_odb_backend *_backend, git_odb *odb)
+{
+	struct bulk_backend *backend = (struct bulk_backend *)_backend;
+	unsigned char checksum[GIT_HASH_MAX_SIZE];
+	char name[GIT_HASH_MAX_SIZE * 2 + 1];
+	git_str pack_path = GIT_STR_INIT, idx_path = GIT_STR_INIT;
+	bool do_fsync = git_repository__fsync_gitdir || odb->do_fsync;
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(odb);
+
+	if (!backend->entries)
+		return 0;
+
+	if ((error = bulk_lock(backend)) < 0)
+		return error;
+
+	if ((error = bulk_finish_pack(checksum, backend)) < 0 ||
+	    (error = git_hash_fmt(name, checksum, git_oid_size(backend->oid_type))) < 0 ||
+	    (error = bulk_pack_path(&pack_path, backend, name, ".pack")) < 0 ||
+	    (error = bulk_pack_path(&idx_path, backend, name, ".idx")) < 0)
+		goto done;
+
+	if (do_fsync && p_fsync(backend->fd) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to fsync bulk checkin packfile");
+		error = -1;
+		goto done;
+	}
+
+	/* close the file to rename it (for Windows), and reopen it for reads */
+	p_close(backend->fd);
+	backend->fd = -1;
+
+	if (p_chmod(backend->path.ptr, GIT_PACK_FILE_MODE) < 0 ||
+	    p_rename(backend->path.ptr, pack_path.ptr) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to move bulk checkin packfile into place");
+		p_unlink(backend->path.ptr);
+		error = -1;
+		goto done;
+	}
+
+	git_str_swap(&backend->path, &pack_path);
+
+	if ((error = backend->fd = git_futils_open_ro(backend->path.ptr)) < 0 ||
+	    (error = bulk_write_index(backend, idx_path.ptr, checksum, do_fsync)) < 0) {
+		/* don't leave a packfile without an index behind */
+		if (backend->fd >= 0)
+			p_close(backend->fd);
+
+		backend->fd = -1;
+		p_unlink(backend->path.ptr);
+		goto done;
+	}
+
+	backend->committed = true;
+
+	if (do_fsync && (error = git_futils_fsync_parent(idx_path.ptr)) < 0)
+		goto done;
+
+	error = git_odb_refresh(odb);
+
+done:
+	git_mutex_unlock(&backend->lock);
+	git_str_dispose(&pack_path);
+	git_str_dispose(&idx_path);
+	return error;
+}
@@ -230,7 +230,7 @@ static int read_loose_packlike(git_rawobj *out, git_str *obj)
 	git_str body = GIT_STR_INIT;
 	const unsigned char *obj_data;
 	obj_hdr hdr;
-	size_t obj_len, head_len, alloc_size;
+	size_t obj_len, head_len, alloc_size, consumed;
 	int error;
 
 	obj_data = (unsigned char *)obj->ptr;
@@ -261,8 +261,20 @@ static int read_loose_packlike(git_rawobj *out, git_str *obj)
 		goto done;
 	}
 
-	if ((error = git_zstream_inflatebuf(&body, obj_data, obj_len)) < 0)
+	/*
+	 * the inflated size is known, so try to inflate it in one shot;
+	 * fall back to streaming (which reports any errors in detail)
+	 */
+	error = git_zstream_inflate_oneshot(body.ptr, hdr.size, &consumed, obj_data, obj_len);
+
+	if (error == 0 && consumed == obj_len) {
+		body.size = hdr.size;
+		body.ptr[body.size] = '\0';
+	} else if (error < 0 && error != GIT_EBUFS) {
+		goto done;
+	} else if ((error = git_zstream_inflatebuf(&body, obj_data, obj_len)) < 0) {
 		goto done;
+	}
 
 	out->len = hdr.size;
 	out->type = hdr.type;
@@ -273,6 +285,50 @@ done:
 	return error;
 }
 
+#ifdef GIT_COMPRESSION_LIBDEFLATE
+/*
+ * The header and the body of a loose object are a single zlib stream;
+ * once the header has been parsed (and so the size is known), inflate
+ * the entire stream in one shot and then shift the body into place.
+ */
+static int read_loose_oneshot(
+	git_rawobj *out,
+	git_str *obj,
+	obj_hdr *hdr,
+	size_t head_len)
+{
+	unsigned char *data;
+	size_t inflated_len, alloc_size, consumed;
+	int error;
+
+	if (GIT_ADD_SIZET_OVERFLOW(&inflated_len, head_len, hdr->size) ||
+	    GIT_ADD_SIZET_OVERFLOW(&alloc_size, inflated_len, 1) ||
+	    (data = git__malloc(alloc_size)) == NULL)
+		return -1;
+
+	error = git_zstream_inflate_oneshot(data, inflated_len,
+		&consumed, obj->ptr, obj->size);
+
+	/* let the streaming inflater report trailing garbage */
+	if (error == 0 && consumed != obj->size)
+		error = GIT_EBUFS;
+
+	if (error < 0) {
+		git__free(data);
+		return error;
+	}
+
+	memmove(data, data + head_len, hdr->size);
+	data[hdr->size] = '\0';
+
+	out->data = data;
+	out->len = hdr->size;
+	out->type = hdr->type;
+
+	return 0;
+}
+#endif
+
 static int read_loose_standard(git_rawobj *out, git_str *obj)
 {
 	git_zstream zstream = GIT_ZSTREAM_INIT;
@@ -302,6 +358,11 @@ static int read_loose_standard(git_rawobj *out, git_str *obj)
 		goto done;
 	}
 
+#ifdef GIT_COMPRESSION_LIBDEFLATE
+	if ((error = read_loose_oneshot(out, obj, &hdr, head_len)) != GIT_EBUFS)
+		goto done;
+#endif
+
 	/*
 	 * allocate a buffer and inflate the object data into it
 	 * (including the initial sequence in the head buffer).
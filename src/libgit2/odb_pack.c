@@ -39,6 +39,24 @@ struct pack_writepack {
 	git_indexer *indexer;
 };
 
+typedef struct {
+	git_odb_stream stream;
+
+	/*
+	 * Object data (or, for deltified objects, the delta) is
+	 * inflated directly out of the pack.
+	 */
+	git_packfile_stream packstream;
+	size_t remaining;
+
+	/*
+	 * Deltified objects are applied incrementally against their
+	 * base, which is the only thing that is held in memory.
+	 */
+	git_rawobj base;
+	git_delta_stream delta;
+} pack_readstream;
+
 /**
  * The wonderful tale of a Packed Object lookup query
  * ===================================================
@@ -604,6 +622,173 @@ static int pack_backend__read(
 	return 0;
 }
 
+static ssize_t pack_readstream_inflate(
+	pack_readstream *stream,
+	void *buffer,
+	size_t buffer_len)
+{
+	off64_t start;
+	ssize_t read;
+
+	if (!buffer_len)
+		return 0;
+
+	/*
+	 * The compressed data may span more than one window; we'll only
+	 * get `GIT_EBUFS` without any progress when the pack is truncated.
+	 */
+	do {
+		start = stream->packstream.curpos;
+		read = git_packfile_stream_read(&stream->packstream, buffer, buffer_len);
+	} while (read == GIT_EBUFS && stream->packstream.curpos != start);
+
+	if (read == GIT_EBUFS || (read == 0 && stream->remaining)) {
+		git_error_set(GIT_ERROR_ODB, "invalid pack file - object is truncated");
+		return -1;
+	} else if (read < 0) {
+		return read;
+	} else if ((size_t)read > stream->remaining) {
+		git_error_set(GIT_ERROR_ODB, "invalid pack file - object is larger than its header");
+		return -1;
+	}
+
+	stream->remaining -= (size_t)read;
+	return read;
+}
+
+static ssize_t pack_readstream_delta_read(void *buffer, size_t len, void *payload)
+{
+	return pack_readstream_inflate(payload, buffer, len);
+}
+
+static int pack_backend__readstream_read(
+	git_odb_stream *_stream,
+	char *buffer,
+	size_t buffer_len)
+{
+	pack_readstream *stream = (pack_readstream *)_stream;
+
+	buffer_len = min(buffer_len, INT_MAX);
+
+	if (stream->base.data)
+		return (int)git_delta_stream_read(&stream->delta, buffer, buffer_len);
+
+	return (int)pack_readstream_inflate(stream, buffer, buffer_len);
+}
+
+static void pack_backend__readstream_free(git_odb_stream *_stream)
+{
+	pack_readstream *stream = (pack_readstream *)_stream;
+
+	git_packfile_stream_dispose(&stream->packstream);
+	git__free(stream->base.data);
+	git__free(stream);
+}
+
+static int pack_readstream_open_delta(
+	size_t *size,
+	git_object_t *type,
+	pack_readstream *stream,
+	struct git_pack_file *p,
+	off64_t obj_offset,
+	off64_t curpos,
+	git_object_t delta_type)
+{
+	git_mwindow *w_curs = NULL;
+	off64_t base_offset;
+	int error;
+
+	error = get_delta_base(&base_offset, p, &w_curs, &curpos,
+		delta_type, obj_offset);
+	git_mwindow_close(&w_curs);
+
+	if (error < 0)
+		return error;
+
+	/*
+	 * The size in the object's header is that of the inflated delta
+	 * instructions, which bounds what we inflate out of the pack; the
+	 * caller reads the object that results from applying them to the
+	 * base, whose size is in the delta itself.
+	 */
+	stream->remaining = *size;
+
+	if ((error = git_packfile_unpack(&stream->base, p, &base_offset)) < 0 ||
+	    (error = git_packfile_stream_open(&stream->packstream, p, curpos)) < 0 ||
+	    (error = git_delta_stream_init(&stream->delta,
+			stream->base.data, stream->base.len,
+			pack_readstream_delta_read, stream)) < 0)
+		return error;
+
+	*size = stream->delta.res_len;
+	*type = stream->base.type;
+	return 0;
+}
+
+static int pack_backend__readstream(
+	git_odb_stream **stream_out,
+	size_t *len_out,
+	git_object_t *type_out,
+	git_odb_backend *backend,
+	const git_oid *oid)
+{
+	pack_readstream *stream = NULL;
+	struct git_pack_entry e;
+	git_mwindow *w_curs = NULL;
+	off64_t curpos;
+	size_t size;
+	git_object_t type;
+	int error;
+
+	GIT_ASSERT_ARG(stream_out);
+	GIT_ASSERT_ARG(len_out);
+	GIT_ASSERT_ARG(type_out);
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(oid);
+
+	if ((error = pack_entry_find(&e, (struct pack_backend *)backend, oid)) < 0)
+		return error;
+
+	curpos = e.offset;
+
+	if ((error = git_packfile_unpack_header(&size, &type, e.p, &w_curs, &curpos)) < 0)
+		return error;
+
+	stream = git__calloc(1, sizeof(pack_readstream));
+	GIT_ERROR_CHECK_ALLOC(stream);
+
+	/*
+	 * Undeltified objects are inflated window-by-window straight
+	 * out of the pack, without allocating a buffer for the object.
+	 * Deltas are streamed the same way and applied against their
+	 * base as the caller reads.
+	 */
+	if (type == GIT_PACKFILE_OFS_DELTA || type == GIT_PACKFILE_REF_DELTA) {
+		if ((error = pack_readstream_open_delta(&size, &type, stream,
+				e.p, e.offset, curpos, type)) < 0)
+			goto done;
+	} else {
+		if ((error = git_packfile_stream_open(&stream->packstream, e.p, curpos)) < 0)
+			goto done;
+
+		stream->remaining = size;
+	}
+
+	stream->stream.backend = backend;
+	stream->stream.read = &pack_backend__readstream_read;
+	stream->stream.free = &pack_backend__readstream_free;
+
+	*stream_out = (git_odb_stream *)stream;
+	*len_out = size;
+	*type_out = type;
+
+done:
+	if (error < 0)
+		pack_backend__readstream_free((git_odb_stream *)stream);
+
+	return error;
+}
+
 static int pack_backend__read_prefix(
 	git_oid *out_oid,
 	void **buffer_p,
@@ -907,6 +1092,7 @@ static int pack_backend__alloc(
 	backend->parent.read = &pack_backend__read;
 	backend->parent.read_prefix = &pack_backend__read_prefix;
 	backend->parent.read_header = &pack_backend__read_header;
+	backend->parent.readstream = &pack_backend__readstream;
 	backend->parent.exists = &pack_backend__exists;
 	backend->parent.exists_prefix = &pack_backend__exists_prefix;
 	backend->parent.refresh = &pack_backend__refresh;
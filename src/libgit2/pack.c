@@ -883,6 +883,30 @@ void git_packfile_stream_dispose(git_packfile_stream *obj)
 	git_zstream_free(&obj->zstream);
 }
 
+static int packfile_unpack_oneshot(
+	char *data,
+	struct git_pack_file *p,
+	git_mwindow **mwindow,
+	off64_t *position,
+	size_t size)
+{
+	unsigned int window_len;
+	unsigned char *in;
+	size_t consumed;
+	int error;
+
+	if ((in = pack_window_open(p, mwindow, *position, &window_len)) == NULL)
+		return -1;
+
+	error = git_zstream_inflate_oneshot(data, size, &consumed, in, window_len);
+	git_mwindow_close(mwindow);
+
+	if (error == 0)
+		*position += consumed;
+
+	return error;
+}
+
 static int packfile_unpack_compressed(
 	git_rawobj *obj,
 	struct git_pack_file *p,
@@ -900,6 +924,16 @@ static int packfile_unpack_compressed(
 	data = git__calloc(1, buffer_len);
 	GIT_ERROR_CHECK_ALLOC(data);
 
+	/*
+	 * Most objects are entirely contained within a single window;
+	 * inflate those in one shot and only fall back to streaming
+	 * across windows when that fails.
+	 */
+	if ((error = packfile_unpack_oneshot(data, p, mwindow, position, size)) == 0)
+		goto done;
+	else if (error != GIT_EBUFS)
+		goto out;
+
 	if ((error = git_zstream_init(&zstream, GIT_ZSTREAM_INFLATE)) < 0) {
 		git_error_set(GIT_ERROR_ZLIB, "failed to init zlib stream on unpack");
 		goto out;
@@ -941,6 +975,7 @@ static int packfile_unpack_compressed(
 		goto out;
 	}
 
+done:
 	/* zlib may have garbled the trailing buffer */
 	data[size] = '\0';
 
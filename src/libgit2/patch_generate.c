@@ -409,6 +409,21 @@ static int patch_generated_create(
 	return error;
 }
 
+static int patch_generated_diff(git_patch_generated *patch)
+{
+	git_xdiff_output xo;
+	int error;
+
+	memset(&xo, 0, sizeof(xo));
+	diff_output_to_patch(&xo.output, patch);
+	git_xdiff_init(&xo, &patch->diff->opts);
+
+	if ((error = patch_generated_invoke_file_callback(patch, &xo.output)) < 0)
+		return error;
+
+	return patch_generated_create(patch, &xo.output);
+}
+
 static int diff_required(git_diff *diff, const char *action)
 {
 	if (diff)
@@ -714,7 +729,6 @@ int git_patch_generated_from_diff(
 	git_patch **patch_ptr, git_diff *diff, size_t idx)
 {
 	int error = 0;
-	git_xdiff_output xo;
 	git_diff_delta *delta = NULL;
 	git_patch_generated *patch = NULL;
 
@@ -741,14 +755,7 @@ int git_patch_generated_from_diff(
 	if ((error = patch_generated_alloc_from_diff(&patch, diff, idx)) < 0)
 		return error;
 
-	memset(&xo, 0, sizeof(xo));
-	diff_output_to_patch(&xo.output, patch);
-	git_xdiff_init(&xo, &diff->opts);
-
-	error = patch_generated_invoke_file_callback(patch, &xo.output);
-
-	if (!error)
-		error = patch_generated_create(patch, &xo.output);
+	error = patch_generated_diff(patch);
 
 	if (!error) {
 		/* TODO: if cumulative diff size is < 0.5 total size, flatten patch */
@@ -763,6 +770,333 @@ int git_patch_generated_from_diff(
 	return error;
 }
 
+int git_patch_generated_diff_lines(
+	git_patch_generated *patch,
+	git_diff_line_cb line_cb,
+	void *payload)
+{
+	git_xdiff_output xo;
+
+	memset(&xo, 0, sizeof(xo));
+	diff_output_init(&xo.output, NULL, NULL, NULL, NULL, line_cb, payload);
+	git_xdiff_init(&xo, &patch->diff->opts);
+
+	return patch_generated_create(patch, &xo.output);
+}
+
+static int patch_foreach_diff(
+	git_patch_generated *patch,
+	git_patch_generated_diff_cb diff_cb,
+	void *payload)
+{
+	return diff_cb ? diff_cb(patch, payload) : patch_generated_diff(patch);
+}
+
+static int patch_foreach_one(
+	git_diff *diff,
+	size_t idx,
+	git_patch_generated_diff_cb diff_cb,
+	git_patch_generated_done_cb done_cb,
+	void *payload)
+{
+	git_patch_generated *patch;
+	int error;
+
+	if ((error = patch_generated_alloc_from_diff(&patch, diff, idx)) < 0)
+		return error;
+
+	if ((error = patch_foreach_diff(patch, diff_cb, payload)) == 0)
+		error = done_cb(patch, payload);
+
+	git_patch_free(&patch->base);
+	return error;
+}
+
+#ifdef GIT_THREADS
+
+/*
+ * Generating the patches for a diff on worker threads: the calling thread
+ * prepares each patch (which looks up the diff drivers through the diff's
+ * attribute session, and that is not thread-safe), the workers load the
+ * file contents and diff them, and the calling thread then hands each
+ * patch to the done callback in delta order.  Only a window of patches is
+ * kept in memory at once.
+ */
+
+#define PATCH_FOREACH_WINDOW_PER_THREAD 8
+#define PATCH_FOREACH_MIN_PER_THREAD 2
+#define PATCH_FOREACH_MAX_THREADS 64
+
+typedef struct {
+	git_patch_generated *patch;
+	int error;
+	unsigned int done : 1;
+} patch_foreach_slot;
+
+typedef struct {
+	git_diff *diff;
+	git_patch_generated_diff_cb diff_cb;
+	void *payload;
+
+	patch_foreach_slot *slots;
+	size_t window;
+
+	git_mutex lock;
+	git_cond work_cond;
+	git_cond done_cond;
+
+	/* deltas before `prepared` may be diffed; `next` is the next one */
+	size_t prepared;
+	size_t next;
+	bool shutdown;
+} patch_foreach_state;
+
+/* Diffs the next prepared patch; called and returns with the lock held. */
+static void patch_foreach_diff_next(patch_foreach_state *state)
+{
+	patch_foreach_slot *slot = &state->slots[state->next++ % state->window];
+	int error;
+
+	if (slot->done)
+		return;
+
+	git_mutex_unlock(&state->lock);
+	error = patch_foreach_diff(slot->patch, state->diff_cb, state->payload);
+	git_mutex_lock(&state->lock);
+
+	slot->error = error;
+	slot->done = 1;
+	git_cond_broadcast(&state->done_cond);
+}
+
+static void *patch_foreach_worker(void *arg)
+{
+	patch_foreach_state *state = arg;
+
+	git_mutex_lock(&state->lock);
+
+	while (!state->shutdown) {
+		if (state->next < state->prepared)
+			patch_foreach_diff_next(state);
+		else
+			git_cond_wait(&state->work_cond, &state->lock);
+	}
+
+	git_mutex_unlock(&state->lock);
+	return NULL;
+}
+
+static int patch_foreach_prepare(patch_foreach_state *state, size_t idx)
+{
+	patch_foreach_slot *slot = &state->slots[idx % state->window];
+	git_diff_delta *delta = git_vector_get(&state->diff->deltas, idx);
+	int error;
+
+	memset(slot, 0, sizeof(*slot));
+
+	if (git_diff_delta__should_skip(&state->diff->opts, delta)) {
+		slot->done = 1;
+		return 0;
+	}
+
+	if ((error = patch_generated_alloc_from_diff(&slot->patch, state->diff, idx)) < 0)
+		return error;
+
+	/*
+	 * Submodules are loaded through the repository's submodule cache,
+	 * which is not thread-safe, so diff them here.
+	 */
+	if (S_ISGITLINK(delta->old_file.mode) || S_ISGITLINK(delta->new_file.mode)) {
+		slot->error = patch_foreach_diff(slot->patch, state->diff_cb, state->payload);
+		slot->done = 1;
+	}
+
+	return 0;
+}
+
+static int patch_foreach_finish(
+	patch_foreach_state *state,
+	size_t idx,
+	git_patch_generated_done_cb done_cb)
+{
+	patch_foreach_slot *slot = &state->slots[idx % state->window];
+	git_patch_generated *patch = slot->patch;
+	int error;
+
+	slot->patch = NULL;
+
+	if (!patch)
+		return 0;
+
+	/*
+	 * Error messages are thread-local; diff the delta again on this
+	 * thread so that the caller sees the worker's error.
+	 */
+	if (slot->error) {
+		git_patch_free(&patch->base);
+
+		return patch_foreach_one(state->diff, idx,
+			state->diff_cb, done_cb, state->payload);
+	}
+
+	error = done_cb(patch, state->payload);
+
+	git_patch_free(&patch->base);
+	return error;
+}
+
+static int patch_foreach_threaded(
+	git_diff *diff,
+	git_patch_generated_diff_cb diff_cb,
+	git_patch_generated_done_cb done_cb,
+	void *payload,
+	unsigned int nr_threads)
+{
+	patch_foreach_state state = { 0 };
+	patch_foreach_slot *slot;
+	git_thread *threads;
+	size_t count = diff->deltas.length, finished = 0, started = 0, i;
+	int error = 0;
+
+	state.diff = diff;
+	state.diff_cb = diff_cb;
+	state.payload = payload;
+	state.window = nr_threads * PATCH_FOREACH_WINDOW_PER_THREAD;
+
+	threads = git__calloc(nr_threads, sizeof(git_thread));
+	GIT_ERROR_CHECK_ALLOC(threads);
+
+	state.slots = git__calloc(state.window, sizeof(patch_foreach_slot));
+	if (!state.slots) {
+		git__free(threads);
+		return -1;
+	}
+
+	if (git_mutex_init(&state.lock)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize lock for patch generation");
+		git__free(state.slots);
+		git__free(threads);
+		return -1;
+	}
+
+	if (git_cond_init(&state.work_cond)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize condition for patch generation");
+		git_mutex_free(&state.lock);
+		git__free(state.slots);
+		git__free(threads);
+		return -1;
+	}
+
+	if (git_cond_init(&state.done_cond)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize condition for patch generation");
+		git_cond_free(&state.work_cond);
+		git_mutex_free(&state.lock);
+		git__free(state.slots);
+		git__free(threads);
+		return -1;
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		if (git_thread_create(&threads[i], patch_foreach_worker, &state) != 0) {
+			git_error_set(GIT_ERROR_THREAD, "unable to create thread");
+			error = -1;
+			break;
+		}
+
+		started++;
+	}
+
+	while (!error && finished < count) {
+		if (state.prepared < count && state.prepared < finished + state.window) {
+			if ((error = patch_foreach_prepare(&state, state.prepared)) < 0)
+				break;
+
+			git_mutex_lock(&state.lock);
+			state.prepared++;
+			git_cond_signal(&state.work_cond);
+			git_mutex_unlock(&state.lock);
+			continue;
+		}
+
+		slot = &state.slots[finished % state.window];
+
+		/* help the workers out until the next patch is ready */
+		git_mutex_lock(&state.lock);
+		while (!slot->done) {
+			if (state.next < state.prepared)
+				patch_foreach_diff_next(&state);
+			else
+				git_cond_wait(&state.done_cond, &state.lock);
+		}
+		git_mutex_unlock(&state.lock);
+
+		error = patch_foreach_finish(&state, finished++, done_cb);
+	}
+
+	git_mutex_lock(&state.lock);
+	state.shutdown = true;
+	git_cond_broadcast(&state.work_cond);
+	git_mutex_unlock(&state.lock);
+
+	for (i = 0; i < started; i++)
+		git_thread_join(&threads[i], NULL);
+
+	for (i = finished; i < state.prepared; i++) {
+		slot = &state.slots[i % state.window];
+
+		if (slot->patch)
+			git_patch_free(&slot->patch->base);
+	}
+
+	git_cond_free(&state.done_cond);
+	git_cond_free(&state.work_cond);
+	git_mutex_free(&state.lock);
+	git__free(state.slots);
+	git__free(threads);
+
+	return error;
+}
+
+#endif
+
+int git_patch_generated_foreach(
+	git_diff *diff,
+	git_patch_generated_diff_cb diff_cb,
+	git_patch_generated_done_cb done_cb,
+	void *payload,
+	unsigned int nr_threads)
+{
+	git_diff_delta *delta;
+	size_t idx;
+	int error = 0;
+
+	GIT_ASSERT_ARG(diff && diff->type == GIT_DIFF_TYPE_GENERATED);
+	GIT_ASSERT_ARG(done_cb);
+
+#ifdef GIT_THREADS
+	if (nr_threads > diff->deltas.length / PATCH_FOREACH_MIN_PER_THREAD)
+		nr_threads = (unsigned int)(diff->deltas.length / PATCH_FOREACH_MIN_PER_THREAD);
+
+	if (nr_threads > PATCH_FOREACH_MAX_THREADS)
+		nr_threads = PATCH_FOREACH_MAX_THREADS;
+
+	if (nr_threads > 1)
+		return patch_foreach_threaded(diff, diff_cb, done_cb, payload, nr_threads);
+#else
+	GIT_UNUSED(nr_threads);
+#endif
+
+	git_vector_foreach(&diff->deltas, idx, delta) {
+		if (git_diff_delta__should_skip(&diff->opts, delta))
+			continue;
+
+		if ((error = patch_foreach_one(diff, idx, diff_cb, done_cb, payload)) != 0)
+			break;
+	}
+
+	return error;
+}
+
 git_diff_driver *git_patch_generated_driver(git_patch_generated *patch)
 {
 	/* ofile driver is representative for whole patch */
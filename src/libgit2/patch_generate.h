@@ -46,6 +46,33 @@ extern int git_patch_generated_new_data(
 extern int git_patch_generated_from_diff(
 	git_patch **, git_diff *, size_t);
 
+/*
+ * Diffs a prepared patch, passing each line to the given callback instead
+ * of storing the hunks and lines in the patch.
+ */
+extern int git_patch_generated_diff_lines(
+	git_patch_generated *patch,
+	git_diff_line_cb line_cb,
+	void *payload);
+
+typedef int (*git_patch_generated_diff_cb)(
+	git_patch_generated *patch, void *payload);
+typedef int (*git_patch_generated_done_cb)(
+	git_patch_generated *patch, void *payload);
+
+/*
+ * Generates the patch for each delta of a generated diff.  The `diff_cb`
+ * (or, if it is NULL, the full patch generation) may be run on one of
+ * `nr_threads` worker threads; the `done_cb` is invoked on the calling
+ * thread for each patch, in delta order.
+ */
+extern int git_patch_generated_foreach(
+	git_diff *diff,
+	git_patch_generated_diff_cb diff_cb,
+	git_patch_generated_done_cb done_cb,
+	void *payload,
+	unsigned int nr_threads);
+
 typedef struct git_patch_generated_output git_patch_generated_output;
 
 struct git_patch_generated_output {
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "peel_cache.h"
+
+#include "hashmap_oid.h"
+#include "pool.h"
+#include "repository.h"
+
+/* The cache is emptied once it holds this many objects. */
+#define PEEL_CACHE_MAX_ENTRIES (1 << 16)
+
+typedef struct {
+	git_oid id;
+	git_oid peeled;
+} peel_cache_entry;
+
+GIT_HASHMAP_OID_SETUP(git_peel_cachemap, peel_cache_entry *);
+
+struct git_peel_cache {
+	git_mutex lock;
+	git_peel_cachemap map;
+	git_pool pool;
+};
+
+static int peel_cache_new(git_peel_cache **out)
+{
+	git_peel_cache *cache;
+
+	cache = git__calloc(1, sizeof(git_peel_cache));
+	GIT_ERROR_CHECK_ALLOC(cache);
+
+	if (git_mutex_init(&cache->lock)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize lock for peel cache");
+		git__free(cache);
+		return -1;
+	}
+
+	if (git_pool_init(&cache->pool, sizeof(peel_cache_entry)) < 0) {
+		git_mutex_free(&cache->lock);
+		git__free(cache);
+		return -1;
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_repository__peel_cache(
+	git_peel_cache **out,
+	git_repository *repo)
+{
+	git_peel_cache *cache, *newcache;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(repo);
+
+	if ((cache = git_atomic_load(repo->peel_cache)) == NULL) {
+		if ((error = peel_cache_new(&newcache)) < 0)
+			return error;
+
+		/* if we race, free losing allocation */
+		if ((cache = git_atomic_compare_and_swap(&repo->peel_cache, NULL, newcache)) == NULL)
+			cache = newcache;
+		else
+			git_peel_cache_free(newcache);
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_peel_cache_lookup(
+	git_oid *out,
+	git_peel_cache *cache,
+	const git_oid *id)
+{
+	peel_cache_entry *entry;
+	int error;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(id);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock peel cache");
+		return -1;
+	}
+
+	if ((error = git_peel_cachemap_get(&entry, &cache->map, id)) == 0)
+		git_oid_cpy(out, &entry->peeled);
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+int git_peel_cache_add(
+	git_peel_cache *cache,
+	const git_oid *id,
+	const git_oid *peeled)
+{
+	peel_cache_entry *entry;
+	int error = 0;
+
+	GIT_ASSERT_ARG(cache);
+	GIT_ASSERT_ARG(id);
+	GIT_ASSERT_ARG(peeled);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "unable to lock peel cache");
+		return -1;
+	}
+
+	if (git_peel_cachemap_contains(&cache->map, id))
+		goto done;
+
+	if (git_peel_cachemap_size(&cache->map) >= PEEL_CACHE_MAX_ENTRIES) {
+		git_peel_cachemap_clear(&cache->map);
+		git_pool_clear(&cache->pool);
+	}
+
+	if ((entry = git_pool_malloc(&cache->pool, 1)) == NULL) {
+		error = -1;
+		goto done;
+	}
+
+	git_oid_cpy(&entry->id, id);
+	git_oid_cpy(&entry->peeled, peeled);
+
+	error = git_peel_cachemap_put(&cache->map, &entry->id, entry);
+
+done:
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+void git_peel_cache_free(git_peel_cache *cache)
+{
+	if (!cache)
+		return;
+
+	git_peel_cachemap_dispose(&cache->map);
+	git_pool_clear(&cache->pool);
+	git_mutex_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_peel_cache_h__
+#define INCLUDE_peel_cache_h__
+
+#include "common.h"
+
+#include "git2/oid.h"
+#include "git2/types.h"
+
+/*
+ * A cache of the objects that references' targets peel to, keyed by the
+ * target's id.  Objects are immutable, so what a tag peels to never
+ * changes, and the cache is kept for the lifetime of the repository;
+ * references that move simply look up their new target.
+ */
+typedef struct git_peel_cache git_peel_cache;
+
+extern int git_repository__peel_cache(
+	git_peel_cache **out,
+	git_repository *repo);
+
+/* Returns GIT_ENOTFOUND if the object is not in the cache. */
+extern int git_peel_cache_lookup(
+	git_oid *out,
+	git_peel_cache *cache,
+	const git_oid *id);
+
+extern int git_peel_cache_add(
+	git_peel_cache *cache,
+	const git_oid *id,
+	const git_oid *peeled);
+
+extern void git_peel_cache_free(git_peel_cache *cache);
+
+#endif
@@ -322,6 +322,36 @@ int git_refdb_reflog_read(git_reflog **out, git_refdb *db,  const char *name)
 	return 0;
 }
 
+int git_refdb_reflog_foreach(
+	git_refdb *db,
+	const char *name,
+	git_refdb_backend_reflog_foreach_cb cb,
+	void *payload)
+{
+	git_reflog *reflog;
+	size_t i;
+	int error;
+
+	GIT_ASSERT_ARG(db);
+	GIT_ASSERT_ARG(db->backend);
+	GIT_ASSERT_ARG(name);
+	GIT_ASSERT_ARG(cb);
+
+	if (db->backend->reflog_foreach)
+		return db->backend->reflog_foreach(db->backend, name, cb, payload);
+
+	if ((error = db->backend->reflog_read(&reflog, db->backend, name)) < 0)
+		return error;
+
+	for (i = 0; i < git_reflog_entrycount(reflog); i++) {
+		if ((error = cb(git_reflog_entry_byindex(reflog, i), payload)) != 0)
+			break;
+	}
+
+	git_reflog_free(reflog);
+	return error;
+}
+
 int git_refdb_should_write_reflog(int *out, git_refdb *db, const git_reference *ref)
 {
 	int error, logall;
@@ -444,3 +474,29 @@ int git_refdb_unlock(git_refdb *db, void *payload, int success, int update_reflo
 
 	return db->backend->unlock(db->backend, payload, success, update_reflog, ref, sig, message);
 }
+
+int git_refdb_unlock_many(git_refdb *db, git_refdb_backend_unlock_entry *entries, size_t len)
+{
+	size_t i;
+	int error = 0;
+
+	GIT_ASSERT_ARG(db);
+	GIT_ASSERT_ARG(entries || !len);
+
+	if (db->backend->unlock_many)
+		return db->backend->unlock_many(db->backend, entries, len);
+
+	/* once an update fails, the remaining locks are only discarded */
+	for (i = 0; i < len; i++) {
+		git_refdb_backend_unlock_entry *entry = &entries[i];
+
+		if (error < 0)
+			db->backend->unlock(db->backend, entry->payload, false, false, NULL, NULL, NULL);
+		else
+			error = db->backend->unlock(db->backend, entry->payload,
+				entry->success, entry->update_reflog,
+				entry->ref, entry->sig, entry->message);
+	}
+
+	return error;
+}
@@ -10,6 +10,7 @@
 #include "common.h"
 
 #include "git2/refdb.h"
+#include "git2/sys/refdb_backend.h"
 #include "repository.h"
 
 #define GIT_INVALID_HEAD "refs/heads/.invalid"
@@ -82,6 +83,17 @@ int git_refdb_delete(git_refdb *refdb, const char *ref_name, const git_oid *old_
 int git_refdb_reflog_read(git_reflog **out, git_refdb *db,  const char *name);
 int git_refdb_reflog_write(git_reflog *reflog);
 
+/*
+ * Call `cb` for each entry of the reflog for `name`, newest first, until
+ * it returns non-zero.  Backends that support it stream the entries from
+ * the end of the log, so looking at the latest entries is cheap.
+ */
+int git_refdb_reflog_foreach(
+	git_refdb *db,
+	const char *name,
+	git_refdb_backend_reflog_foreach_cb cb,
+	void *payload);
+
 /**
  * Determine whether a reflog entry should be created for the given reference.
  *
@@ -131,6 +143,7 @@ int git_refdb_ensure_log(git_refdb *refdb, const char *refname);
 
 int git_refdb_lock(void **payload, git_refdb *db, const char *refname);
 int git_refdb_unlock(git_refdb *db, void *payload, int success, int update_reflog, const git_reference *ref, const git_signature *sig, const char *message);
+int git_refdb_unlock_many(git_refdb *db, git_refdb_backend_unlock_entry *entries, size_t len);
 
 GIT_INLINE(const char *) git_refdb_type_name(git_refdb_t type)
 {
@@ -550,18 +550,21 @@ static int ref_error_notfound(const char *name)
 	return GIT_ENOTFOUND;
 }
 
-static char *packed_set_peeling_mode(
-        char *data,
-        size_t data_sz,
-        refdb_fs_backend *backend)
+static const char *packed_parse_header(
+	const char *data,
+	size_t data_sz,
+	int *peeling_mode,
+	bool *sorted)
 {
 	static const char *traits_header = "# pack-refs with:";
-	char *eol;
-	backend->peeling_mode = PEELING_NONE;
+	const char *eol;
+
+	*peeling_mode = PEELING_NONE;
+	*sorted = false;
 
 	if (git__prefixncmp(data, data_sz, traits_header) == 0) {
 		size_t hdr_sz = strlen(traits_header);
-		const char *sorted = " sorted ";
+		const char *sorted_trait = " sorted ";
 		const char *peeled = " peeled ";
 		const char *fully_peeled = " fully-peeled ";
 		data += hdr_sz;
@@ -573,51 +576,66 @@ static char *packed_set_peeling_mode(
 			return NULL;
 
 		if (git__memmem(data, eol - data, fully_peeled, strlen(fully_peeled)))
-			backend->peeling_mode = PEELING_FULL;
+			*peeling_mode = PEELING_FULL;
 		else if (git__memmem(data, eol - data, peeled, strlen(peeled)))
-			backend->peeling_mode = PEELING_STANDARD;
+			*peeling_mode = PEELING_STANDARD;
 
-		backend->sorted = NULL != git__memmem(data, eol - data, sorted, strlen(sorted));
+		*sorted = NULL != git__memmem(data, eol - data, sorted_trait, strlen(sorted_trait));
 
 		return eol + 1;
 	}
 	return data;
 }
 
-static void packed_map_free(refdb_fs_backend *backend)
+static char *packed_set_peeling_mode(
+        char *data,
+        size_t data_sz,
+        refdb_fs_backend *backend)
 {
-	if (backend->packed_refs_map.data) {
+	bool sorted;
+
+	data = (char *)packed_parse_header(data, data_sz, &backend->peeling_mode, &sorted);
+	backend->sorted = sorted;
+
+	return data;
+}
+
+static void packed_map_dispose(git_map *map)
+{
+	if (map->data) {
 #ifdef GIT_WIN32
-		git__free(backend->packed_refs_map.data);
+		git__free(map->data);
 #else
-		git_futils_mmap_free(&backend->packed_refs_map);
+		git_futils_mmap_free(map);
 #endif
-		backend->packed_refs_map.data = NULL;
-		backend->packed_refs_map.len = 0;
+		map->data = NULL;
+		map->len = 0;
+	}
+}
+
+static void packed_map_free(refdb_fs_backend *backend)
+{
+	if (backend->packed_refs_map.data) {
+		packed_map_dispose(&backend->packed_refs_map);
 		git_futils_filestamp_set(&backend->packed_refs_stamp, NULL);
 	}
 }
 
-static int packed_map_check(refdb_fs_backend *backend)
+/*
+ * Map the packed-refs file at `path` into `map`.  If the file does not
+ * exist or is empty, this succeeds but leaves `map` empty.
+ */
+static int packed_map_open(
+	git_map *map,
+	git_futils_filestamp *stamp,
+	const char *path)
 {
 	int error = 0;
 	git_file fd = -1;
 	struct stat st;
 
-	if ((error = git_mutex_lock(&backend->prlock)) < 0)
-		return error;
-
-	if (backend->packed_refs_map.data &&
-	    !git_futils_filestamp_check(
-	            &backend->packed_refs_stamp, backend->refcache->path)) {
-		git_mutex_unlock(&backend->prlock);
-		return error;
-	}
-	packed_map_free(backend);
-
-	fd = git_futils_open_ro(backend->refcache->path);
+	fd = git_futils_open_ro(path);
 	if (fd < 0) {
-		git_mutex_unlock(&backend->prlock);
 		if (fd == GIT_ENOTFOUND) {
 			git_error_clear();
 			return 0;
@@ -627,45 +645,64 @@ static int packed_map_check(refdb_fs_backend *backend)
 
 	if (p_fstat(fd, &st) < 0) {
 		p_close(fd);
-		git_mutex_unlock(&backend->prlock);
-		git_error_set(GIT_ERROR_OS, "unable to stat packed-refs '%s'", backend->refcache->path);
+		git_error_set(GIT_ERROR_OS, "unable to stat packed-refs '%s'", path);
 		return -1;
 	}
 
 	if (st.st_size == 0) {
 		p_close(fd);
-		git_mutex_unlock(&backend->prlock);
 		return 0;
 	}
 
-	git_futils_filestamp_set_from_stat(&backend->packed_refs_stamp, &st);
+	if (stamp)
+		git_futils_filestamp_set_from_stat(stamp, &st);
 
 #ifdef GIT_WIN32
 	/* on windows, we copy the entire file into memory rather than using
 	 * mmap() because using mmap() on windows also locks the file and this
 	 * map is long-lived. */
-	backend->packed_refs_map.len = (size_t)st.st_size;
-	backend->packed_refs_map.data =
-	        git__malloc(backend->packed_refs_map.len);
-	GIT_ERROR_CHECK_ALLOC(backend->packed_refs_map.data);
+	map->len = (size_t)st.st_size;
+	map->data = git__malloc(map->len);
+	GIT_ERROR_CHECK_ALLOC(map->data);
 	{
-		ssize_t bytesread =
-		        p_read(fd, backend->packed_refs_map.data,
-		               backend->packed_refs_map.len);
-		error = (bytesread == (ssize_t)backend->packed_refs_map.len) ?  0 : -1;
+		ssize_t bytesread = p_read(fd, map->data, map->len);
+		error = (bytesread == (ssize_t)map->len) ?  0 : -1;
+	}
+
+	if (error < 0) {
+		git__free(map->data);
+		map->data = NULL;
+		map->len = 0;
 	}
 #else
-	error = git_futils_mmap_ro(&backend->packed_refs_map, fd, 0, (size_t)st.st_size);
+	error = git_futils_mmap_ro(map, fd, 0, (size_t)st.st_size);
 #endif
 	p_close(fd);
-	if (error < 0) {
+	return error;
+}
+
+static int packed_map_check(refdb_fs_backend *backend)
+{
+	int error = 0;
+
+	if ((error = git_mutex_lock(&backend->prlock)) < 0)
+		return error;
+
+	if (backend->packed_refs_map.data &&
+	    !git_futils_filestamp_check(
+	            &backend->packed_refs_stamp, backend->refcache->path)) {
 		git_mutex_unlock(&backend->prlock);
 		return error;
 	}
+	packed_map_free(backend);
+
+	error = packed_map_open(&backend->packed_refs_map,
+		&backend->packed_refs_stamp, backend->refcache->path);
 
-	packed_set_peeling_mode(
-	        backend->packed_refs_map.data, backend->packed_refs_map.len,
-	        backend);
+	if (!error && backend->packed_refs_map.data)
+		packed_set_peeling_mode(
+		        backend->packed_refs_map.data, backend->packed_refs_map.len,
+		        backend);
 
 	git_mutex_unlock(&backend->prlock);
 	return error;
@@ -884,6 +921,20 @@ typedef struct {
 	git_sortedcache *cache;
 	size_t loose_pos;
 	size_t packed_pos;
+
+	/*
+	 * When the packed-refs file is sorted, packed references are read
+	 * straight from a private map of the file instead of from a copy of
+	 * the refcache.  Only the range of records that start with the
+	 * literal prefix of the glob is visited, and loose references that
+	 * shadow a packed one are looked up in `shadowed`.
+	 */
+	git_map packed_map;
+	const char *packed_prefix;
+	const char *packed_cur;
+	const char *packed_end;
+	git_str packed_name;
+	git_vector shadowed;
 } refdb_fs_iter;
 
 static void refdb_fs_backend__iterator_free(git_reference_iterator *_iter)
@@ -891,8 +942,11 @@ static void refdb_fs_backend__iterator_free(git_reference_iterator *_iter)
 	refdb_fs_iter *iter = GIT_CONTAINER_OF(_iter, refdb_fs_iter, parent);
 
 	git_vector_dispose(&iter->loose);
+	git_vector_dispose(&iter->shadowed);
 	git_pool_clear(&iter->pool);
 	git_sortedcache_free(iter->cache);
+	packed_map_dispose(&iter->packed_map);
+	git_str_dispose(&iter->packed_name);
 	git__free(iter);
 }
 
@@ -1040,6 +1094,172 @@ done:
 	return error;
 }
 
+/*
+ * Set up the iterator to read the packed references from a map of the
+ * packed-refs file.  Returns 1 if the file is mapped and sorted, 0 if the
+ * caller needs to fall back to the refcache.
+ */
+static int iter_load_packed_map(
+	refdb_fs_backend *backend,
+	refdb_fs_iter *iter)
+{
+	const char *data, *left, *right;
+	size_t prefix_len = 0;
+	int peeling_mode, error;
+	bool sorted;
+
+	if (!backend->gitpath)
+		return 0;
+
+	if ((error = packed_map_open(&iter->packed_map, NULL, backend->refcache->path)) < 0)
+		return error;
+
+	/* a missing packed-refs file is trivially sorted */
+	if (!iter->packed_map.data)
+		return 1;
+
+	data = iter->packed_map.data;
+	right = data + iter->packed_map.len;
+
+	if ((left = packed_parse_header(data, iter->packed_map.len, &peeling_mode, &sorted)) == NULL)
+		goto parse_failed;
+
+	if (!sorted) {
+		packed_map_dispose(&iter->packed_map);
+		return 0;
+	}
+
+	while (left < right && *left == '#') {
+		if (!(left = memchr(left, '\n', right - left)))
+			goto parse_failed;
+		left++;
+	}
+
+	iter->packed_end = right;
+
+	/*
+	 * The literal portion of the glob (up to the first wildcard) bounds
+	 * the records that can possibly match; bisect to the first of them.
+	 */
+	if (iter->glob)
+		prefix_len = strcspn(iter->glob, "?*[\\");
+
+	if (prefix_len) {
+		iter->packed_prefix = git_pool_strndup(&iter->pool, iter->glob, prefix_len);
+		GIT_ERROR_CHECK_ALLOC(iter->packed_prefix);
+
+		while (left < right) {
+			const char *mid = left + (right - left) / 2;
+			const char *rec = start_of_record(left, mid);
+
+			if (cmp_record_to_refname(rec, iter->packed_end - rec,
+					iter->packed_prefix, backend->oid_type) < 0)
+				left = end_of_record(mid, right);
+			else
+				right = rec;
+		}
+	}
+
+	iter->packed_cur = left;
+	return 1;
+
+parse_failed:
+	git_error_set(GIT_ERROR_REFERENCE, "corrupted packed references file");
+	return -1;
+}
+
+/*
+ * Parse the next record of the mapped packed-refs file into the
+ * iterator's name buffer.  Returns GIT_ITEROVER once the records no
+ * longer share the prefix of the glob.
+ */
+static int iter_packed_map_next(
+	git_oid *oid,
+	git_oid *peel,
+	bool *has_peel,
+	refdb_fs_backend *backend,
+	refdb_fs_iter *iter)
+{
+	size_t oid_hexsize = git_oid_hexsize(backend->oid_type);
+	const char *rec, *name, *eol, *end = iter->packed_end;
+	size_t name_len;
+
+	while ((rec = iter->packed_cur) != NULL && rec < end) {
+		if ((size_t)(end - rec) < oid_hexsize + 2 ||
+		    git_oid_from_prefix(oid, rec, oid_hexsize, backend->oid_type) < 0 ||
+		    rec[oid_hexsize] != ' ')
+			goto parse_failed;
+
+		name = rec + oid_hexsize + 1;
+
+		if (!(eol = memchr(name, '\n', end - name)))
+			goto parse_failed;
+
+		name_len = eol - name;
+		if (name_len && name[name_len - 1] == '\r')
+			name_len--;
+
+		rec = eol + 1;
+		*has_peel = false;
+
+		/* look for optional "^<OID>\n" */
+
+		if (rec < end && *rec == '^') {
+			if ((size_t)(end - rec) < oid_hexsize + 1 ||
+			    git_oid_from_prefix(peel, rec + 1, oid_hexsize, backend->oid_type) < 0)
+				goto parse_failed;
+
+			rec += oid_hexsize + 1;
+			*has_peel = true;
+
+			if (rec < end) {
+				if (!(eol = memchr(rec, '\n', end - rec)))
+					goto parse_failed;
+				rec = eol + 1;
+			}
+		}
+
+		iter->packed_cur = rec;
+
+		if (iter->packed_prefix &&
+		    git__prefixncmp(name, name_len, iter->packed_prefix) != 0)
+			break;
+
+		git_str_clear(&iter->packed_name);
+		if (git_str_put(&iter->packed_name, name, name_len) < 0)
+			return -1;
+
+		if (git_vector_bsearch(NULL, &iter->shadowed, iter->packed_name.ptr) == 0)
+			continue;
+		if (iter->glob && wildmatch(iter->glob, iter->packed_name.ptr, 0) != 0)
+			continue;
+
+		return 0;
+	}
+
+	iter->packed_cur = NULL;
+	return GIT_ITEROVER;
+
+parse_failed:
+	iter->packed_cur = NULL;
+	git_error_set(GIT_ERROR_REFERENCE, "corrupted packed references file");
+	return -1;
+}
+
+static int iter_loose_shadow(refdb_fs_iter *iter, const char *path)
+{
+	struct packref *ref;
+
+	if (!iter->cache)
+		return git_vector_insert(&iter->shadowed, (char *)path);
+
+	ref = git_sortedcache_lookup(iter->cache, path);
+	if (ref)
+		ref->flags |= PACKREF_SHADOWED;
+
+	return 0;
+}
+
 static int refdb_fs_backend__iterator_next(
 	git_reference **out, git_reference_iterator *_iter)
 {
@@ -1052,16 +1272,30 @@ static int refdb_fs_backend__iterator_next(
 		const char *path = git_vector_get(&iter->loose, iter->loose_pos++);
 
 		if (loose_lookup(out, backend, path) == 0) {
-			ref = git_sortedcache_lookup(iter->cache, path);
-			if (ref)
-				ref->flags |= PACKREF_SHADOWED;
+			if ((error = iter_loose_shadow(iter, path)) < 0) {
+				git_reference_free(*out);
+				*out = NULL;
+			}
 
-			return 0;
+			return error;
 		}
 
 		git_error_clear();
 	}
 
+	if (!iter->cache) {
+		git_oid oid, peel;
+		bool has_peel;
+
+		git_vector_sort(&iter->shadowed);
+
+		if ((error = iter_packed_map_next(&oid, &peel, &has_peel, backend, iter)) < 0)
+			return error;
+
+		*out = git_reference__alloc(iter->packed_name.ptr, &oid, has_peel ? &peel : NULL);
+		return (*out != NULL) ? 0 : -1;
+	}
+
 	error = GIT_ITEROVER;
 	while (iter->packed_pos < git_sortedcache_entrycount(iter->cache)) {
 		ref = git_sortedcache_entry(iter->cache, iter->packed_pos++);
@@ -1091,12 +1325,10 @@ static int refdb_fs_backend__iterator_next_name(
 
 	while (iter->loose_pos < iter->loose.length) {
 		const char *path = git_vector_get(&iter->loose, iter->loose_pos++);
-		struct packref *ref;
 
 		if (loose_lookup(NULL, backend, path) == 0) {
-			ref = git_sortedcache_lookup(iter->cache, path);
-			if (ref)
-				ref->flags |= PACKREF_SHADOWED;
+			if ((error = iter_loose_shadow(iter, path)) < 0)
+				return error;
 
 			*out = path;
 			return 0;
@@ -1105,6 +1337,19 @@ static int refdb_fs_backend__iterator_next_name(
 		git_error_clear();
 	}
 
+	if (!iter->cache) {
+		git_oid oid, peel;
+		bool has_peel;
+
+		git_vector_sort(&iter->shadowed);
+
+		if ((error = iter_packed_map_next(&oid, &peel, &has_peel, backend, iter)) < 0)
+			return error;
+
+		*out = iter->packed_name.ptr;
+		return 0;
+	}
+
 	error = GIT_ITEROVER;
 	while (iter->packed_pos < git_sortedcache_entrycount(iter->cache)) {
 		ref = git_sortedcache_entry(iter->cache, iter->packed_pos++);
@@ -1139,7 +1384,8 @@ static int refdb_fs_backend__iterator(
 	if ((error = git_pool_init(&iter->pool, 1)) < 0)
 		goto out;
 
-	if ((error = git_vector_init(&iter->loose, 8, NULL)) < 0)
+	if ((error = git_vector_init(&iter->loose, 8, NULL)) < 0 ||
+	    (error = git_vector_init(&iter->shadowed, 8, git__strcmp_cb)) < 0)
 		goto out;
 
 	if (glob != NULL &&
@@ -1151,11 +1397,18 @@ static int refdb_fs_backend__iterator(
 	if ((error = iter_load_loose_paths(backend, iter)) < 0)
 		goto out;
 
-	if ((error = packed_reload(backend)) < 0)
+	if ((error = iter_load_packed_map(backend, iter)) < 0)
 		goto out;
 
-	if ((error = git_sortedcache_copy(&iter->cache, backend->refcache, 1, NULL, NULL)) < 0)
-		goto out;
+	if (!error) {
+		if ((error = packed_reload(backend)) < 0)
+			goto out;
+
+		if ((error = git_sortedcache_copy(&iter->cache, backend->refcache, 1, NULL, NULL)) < 0)
+			goto out;
+	}
+
+	error = 0;
 
 	iter->parent.next = refdb_fs_backend__iterator_next;
 	iter->parent.next_name = refdb_fs_backend__iterator_next_name;
@@ -1652,7 +1905,7 @@ out:
  * check with HEAD only which should cover 99% of all usage
  * scenarios (even 100% of the default ones).
  */
-static int maybe_append_head(refdb_fs_backend *backend, const git_reference *ref, const git_signature *who, const char *message)
+static int maybe_append_head(refdb_fs_backend *backend, const git_reference *ref, const git_oid *old, const git_signature *who, const char *message)
 {
 	git_reference *head = NULL;
 	git_refdb *refdb = NULL;
@@ -1666,7 +1919,9 @@ static int maybe_append_head(refdb_fs_backend *backend, const git_reference *ref
 		goto out;
 
 	/* if we can't resolve, we use {0}*40 as old id */
-	if (git_reference_name_to_id(&old_id, backend->repo, ref->name) < 0)
+	if (old)
+		git_oid_cpy(&old_id, old);
+	else if (git_reference_name_to_id(&old_id, backend->repo, ref->name) < 0)
 		git_oid_clear(&old_id, git_repository_oid_type(backend->repo));
 
 	if ((error = git_reference_lookup(&head, backend->repo, GIT_HEAD_REF)) < 0 ||
@@ -1753,7 +2008,7 @@ static int refdb_fs_backend__write_tail(
 		if (should_write) {
 			if ((error = reflog_append(backend, ref, NULL, NULL, who, message)) < 0)
 				goto on_error;
-			if ((error = maybe_append_head(backend, ref, who, message)) < 0)
+			if ((error = maybe_append_head(backend, ref, NULL, who, message)) < 0)
 				goto on_error;
 		}
 	}
@@ -1917,6 +2172,228 @@ cleanup:
 	return error;
 }
 
+/*
+ * Below this many updates, a transaction writes loose references; at or
+ * above it, the updates are merged into packed-refs in a single rewrite.
+ */
+#define PACKED_BATCH_THRESHOLD 16
+
+static bool unlock_entry_is_packable(const git_refdb_backend_unlock_entry *entry)
+{
+	if (entry->success == 2)
+		return true;
+
+	return entry->success == 1 &&
+	       entry->ref->type == GIT_REFERENCE_DIRECT &&
+	       git__prefixcmp(entry->ref->name, GIT_REFS_DIR) == 0 &&
+	       !git_reference__is_per_worktree_ref(entry->ref->name);
+}
+
+typedef struct {
+	bool batched;
+	bool reflog;
+	git_oid old_id;
+} packed_batch_entry;
+
+/*
+ * Check whether a packable update needs to be written at all, and note
+ * the reference's current value for its reflog: the reflog is only
+ * written once packed-refs has been committed, at which point the old
+ * value can no longer be looked up.
+ */
+static int packed_batch_prepare(
+	packed_batch_entry *batch,
+	refdb_fs_backend *backend,
+	const git_refdb_backend_unlock_entry *entry)
+{
+	const git_reference *ref = entry->ref;
+	git_refdb *refdb;
+	int error, exists, cmp = 0, should_write;
+
+	batch->batched = true;
+
+	if (entry->success == 2) {
+		if ((error = refdb_fs_backend__exists(&exists, &backend->parent, ref->name)) < 0)
+			return error;
+
+		return exists ? 0 : ref_error_notfound(ref->name);
+	}
+
+	/* Don't update if we have the same value */
+	error = cmp_old_ref(&cmp, &backend->parent, ref->name, &ref->target.oid, NULL);
+	if (error < 0 && error != GIT_ENOTFOUND)
+		return error;
+
+	if (!error && !cmp) {
+		batch->batched = false;
+		return 0;
+	}
+
+	if (!entry->update_reflog)
+		return 0;
+
+	if ((error = git_repository_refdb__weakptr(&refdb, backend->repo)) < 0 ||
+	    (error = git_refdb_should_write_reflog(&should_write, refdb, ref)) < 0)
+		return error;
+
+	if (!should_write)
+		return 0;
+
+	if ((error = git_reference_name_to_id(&batch->old_id, backend->repo, ref->name)) < 0) {
+		if (error != GIT_ENOTFOUND)
+			return error;
+
+		git_error_clear();
+		git_oid_clear(&batch->old_id, backend->oid_type);
+	}
+
+	batch->reflog = true;
+	return 0;
+}
+
+static int packed_batch_reflog(
+	refdb_fs_backend *backend,
+	const git_refdb_backend_unlock_entry *entry,
+	const packed_batch_entry *batch)
+{
+	int error;
+
+	if (!batch->reflog)
+		return 0;
+
+	if ((error = reflog_append(backend, entry->ref, &batch->old_id, NULL, entry->sig, entry->message)) < 0 ||
+	    (error = maybe_append_head(backend, entry->ref, &batch->old_id, entry->sig, entry->message)) < 0)
+		return error;
+
+	return 0;
+}
+
+static int packed_batch_apply(
+	refdb_fs_backend *backend,
+	git_refdb_backend_unlock_entry *entries,
+	packed_batch_entry *batch,
+	size_t len)
+{
+	size_t i, pos;
+	int error;
+
+	if ((error = packed_reload(backend)) < 0 ||
+	    (error = git_sortedcache_wlock(backend->refcache)) < 0)
+		return error;
+
+	for (i = 0; i < len; i++) {
+		const git_reference *ref = entries[i].ref;
+		struct packref *packref;
+
+		if (!batch[i].batched)
+			continue;
+
+		if (entries[i].success == 2) {
+			if (git_sortedcache_lookup_index(&pos, backend->refcache, ref->name) == 0 &&
+			    (error = git_sortedcache_remove(backend->refcache, pos)) < 0)
+				break;
+
+			continue;
+		}
+
+		if ((error = git_sortedcache_upsert((void **)&packref, backend->refcache, ref->name)) < 0)
+			break;
+
+		git_oid_cpy(&packref->oid, &ref->target.oid);
+		git_oid_clear(&packref->peel, backend->oid_type);
+		packref->flags = 0;
+	}
+
+	git_sortedcache_wunlock(backend->refcache);
+
+	return error ? error : packed_write(backend);
+}
+
+/*
+ * Apply the updates of a transaction.  Once there are enough of them, the
+ * direct references and deletions are merged into the packed-refs file in
+ * one rewrite (with a single fsync), and their loose files are removed
+ * while we still hold their locks; their reflogs are only written once
+ * all of that has succeeded.  Anything else (symbolic references,
+ * per-worktree references) goes through the regular unlock.
+ */
+static int refdb_fs_backend__unlock_many(
+	git_refdb_backend *_backend,
+	git_refdb_backend_unlock_entry *entries,
+	size_t len)
+{
+	refdb_fs_backend *backend = GIT_CONTAINER_OF(_backend, refdb_fs_backend, parent);
+	packed_batch_entry *batch = NULL;
+	size_t i, packable = 0;
+	bool applied = false;
+	int error = 0, entry_error;
+
+	for (i = 0; i < len; i++) {
+		if (unlock_entry_is_packable(&entries[i]))
+			packable++;
+	}
+
+	if (packable >= PACKED_BATCH_THRESHOLD) {
+		batch = git__calloc(len, sizeof(packed_batch_entry));
+		GIT_ERROR_CHECK_ALLOC(batch);
+
+		for (i = 0; i < len && !error; i++) {
+			if (!unlock_entry_is_packable(&entries[i]))
+				continue;
+
+			if ((error = packed_batch_prepare(&batch[i], backend, &entries[i])) < 0)
+				break;
+
+			/* an unchanged reference only needs its lock released */
+			if (!batch[i].batched)
+				entries[i].success = false;
+		}
+
+		if (!error)
+			applied = !(error = packed_batch_apply(backend, entries, batch, len));
+	}
+
+	for (i = 0; i < len; i++) {
+		git_refdb_backend_unlock_entry *entry = &entries[i];
+		git_filebuf *lock = entry->payload;
+
+		if (batch && batch[i].batched) {
+			entry_error = 0;
+
+			/*
+			 * Once packed-refs has been rewritten, every loose file
+			 * has to go even if an earlier entry failed: it would
+			 * otherwise shadow the new packed value.
+			 */
+			if (applied && p_unlink(lock->path_original) < 0 && errno != ENOENT) {
+				git_error_set(GIT_ERROR_OS, "failed to remove loose reference '%s'", entry->ref->name);
+				entry_error = -1;
+			}
+
+			git_filebuf_cleanup(lock);
+			git__free(lock);
+
+			if (applied && !entry_error)
+				entry_error = refdb_fs_backend__prune_refs(backend, entry->ref->name, "");
+
+			if (applied && !entry_error)
+				entry_error = packed_batch_reflog(backend, entry, &batch[i]);
+
+			if (!error)
+				error = entry_error;
+		} else if (error < 0) {
+			refdb_fs_backend__unlock(_backend, lock, false, false, NULL, NULL, NULL);
+		} else {
+			error = refdb_fs_backend__unlock(_backend, lock,
+				entry->success, entry->update_reflog,
+				entry->ref, entry->sig, entry->message);
+		}
+	}
+
+	git__free(batch);
+	return error;
+}
+
 static int refdb_reflog_fs__rename(git_refdb_backend *_backend, const char *old_name, const char *new_name);
 
 static int refdb_fs_backend__rename(
@@ -2091,59 +2568,114 @@ static int reflog_alloc(
 	return 0;
 }
 
+/*
+ * Parse the reflog line at the parser's current position into `out`.
+ * Malformed lines are skipped, in which case `out` is set to `NULL`.
+ */
+static int reflog_parse_entry(
+	git_reflog_entry **out,
+	git_parse_ctx *parser,
+	git_oid_t oid_type)
+{
+	git_reflog_entry *entry;
+	const char *sig;
+	char c;
+
+	*out = NULL;
+
+	entry = git__calloc(1, sizeof(*entry));
+	GIT_ERROR_CHECK_ALLOC(entry);
+	entry->committer = git__calloc(1, sizeof(*entry->committer));
+	GIT_ERROR_CHECK_ALLOC(entry->committer);
+
+	if (git_parse_advance_oid(&entry->oid_old, parser, oid_type) < 0 ||
+	    git_parse_advance_expected(parser, " ", 1) < 0 ||
+	    git_parse_advance_oid(&entry->oid_cur, parser, oid_type) < 0)
+		goto skip;
+
+	sig = parser->line;
+	while (git_parse_peek(&c, parser, 0) == 0 && c != '\t' && c != '\n')
+		git_parse_advance_chars(parser, 1);
+
+	if (git_signature__parse(entry->committer, &sig, parser->line, NULL, 0) < 0)
+		goto skip;
+
+	if (c == '\t') {
+		size_t len;
+		git_parse_advance_chars(parser, 1);
+
+		len = parser->line_len;
+		if (parser->line[len - 1] == '\n')
+			len--;
+
+		entry->msg = git__strndup(parser->line, len);
+		GIT_ERROR_CHECK_ALLOC(entry->msg);
+	}
+
+	*out = entry;
+	return 0;
+
+skip:
+	git_reflog_entry__free(entry);
+	return 0;
+}
+
 static int reflog_parse(git_reflog *log, const char *buf, size_t buf_size)
 {
 	git_parse_ctx parser = GIT_PARSE_CTX_INIT;
+	git_reflog_entry *entry;
 
 	if ((git_parse_ctx_init(&parser, buf, buf_size)) < 0)
 		return -1;
 
 	for (; parser.remain_len; git_parse_advance_line(&parser)) {
-		git_reflog_entry *entry;
-		const char *sig;
-		char c;
-
-		entry = git__calloc(1, sizeof(*entry));
-		GIT_ERROR_CHECK_ALLOC(entry);
-		entry->committer = git__calloc(1, sizeof(*entry->committer));
-		GIT_ERROR_CHECK_ALLOC(entry->committer);
-
-		if (git_parse_advance_oid(&entry->oid_old, &parser, log->oid_type) < 0 ||
-		    git_parse_advance_expected(&parser, " ", 1) < 0 ||
-		    git_parse_advance_oid(&entry->oid_cur, &parser, log->oid_type) < 0)
-			goto next;
+		if (reflog_parse_entry(&entry, &parser, log->oid_type) < 0)
+			return -1;
 
-		sig = parser.line;
-		while (git_parse_peek(&c, &parser, 0) == 0 && c != '\t' && c != '\n')
-			git_parse_advance_chars(&parser, 1);
+		if (entry && git_vector_insert(&log->entries, entry) < 0) {
+			git_reflog_entry__free(entry);
+			return -1;
+		}
+	}
 
-		if (git_signature__parse(entry->committer, &sig, parser.line, NULL, 0) < 0)
-			goto next;
+	return 0;
+}
 
-		if (c == '\t') {
-			size_t len;
-			git_parse_advance_chars(&parser, 1);
+/*
+ * Walk the reflog backwards, starting from the end of the file, so that
+ * looking at the most recent entries does not require us to read and
+ * parse the whole (potentially huge) log.
+ */
+static int reflog_foreach_reverse(
+	const char *buf,
+	size_t buf_size,
+	git_oid_t oid_type,
+	git_refdb_backend_reflog_foreach_cb cb,
+	void *payload)
+{
+	git_parse_ctx parser = GIT_PARSE_CTX_INIT;
+	git_reflog_entry *entry;
+	size_t end = buf_size, start;
+	int error = 0;
 
-			len = parser.line_len;
-			if (parser.line[len - 1] == '\n')
-				len--;
+	while (end > 0 && !error) {
+		/* Find the start of the line, ignoring its trailing newline */
+		for (start = end - 1; start > 0 && buf[start - 1] != '\n'; start--)
+			;
 
-			entry->msg = git__strndup(parser.line, len);
-			GIT_ERROR_CHECK_ALLOC(entry->msg);
-		}
+		if ((error = git_parse_ctx_init(&parser, buf + start, end - start)) < 0 ||
+		    (error = reflog_parse_entry(&entry, &parser, oid_type)) < 0)
+			break;
 
-		if ((git_vector_insert(&log->entries, entry)) < 0) {
+		if (entry) {
+			error = cb(entry, payload);
 			git_reflog_entry__free(entry);
-			return -1;
 		}
 
-		continue;
-
-next:
-		git_reflog_entry__free(entry);
+		end = start;
 	}
 
-	return 0;
+	return error;
 }
 
 static int create_new_reflog_file(const char *filepath)
@@ -2259,6 +2791,61 @@ success:
 	return error;
 }
 
+static int refdb_reflog_fs__foreach(
+	git_refdb_backend *_backend,
+	const char *name,
+	git_refdb_backend_reflog_foreach_cb cb,
+	void *payload)
+{
+	refdb_fs_backend *backend;
+	git_str log_path = GIT_STR_INIT;
+	git_map map = { 0 };
+	git_file fd = -1;
+	uint64_t size;
+	int error;
+
+	GIT_ASSERT_ARG(_backend);
+	GIT_ASSERT_ARG(name);
+	GIT_ASSERT_ARG(cb);
+
+	backend = GIT_CONTAINER_OF(_backend, refdb_fs_backend, parent);
+
+	if ((error = reflog_path(&log_path, backend->repo, name)) < 0)
+		goto done;
+
+	if ((fd = git_futils_open_ro(log_path.ptr)) < 0) {
+		/* A missing reflog simply has no entries */
+		if ((error = fd) == GIT_ENOTFOUND) {
+			git_error_clear();
+			error = 0;
+		}
+
+		goto done;
+	}
+
+	if ((error = git_futils_filesize(&size, fd)) < 0 || !size)
+		goto done;
+
+	if (!git__is_sizet(size)) {
+		git_error_set(GIT_ERROR_OS, "reflog for '%s' is too large to map", name);
+		error = -1;
+		goto done;
+	}
+
+	if ((error = git_futils_mmap_ro(&map, fd, 0, (size_t)size)) < 0)
+		goto done;
+
+	error = reflog_foreach_reverse(map.data, map.len, backend->oid_type, cb, payload);
+
+done:
+	if (map.data)
+		git_futils_mmap_free(&map);
+	if (fd >= 0)
+		p_close(fd);
+	git_str_dispose(&log_path);
+	return error;
+}
+
 static int serialize_reflog_entry(
 	git_str *buf,
 	const git_oid *oid_old,
@@ -2629,6 +3216,7 @@ int git_refdb_backend_fs(
 	backend->parent.compress = &refdb_fs_backend__compress;
 	backend->parent.lock = &refdb_fs_backend__lock;
 	backend->parent.unlock = &refdb_fs_backend__unlock;
+	backend->parent.unlock_many = &refdb_fs_backend__unlock_many;
 	backend->parent.has_log = &refdb_reflog_fs__has_log;
 	backend->parent.ensure_log = &refdb_reflog_fs__ensure_log;
 	backend->parent.free = &refdb_fs_backend__free;
@@ -2636,6 +3224,7 @@ int git_refdb_backend_fs(
 	backend->parent.reflog_write = &refdb_reflog_fs__write;
 	backend->parent.reflog_rename = &refdb_reflog_fs__rename;
 	backend->parent.reflog_delete = &refdb_reflog_fs__delete;
+	backend->parent.reflog_foreach = &refdb_reflog_fs__foreach;
 
 	*backend_out = (git_refdb_backend *)backend;
 	return 0;
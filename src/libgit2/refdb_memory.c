@@ -0,0 +1,990 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "refs.h"
+#include "repository.h"
+#include "reflog.h"
+#include "refdb.h"
+#include "signature.h"
+#include "wildmatch.h"
+#include "hashmap_str.h"
+
+#include <git2/refdb.h>
+#include <git2/sys/refdb_backend.h>
+#include <git2/sys/refs.h>
+
+/*
+ * The in-memory refdb keeps every reference in a single array that is
+ * sorted by name, so that lookups are a binary search and iterating a
+ * namespace (eg. `refs/heads/`) only visits the references below it.
+ * Reflogs are kept in a map keyed by reference name.  Nothing is ever
+ * written to disk; together with the mempack ODB backend this allows a
+ * repository to live entirely in memory.
+ */
+
+GIT_HASHMAP_STR_SETUP(git_refdb_memory_reflogmap, git_reflog *);
+
+typedef struct {
+	git_refdb_backend parent;
+
+	git_repository *repo;
+	git_oid_t oid_type;
+
+	/* the references, sorted by name */
+	git_vector refs;
+
+	git_refdb_memory_reflogmap reflogs;
+
+	/* the names of the references locked by a transaction */
+	git_hashmap_str locks;
+} refdb_memory;
+
+typedef struct {
+	git_reference_iterator parent;
+
+	refdb_memory *backend;
+	char *glob;
+	size_t prefix_len;
+
+	/* the name of the last reference returned, if any */
+	git_str current;
+	unsigned int started : 1;
+} refdb_memory_iter;
+
+static int refdb_memory_ref_cmp(const void *a, const void *b)
+{
+	const git_reference *one = a, *two = b;
+	return strcmp(one->name, two->name);
+}
+
+static int refdb_memory_ref_lookup_cmp(const void *key, const void *element)
+{
+	const git_reference *ref = element;
+	return strcmp(key, ref->name);
+}
+
+static git_reference *refdb_memory_ref_alloc(const git_reference *ref, const char *name)
+{
+	if (ref->type == GIT_REFERENCE_SYMBOLIC)
+		return git_reference__alloc_symbolic(name, ref->target.symbolic);
+
+	return git_reference__alloc(name, &ref->target.oid, NULL);
+}
+
+static git_reference *refdb_memory_find(refdb_memory *backend, const char *name, size_t *pos)
+{
+	size_t at;
+
+	if (git_vector_bsearch2(&at, &backend->refs, refdb_memory_ref_lookup_cmp, name) < 0)
+		at = SIZE_MAX;
+
+	if (pos)
+		*pos = at;
+
+	return at == SIZE_MAX ? NULL : git_vector_get(&backend->refs, at);
+}
+
+static int refdb_memory_ref_error_notfound(const char *name)
+{
+	git_error_set(GIT_ERROR_REFERENCE, "reference '%s' not found", name);
+	return GIT_ENOTFOUND;
+}
+
+static int refdb_memory_check_unlocked(refdb_memory *backend, const char *name)
+{
+	if (git_hashmap_str_contains(&backend->locks, name)) {
+		git_error_set(GIT_ERROR_REFERENCE, "reference '%s' is locked", name);
+		return GIT_ELOCKED;
+	}
+
+	return 0;
+}
+
+/*
+ * Ensure that `new_name` can be created: it must not exist unless we are
+ * forcing the update, and it must not collide with a reference that is
+ * either a leading path of it or that lives beneath it.  The reference
+ * called `old_name`, if any, is about to go away and thus is ignored.
+ */
+static int refdb_memory_name_available(
+	refdb_memory *backend,
+	const char *new_name,
+	const char *old_name,
+	int force)
+{
+	git_str path = GIT_STR_INIT;
+	git_reference *ref;
+	size_t pos;
+	int error = 0;
+
+	if (!force && refdb_memory_find(backend, new_name, NULL)) {
+		git_error_set(GIT_ERROR_REFERENCE,
+			"failed to write reference '%s': a reference with "
+			"that name already exists.", new_name);
+		return GIT_EEXISTS;
+	}
+
+	if ((error = git_str_sets(&path, new_name)) < 0)
+		goto done;
+
+	while (strchr(path.ptr, '/')) {
+		git_str_rtruncate_at_char(&path, '/');
+
+		if ((old_name == NULL || strcmp(path.ptr, old_name)) &&
+		    refdb_memory_find(backend, path.ptr, NULL))
+			goto collision;
+	}
+
+	git_str_clear(&path);
+
+	if ((error = git_str_printf(&path, "%s/", new_name)) < 0)
+		goto done;
+
+	git_vector_bsearch2(&pos, &backend->refs, refdb_memory_ref_lookup_cmp, path.ptr);
+
+	for (; (ref = git_vector_get(&backend->refs, pos)) != NULL; pos++) {
+		if (git__prefixcmp(ref->name, path.ptr))
+			break;
+
+		if (old_name == NULL || strcmp(ref->name, old_name))
+			goto collision;
+	}
+
+	goto done;
+
+collision:
+	git_error_set(GIT_ERROR_REFERENCE,
+		"path to reference '%s' collides with existing one", new_name);
+	error = -1;
+
+done:
+	git_str_dispose(&path);
+	return error;
+}
+
+static int refdb_memory_cmp_ref(
+	int *cmp,
+	refdb_memory *backend,
+	const char *name,
+	const git_oid *old_id,
+	const char *old_target)
+{
+	git_reference *ref;
+
+	*cmp = 0;
+
+	/* It "matches" if there is no old value to compare against */
+	if (!old_id && !old_target)
+		return 0;
+
+	if ((ref = refdb_memory_find(backend, name, NULL)) == NULL) {
+		if (old_id && git_oid_is_zero(old_id))
+			return 0;
+
+		return refdb_memory_ref_error_notfound(name);
+	}
+
+	if (old_id)
+		*cmp = ref->type != GIT_REFERENCE_DIRECT ? -1 :
+			git_oid_cmp(old_id, &ref->target.oid);
+	else
+		*cmp = ref->type != GIT_REFERENCE_SYMBOLIC ? 1 :
+			git__strcmp(old_target, ref->target.symbolic);
+
+	return 0;
+}
+
+static git_reflog *refdb_memory_reflog_alloc(refdb_memory *backend, const char *name)
+{
+	git_reflog *reflog;
+
+	if ((reflog = git__calloc(1, sizeof(git_reflog))) == NULL ||
+	    (reflog->ref_name = git__strdup(name)) == NULL ||
+	    git_vector_init(&reflog->entries, 0, NULL) < 0) {
+		git_reflog_free(reflog);
+		return NULL;
+	}
+
+	reflog->oid_type = backend->oid_type;
+	return reflog;
+}
+
+static int refdb_memory_reflog_copy(git_reflog *out, const git_reflog *reflog)
+{
+	git_reflog_entry *entry, *copy;
+	size_t i;
+
+	if (git_vector_size_hint(&out->entries, reflog->entries.length) < 0)
+		return -1;
+
+	git_vector_foreach(&reflog->entries, i, entry) {
+		copy = git__calloc(1, sizeof(git_reflog_entry));
+		GIT_ERROR_CHECK_ALLOC(copy);
+
+		git_oid_cpy(&copy->oid_old, &entry->oid_old);
+		git_oid_cpy(&copy->oid_cur, &entry->oid_cur);
+
+		if ((entry->msg && (copy->msg = git__strdup(entry->msg)) == NULL) ||
+		    git_signature_dup(&copy->committer, entry->committer) < 0 ||
+		    git_vector_insert(&out->entries, copy) < 0) {
+			git_reflog_entry__free(copy);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int refdb_memory_reflog_append_entry(
+	refdb_memory *backend,
+	const char *name,
+	const git_oid *old_id,
+	const git_oid *new_id,
+	const git_signature *who,
+	const char *message)
+{
+	git_reflog *reflog = NULL;
+	git_reflog_entry *entry;
+	size_t i;
+
+	if (git_refdb_memory_reflogmap_get(&reflog, &backend->reflogs, name) != 0) {
+		if ((reflog = refdb_memory_reflog_alloc(backend, name)) == NULL ||
+		    git_refdb_memory_reflogmap_put(&backend->reflogs, reflog->ref_name, reflog) < 0) {
+			git_reflog_free(reflog);
+			return -1;
+		}
+	}
+
+	entry = git__calloc(1, sizeof(git_reflog_entry));
+	GIT_ERROR_CHECK_ALLOC(entry);
+
+	git_oid_cpy(&entry->oid_old, old_id);
+	git_oid_cpy(&entry->oid_cur, new_id);
+
+	if (git_signature_dup(&entry->committer, who) < 0)
+		goto on_error;
+
+	/* Messages are single lines, just like in a reflog file */
+	if (message) {
+		git_str msg = GIT_STR_INIT;
+
+		git_str_puts(&msg, message);
+
+		for (i = 0; i < msg.size; i++)
+			if (msg.ptr[i] == '\n')
+				msg.ptr[i] = ' ';
+		git_str_rtrim(&msg);
+
+		if (git_str_oom(&msg))
+			goto on_error;
+
+		entry->msg = git_str_detach(&msg);
+	}
+
+	if (git_vector_insert(&reflog->entries, entry) < 0)
+		goto on_error;
+
+	return 0;
+
+on_error:
+	git_reflog_entry__free(entry);
+	return -1;
+}
+
+static int refdb_memory_reflog_append(
+	refdb_memory *backend,
+	const git_reference *ref,
+	const git_oid *old,
+	const git_oid *new,
+	const git_signature *who,
+	const char *message)
+{
+	int error, is_symbolic;
+	git_oid old_id, new_id;
+
+	is_symbolic = ref->type == GIT_REFERENCE_SYMBOLIC;
+
+	/* "normal" symbolic updates do not write */
+	if (is_symbolic && strcmp(ref->name, GIT_HEAD_REF) && !(old && new))
+		return 0;
+
+	git_oid_clear(&old_id, backend->oid_type);
+	git_oid_clear(&new_id, backend->oid_type);
+
+	if (old) {
+		git_oid_cpy(&old_id, old);
+	} else {
+		error = git_reference_name_to_id(&old_id, backend->repo, ref->name);
+		if (error < 0 && error != GIT_ENOTFOUND)
+			return error;
+	}
+
+	if (new) {
+		git_oid_cpy(&new_id, new);
+	} else if (!is_symbolic) {
+		git_oid_cpy(&new_id, git_reference_target(ref));
+	} else {
+		error = git_reference_name_to_id(&new_id, backend->repo,
+			git_reference_symbolic_target(ref));
+		if (error < 0 && error != GIT_ENOTFOUND)
+			return error;
+
+		/* detaching HEAD does not create an entry */
+		if (error == GIT_ENOTFOUND)
+			return 0;
+
+		git_error_clear();
+	}
+
+	return refdb_memory_reflog_append_entry(backend, ref->name,
+		&old_id, &new_id, who, message);
+}
+
+/* Update HEAD's reflog, too, when it points to the reference being updated */
+static int refdb_memory_maybe_append_head(
+	refdb_memory *backend,
+	const git_reference *ref,
+	const git_signature *who,
+	const char *message)
+{
+	git_reference *head = NULL;
+	git_refdb *refdb;
+	int error, write_reflog;
+	git_oid old_id;
+
+	if ((error = git_repository_refdb__weakptr(&refdb, backend->repo)) < 0)
+		return error;
+
+	/* Unlike on disk, a repository in memory need not have a HEAD */
+	if ((error = git_refdb_should_write_head_reflog(&write_reflog, refdb, ref)) == GIT_ENOTFOUND) {
+		git_error_clear();
+		return 0;
+	}
+
+	if (error < 0 || !write_reflog)
+		return error;
+
+	/* if we can't resolve, we use {0}*40 as old id */
+	if (git_reference_name_to_id(&old_id, backend->repo, ref->name) < 0)
+		git_oid_clear(&old_id, backend->oid_type);
+
+	if ((error = git_reference_lookup(&head, backend->repo, GIT_HEAD_REF)) == 0)
+		error = refdb_memory_reflog_append(backend, head, &old_id,
+			git_reference_target(ref), who, message);
+
+	git_reference_free(head);
+	return error;
+}
+
+static int refdb_memory_store(refdb_memory *backend, const git_reference *ref)
+{
+	git_reference *existing, *stored;
+	size_t pos;
+
+	if ((stored = refdb_memory_ref_alloc(ref, ref->name)) == NULL)
+		return -1;
+
+	if (git_vector_bsearch2(&pos, &backend->refs, refdb_memory_ref_lookup_cmp, ref->name) == 0) {
+		existing = git_vector_get(&backend->refs, pos);
+		backend->refs.contents[pos] = stored;
+		git_reference_free(existing);
+		return 0;
+	}
+
+	if (git_vector_insert_sorted(&backend->refs, stored, NULL) < 0) {
+		git_reference_free(stored);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int refdb_memory_write_tail(
+	refdb_memory *backend,
+	const git_reference *ref,
+	int update_reflog,
+	const git_oid *old_id,
+	const char *old_target,
+	const git_signature *who,
+	const char *message)
+{
+	const char *new_target = NULL;
+	const git_oid *new_id = NULL;
+	int error, cmp, should_write;
+
+	if ((error = refdb_memory_cmp_ref(&cmp, backend, ref->name, old_id, old_target)) < 0)
+		return error;
+
+	if (cmp) {
+		git_error_set(GIT_ERROR_REFERENCE, "old reference value does not match");
+		return GIT_EMODIFIED;
+	}
+
+	if (ref->type == GIT_REFERENCE_SYMBOLIC)
+		new_target = ref->target.symbolic;
+	else
+		new_id = &ref->target.oid;
+
+	/* Don't update if we have the same value */
+	if (refdb_memory_find(backend, ref->name, NULL) &&
+	    refdb_memory_cmp_ref(&cmp, backend, ref->name, new_id, new_target) == 0 && !cmp)
+		return 0;
+
+	if (update_reflog) {
+		git_refdb *refdb;
+
+		if ((error = git_repository_refdb__weakptr(&refdb, backend->repo)) < 0 ||
+		    (error = git_refdb_should_write_reflog(&should_write, refdb, ref)) < 0)
+			return error;
+
+		if (should_write &&
+		    ((error = refdb_memory_reflog_append(backend, ref, NULL, NULL, who, message)) < 0 ||
+		     (error = refdb_memory_maybe_append_head(backend, ref, who, message)) < 0))
+			return error;
+	}
+
+	return refdb_memory_store(backend, ref);
+}
+
+static int refdb_memory_delete_tail(
+	refdb_memory *backend,
+	const char *ref_name,
+	const git_oid *old_id,
+	const char *old_target)
+{
+	git_reference *ref;
+	size_t pos;
+	int error, cmp;
+
+	if ((ref = refdb_memory_find(backend, ref_name, &pos)) == NULL)
+		return refdb_memory_ref_error_notfound(ref_name);
+
+	if ((error = refdb_memory_cmp_ref(&cmp, backend, ref_name, old_id, old_target)) < 0)
+		return error;
+
+	if (cmp) {
+		git_error_set(GIT_ERROR_REFERENCE, "old reference value does not match");
+		return GIT_EMODIFIED;
+	}
+
+	if ((error = git_vector_remove(&backend->refs, pos)) < 0)
+		return error;
+
+	git_reference_free(ref);
+	return 0;
+}
+
+static int refdb_memory_exists(
+	int *exists,
+	git_refdb_backend *_backend,
+	const char *ref_name)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+
+	GIT_ASSERT_ARG(backend);
+
+	*exists = (refdb_memory_find(backend, ref_name, NULL) != NULL);
+	return 0;
+}
+
+static int refdb_memory_lookup(
+	git_reference **out,
+	git_refdb_backend *_backend,
+	const char *ref_name)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reference *ref;
+
+	GIT_ASSERT_ARG(backend);
+
+	if ((ref = refdb_memory_find(backend, ref_name, NULL)) == NULL)
+		return refdb_memory_ref_error_notfound(ref_name);
+
+	*out = refdb_memory_ref_alloc(ref, ref->name);
+	GIT_ERROR_CHECK_ALLOC(*out);
+
+	return 0;
+}
+
+/*
+ * Find the next reference to return.  Rather than keeping an index into
+ * the array, we search for the successor of the last name we returned,
+ * so that references being written or deleted while iterating don't
+ * make us skip or repeat entries.
+ */
+static git_reference *refdb_memory_iter_advance(refdb_memory_iter *iter)
+{
+	refdb_memory *backend = iter->backend;
+	git_reference *ref;
+	size_t pos;
+
+	if (!iter->started) {
+		git_str_clear(&iter->current);
+
+		if (git_str_put(&iter->current, iter->glob ? iter->glob : "", iter->prefix_len) < 0)
+			return NULL;
+
+		git_vector_bsearch2(&pos, &backend->refs, refdb_memory_ref_lookup_cmp, iter->current.ptr);
+		iter->started = 1;
+	} else if (git_vector_bsearch2(&pos, &backend->refs, refdb_memory_ref_lookup_cmp, iter->current.ptr) == 0) {
+		pos++;
+	}
+
+	for (; (ref = git_vector_get(&backend->refs, pos)) != NULL; pos++) {
+		if (iter->prefix_len && strncmp(ref->name, iter->glob, iter->prefix_len))
+			return NULL;
+
+		if (iter->glob && wildmatch(iter->glob, ref->name, 0) != 0)
+			continue;
+
+		git_str_clear(&iter->current);
+
+		if (git_str_puts(&iter->current, ref->name) < 0)
+			return NULL;
+
+		return ref;
+	}
+
+	return NULL;
+}
+
+static int refdb_memory_iter_next(git_reference **out, git_reference_iterator *_iter)
+{
+	refdb_memory_iter *iter = GIT_CONTAINER_OF(_iter, refdb_memory_iter, parent);
+	git_reference *ref;
+
+	if ((ref = refdb_memory_iter_advance(iter)) == NULL)
+		return git_str_oom(&iter->current) ? -1 : GIT_ITEROVER;
+
+	*out = refdb_memory_ref_alloc(ref, ref->name);
+	GIT_ERROR_CHECK_ALLOC(*out);
+
+	return 0;
+}
+
+static int refdb_memory_iter_next_name(const char **out, git_reference_iterator *_iter)
+{
+	refdb_memory_iter *iter = GIT_CONTAINER_OF(_iter, refdb_memory_iter, parent);
+
+	if (refdb_memory_iter_advance(iter) == NULL)
+		return git_str_oom(&iter->current) ? -1 : GIT_ITEROVER;
+
+	*out = iter->current.ptr;
+	return 0;
+}
+
+static void refdb_memory_iter_free(git_reference_iterator *_iter)
+{
+	refdb_memory_iter *iter = GIT_CONTAINER_OF(_iter, refdb_memory_iter, parent);
+
+	git_str_dispose(&iter->current);
+	git__free(iter->glob);
+	git__free(iter);
+}
+
+static int refdb_memory_iterator(
+	git_reference_iterator **out,
+	git_refdb_backend *_backend,
+	const char *glob)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	refdb_memory_iter *iter;
+
+	GIT_ASSERT_ARG(backend);
+
+	iter = git__calloc(1, sizeof(refdb_memory_iter));
+	GIT_ERROR_CHECK_ALLOC(iter);
+
+	if (glob) {
+		iter->glob = git__strdup(glob);
+		GIT_ERROR_CHECK_ALLOC(iter->glob);
+
+		/* only references starting with the literal part can match */
+		iter->prefix_len = strcspn(glob, "?*[\\");
+	}
+
+	iter->backend = backend;
+	iter->parent.next = refdb_memory_iter_next;
+	iter->parent.next_name = refdb_memory_iter_next_name;
+	iter->parent.free = refdb_memory_iter_free;
+
+	*out = &iter->parent;
+	return 0;
+}
+
+static int refdb_memory_write(
+	git_refdb_backend *_backend,
+	const git_reference *ref,
+	int force,
+	const git_signature *who,
+	const char *message,
+	const git_oid *old_id,
+	const char *old_target)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+
+	if ((error = refdb_memory_name_available(backend, ref->name, NULL, force)) < 0 ||
+	    (error = refdb_memory_check_unlocked(backend, ref->name)) < 0)
+		return error;
+
+	return refdb_memory_write_tail(backend, ref, true, old_id, old_target, who, message);
+}
+
+static int refdb_memory_reflog_delete(git_refdb_backend *_backend, const char *name)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *reflog;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(name);
+
+	if (git_refdb_memory_reflogmap_get(&reflog, &backend->reflogs, name) != 0)
+		return 0;
+
+	git_refdb_memory_reflogmap_remove(&backend->reflogs, name);
+	git_reflog_free(reflog);
+
+	return 0;
+}
+
+static int refdb_memory_reflog_rename(
+	git_refdb_backend *_backend,
+	const char *old_name,
+	const char *new_name)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *reflog;
+	git_str normalized = GIT_STR_INIT;
+	char *name;
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(old_name);
+	GIT_ASSERT_ARG(new_name);
+
+	if ((error = git_reference__normalize_name(&normalized,
+			new_name, GIT_REFERENCE_FORMAT_ALLOW_ONELEVEL)) < 0)
+		return error;
+
+	if (git_refdb_memory_reflogmap_get(&reflog, &backend->reflogs, old_name) != 0) {
+		error = GIT_ENOTFOUND;
+		goto done;
+	}
+
+	if (!strcmp(old_name, normalized.ptr))
+		goto done;
+
+	if ((error = refdb_memory_reflog_delete(_backend, normalized.ptr)) < 0)
+		goto done;
+
+	git_refdb_memory_reflogmap_remove(&backend->reflogs, old_name);
+
+	name = git_str_detach(&normalized);
+	git__free(reflog->ref_name);
+	reflog->ref_name = name;
+
+	if ((error = git_refdb_memory_reflogmap_put(&backend->reflogs, reflog->ref_name, reflog)) < 0)
+		git_reflog_free(reflog);
+
+done:
+	git_str_dispose(&normalized);
+	return error;
+}
+
+static int refdb_memory_del(
+	git_refdb_backend *_backend,
+	const char *ref_name,
+	const git_oid *old_id,
+	const char *old_target)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(ref_name);
+
+	if ((error = refdb_memory_check_unlocked(backend, ref_name)) < 0 ||
+	    (error = refdb_memory_delete_tail(backend, ref_name, old_id, old_target)) < 0)
+		return error;
+
+	return refdb_memory_reflog_delete(_backend, ref_name);
+}
+
+static int refdb_memory_rename(
+	git_reference **out,
+	git_refdb_backend *_backend,
+	const char *old_name,
+	const char *new_name,
+	int force,
+	const git_signature *who,
+	const char *message)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reference *old, *new = NULL;
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+
+	if ((error = refdb_memory_name_available(backend, new_name, old_name, force)) < 0 ||
+	    (error = refdb_memory_check_unlocked(backend, old_name)) < 0 ||
+	    (error = refdb_memory_check_unlocked(backend, new_name)) < 0)
+		return error;
+
+	if ((old = refdb_memory_find(backend, old_name, NULL)) == NULL)
+		return refdb_memory_ref_error_notfound(old_name);
+
+	if ((new = refdb_memory_ref_alloc(old, new_name)) == NULL)
+		return -1;
+
+	/*
+	 * Store the new reference before removing the old one, so that a
+	 * failure leaves the old reference in place.
+	 */
+	if ((error = refdb_memory_store(backend, new)) < 0 ||
+	    (strcmp(old_name, new_name) &&
+	     (error = refdb_memory_delete_tail(backend, old_name, NULL, NULL)) < 0)) {
+		git_reference_free(new);
+		return error;
+	}
+
+	/* Try to rename the reflog; it's ok if the old doesn't exist */
+	if (((error = refdb_memory_reflog_rename(_backend, old_name, new_name)) < 0 &&
+	     error != GIT_ENOTFOUND) ||
+	    (error = refdb_memory_reflog_append(backend, new,
+			git_reference_target(new), NULL, who, message)) < 0 ||
+	    out == NULL) {
+		git_reference_free(new);
+		return error;
+	}
+
+	*out = new;
+	return 0;
+}
+
+static int refdb_memory_has_log(git_refdb_backend *_backend, const char *refname)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(refname);
+
+	return git_refdb_memory_reflogmap_contains(&backend->reflogs, refname);
+}
+
+static int refdb_memory_ensure_log(git_refdb_backend *_backend, const char *refname)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *reflog;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(refname);
+
+	if (git_refdb_memory_reflogmap_contains(&backend->reflogs, refname))
+		return 0;
+
+	if ((reflog = refdb_memory_reflog_alloc(backend, refname)) == NULL ||
+	    git_refdb_memory_reflogmap_put(&backend->reflogs, reflog->ref_name, reflog) < 0) {
+		git_reflog_free(reflog);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int refdb_memory_reflog_read(
+	git_reflog **out,
+	git_refdb_backend *_backend,
+	const char *name)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *reflog, *stored;
+
+	GIT_ASSERT_ARG(out);
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(name);
+
+	if ((reflog = refdb_memory_reflog_alloc(backend, name)) == NULL)
+		return -1;
+
+	if (git_refdb_memory_reflogmap_get(&stored, &backend->reflogs, name) == 0 &&
+	    refdb_memory_reflog_copy(reflog, stored) < 0) {
+		git_reflog_free(reflog);
+		return -1;
+	}
+
+	*out = reflog;
+	return 0;
+}
+
+static int refdb_memory_reflog_foreach(
+	git_refdb_backend *_backend,
+	const char *name,
+	git_refdb_backend_reflog_foreach_cb cb,
+	void *payload)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *reflog;
+	size_t i;
+	int error = 0;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(name);
+	GIT_ASSERT_ARG(cb);
+
+	if (git_refdb_memory_reflogmap_get(&reflog, &backend->reflogs, name) != 0)
+		return 0;
+
+	for (i = reflog->entries.length; i > 0 && !error; i--)
+		error = cb(git_vector_get(&reflog->entries, i - 1), payload);
+
+	return error;
+}
+
+static int refdb_memory_reflog_write(git_refdb_backend *_backend, git_reflog *reflog)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_reflog *stored;
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+	GIT_ASSERT_ARG(reflog);
+
+	if ((stored = refdb_memory_reflog_alloc(backend, reflog->ref_name)) == NULL ||
+	    refdb_memory_reflog_copy(stored, reflog) < 0) {
+		git_reflog_free(stored);
+		return -1;
+	}
+
+	if ((error = refdb_memory_reflog_delete(_backend, reflog->ref_name)) < 0 ||
+	    (error = git_refdb_memory_reflogmap_put(&backend->reflogs, stored->ref_name, stored)) < 0)
+		git_reflog_free(stored);
+
+	return error;
+}
+
+static int refdb_memory_lock(void **out, git_refdb_backend *_backend, const char *refname)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	char *name;
+	int error;
+
+	GIT_ASSERT_ARG(backend);
+
+	if ((error = refdb_memory_check_unlocked(backend, refname)) < 0)
+		return error;
+
+	name = git__strdup(refname);
+	GIT_ERROR_CHECK_ALLOC(name);
+
+	if ((error = git_hashmap_str_put(&backend->locks, name, name)) < 0) {
+		git__free(name);
+		return error;
+	}
+
+	*out = name;
+	return 0;
+}
+
+static int refdb_memory_unlock(
+	git_refdb_backend *_backend,
+	void *payload,
+	int success,
+	int update_reflog,
+	const git_reference *ref,
+	const git_signature *sig,
+	const char *message)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	char *name = payload;
+	int error = 0;
+
+	git_hashmap_str_remove(&backend->locks, name);
+
+	if (success == 2) {
+		if ((error = refdb_memory_delete_tail(backend, ref->name, NULL, NULL)) == 0)
+			error = refdb_memory_reflog_delete(_backend, ref->name);
+	} else if (success) {
+		error = refdb_memory_write_tail(backend, ref, update_reflog, NULL, NULL, sig, message);
+	}
+
+	git__free(name);
+	return error;
+}
+
+static void refdb_memory_free(git_refdb_backend *_backend)
+{
+	refdb_memory *backend = GIT_CONTAINER_OF(_backend, refdb_memory, parent);
+	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	git_reference *ref;
+	git_reflog *reflog;
+	void *name;
+	size_t i;
+
+	if (!backend)
+		return;
+
+	git_vector_foreach(&backend->refs, i, ref)
+		git_reference_free(ref);
+
+	while (git_refdb_memory_reflogmap_iterate(&iter, NULL, &reflog, &backend->reflogs) == 0)
+		git_reflog_free(reflog);
+
+	iter = GIT_HASHMAP_ITER_INIT;
+
+	while (git_hashmap_str_iterate(&iter, NULL, &name, &backend->locks) == 0)
+		git__free(name);
+
+	git_vector_dispose(&backend->refs);
+	git_refdb_memory_reflogmap_dispose(&backend->reflogs);
+	git_hashmap_str_dispose(&backend->locks);
+	git__free(backend);
+}
+
+int git_refdb_backend_memory(
+	git_refdb_backend **backend_out,
+	git_repository *repository)
+{
+	refdb_memory *backend;
+
+	GIT_ASSERT_ARG(backend_out);
+	GIT_ASSERT_ARG(repository);
+
+	backend = git__calloc(1, sizeof(refdb_memory));
+	GIT_ERROR_CHECK_ALLOC(backend);
+
+	if (git_refdb_init_backend(&backend->parent, GIT_REFDB_BACKEND_VERSION) < 0 ||
+	    git_vector_init(&backend->refs, 0, refdb_memory_ref_cmp) < 0) {
+		git__free(backend);
+		return -1;
+	}
+
+	backend->repo = repository;
+	backend->oid_type = repository->oid_type;
+
+	backend->parent.exists = &refdb_memory_exists;
+	backend->parent.lookup = &refdb_memory_lookup;
+	backend->parent.iterator = &refdb_memory_iterator;
+	backend->parent.write = &refdb_memory_write;
+	backend->parent.del = &refdb_memory_del;
+	backend->parent.rename = &refdb_memory_rename;
+	backend->parent.has_log = &refdb_memory_has_log;
+	backend->parent.ensure_log = &refdb_memory_ensure_log;
+	backend->parent.free = &refdb_memory_free;
+	backend->parent.reflog_read = &refdb_memory_reflog_read;
+	backend->parent.reflog_write = &refdb_memory_reflog_write;
+	backend->parent.reflog_rename = &refdb_memory_reflog_rename;
+	backend->parent.reflog_delete = &refdb_memory_reflog_delete;
+	backend->parent.reflog_foreach = &refdb_memory_reflog_foreach;
+	backend->parent.lock = &refdb_memory_lock;
+	backend->parent.unlock = &refdb_memory_unlock;
+
+	*backend_out = (git_refdb_backend *)backend;
+	return 0;
+}
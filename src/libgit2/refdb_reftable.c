@@ -27,6 +27,8 @@
 #include <reftable-table.h>
 #include <reftable-writer.h>
 
+bool git_refdb_reftable__background_compaction = false;
+
 typedef enum {
 	REFDB_REFTABLE_STACK_MAIN,
 	REFDB_REFTABLE_STACK_WORKTREE,
@@ -42,6 +44,23 @@ typedef struct {
 	git_repository *repo;
 	refdb_reftable_stack *stack;
 	refdb_reftable_stack *worktree_stack;
+
+	unsigned int auto_compaction : 1,
+	             background_compaction : 1;
+	uint8_t geometric_factor;
+
+#ifdef GIT_THREADS
+	/*
+	 * With background compaction, writes only flag the stack that they
+	 * updated in `compaction_pending`, and a worker thread compacts it.
+	 */
+	git_thread compaction_thread;
+	git_mutex compaction_lock;
+	git_cond compaction_cond;
+	unsigned int compaction_pending;
+	unsigned int compaction_started : 1,
+	             compaction_shutdown : 1;
+#endif
 } refdb_reftable;
 
 typedef struct {
@@ -147,6 +166,14 @@ static int refdb_reftable_stack_for(refdb_reftable_stack **out,
 	options.hash_id = REFTABLE_HASH_SHA1;
 #endif
 	options.lock_timeout_ms = 100;
+	options.auto_compaction_factor = backend->geometric_factor;
+
+	/*
+	 * Geometric auto-compaction normally runs as part of every write;
+	 * when it is done in the background, the writes skip it.
+	 */
+	options.disable_auto_compact = !backend->auto_compaction ||
+	                               backend->background_compaction;
 
 	switch (which) {
 	case REFDB_REFTABLE_STACK_WORKTREE:
@@ -208,6 +235,118 @@ static int refdb_reftable_stack_for_refname(refdb_reftable_stack **out,
 	return refdb_reftable_stack_for(out, backend, type);
 }
 
+#ifdef GIT_THREADS
+
+static void *refdb_reftable_compaction_thread(void *payload)
+{
+	refdb_reftable *backend = payload;
+	refdb_reftable_stack *stack;
+	unsigned int pending;
+
+	if (git_mutex_lock(&backend->compaction_lock) < 0)
+		return NULL;
+
+	while (true) {
+		while (!backend->compaction_pending && !backend->compaction_shutdown)
+			git_cond_wait(&backend->compaction_cond, &backend->compaction_lock);
+
+		/* finish outstanding work before shutting down */
+		if (!backend->compaction_pending)
+			break;
+
+		pending = backend->compaction_pending;
+		backend->compaction_pending = 0;
+		git_mutex_unlock(&backend->compaction_lock);
+
+		/*
+		 * Taking the stack from the backend gives us exclusive use of
+		 * it; concurrent writers in other processes are serialized by
+		 * the stack's own lock on "tables.list".  Losing that race is
+		 * benign, since the next write schedules another compaction.
+		 */
+		if ((pending & (1 << REFDB_REFTABLE_STACK_MAIN)) &&
+		    refdb_reftable_stack_for(&stack, backend, REFDB_REFTABLE_STACK_MAIN) == 0) {
+			reftable_stack_auto_compact(stack->stack);
+			refdb_reftable_return_stack(backend, stack);
+		}
+
+		if ((pending & (1 << REFDB_REFTABLE_STACK_WORKTREE)) &&
+		    refdb_reftable_stack_for(&stack, backend, REFDB_REFTABLE_STACK_WORKTREE) == 0) {
+			reftable_stack_auto_compact(stack->stack);
+			refdb_reftable_return_stack(backend, stack);
+		}
+
+		git_error_clear();
+
+		if (git_mutex_lock(&backend->compaction_lock) < 0)
+			return NULL;
+	}
+
+	git_mutex_unlock(&backend->compaction_lock);
+	return NULL;
+}
+
+static int refdb_reftable_schedule_compaction(refdb_reftable *backend,
+					      refdb_reftable_stack *stack)
+{
+	int error = 0;
+
+	if (git_mutex_lock(&backend->compaction_lock) < 0) {
+		git_error_set(GIT_ERROR_OS, "failed to lock compaction state");
+		return -1;
+	}
+
+	if (!backend->compaction_started) {
+		if ((error = git_thread_create(&backend->compaction_thread,
+					       refdb_reftable_compaction_thread, backend)) < 0) {
+			git_error_set(GIT_ERROR_THREAD, "unable to create compaction thread");
+			goto out;
+		}
+
+		backend->compaction_started = 1;
+	}
+
+	backend->compaction_pending |= (1 << stack->which);
+	git_cond_signal(&backend->compaction_cond);
+
+out:
+	git_mutex_unlock(&backend->compaction_lock);
+	return error;
+}
+
+#endif
+
+/*
+ * Add a new table to the stack.  Unless compaction happens in the
+ * background, the reftable library auto-compacts the stack as part of the
+ * addition, merging tables so that their sizes form a geometric sequence.
+ * This keeps the number of tables logarithmic in the number of writes.
+ */
+static int refdb_reftable_stack_add(refdb_reftable *backend,
+				    refdb_reftable_stack *stack,
+				    int (*write_table)(struct reftable_writer *, void *),
+				    void *write_arg)
+{
+	int error;
+
+	if ((error = reftable_stack_add(stack->stack, write_table, write_arg,
+					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0)
+		return error;
+
+#ifdef GIT_THREADS
+	/* the write succeeded; if we cannot hand off, compact right here */
+	if (backend->auto_compaction && backend->background_compaction &&
+	    refdb_reftable_schedule_compaction(backend, stack) < 0) {
+		git_error_clear();
+		reftable_stack_auto_compact(stack->stack);
+	}
+#else
+	GIT_UNUSED(backend);
+#endif
+
+	return 0;
+}
+
 static int refdb_reftable_reference_from_record(git_reference **out,
 						struct reftable_ref_record *record,
 						git_oid_t type)
@@ -519,8 +658,8 @@ static int refdb_reftable_init(git_refdb_backend *_backend,
 			data.initial_head = initial_head;
 			data.error = 0;
 
-			if ((error = reftable_stack_add(stack->stack, refdb_reftable_write_head_table,
-							&data, REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+			if ((error = refdb_reftable_stack_add(backend, stack, refdb_reftable_write_head_table,
+					      &data)) < 0) {
 				if (data.error)
 					error = data.error;
 				else
@@ -1009,8 +1148,8 @@ static int refdb_reftable_write(git_refdb_backend *_backend,
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, ref->name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_write_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_write_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1164,8 +1303,8 @@ static int refdb_reftable_delete(git_refdb_backend *_backend,
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, refname)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_write_delete_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_write_delete_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1354,8 +1493,8 @@ static int refdb_reftable_rename(git_reference **out,
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, old_name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_write_rename_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_write_rename_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1371,6 +1510,21 @@ out:
 static void refdb_reftable_free(git_refdb_backend *_backend)
 {
 	refdb_reftable *backend = GIT_CONTAINER_OF(_backend, refdb_reftable, parent);
+
+#ifdef GIT_THREADS
+	if (backend->compaction_started) {
+		git_mutex_lock(&backend->compaction_lock);
+		backend->compaction_shutdown = 1;
+		git_cond_signal(&backend->compaction_cond);
+		git_mutex_unlock(&backend->compaction_lock);
+
+		git_thread_join(&backend->compaction_thread, NULL);
+	}
+
+	git_cond_free(&backend->compaction_cond);
+	git_mutex_free(&backend->compaction_lock);
+#endif
+
 	refdb_reftable_stack_free(backend->worktree_stack);
 	refdb_reftable_stack_free(backend->stack);
 	git__free(backend);
@@ -1453,8 +1607,8 @@ static int refdb_reftable_ensure_log(git_refdb_backend *_backend,
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_write_log_existence_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_write_log_existence_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1656,8 +1810,8 @@ static int refdb_reftable_reflog_write(git_refdb_backend *_backend, git_reflog *
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, reflog->ref_name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_write_reflog_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_write_reflog_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1723,8 +1877,8 @@ static int refdb_reftable_reflog_rename(git_refdb_backend *_backend, const char
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, old_name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_reflog_write_rename_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_reflog_write_rename_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1779,8 +1933,8 @@ static int refdb_reftable_reflog_delete(git_refdb_backend *_backend, const char
 	if ((error = refdb_reftable_stack_for_refname(&data.stack, backend, name)) < 0)
 		goto out;
 
-	if ((error = reftable_stack_add(data.stack->stack, refdb_reftable_reflog_write_delete_table, &data,
-					REFTABLE_STACK_NEW_ADDITION_RELOAD)) < 0) {
+	if ((error = refdb_reftable_stack_add(backend, data.stack, refdb_reftable_reflog_write_delete_table,
+					      &data)) < 0) {
 		if (data.error)
 			error = data.error;
 		else
@@ -1824,6 +1978,32 @@ out:
 	return error;
 }
 
+static int refdb_reftable_load_config(refdb_reftable *backend)
+{
+	int auto_compaction, factor;
+	int error;
+
+	if ((error = git_repository__configmap_lookup(&auto_compaction, backend->repo,
+			GIT_CONFIGMAP_REFTABLE_AUTOCOMPACTION)) < 0 ||
+	    (error = git_repository__configmap_lookup(&factor, backend->repo,
+			GIT_CONFIGMAP_REFTABLE_GEOMETRICFACTOR)) < 0)
+		return error;
+
+	if (factor < 2 || factor > UINT8_MAX) {
+		git_error_set(GIT_ERROR_CONFIG, "invalid reftable.geometricFactor '%d'", factor);
+		return -1;
+	}
+
+	backend->auto_compaction = !!auto_compaction;
+	backend->geometric_factor = (uint8_t)factor;
+
+#ifdef GIT_THREADS
+	backend->background_compaction = git_refdb_reftable__background_compaction;
+#endif
+
+	return 0;
+}
+
 int git_refdb_backend_reftable(git_refdb_backend **out,
 			       git_repository *repository)
 {
@@ -1845,11 +2025,30 @@ int git_refdb_backend_reftable(git_refdb_backend **out,
 	backend = git__calloc(1, sizeof(refdb_reftable));
 	GIT_ERROR_CHECK_ALLOC(backend);
 
+#ifdef GIT_THREADS
+	if (git_mutex_init(&backend->compaction_lock)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize lock for reftable compaction");
+		git__free(backend);
+		return -1;
+	}
+
+	if (git_cond_init(&backend->compaction_cond)) {
+		git_error_set(GIT_ERROR_OS, "unable to initialize condition for reftable compaction");
+		git_mutex_free(&backend->compaction_lock);
+		git__free(backend);
+		return -1;
+	}
+#endif
+
 	if ((error = git_refdb_init_backend(&backend->parent, GIT_REFDB_BACKEND_VERSION)) < 0) {
 		goto out;
 	}
 
 	backend->repo = repository;
+
+	if ((error = refdb_reftable_load_config(backend)) < 0)
+		goto out;
+
 	backend->parent.init = refdb_reftable_init;
 	backend->parent.exists = refdb_reftable_exists;
 	backend->parent.lookup = refdb_reftable_lookup;
@@ -1872,7 +2071,7 @@ int git_refdb_backend_reftable(git_refdb_backend **out,
 
 out:
 	if (backend)
-		git__free(backend);
+		refdb_reftable_free(&backend->parent);
 	git_str_dispose(&dir);
 	return error;
 }
@@ -1897,5 +2096,6 @@ int git_reftable_global_init(void)
 	reftable_set_alloc(reftable_git_malloc,
 			   reftable_git_realloc,
 			   reftable_git_free);
-	return 0;
+
+	return git_reftable_map_cache_global_init();
 }
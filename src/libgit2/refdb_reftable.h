@@ -9,6 +9,8 @@
 
 #include "common.h"
 
+extern bool git_refdb_reftable__background_compaction;
+
 int git_reftable_global_init(void);
 
 #endif
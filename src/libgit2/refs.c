@@ -620,8 +620,14 @@ static int refs_update_head(git_repository *worktree, void *_payload)
 	git_reference *head = NULL, *updated = NULL;
 	int error;
 
-	if ((error = git_reference_lookup(&head, worktree, GIT_HEAD_REF)) < 0)
+	/* A repository without a HEAD (eg. one in memory) has nothing to update */
+	if ((error = git_reference_lookup(&head, worktree, GIT_HEAD_REF)) == GIT_ENOTFOUND) {
+		git_error_clear();
+		error = 0;
+		goto out;
+	} else if (error < 0) {
 		goto out;
+	}
 
 	if (git_reference_type(head) != GIT_REFERENCE_SYMBOLIC ||
 	    git__strcmp(git_reference_symbolic_target(head), payload->old_name) != 0)
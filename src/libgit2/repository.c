@@ -181,6 +181,15 @@ void git_repository_free(git_repository *repo)
 	git_diff_driver_registry_free(repo->diff_drivers);
 	repo->diff_drivers = NULL;
 
+	git_hashsig_cache_free(repo->hashsig_cache);
+	repo->hashsig_cache = NULL;
+
+	git_merge_base_cache_free(repo->merge_base_cache);
+	repo->merge_base_cache = NULL;
+
+	git_peel_cache_free(repo->peel_cache);
+	repo->peel_cache = NULL;
+
 	for (i = 0; i < repo->reserved_names.size; i++)
 		git_str_dispose(git_array_get(repo->reserved_names, i));
 	git_array_clear(repo->reserved_names);
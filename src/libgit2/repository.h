@@ -26,6 +26,9 @@
 #include "submodule.h"
 #include "diff_driver.h"
 #include "grafts.h"
+#include "hashsig_cache.h"
+#include "merge_base_cache.h"
+#include "peel_cache.h"
 
 #define DOT_GIT ".git"
 #define GIT_DIR DOT_GIT "/"
@@ -55,6 +58,10 @@ typedef enum {
 	GIT_CONFIGMAP_PROTECTNTFS,      /* core.protectNTFS */
 	GIT_CONFIGMAP_FSYNCOBJECTFILES, /* core.fsyncObjectFiles */
 	GIT_CONFIGMAP_LONGPATHS,        /* core.longpaths */
+	GIT_CONFIGMAP_REFTABLE_AUTOCOMPACTION, /* reftable.autoCompaction */
+	GIT_CONFIGMAP_REFTABLE_GEOMETRICFACTOR, /* reftable.geometricFactor */
+	GIT_CONFIGMAP_HASHSIGCACHE,     /* core.hashsigCache */
+	GIT_CONFIGMAP_MERGEBASECACHE,   /* core.mergeBaseCache */
 	GIT_CONFIGMAP_CACHE_MAX
 } git_configmap_item;
 
@@ -123,7 +130,15 @@ typedef enum {
 	/* core.fsyncObjectFiles */
 	GIT_FSYNCOBJECTFILES_DEFAULT = GIT_CONFIGMAP_FALSE,
 	/* core.longpaths */
-	GIT_LONGPATHS_DEFAULT = GIT_CONFIGMAP_FALSE
+	GIT_LONGPATHS_DEFAULT = GIT_CONFIGMAP_FALSE,
+	/* reftable.autoCompaction */
+	GIT_REFTABLE_AUTOCOMPACTION_DEFAULT = GIT_CONFIGMAP_TRUE,
+	/* reftable.geometricFactor */
+	GIT_REFTABLE_GEOMETRICFACTOR_DEFAULT = 2,
+	/* core.hashsigCache */
+	GIT_HASHSIGCACHE_DEFAULT = GIT_CONFIGMAP_FALSE,
+	/* core.mergeBaseCache */
+	GIT_MERGEBASECACHE_DEFAULT = GIT_CONFIGMAP_FALSE
 } git_configmap_value;
 
 /* internal repository init flags */
@@ -143,6 +158,9 @@ struct git_repository {
 	git_cache objects;
 	git_attr_cache *attrcache;
 	git_diff_driver_registry *diff_drivers;
+	git_hashsig_cache *hashsig_cache;
+	git_merge_base_cache *merge_base_cache;
+	git_peel_cache *peel_cache;
 
 	char *gitlink;
 	char *gitdir;
@@ -144,18 +144,40 @@ static int try_parse_numeric(int *n, const char *curly_braces_content)
 	return 0;
 }
 
+typedef struct {
+	git_regexp *preg;
+	size_t cur;
+	git_str *branch;
+} checked_out_branch_data;
+
+static int find_checked_out_branch(const git_reflog_entry *entry, void *payload)
+{
+	checked_out_branch_data *data = payload;
+	git_regmatch regexmatches[2];
+	const char *msg;
+
+	if ((msg = git_reflog_entry_message(entry)) == NULL ||
+	    git_regexp_search(data->preg, msg, 2, regexmatches) < 0)
+		return 0;
+
+	if (--data->cur > 0)
+		return 0;
+
+	if (git_str_put(data->branch, msg + regexmatches[1].start,
+			regexmatches[1].end - regexmatches[1].start) < 0)
+		return -1;
+
+	return 1;
+}
+
 static int retrieve_previously_checked_out_branch_or_revision(git_object **out, git_reference **base_ref, git_repository *repo, const char *identifier, size_t position)
 {
 	git_reference *ref = NULL;
-	git_reflog *reflog = NULL;
+	git_refdb *refdb;
 	git_regexp preg;
 	int error = -1;
-	size_t i, numentries, cur;
-	const git_reflog_entry *entry;
-	const char *msg;
 	git_str buf = GIT_STR_INIT;
-
-	cur = position;
+	checked_out_branch_data data;
 
 	if (*identifier != '\0' || *base_ref != NULL)
 		return GIT_EINVALIDSPEC;
@@ -163,108 +185,95 @@ static int retrieve_previously_checked_out_branch_or_revision(git_object **out,
 	if (build_regex(&preg, "checkout: moving from (.*) to .*") < 0)
 		return -1;
 
-	if (git_reference_lookup(&ref, repo, GIT_HEAD_REF) < 0)
+	if (git_reference_lookup(&ref, repo, GIT_HEAD_REF) < 0 ||
+	    git_repository_refdb__weakptr(&refdb, repo) < 0)
 		goto cleanup;
 
-	if (git_reflog_read(&reflog, repo, GIT_HEAD_REF) < 0)
-		goto cleanup;
-
-	numentries  = git_reflog_entrycount(reflog);
-
-	for (i = 0; i < numentries; i++) {
-		git_regmatch regexmatches[2];
-
-		entry = git_reflog_entry_byindex(reflog, i);
-		msg = git_reflog_entry_message(entry);
-		if (!msg)
-			continue;
-
-		if (git_regexp_search(&preg, msg, 2, regexmatches) < 0)
-			continue;
-
-		cur--;
-
-		if (cur > 0)
-			continue;
+	data.preg = &preg;
+	data.cur = position;
+	data.branch = &buf;
 
-		if ((git_str_put(&buf, msg+regexmatches[1].start, regexmatches[1].end - regexmatches[1].start)) < 0)
-			goto cleanup;
-
-		if ((error = git_reference_dwim(base_ref, repo, git_str_cstr(&buf))) == 0)
-			goto cleanup;
+	/* Only read the reflog back to the checkout that we're looking for */
+	if ((error = git_refdb_reflog_foreach(refdb, GIT_HEAD_REF, find_checked_out_branch, &data)) < 0)
+		goto cleanup;
 
-		if (error < 0 && error != GIT_ENOTFOUND)
-			goto cleanup;
+	if (error == 0) {
+		error = GIT_ENOTFOUND;
+		goto cleanup;
+	}
 
-		error = maybe_abbrev(out, repo, git_str_cstr(&buf));
+	if ((error = git_reference_dwim(base_ref, repo, git_str_cstr(&buf))) == 0)
+		goto cleanup;
 
+	if (error < 0 && error != GIT_ENOTFOUND)
 		goto cleanup;
-	}
 
-	error = GIT_ENOTFOUND;
+	error = maybe_abbrev(out, repo, git_str_cstr(&buf));
 
 cleanup:
 	git_reference_free(ref);
 	git_str_dispose(&buf);
 	git_regexp_dispose(&preg);
-	git_reflog_free(reflog);
 	return error;
 }
 
-static int retrieve_oid_from_reflog(git_oid *oid, git_reference *ref, size_t identifier)
-{
-	git_reflog *reflog;
+typedef struct {
+	size_t identifier;
+	bool search_by_pos;
 	size_t numentries;
-	const git_reflog_entry *entry = NULL;
-	bool search_by_pos = (identifier <= 100000000);
-
-	if (git_reflog_read(&reflog, git_reference_owner(ref), git_reference_name(ref)) < 0)
-		return -1;
+	git_oid *oid;
+} reflog_oid_data;
 
-	numentries = git_reflog_entrycount(reflog);
-
-	if (search_by_pos) {
-		if (numentries < identifier + 1)
-			goto notfound;
+static int find_reflog_oid(const git_reflog_entry *entry, void *payload)
+{
+	reflog_oid_data *data = payload;
 
-		entry = git_reflog_entry_byindex(reflog, identifier);
-		git_oid_cpy(oid, git_reflog_entry_id_new(entry));
+	if (data->search_by_pos) {
+		if (data->numentries++ < data->identifier)
+			return 0;
 	} else {
-		size_t i;
-		git_time commit_time;
+		/*
+		 * Remember each entry, so that we end up with the oldest one
+		 * when none of them is old enough.
+		 */
+		git_oid_cpy(data->oid, git_reflog_entry_id_new(entry));
+		data->numentries++;
 
-		for (i = 0; i < numentries; i++) {
-			entry = git_reflog_entry_byindex(reflog, i);
-			commit_time = git_reflog_entry_committer(entry)->when;
+		if (git_reflog_entry_committer(entry)->when.time > (git_time_t)data->identifier)
+			return 0;
+	}
 
-			if (commit_time.time > (git_time_t)identifier)
-				continue;
+	git_oid_cpy(data->oid, git_reflog_entry_id_new(entry));
+	return 1;
+}
 
-			git_oid_cpy(oid, git_reflog_entry_id_new(entry));
-			break;
-		}
+static int retrieve_oid_from_reflog(git_oid *oid, git_reference *ref, size_t identifier)
+{
+	reflog_oid_data data;
+	git_refdb *refdb;
+	int error;
 
-		if (i == numentries) {
-			if (entry == NULL)
-				goto notfound;
+	data.identifier = identifier;
+	data.search_by_pos = (identifier <= 100000000);
+	data.numentries = 0;
+	data.oid = oid;
 
-			/*
-			 * TODO: emit a warning (log for 'branch' only goes back to ...)
-			 */
-			git_oid_cpy(oid, git_reflog_entry_id_new(entry));
-		}
-	}
+	if (git_repository_refdb__weakptr(&refdb, git_reference_owner(ref)) < 0 ||
+	    (error = git_refdb_reflog_foreach(refdb, git_reference_name(ref), find_reflog_oid, &data)) < 0)
+		return -1;
 
-	git_reflog_free(reflog);
-	return 0;
+	/*
+	 * TODO: emit a warning when searching by date and the log for
+	 * 'branch' only goes back to ...
+	 */
+	if (error > 0 || (!data.search_by_pos && data.numentries))
+		return 0;
 
-notfound:
 	git_error_set(
 		GIT_ERROR_REFERENCE,
 		"reflog for '%s' has only %"PRIuZ" entries, asked for %"PRIuZ,
-		git_reference_name(ref), numentries, identifier);
+		git_reference_name(ref), data.numentries, identifier);
 
-	git_reflog_free(reflog);
 	return GIT_ENOTFOUND;
 }
 
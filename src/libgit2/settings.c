@@ -22,6 +22,7 @@
 #include "object.h"
 #include "odb.h"
 #include "rand.h"
+#include "refdb_reftable.h"
 #include "refs.h"
 #include "runtime.h"
 #include "sysdir.h"
@@ -328,6 +329,10 @@ int git_libgit2_opts(int key, ...)
 		git_repository__fsync_gitdir = (va_arg(ap, int) != 0);
 		break;
 
+	case GIT_OPT_ENABLE_REFTABLE_BACKGROUND_COMPACTION:
+		git_refdb_reftable__background_compaction = (va_arg(ap, int) != 0);
+		break;
+
 	case GIT_OPT_GET_WINDOWS_SHAREMODE:
 #ifdef GIT_WIN32
 		*(va_arg(ap, unsigned long *)) = git_win32__createfile_sharemode;
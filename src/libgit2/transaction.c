@@ -298,12 +298,16 @@ int git_transaction_set_reflog(git_transaction *tx, const char *refname, const g
 	return 0;
 }
 
-static int update_target(git_refdb *db, transaction_node *node)
+static int prepare_update(git_refdb_backend_unlock_entry *entry, transaction_node *node)
 {
 	git_reference *ref;
-	int error, update_reflog;
 
-	if (node->ref_type == GIT_REFERENCE_DIRECT) {
+	entry->payload = node->payload;
+
+	if (node->ref_type == GIT_REFERENCE_INVALID) {
+		/* ref was locked but not modified */
+		return 0;
+	} else if (node->ref_type == GIT_REFERENCE_DIRECT) {
 		ref = git_reference__alloc(node->name, &node->target.id, NULL);
 	} else if (node->ref_type == GIT_REFERENCE_SYMBOLIC) {
 		ref = git_reference__alloc_symbolic(node->name, node->target.symbolic);
@@ -312,28 +316,27 @@ static int update_target(git_refdb *db, transaction_node *node)
 	}
 
 	GIT_ERROR_CHECK_ALLOC(ref);
-	update_reflog = node->reflog == NULL;
+
+	entry->ref = ref;
 
 	if (node->remove) {
-		error =  git_refdb_unlock(db, node->payload, 2, false, ref, NULL, NULL);
-	} else if (node->ref_type == GIT_REFERENCE_DIRECT) {
-		error = git_refdb_unlock(db, node->payload, true, update_reflog, ref, node->sig, node->message);
-	} else if (node->ref_type == GIT_REFERENCE_SYMBOLIC) {
-		error = git_refdb_unlock(db, node->payload, true, update_reflog, ref, node->sig, node->message);
+		entry->success = 2;
 	} else {
-		abort();
+		entry->success = true;
+		entry->update_reflog = node->reflog == NULL;
+		entry->sig = node->sig;
+		entry->message = node->message;
 	}
 
-	git_reference_free(ref);
-	node->committed = true;
-
-	return error;
+	return 0;
 }
 
 int git_transaction_commit(git_transaction *tx)
 {
 	transaction_node *node;
 	git_hashmap_iter_t iter = GIT_HASHMAP_ITER_INIT;
+	git_refdb_backend_unlock_entry *entries = NULL;
+	size_t count, i = 0;
 	int error = 0;
 
 	GIT_ASSERT_ARG(tx);
@@ -351,20 +354,38 @@ int git_transaction_commit(git_transaction *tx)
 			if ((error = tx->db->backend->reflog_write(tx->db->backend, node->reflog)) < 0)
 				return error;
 		}
+	}
 
-		if (node->ref_type == GIT_REFERENCE_INVALID) {
-			/* ref was locked but not modified */
-			if ((error = git_refdb_unlock(tx->db, node->payload, false, false, NULL, NULL, NULL)) < 0) {
-				return error;
-			}
-			node->committed = true;
-		} else {
-			if ((error = update_target(tx->db, node)) < 0)
-				return error;
-		}
+	/*
+	 * Hand all of the updates to the refdb at once, so that backends
+	 * can apply them in a single pass.
+	 */
+	if ((count = git_transaction_nodemap_size(&tx->locks)) == 0)
+		return 0;
+
+	entries = git__calloc(count, sizeof(git_refdb_backend_unlock_entry));
+	GIT_ERROR_CHECK_ALLOC(entries);
+
+	iter = GIT_HASHMAP_ITER_INIT;
+
+	while (git_transaction_nodemap_iterate(&iter, NULL, &node, &tx->locks) == 0) {
+		if ((error = prepare_update(&entries[i++], node)) < 0)
+			goto done;
 	}
 
-	return 0;
+	error = git_refdb_unlock_many(tx->db, entries, count);
+
+	iter = GIT_HASHMAP_ITER_INIT;
+
+	while (git_transaction_nodemap_iterate(&iter, NULL, &node, &tx->locks) == 0)
+		node->committed = true;
+
+done:
+	for (i = 0; i < count; i++)
+		git_reference_free((git_reference *)entries[i].ref);
+
+	git__free(entries);
+	return error;
 }
 
 void git_transaction_free(git_transaction *tx)
@@ -9,7 +9,12 @@
 
 #include <zlib.h>
 
+#ifdef GIT_COMPRESSION_LIBDEFLATE
+# include <libdeflate.h>
+#endif
+
 #include "str.h"
+#include "runtime.h"
 
 #define ZSTREAM_BUFFER_SIZE (1024 * 1024)
 #define ZSTREAM_BUFFER_MIN_EXTRA 8
@@ -208,3 +213,126 @@ int git_zstream_inflatebuf(git_str *out, const void *in, size_t in_len)
 {
 	return zstream_buf(out, in, in_len, GIT_ZSTREAM_INFLATE);
 }
+
+#ifdef GIT_COMPRESSION_LIBDEFLATE
+
+/*
+ * Decompressors are not thread safe, but are reusable and somewhat
+ * expensive to set up; keep one around for each thread.
+ */
+static git_tlsdata_key decompressor_key;
+
+static void GIT_SYSTEM_CALL decompressor_free(void *decompressor)
+{
+	if (decompressor)
+		libdeflate_free_decompressor(decompressor);
+}
+
+static void git_zstream_global_shutdown(void)
+{
+	struct libdeflate_decompressor *decompressor;
+
+	decompressor = git_tlsdata_get(decompressor_key);
+	git_tlsdata_set(decompressor_key, NULL);
+
+	decompressor_free(decompressor);
+
+	git_tlsdata_dispose(decompressor_key);
+}
+
+int git_zstream_global_init(void)
+{
+	if (git_tlsdata_init(&decompressor_key, &decompressor_free) != 0)
+		return -1;
+
+	return git_runtime_shutdown_register(git_zstream_global_shutdown);
+}
+
+static struct libdeflate_decompressor *decompressor_get(void)
+{
+	struct libdeflate_decompressor *decompressor;
+
+	if ((decompressor = git_tlsdata_get(decompressor_key)) != NULL)
+		return decompressor;
+
+	if ((decompressor = libdeflate_alloc_decompressor()) == NULL) {
+		git_error_set_oom();
+		return NULL;
+	}
+
+	if (git_tlsdata_set(decompressor_key, decompressor) != 0) {
+		libdeflate_free_decompressor(decompressor);
+		git_error_set(GIT_ERROR_OS, "could not store decompressor");
+		return NULL;
+	}
+
+	return decompressor;
+}
+
+int git_zstream_inflate_oneshot(
+	void *out,
+	size_t out_len,
+	size_t *in_used,
+	const void *in,
+	size_t in_len)
+{
+	struct libdeflate_decompressor *decompressor;
+	enum libdeflate_result result;
+	size_t actual_in = 0, actual_out = 0;
+
+	if ((decompressor = decompressor_get()) == NULL)
+		return -1;
+
+	result = libdeflate_zlib_decompress_ex(decompressor,
+		in, in_len, out, out_len, &actual_in, &actual_out);
+
+	/*
+	 * libdeflate does not distinguish truncated input from corrupt
+	 * input; let the streaming inflater produce a meaningful error.
+	 */
+	if (result != LIBDEFLATE_SUCCESS || actual_out != out_len)
+		return GIT_EBUFS;
+
+	if (in_used)
+		*in_used = actual_in;
+
+	return 0;
+}
+
+#else
+
+int git_zstream_global_init(void)
+{
+	return 0;
+}
+
+int git_zstream_inflate_oneshot(
+	void *out,
+	size_t out_len,
+	size_t *in_used,
+	const void *in,
+	size_t in_len)
+{
+	git_zstream zs = GIT_ZSTREAM_INIT;
+	size_t out_written = out_len;
+	int error;
+
+	if ((error = git_zstream_init(&zs, GIT_ZSTREAM_INFLATE)) < 0 ||
+	    (error = git_zstream_set_input(&zs, in, in_len)) < 0 ||
+	    (error = git_zstream_get_output_chunk(out, &out_written, &zs)) < 0)
+		goto done;
+
+	if (!git_zstream_eos(&zs) || out_written != out_len) {
+		error = GIT_EBUFS;
+		goto done;
+	}
+
+	if (in_used)
+		*in_used = in_len - zs.in_len;
+
+done:
+	git_zstream_free(&zs);
+	return error;
+}
+
+#endif
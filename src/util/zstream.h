@@ -29,6 +29,8 @@ typedef struct {
 
 #define GIT_ZSTREAM_INIT {{0}}
 
+int git_zstream_global_init(void);
+
 int git_zstream_init(git_zstream *zstream, git_zstream_t type);
 void git_zstream_free(git_zstream *zstream);
 
@@ -51,4 +53,21 @@ void git_zstream_reset(git_zstream *zstream);
 int git_zstream_deflatebuf(git_str *out, const void *in, size_t in_len);
 int git_zstream_inflatebuf(git_str *out, const void *in, size_t in_len);
 
+/*
+ * Inflate a complete zlib stream whose inflated size is known up front
+ * into `out`, in a single call.  This uses libdeflate when it is enabled.
+ * `in` may extend past the end of the compressed stream; on success,
+ * `in_used` (if not NULL) is set to the number of compressed bytes that
+ * were consumed.  Returns `GIT_EBUFS` if the stream could not be fully
+ * inflated from the given input (for example, because it is truncated
+ * or does not inflate to exactly `out_len` bytes), in which case callers
+ * should fall back to streaming inflation.
+ */
+int git_zstream_inflate_oneshot(
+	void *out,
+	size_t out_len,
+	size_t *in_used,
+	const void *in,
+	size_t in_len);
+
 #endif
@@ -424,3 +424,79 @@ void test_attr_repo__unlink(void)
 	cl_git_pass(git_attr_get(&value, g_repo, 0, "file.txt", "foo"));
 	cl_assert_equal_p(value, NULL);
 }
+
+void test_attr_repo__many_rules(void)
+{
+	git_str contents = GIT_STR_INIT;
+	const char *value;
+	int i;
+
+	for (i = 0; i < 32; i++)
+		cl_git_pass(git_str_printf(&contents, "padding%d.dat pad=%d\n", i, i));
+
+	cl_git_pass(git_str_puts(&contents,
+		"* foo=default\n"
+		"*.txt foo=text\n"
+		"docs/*.txt foo=docs\n"
+		"README.txt foo=readme\n"));
+	cl_git_rewritefile("attr/.gitattributes", contents.ptr);
+
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "file.bin", "foo"));
+	cl_assert_equal_s(value, "default");
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "dir/file.txt", "foo"));
+	cl_assert_equal_s(value, "text");
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "docs/file.txt", "foo"));
+	cl_assert_equal_s(value, "docs");
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "docs/README.txt", "foo"));
+	cl_assert_equal_s(value, "readme");
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "padding3.dat", "pad"));
+	cl_assert_equal_s(value, "3");
+	cl_git_pass(git_attr_get(&value, g_repo, 0, "padding3.dat", "foo"));
+	cl_assert_equal_s(value, "default");
+
+	git_str_dispose(&contents);
+}
+
+void test_attr_repo__session_reuses_directory_lookups(void)
+{
+	const char *values[2], *attrs[2] = { "cachedattr", "rootattr" };
+	git_attr_session session;
+
+	cl_git_pass(p_mkdir("attr/cached", 0777));
+	cl_git_rewritefile("attr/cached/.gitattributes", "*.txt cachedattr=first\n");
+
+	/* load the attribute file before the session begins */
+	cl_git_pass(git_attr_get(&values[0], g_repo, 0, "cached/a.txt", "cachedattr"));
+	cl_assert_equal_s(values[0], "first");
+
+	/* a file that was loaded before the session is checked for changes */
+	cl_git_rewritefile("attr/cached/.gitattributes", "*.txt cachedattr=second-value\n");
+
+	cl_git_pass(git_attr_session__init(&session, g_repo));
+
+	cl_git_pass(git_attr_get_many_with_session(values, g_repo, &session, NULL, "cached/a.txt", ARRAY_SIZE(attrs), attrs));
+	cl_assert_equal_s(values[0], "second-value");
+	cl_assert(GIT_ATTR_IS_TRUE(values[1]));
+
+	cl_git_pass(git_attr_get_many_with_session(values, g_repo, &session, NULL, "cached/b.bin", ARRAY_SIZE(attrs), attrs));
+	cl_assert_equal_p(values[0], NULL);
+	cl_assert(GIT_ATTR_IS_TRUE(values[1]));
+
+	/* but once it has been checked in the session, it is not again */
+	cl_git_rewritefile("attr/cached/.gitattributes", "*.txt cachedattr=third\n");
+
+	cl_git_pass(git_attr_get_many_with_session(values, g_repo, &session, NULL, "cached/c.txt", ARRAY_SIZE(attrs), attrs));
+	cl_assert_equal_s(values[0], "second-value");
+
+	/* lookups in other directories still see their own files */
+	cl_git_pass(git_attr_get_many_with_session(values, g_repo, &session, NULL, "root_test2", ARRAY_SIZE(attrs), attrs));
+	cl_assert_equal_p(values[0], NULL);
+	cl_assert(GIT_ATTR_IS_FALSE(values[1]));
+
+	git_attr_session__free(&session);
+
+	cl_git_pass(git_attr_session__init(&session, g_repo));
+	cl_git_pass(git_attr_get_many_with_session(values, g_repo, &session, NULL, "cached/c.txt", ARRAY_SIZE(attrs), attrs));
+	cl_assert_equal_s(values[0], "third");
+	git_attr_session__free(&session);
+}
@@ -1,6 +1,7 @@
 #include "clar_libgit2.h"
 
 #include "config_backend.h"
+#include "fs_path.h"
 
 static git_config *cfg;
 static git_config *snapshot;
@@ -176,3 +177,163 @@ void test_config_snapshot__snapshot_from_in_memory(void)
 
 	git_config_entry_free(entry);
 }
+
+static void set_mtime_wayback(const char *path)
+{
+	struct p_timeval times[2];
+
+	times[0].tv_sec = 1234567890;
+	times[0].tv_usec = 0;
+	times[1].tv_sec = 1234567890;
+	times[1].tv_usec = 0;
+
+	cl_must_pass(p_utimes(path, times));
+}
+
+void test_config_snapshot__shares_unchanged_files(void)
+{
+	git_config *other, *other_snapshot;
+	git_config_entry *entry, *other_entry, *snapshot_entry;
+	git_str path = GIT_STR_INIT;
+	int32_t i;
+
+	cl_git_mkfile("shared", "[core]\nvalue = 1\n");
+	set_mtime_wayback("shared");
+	cl_git_pass(git_fs_path_prettify(&path, "shared", NULL));
+
+	cl_git_pass(git_config_open_ondisk(&cfg, path.ptr));
+	cl_git_pass(git_config_open_ondisk(&other, path.ptr));
+	cl_git_pass(git_config_snapshot(&snapshot, cfg));
+	cl_git_pass(git_config_snapshot(&other_snapshot, snapshot));
+
+	/* Both configurations and the snapshots share the parsed entries */
+	cl_git_pass(git_config_get_entry(&entry, cfg, "core.value"));
+	cl_git_pass(git_config_get_entry(&other_entry, other, "core.value"));
+	cl_git_pass(git_config_get_entry(&snapshot_entry, other_snapshot, "core.value"));
+	cl_assert_equal_p(entry, other_entry);
+	cl_assert_equal_p(entry, snapshot_entry);
+	git_config_entry_free(entry);
+	git_config_entry_free(other_entry);
+	git_config_entry_free(snapshot_entry);
+	git_config_free(other);
+
+	/* Rewrite the file with contents of the same size */
+	cl_git_mkfile("shared", "[core]\nvalue = 2\n");
+
+	cl_git_pass(git_config_open_ondisk(&other, path.ptr));
+	cl_git_pass(git_config_get_int32(&i, other, "core.value"));
+	cl_assert_equal_i(2, i);
+	cl_git_pass(git_config_get_int32(&i, cfg, "core.value"));
+	cl_assert_equal_i(2, i);
+	cl_git_pass(git_config_get_int32(&i, other_snapshot, "core.value"));
+	cl_assert_equal_i(1, i);
+
+	git_config_free(other_snapshot);
+	git_config_free(other);
+	git_str_dispose(&path);
+	cl_git_pass(p_unlink("shared"));
+}
+
+void test_config_snapshot__does_not_share_conditional_includes(void)
+{
+	git_config *other;
+	git_config_entry *entry, *other_entry;
+	git_str path = GIT_STR_INIT;
+
+	cl_git_mkfile("conditional", "[core]\nvalue = 1\n[includeIf \"gitdir:/nonexistent/\"]\npath = other\n");
+	set_mtime_wayback("conditional");
+	cl_git_pass(git_fs_path_prettify(&path, "conditional", NULL));
+
+	cl_git_pass(git_config_open_ondisk(&cfg, path.ptr));
+	cl_git_pass(git_config_open_ondisk(&other, path.ptr));
+
+	cl_git_pass(git_config_get_entry(&entry, cfg, "core.value"));
+	cl_git_pass(git_config_get_entry(&other_entry, other, "core.value"));
+	cl_assert(entry != other_entry);
+	git_config_entry_free(entry);
+	git_config_entry_free(other_entry);
+
+	git_config_free(other);
+	git_str_dispose(&path);
+	cl_git_pass(p_unlink("conditional"));
+}
+
+static int collect_values(const git_config_entry *entry, void *payload)
+{
+	git_str *out = payload;
+
+	return git_str_printf(out, "%s=%s;", entry->name, entry->value);
+}
+
+void test_config_snapshot__multivars_and_globs_across_levels(void)
+{
+	git_str values = GIT_STR_INIT;
+	git_config_entry *entry;
+
+	cl_git_mkfile("global", "[remote \"origin\"]\nfetch = a\n[core]\nvalue = global\n");
+	cl_git_mkfile("local", "[remote \"origin\"]\nfetch = b\nFetch = c\n[core]\nvalue = local\n");
+
+	cl_git_pass(git_config_new(&cfg));
+	cl_git_pass(git_config_add_file_ondisk(cfg, "global", GIT_CONFIG_LEVEL_GLOBAL, NULL, 0));
+	cl_git_pass(git_config_add_file_ondisk(cfg, "local", GIT_CONFIG_LEVEL_LOCAL, NULL, 0));
+	cl_git_pass(git_config_snapshot(&snapshot, cfg));
+
+	/* values come in order of increasing priority */
+	cl_git_pass(git_config_get_multivar_foreach(snapshot, "Remote.origin.FETCH", NULL, collect_values, &values));
+	cl_assert_equal_s("remote.origin.fetch=a;remote.origin.fetch=b;remote.origin.fetch=c;", values.ptr);
+
+	git_str_clear(&values);
+	cl_git_pass(git_config_get_multivar_foreach(snapshot, "remote.origin.fetch", "^[ac]$", collect_values, &values));
+	cl_assert_equal_s("remote.origin.fetch=a;remote.origin.fetch=c;", values.ptr);
+
+	cl_git_fail_with(GIT_ENOTFOUND,
+		git_config_get_multivar_foreach(snapshot, "remote.origin.push", NULL, collect_values, &values));
+
+	git_str_clear(&values);
+	cl_git_pass(git_config_foreach_match(snapshot, "^core\\.", collect_values, &values));
+	cl_assert_equal_s("core.value=global;core.value=local;", values.ptr);
+
+	/* single values resolve to the highest priority level */
+	cl_git_pass(git_config_get_entry(&entry, snapshot, "core.value"));
+	cl_assert_equal_s("local", entry->value);
+	cl_assert_equal_i(GIT_CONFIG_LEVEL_LOCAL, entry->level);
+	git_config_entry_free(entry);
+
+	cl_git_fail_with(GIT_ENOTFOUND, git_config_get_entry(&entry, snapshot, "core.missing"));
+
+	git_str_dispose(&values);
+	cl_git_pass(p_unlink("global"));
+	cl_git_pass(p_unlink("local"));
+}
+
+void test_config_snapshot__iterator_outlives_backend_changes(void)
+{
+	git_config_iterator *iter;
+	git_config_entry *entry;
+
+	cl_git_mkfile("local", "[remote \"origin\"]\nfetch = a\nfetch = b\n");
+	cl_git_mkfile("other", "[remote \"origin\"]\nfetch = c\n");
+
+	cl_git_pass(git_config_new(&cfg));
+	cl_git_pass(git_config_add_file_ondisk(cfg, "local", GIT_CONFIG_LEVEL_LOCAL, NULL, 0));
+	cl_git_pass(git_config_snapshot(&snapshot, cfg));
+
+	cl_git_pass(git_config_multivar_iterator_new(&iter, snapshot, "remote.origin.fetch", NULL));
+	cl_git_pass(git_config_next(&entry, iter));
+	cl_assert_equal_s("a", entry->value);
+
+	/* replacing the level frees the snapshot's backend for it */
+	cl_git_pass(git_config_add_file_ondisk(snapshot, "other", GIT_CONFIG_LEVEL_LOCAL, NULL, 1));
+
+	cl_git_pass(git_config_next(&entry, iter));
+	cl_assert_equal_s("b", entry->value);
+	cl_git_fail_with(GIT_ITEROVER, git_config_next(&entry, iter));
+	git_config_iterator_free(iter);
+
+	cl_git_pass(git_config_get_entry(&entry, snapshot, "remote.origin.fetch"));
+	cl_assert_equal_s("c", entry->value);
+	git_config_entry_free(entry);
+
+	cl_git_pass(p_unlink("local"));
+	cl_git_pass(p_unlink("other"));
+}
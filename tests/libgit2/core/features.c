@@ -190,6 +190,8 @@ void test_core_features__backends(void)
 
 #if defined(GIT_COMPRESSION_BUILTIN)
 	cl_assert_equal_s("builtin", compression);
+#elif defined(GIT_COMPRESSION_ZLIB_NG)
+	cl_assert_equal_s("zlib-ng", compression);
 #elif defined(GIT_COMPRESSION_ZLIB)
 	cl_assert_equal_s("zlib", compression);
 #else
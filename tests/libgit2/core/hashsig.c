@@ -1,5 +1,5 @@
 #include "clar_libgit2.h"
-#include "git2/sys/hashsig.h"
+#include "hashsig.h"
 #include "futils.h"
 
 #define SIMILARITY_TEST_DATA_1 \
@@ -180,3 +180,59 @@ void test_core_hashsig__similarity_metric_whitespace(void)
 
 	git_str_dispose(&buf);
 }
+
+static void create_numbered_sig(git_hashsig **out, int first, int count)
+{
+	git_str buf = GIT_STR_INIT;
+	int i;
+
+	for (i = first; i < first + count; i++)
+		cl_git_pass(git_str_printf(&buf, "line %d\n", i));
+
+	cl_git_pass(git_hashsig_create(out, buf.ptr, buf.size, GIT_HASHSIG_ALLOW_SMALL_FILES));
+	git_str_dispose(&buf);
+}
+
+void test_core_hashsig__index_matches_compare(void)
+{
+	/* first line and line count; some overflow the heaps, one is empty */
+	static const int files[][2] = {
+		{ 0, 50 }, { 10, 50 }, { 25, 50 }, { 40, 20 }, { 100, 5 },
+		{ 0, 0 }, { 0, 400 }, { 50, 400 }, { 200, 400 }, { 0, 401 }
+	};
+	static const int thresholds[] = { 1, 50, 90, 100 };
+	git_hashsig *sigs[ARRAY_SIZE(files)];
+	git_hashsig_index *index;
+	const size_t *found;
+	size_t i, j, k, found_len, expected_len;
+
+	for (i = 0; i < ARRAY_SIZE(files); i++)
+		create_numbered_sig(&sigs[i], files[i][0], files[i][1]);
+
+	cl_git_pass(git_hashsig_index_new(&index));
+
+	for (i = 0; i < ARRAY_SIZE(files); i++)
+		cl_git_pass(git_hashsig_index_add(index, sigs[i], i * 10));
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		for (k = 0; k < ARRAY_SIZE(thresholds); k++) {
+			cl_git_pass(git_hashsig_index_lookup(&found, &found_len,
+				index, sigs[i], thresholds[k]));
+
+			for (j = 0, expected_len = 0; j < ARRAY_SIZE(files); j++) {
+				if (git_hashsig_compare(sigs[j], sigs[i]) < thresholds[k])
+					continue;
+
+				cl_assert(expected_len < found_len);
+				cl_assert_equal_sz(j * 10, found[expected_len++]);
+			}
+
+			cl_assert_equal_sz(expected_len, found_len);
+		}
+	}
+
+	git_hashsig_index_free(index);
+
+	for (i = 0; i < ARRAY_SIZE(files); i++)
+		git_hashsig_free(sigs[i]);
+}
@@ -19,3 +19,97 @@ void test_delta_apply__read_after_limit(void)
 
 	cl_git_fail(git_delta_apply(&out, &outlen, base, sizeof(base), delta, sizeof(delta)));
 }
+
+struct delta_reader {
+	const unsigned char *data;
+	size_t len;
+	size_t pos;
+	size_t max_read;
+};
+
+static ssize_t delta_reader_cb(void *buf, size_t len, void *payload)
+{
+	struct delta_reader *reader = payload;
+	size_t chunk = min(min(len, reader->len - reader->pos), reader->max_read);
+
+	memcpy(buf, reader->data + reader->pos, chunk);
+	reader->pos += chunk;
+
+	return (ssize_t)chunk;
+}
+
+static int stream_apply(
+	git_str *out,
+	const unsigned char *base,
+	size_t base_len,
+	const unsigned char *delta,
+	size_t delta_len,
+	size_t blocksize)
+{
+	struct delta_reader reader = { 0 };
+	git_delta_stream stream;
+	char buf[64];
+	ssize_t ret;
+	int error;
+
+	reader.data = delta;
+	reader.len = delta_len;
+	reader.max_read = blocksize;
+
+	if ((error = git_delta_stream_init(&stream, base, base_len, delta_reader_cb, &reader)) < 0)
+		return error;
+
+	while ((ret = git_delta_stream_read(&stream, buf, min(blocksize, sizeof(buf)))) > 0)
+		cl_git_pass(git_str_put(out, buf, ret));
+
+	if (ret == 0)
+		cl_assert_equal_i(stream.res_len, out->size);
+
+	return (int)ret;
+}
+
+void test_delta_apply__stream(void)
+{
+	const unsigned char base[] = "0123456789abcdef";
+	const unsigned char delta[] = {
+		0x10, 0x0e,                   /* base size 16, result size 14 */
+		0x91, 0x0a, 0x06,             /* copy 6 bytes at offset 10 */
+		0x04, 'w', 'x', 'y', 'z',     /* insert 4 bytes */
+		0x90, 0x04                    /* copy 4 bytes at offset 0 */
+	};
+	size_t blocksizes[] = { 1, 3, 64 };
+	git_str out = GIT_STR_INIT;
+	void *expected;
+	size_t expected_len, i;
+
+	cl_git_pass(git_delta_apply(&expected, &expected_len, base, 16, delta, sizeof(delta)));
+	cl_assert_equal_strn("abcdefwxyz0123", expected, expected_len);
+
+	for (i = 0; i < ARRAY_SIZE(blocksizes); i++) {
+		cl_git_pass(stream_apply(&out, base, 16, delta, sizeof(delta), blocksizes[i]));
+		cl_assert_equal_strn(expected, out.ptr, expected_len);
+		git_str_clear(&out);
+	}
+
+	git__free(expected);
+	git_str_dispose(&out);
+}
+
+void test_delta_apply__stream_fails_on_bad_deltas(void)
+{
+	unsigned char base[16] = { 0 };
+	unsigned char read_at_off[] = { 0x10, 0x10, 0xff, 0xff, 0xff, 0xff, 0xff, 0x10, 0x00, 0x00 };
+	unsigned char read_after_limit[] = { 0x10, 0x70, 0xff };
+	unsigned char bad_base_size[] = { 0x11, 0x01, 0x01, 'a' };
+	unsigned char truncated[] = { 0x10, 0x04, 0x04, 'a', 'b' };
+	unsigned char trailing[] = { 0x10, 0x01, 0x01, 'a', 0x01, 'b' };
+	git_str out = GIT_STR_INIT;
+
+	cl_git_fail(stream_apply(&out, base, sizeof(base), read_at_off, sizeof(read_at_off), 64));
+	cl_git_fail(stream_apply(&out, base, sizeof(base), read_after_limit, sizeof(read_after_limit), 64));
+	cl_git_fail(stream_apply(&out, base, sizeof(base), bad_base_size, sizeof(bad_base_size), 64));
+	cl_git_fail(stream_apply(&out, base, sizeof(base), truncated, sizeof(truncated), 64));
+	cl_git_fail(stream_apply(&out, base, sizeof(base), trailing, sizeof(trailing), 64));
+
+	git_str_dispose(&out);
+}
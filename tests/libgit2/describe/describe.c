@@ -1,5 +1,6 @@
 #include "clar_libgit2.h"
 #include "describe_helpers.h"
+#include "describe.h"
 
 void test_describe_describe__can_describe_against_a_bare_repo(void)
 {
@@ -53,3 +54,83 @@ void test_describe_describe__describe_a_repo_with_no_refs(void)
 	git_str_dispose(&buf);
 	cl_git_sandbox_cleanup();
 }
+
+void test_describe_describe__follows_tags_that_move(void)
+{
+	git_repository *repo;
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+	git_describe_format_options fmt_opts = GIT_DESCRIBE_FORMAT_OPTIONS_INIT;
+	git_signature *tagger;
+	git_object *target;
+	git_oid tag_id;
+
+	repo = cl_git_sandbox_init("testrepo.git");
+	opts.show_commit_oid_as_fallback = 1;
+
+	cl_git_pass(git_signature_new(&tagger, "tagger", "tagger@libgit2.org", 1380553019, 0));
+
+	/* describe twice, so that the second is answered by peeled tags */
+	assert_describe("be3563a*", "HEAD^", repo, &opts, &fmt_opts);
+	assert_describe("be3563a*", "HEAD^", repo, &opts, &fmt_opts);
+
+	cl_git_pass(git_revparse_single(&target, repo, "HEAD~2"));
+	cl_git_pass(git_tag_create(&tag_id, repo, "moving", target, tagger, "moving", 0));
+	git_object_free(target);
+
+	assert_describe("moving-*", "HEAD^", repo, &opts, &fmt_opts);
+	assert_describe("moving-*", "HEAD^", repo, &opts, &fmt_opts);
+
+	cl_git_pass(git_revparse_single(&target, repo, "HEAD^"));
+	cl_git_pass(git_tag_create(&tag_id, repo, "moving", target, tagger, "moved", 1));
+	git_object_free(target);
+
+	assert_describe("moving", "HEAD^", repo, &opts, &fmt_opts);
+
+	cl_git_pass(git_tag_delete(repo, "moving"));
+
+	assert_describe("be3563a*", "HEAD^", repo, &opts, &fmt_opts);
+
+	git_signature_free(tagger);
+	cl_git_sandbox_cleanup();
+}
+
+void test_describe_describe__walk_is_bounded_by_generation(void)
+{
+	git_repository *repo;
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+	git_describe_format_options fmt_opts = GIT_DESCRIBE_FORMAT_OPTIONS_INIT;
+	git_describe_result *result;
+	git_revwalk *walk;
+	git_object *object;
+	git_commit_list_node *parent, *grandparent;
+	git_oid parent_id, grandparent_id;
+	git_buf buf = GIT_BUF_INIT;
+
+	/* testrepo.git has a commit-graph; hard_tag names a65fedf */
+	cl_git_pass(git_repository_open(&repo, cl_fixture("testrepo.git")));
+	cl_git_pass(git_revwalk_new(&walk, repo));
+	cl_git_pass(git_revparse_single(&object, repo, "763d71aadf09a7951596c9746c024e7eece7c7af"));
+
+	cl_git_pass(git_oid_from_string(&parent_id, "c47800c7266a2be04c571c04d5a6614691ea99bd", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&grandparent_id, "5b5b025afb0b4c913b4c338a42934a3863bf3644", GIT_OID_SHA1));
+
+	opts.describe_strategy = GIT_DESCRIBE_TAGS;
+	opts.pattern = "hard*";
+	opts.show_commit_oid_as_fallback = 1;
+
+	cl_git_pass(git_describe__commit(&result, walk, object, &opts));
+	cl_git_pass(git_describe_format(&buf, result, &fmt_opts));
+	cl_assert_equal_s("763d71a", buf.ptr);
+
+	/* the walk stops once it is below the named commit's generation */
+	cl_assert((parent = git_revwalk__commit_lookup(walk, &parent_id)) != NULL);
+	cl_assert(parent->parsed);
+	cl_assert((grandparent = git_revwalk__commit_lookup(walk, &grandparent_id)) != NULL);
+	cl_assert(!grandparent->parsed);
+
+	git_buf_dispose(&buf);
+	git_describe_result_free(result);
+	git_object_free(object);
+	git_revwalk_free(walk);
+	git_repository_free(repo);
+}
@@ -451,3 +451,115 @@ void test_diff_diffiter__checks_options_version(void)
 	cl_assert_equal_i(GIT_ERROR_INVALID, err->klass);
 }
 
+static void assert_threaded_patches_match(
+	git_repository *repo, git_tree *old_tree, uint32_t flags)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *diff;
+	git_buf expected = GIT_BUF_INIT, actual = GIT_BUF_INIT;
+
+	opts.flags = flags;
+
+	cl_git_pass(git_diff_tree_to_workdir_with_index(&diff, repo, old_tree, &opts));
+	cl_assert(git_diff_num_deltas(diff) > 1);
+	cl_git_pass(git_diff_to_buf(&expected, diff, GIT_DIFF_FORMAT_PATCH));
+	git_diff_free(diff);
+
+	opts.threads = 4;
+
+	cl_git_pass(git_diff_tree_to_workdir_with_index(&diff, repo, old_tree, &opts));
+	cl_git_pass(git_diff_to_buf(&actual, diff, GIT_DIFF_FORMAT_PATCH));
+	git_diff_free(diff);
+
+	cl_assert(expected.size > 0);
+	cl_assert_equal_s(expected.ptr, actual.ptr);
+
+	git_buf_dispose(&expected);
+	git_buf_dispose(&actual);
+}
+
+void test_diff_diffiter__threaded_patches_are_in_delta_order(void)
+{
+	git_repository *repo = cl_git_sandbox_init("status");
+	git_tree *empty;
+	git_oid empty_id;
+	git_treebuilder *builder;
+	git_str path = GIT_STR_INIT;
+	int i;
+
+	/* enough changes that the workers need to cycle through their window */
+	for (i = 0; i < 100; i++) {
+		git_str_clear(&path);
+		cl_git_pass(git_str_printf(&path, "status/generated_%03d.txt", i));
+		cl_git_mkfile(path.ptr, i % 2 ? "odd\ncontent\n" : "even\n");
+	}
+
+	assert_threaded_patches_match(repo, NULL,
+		GIT_DIFF_INCLUDE_UNTRACKED | GIT_DIFF_SHOW_UNTRACKED_CONTENT |
+		GIT_DIFF_RECURSE_UNTRACKED_DIRS);
+
+	cl_git_pass(git_treebuilder_new(&builder, repo, NULL));
+	cl_git_pass(git_treebuilder_write(&empty_id, builder));
+	cl_git_pass(git_tree_lookup(&empty, repo, &empty_id));
+
+	assert_threaded_patches_match(repo, empty, GIT_DIFF_SHOW_BINARY);
+
+	git_tree_free(empty);
+	git_treebuilder_free(builder);
+	git_str_dispose(&path);
+}
+
+static int stop_after_three_files(
+	const git_diff_delta *delta, float progress, void *payload)
+{
+	size_t *count = payload;
+
+	GIT_UNUSED(delta);
+	GIT_UNUSED(progress);
+
+	return (++(*count) == 3) ? -42 : 0;
+}
+
+void test_diff_diffiter__threaded_foreach_can_be_stopped(void)
+{
+	git_repository *repo = cl_git_sandbox_init("status");
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *diff;
+	size_t count = 0;
+
+	opts.flags = GIT_DIFF_INCLUDE_UNTRACKED | GIT_DIFF_SHOW_UNTRACKED_CONTENT;
+	opts.threads = 2;
+
+	cl_git_pass(git_diff_index_to_workdir(&diff, repo, NULL, &opts));
+	cl_assert(git_diff_num_deltas(diff) > 3);
+
+	cl_assert_equal_i(-42, git_diff_foreach(diff,
+		stop_after_three_files, NULL, NULL, NULL, &count));
+	cl_assert_equal_sz(3, count);
+
+	git_diff_free(diff);
+}
+
+void test_diff_diffiter__threaded_limits_thread_count(void)
+{
+	git_repository *repo = cl_git_sandbox_init("status");
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *diff;
+	git_buf expected = GIT_BUF_INIT, actual = GIT_BUF_INIT;
+
+	cl_git_pass(git_diff_index_to_workdir(&diff, repo, NULL, &opts));
+	cl_git_pass(git_diff_to_buf(&expected, diff, GIT_DIFF_FORMAT_PATCH));
+	git_diff_free(diff);
+
+	/* far more threads than deltas (or than we would ever start) */
+	opts.threads = UINT_MAX;
+
+	cl_git_pass(git_diff_index_to_workdir(&diff, repo, NULL, &opts));
+	cl_git_pass(git_diff_to_buf(&actual, diff, GIT_DIFF_FORMAT_PATCH));
+	git_diff_free(diff);
+
+	cl_assert_equal_s(expected.ptr, actual.ptr);
+
+	git_buf_dispose(&expected);
+	git_buf_dispose(&actual);
+}
@@ -701,3 +701,44 @@ void test_diff_patch__can_strip_bad_utf8(void)
 	git_patch_free(patch);
 	git_buf_dispose(&buf);
 }
+
+static void assert_patch_from_buffers(
+	const char *expected, const char *a, const char *b, uint32_t flags)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_patch *patch;
+	git_buf buf = GIT_BUF_INIT;
+
+	opts.flags = flags;
+
+	cl_git_pass(git_patch_from_buffers(&patch, a, strlen(a), NULL, b, strlen(b), NULL, &opts));
+	cl_git_pass(git_patch_to_buf(&buf, patch));
+
+	cl_assert_equal_s(expected, buf.ptr);
+
+	git_patch_free(patch);
+	git_buf_dispose(&buf);
+}
+
+#define ALGORITHMS_HEADER \
+	"diff --git a/file b/file\n" \
+	"index 5825ceb..bc8175c 100644\n" \
+	"--- a/file\n" \
+	"+++ b/file\n" \
+	"@@ -1,7 +1,7 @@\n"
+
+void test_diff_patch__diff_algorithms(void)
+{
+	const char *a = "c\nc\nc\nd\nb\nb\na\n";
+	const char *b = "c\na\nb\nd\nc\na\na\n";
+
+	assert_patch_from_buffers(ALGORITHMS_HEADER
+		" c\n-c\n-c\n-d\n-b\n+a\n b\n+d\n+c\n+a\n a\n",
+		a, b, 0);
+	assert_patch_from_buffers(ALGORITHMS_HEADER
+		" c\n-c\n-c\n-d\n-b\n-b\n+a\n+b\n+d\n+c\n+a\n a\n",
+		a, b, GIT_DIFF_HISTOGRAM);
+	assert_patch_from_buffers(ALGORITHMS_HEADER
+		" c\n-c\n-c\n+a\n+b\n d\n-b\n-b\n+c\n+a\n a\n",
+		a, b, GIT_DIFF_PATIENCE);
+}
@@ -1,5 +1,7 @@
 #include "clar_libgit2.h"
 #include "diff_helpers.h"
+#include "futils.h"
+#include "hashsig_cache.h"
 
 static git_repository *g_repo = NULL;
 
@@ -2078,3 +2080,292 @@ void test_diff_rename__break_rewrite(void)
 	git_tree_free(old_tree);
 	git_tree_free(new_tree);
 }
+
+#define MANY_RENAMES 40
+
+static git_tree *many_files_tree(const char *prefix, bool modify)
+{
+	git_treebuilder *builder;
+	git_str path = GIT_STR_INIT, content = GIT_STR_INIT;
+	git_oid blob_id, tree_id;
+	git_tree *tree;
+	int i, line;
+
+	cl_git_pass(git_treebuilder_new(&builder, g_repo, NULL));
+
+	for (i = 0; i < MANY_RENAMES; i++) {
+		git_str_clear(&content);
+
+		for (line = 0; line < 40; line++) {
+			if (modify && line == i % 40)
+				cl_git_pass(git_str_printf(&content, "changed line %d\n", line));
+			else
+				cl_git_pass(git_str_printf(&content, "file %d, line %d\n", i, line));
+		}
+
+		cl_git_pass(git_blob_create_from_buffer(&blob_id, g_repo, content.ptr, content.size));
+
+		git_str_clear(&path);
+		cl_git_pass(git_str_printf(&path, "%s%02d.txt", prefix, i));
+		cl_git_pass(git_treebuilder_insert(NULL, builder, path.ptr, &blob_id, GIT_FILEMODE_BLOB));
+	}
+
+	cl_git_pass(git_treebuilder_write(&tree_id, builder));
+	cl_git_pass(git_tree_lookup(&tree, g_repo, &tree_id));
+
+	git_treebuilder_free(builder);
+	git_str_dispose(&content);
+	git_str_dispose(&path);
+	return tree;
+}
+
+static void assert_many_renames(unsigned int threads)
+{
+	git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+	const git_diff_delta *delta;
+	size_t i;
+
+	old_tree = many_files_tree("old", false);
+	new_tree = many_files_tree("new", true);
+
+	diffopts.threads = threads;
+
+	/* far fewer than the number of sources that need to be examined */
+	opts.flags = GIT_DIFF_FIND_RENAMES;
+	opts.rename_limit = 2;
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, old_tree, new_tree, &diffopts));
+	cl_git_pass(git_diff_find_similar(diff, &opts));
+
+	cl_assert_equal_sz(MANY_RENAMES, git_diff_num_deltas(diff));
+
+	for (i = 0; i < MANY_RENAMES; i++) {
+		delta = git_diff_get_delta(diff, i);
+
+		cl_assert_equal_i(GIT_DELTA_RENAMED, delta->status);
+		cl_assert_equal_strn(delta->old_file.path + 3, delta->new_file.path + 3, 6);
+		cl_assert(delta->similarity >= 90 && delta->similarity < 100);
+	}
+
+	git_diff_free(diff);
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
+
+void test_diff_rename__many_sources_beyond_rename_limit(void)
+{
+	assert_many_renames(0);
+}
+
+void test_diff_rename__many_sources_with_threaded_signatures(void)
+{
+	assert_many_renames(4);
+}
+
+static void assert_many_renames_in_buf(git_buf *out)
+{
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+
+	old_tree = many_files_tree("old", false);
+	new_tree = many_files_tree("new", true);
+
+	opts.flags = GIT_DIFF_FIND_RENAMES;
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, old_tree, new_tree, NULL));
+	cl_git_pass(git_diff_find_similar(diff, &opts));
+	cl_git_pass(git_diff_to_buf(out, diff, GIT_DIFF_FORMAT_NAME_STATUS));
+
+	git_diff_free(diff);
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
+
+void test_diff_rename__signature_cache(void)
+{
+	git_buf uncached = GIT_BUF_INIT, cached = GIT_BUF_INIT;
+	git_hashsig_cache *hashsigs;
+	git_hashsig *sig, *expected;
+	git_str path = GIT_STR_INIT;
+	git_blob *blob;
+	git_tree *tree;
+	struct stat st;
+
+	assert_many_renames_in_buf(&uncached);
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "hashsigs"));
+	cl_assert(!git_fs_path_exists(path.ptr));
+
+	cl_repo_set_bool(g_repo, "core.hashsigCache", true);
+	g_repo = cl_git_sandbox_reopen();
+
+	assert_many_renames_in_buf(&cached);
+	cl_assert_equal_s(uncached.ptr, cached.ptr);
+
+	/* one signature for each side of each rename */
+	cl_must_pass(p_stat(path.ptr, &st));
+	cl_assert_equal_i(16 + (2 * MANY_RENAMES * (GIT_OID_SHA1_SIZE + 1028)), st.st_size);
+
+	/* the signatures are reused, rather than recalculated */
+	g_repo = cl_git_sandbox_reopen();
+
+	git_buf_dispose(&cached);
+	assert_many_renames_in_buf(&cached);
+	cl_assert_equal_s(uncached.ptr, cached.ptr);
+
+	cl_must_pass(p_stat(path.ptr, &st));
+	cl_assert_equal_i(16 + (2 * MANY_RENAMES * (GIT_OID_SHA1_SIZE + 1028)), st.st_size);
+
+	tree = many_files_tree("old", false);
+	cl_git_pass(git_blob_lookup(&blob, g_repo, git_tree_entry_id(git_tree_entry_byindex(tree, 0))));
+	cl_git_pass(git_hashsig_create(&expected, git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob),
+		GIT_HASHSIG_SMART_WHITESPACE | GIT_HASHSIG_ALLOW_SMALL_FILES));
+
+	cl_git_pass(git_repository__hashsig_cache(&hashsigs, g_repo));
+	cl_assert(hashsigs != NULL);
+	cl_git_pass(git_hashsig_cache_lookup(&sig, hashsigs, git_blob_id(blob),
+		GIT_HASHSIG_SMART_WHITESPACE | GIT_HASHSIG_ALLOW_SMALL_FILES));
+	cl_assert_equal_i(100, git_hashsig_compare(expected, sig));
+	cl_git_fail_with(GIT_ENOTFOUND, git_hashsig_cache_lookup(&sig, hashsigs,
+		git_blob_id(blob), GIT_HASHSIG_NORMAL));
+
+	git_hashsig_free(sig);
+	git_hashsig_free(expected);
+	git_blob_free(blob);
+	git_tree_free(tree);
+	git_str_dispose(&path);
+	git_buf_dispose(&cached);
+	git_buf_dispose(&uncached);
+}
+
+void test_diff_rename__exact_match_without_signature(void)
+{
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_index *index;
+	git_tree *tree;
+	git_diff *diff;
+	const git_diff_delta *delta;
+
+	tree = resolve_commit_oid_to_tree(g_repo, RENAME_MODIFICATION_COMMIT);
+
+	cl_git_pass(p_rename("renames/songof7cities.txt", "renames/newname.txt"));
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_remove_bypath(index, "songof7cities.txt"));
+	cl_git_pass(git_index_add_bypath(index, "newname.txt"));
+	cl_git_pass(git_index_write(index));
+
+	/* a change in the workdir makes the workdir the new side */
+	cl_git_append2file("renames/untimely.txt", "a new line\n");
+
+	cl_git_pass(git_diff_tree_to_workdir_with_index(&diff, g_repo, tree, NULL));
+	cl_assert_equal_i(3, git_diff_num_deltas(diff));
+
+	/* a target that is no longer a regular file has no signature */
+	cl_git_pass(p_unlink("renames/newname.txt"));
+	cl_git_pass(p_mkdir("renames/newname.txt", 0777));
+
+	opts.flags = GIT_DIFF_FIND_RENAMES;
+	cl_git_pass(git_diff_find_similar(diff, &opts));
+
+	/* but it is still renamed, because the ids match */
+	cl_assert_equal_i(2, git_diff_num_deltas(diff));
+	cl_assert((delta = git_diff_get_delta(diff, 0)) != NULL);
+	cl_assert_equal_i(GIT_DELTA_RENAMED, delta->status);
+	cl_assert_equal_i(100, delta->similarity);
+	cl_assert_equal_s("songof7cities.txt", delta->old_file.path);
+	cl_assert_equal_s("newname.txt", delta->new_file.path);
+
+	git_diff_free(diff);
+	git_index_free(index);
+	git_tree_free(tree);
+}
+
+#define SIGNATURE_CACHE_OPTS \
+	(GIT_HASHSIG_SMART_WHITESPACE | GIT_HASHSIG_ALLOW_SMALL_FILES)
+#define SIGNATURE_CACHE_SIZE(n) (16 + ((n) * (GIT_OID_SHA1_SIZE + 1028)))
+
+static git_hashsig *signature_cache_blob(git_oid *id, const char *content)
+{
+	git_hashsig *sig;
+
+	cl_git_pass(git_blob_create_from_buffer(id, g_repo, content, strlen(content)));
+	cl_git_pass(git_hashsig_create(&sig, content, strlen(content), SIGNATURE_CACHE_OPTS));
+	return sig;
+}
+
+static bool signature_cache_has(git_hashsig_cache *hashsigs, const git_oid *id)
+{
+	git_hashsig *sig;
+	int error;
+
+	if ((error = git_hashsig_cache_lookup(&sig, hashsigs, id, SIGNATURE_CACHE_OPTS)) == GIT_ENOTFOUND)
+		return false;
+
+	cl_git_pass(error);
+	git_hashsig_free(sig);
+	return true;
+}
+
+void test_diff_rename__signature_cache_generations(void)
+{
+	git_hashsig_cache *hashsigs;
+	git_hashsig *one, *two, *three;
+	git_oid one_id, two_id, three_id;
+	git_str path = GIT_STR_INIT;
+	struct stat st;
+
+	cl_repo_set_bool(g_repo, "core.hashsigCache", true);
+	g_repo = cl_git_sandbox_reopen();
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "hashsigs"));
+
+	one = signature_cache_blob(&one_id, "one\ntwo\nthree\nfour\nfive\n");
+	two = signature_cache_blob(&two_id, "two\nthree\nfour\nfive\nsix\n");
+	three = signature_cache_blob(&three_id, "three\nfour\nfive\nsix\nseven\n");
+
+	/* signatures can be looked up before they're written */
+	cl_git_pass(git_repository__hashsig_cache(&hashsigs, g_repo));
+	cl_git_pass(git_hashsig_cache_add(hashsigs, &one_id, one));
+	cl_assert(signature_cache_has(hashsigs, &one_id));
+	cl_git_pass(git_hashsig_cache_add(hashsigs, &two_id, two));
+	cl_git_pass(git_hashsig_cache_write(hashsigs));
+
+	cl_must_pass(p_stat(path.ptr, &st));
+	cl_assert_equal_i(SIGNATURE_CACHE_SIZE(2), st.st_size);
+
+	/* a full cache only keeps the signatures that were used */
+	g_repo = cl_git_sandbox_reopen();
+	cl_git_pass(git_repository__hashsig_cache(&hashsigs, g_repo));
+	git_hashsig_cache__set_max_records(hashsigs, 2);
+
+	cl_assert(signature_cache_has(hashsigs, &one_id));
+	cl_git_pass(git_hashsig_cache_add(hashsigs, &three_id, three));
+	cl_git_pass(git_hashsig_cache_write(hashsigs));
+
+	cl_must_pass(p_stat(path.ptr, &st));
+	cl_assert_equal_i(SIGNATURE_CACHE_SIZE(2), st.st_size);
+	cl_assert(signature_cache_has(hashsigs, &one_id));
+	cl_assert(!signature_cache_has(hashsigs, &two_id));
+	cl_assert(signature_cache_has(hashsigs, &three_id));
+
+	/* and isn't rewritten when there's no room for new signatures */
+	g_repo = cl_git_sandbox_reopen();
+	cl_git_pass(git_repository__hashsig_cache(&hashsigs, g_repo));
+	git_hashsig_cache__set_max_records(hashsigs, 1);
+
+	cl_assert(signature_cache_has(hashsigs, &one_id));
+	cl_git_pass(git_hashsig_cache_add(hashsigs, &two_id, two));
+	cl_git_pass(git_hashsig_cache_write(hashsigs));
+
+	cl_must_pass(p_stat(path.ptr, &st));
+	cl_assert_equal_i(SIGNATURE_CACHE_SIZE(2), st.st_size);
+	cl_assert(signature_cache_has(hashsigs, &three_id));
+
+	git_hashsig_free(one);
+	git_hashsig_free(two);
+	git_hashsig_free(three);
+	git_str_dispose(&path);
+}
@@ -397,3 +397,63 @@ void test_diff_stats__new_file(void)
 	git_buf_dispose(&buf);
 	git_diff_free(diff);
 }
+
+static void diff_stats_between_trees(
+	git_diff_stats **stats,
+	const char *old_spec,
+	const char *new_spec,
+	unsigned int threads)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_object *old_tree = NULL, *new_tree;
+	git_diff *diff;
+
+	opts.threads = threads;
+
+	if (old_spec)
+		cl_git_pass(git_revparse_single(&old_tree, _repo, old_spec));
+	cl_git_pass(git_revparse_single(&new_tree, _repo, new_spec));
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, _repo,
+		(git_tree *)old_tree, (git_tree *)new_tree, &opts));
+	cl_git_pass(git_diff_get_stats(stats, diff));
+
+	git_diff_free(diff);
+	git_object_free(new_tree);
+	git_object_free(old_tree);
+}
+
+void test_diff_stats__threaded(void)
+{
+	git_diff_stats *expected;
+	git_buf expected_buf = GIT_BUF_INIT, buf = GIT_BUF_INIT;
+	const char *stat =
+	" file2.txt | 5 +++--\n" \
+	" file3.txt | 6 ++++--\n" \
+	" 2 files changed, 7 insertions(+), 4 deletions(-)\n";
+
+	diff_stats_between_trees(&_stats,
+		"cd471f0d8770371e1bc78bcbb38db4c7e4106bd2~1^{tree}",
+		"cd471f0d8770371e1bc78bcbb38db4c7e4106bd2^{tree}", 4);
+
+	cl_git_pass(git_diff_stats_to_buf(&buf, _stats, GIT_DIFF_STATS_FULL, 0));
+	cl_assert_equal_s(stat, buf.ptr);
+	git_buf_dispose(&buf);
+	git_diff_stats_free(_stats);
+
+	diff_stats_between_trees(&expected, NULL, "HEAD^{tree}", 0);
+	diff_stats_between_trees(&_stats, NULL, "HEAD^{tree}", 4);
+
+	cl_assert(git_diff_stats_files_changed(_stats) > 1);
+	cl_assert_equal_sz(git_diff_stats_files_changed(expected), git_diff_stats_files_changed(_stats));
+	cl_assert_equal_sz(git_diff_stats_insertions(expected), git_diff_stats_insertions(_stats));
+	cl_assert_equal_sz(git_diff_stats_deletions(expected), git_diff_stats_deletions(_stats));
+
+	cl_git_pass(git_diff_stats_to_buf(&expected_buf, expected, GIT_DIFF_STATS_FULL, 80));
+	cl_git_pass(git_diff_stats_to_buf(&buf, _stats, GIT_DIFF_STATS_FULL, 80));
+	cl_assert_equal_s(expected_buf.ptr, buf.ptr);
+
+	git_buf_dispose(&expected_buf);
+	git_buf_dispose(&buf);
+	git_diff_stats_free(expected);
+}
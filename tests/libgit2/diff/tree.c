@@ -573,3 +573,155 @@ void test_diff_tree__diff_tree_with_empty_dir_entry_succeeds(void)
 	git_treebuilder_free(builder);
 	git_buf_dispose(&patch);
 }
+
+static int iterate_progress(
+	const git_diff *diff_so_far,
+	const char *old_path,
+	const char *new_path,
+	void *payload)
+{
+	GIT_UNUSED(diff_so_far);
+	GIT_UNUSED(old_path);
+	GIT_UNUSED(new_path);
+	GIT_UNUSED(payload);
+	return 0;
+}
+
+static void assert_same_as_iterators(
+	git_tree *old_tree, git_tree *new_tree, git_diff_options *o)
+{
+	git_diff *simple, *iterated;
+	git_buf simple_buf = GIT_BUF_INIT, iterated_buf = GIT_BUF_INIT;
+
+	/* a progress callback requires the generic iterator-based diff */
+	cl_git_pass(git_diff_tree_to_tree(&simple, g_repo, old_tree, new_tree, o));
+	o->progress_cb = iterate_progress;
+	cl_git_pass(git_diff_tree_to_tree(&iterated, g_repo, old_tree, new_tree, o));
+	o->progress_cb = NULL;
+
+	cl_git_pass(git_diff_to_buf(&simple_buf, simple, GIT_DIFF_FORMAT_RAW));
+	cl_git_pass(git_diff_to_buf(&iterated_buf, iterated, GIT_DIFF_FORMAT_RAW));
+	cl_assert_equal_s(iterated_buf.ptr, simple_buf.ptr);
+
+	git_buf_dispose(&simple_buf);
+	git_buf_dispose(&iterated_buf);
+
+	cl_git_pass(git_diff_to_buf(&simple_buf, simple, GIT_DIFF_FORMAT_PATCH));
+	cl_git_pass(git_diff_to_buf(&iterated_buf, iterated, GIT_DIFF_FORMAT_PATCH));
+	cl_assert_equal_s(iterated_buf.ptr, simple_buf.ptr);
+
+	git_buf_dispose(&simple_buf);
+	git_buf_dispose(&iterated_buf);
+	git_diff_free(simple);
+	git_diff_free(iterated);
+}
+
+static void assert_history_same_as_iterators(const char *sandbox)
+{
+	char *pathspecs[] = { "*.txt", "sub" };
+	uint32_t flags[] = { 0, GIT_DIFF_REVERSE, GIT_DIFF_INCLUDE_TYPECHANGE,
+		GIT_DIFF_IGNORE_SUBMODULES };
+	git_revwalk *walk;
+	git_commit *commit;
+	git_tree *prev = NULL, *tree;
+	git_oid id;
+	size_t i;
+
+	g_repo = cl_git_sandbox_init(sandbox);
+
+	cl_git_pass(git_revwalk_new(&walk, g_repo));
+	cl_git_pass(git_revwalk_push_glob(walk, "refs/*"));
+	git_revwalk_sorting(walk, GIT_SORT_TIME);
+
+	while (git_revwalk_next(&id, walk) == 0) {
+		cl_git_pass(git_commit_lookup(&commit, g_repo, &id));
+		cl_git_pass(git_commit_tree(&tree, commit));
+		git_commit_free(commit);
+
+		for (i = 0; i < ARRAY_SIZE(flags); i++) {
+			opts.flags = flags[i];
+			assert_same_as_iterators(prev, tree, &opts);
+			assert_same_as_iterators(tree, prev, &opts);
+		}
+
+		opts.flags = 0;
+		opts.pathspec.strings = pathspecs;
+		opts.pathspec.count = ARRAY_SIZE(pathspecs);
+		assert_same_as_iterators(prev, tree, &opts);
+		opts.pathspec.count = 0;
+
+		git_tree_free(prev);
+		prev = tree;
+	}
+
+	git_tree_free(prev);
+	git_revwalk_free(walk);
+}
+
+void test_diff_tree__matches_iterator_diff_across_history(void)
+{
+	assert_history_same_as_iterators("attr");
+}
+
+void test_diff_tree__matches_iterator_diff_with_typechanges(void)
+{
+	assert_history_same_as_iterators("typechanges");
+}
+
+void test_diff_tree__matches_iterator_diff_with_submodules(void)
+{
+	assert_history_same_as_iterators("submod2");
+}
+
+static void build_tree(
+	git_tree **out,
+	const char *content,
+	const char *missing_tree)
+{
+	git_treebuilder *builder;
+	git_oid blob, subtree, missing, tree;
+
+	cl_git_pass(git_blob_create_from_buffer(&blob, g_repo, content, strlen(content)));
+
+	cl_git_pass(git_treebuilder_new(&builder, g_repo, NULL));
+	cl_git_pass(git_treebuilder_insert(NULL, builder, "file.txt", &blob, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(&subtree, builder));
+	git_treebuilder_free(builder);
+
+	cl_git_pass(git_oid_from_string(&missing, missing_tree, GIT_OID_SHA1));
+
+	cl_git_pass(git_treebuilder_new(&builder, g_repo, NULL));
+	cl_git_pass(git_treebuilder_insert(NULL, builder, "dir", &subtree, GIT_FILEMODE_TREE));
+	cl_git_pass(git_treebuilder_insert(NULL, builder, "missing", &missing, GIT_FILEMODE_TREE));
+	cl_git_pass(git_treebuilder_write(&tree, builder));
+	git_treebuilder_free(builder);
+
+	cl_git_pass(git_tree_lookup(out, g_repo, &tree));
+}
+
+void test_diff_tree__pathspec_skips_unmatched_trees(void)
+{
+	char *pathspecs[] = { "dir/*.txt" };
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+
+	/* the trees outside of the pathspec don't exist and can't be read */
+	cl_git_pass(git_libgit2_opts(GIT_OPT_ENABLE_STRICT_OBJECT_CREATION, 0));
+	build_tree(&a, "one\n", "1111111111111111111111111111111111111111");
+	build_tree(&b, "two\n", "2222222222222222222222222222222222222222");
+	cl_git_pass(git_libgit2_opts(GIT_OPT_ENABLE_STRICT_OBJECT_CREATION, 1));
+
+	cl_git_fail(git_diff_tree_to_tree(&diff, g_repo, a, b, &opts));
+
+	opts.pathspec.strings = pathspecs;
+	opts.pathspec.count = ARRAY_SIZE(pathspecs);
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, a, b, &opts));
+	cl_assert_equal_i(1, git_diff_num_deltas(diff));
+	cl_assert_equal_s("dir/file.txt", git_diff_get_delta(diff, 0)->new_file.path);
+	git_diff_free(diff);
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, NULL, b, &opts));
+	cl_assert_equal_i(1, git_diff_num_deltas(diff));
+	cl_assert_equal_s("dir/file.txt", git_diff_get_delta(diff, 0)->new_file.path);
+}
@@ -1,4 +1,5 @@
 #include "clar_libgit2.h"
+#include "oidarray.h"
 
 static git_repository *_repo;
 static git_commit *commit;
@@ -56,3 +57,58 @@ void test_graph_ahead_behind__returns_correct_result(void)
 
 	git_commit_free(other);
 }
+
+void test_graph_ahead_behind__many_matches_single(void)
+{
+	git_branch_iterator *iter;
+	git_branch_t type;
+	git_reference *ref;
+	git_array_oid_t branches = GIT_ARRAY_INIT;
+	git_oid *locals, *id;
+	size_t *aheads, *behinds;
+	size_t count, i, j;
+	int error;
+
+	cl_git_pass(git_branch_iterator_new(&iter, _repo, GIT_BRANCH_ALL));
+
+	while ((error = git_branch_next(&ref, &type, iter)) == 0) {
+		id = git_array_alloc(branches);
+		cl_assert(id);
+		git_oid_cpy(id, git_reference_target(ref));
+		git_reference_free(ref);
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	git_branch_iterator_free(iter);
+
+	/* enough local commits that they are compared in several batches */
+	count = 600;
+
+	locals = git__calloc(count, sizeof(git_oid));
+	aheads = git__calloc(count, sizeof(size_t));
+	behinds = git__calloc(count, sizeof(size_t));
+	cl_assert(locals && aheads && behinds);
+
+	for (i = 0; i < count; i++)
+		git_oid_cpy(&locals[i], git_array_get(branches, i % branches.size));
+
+	for (i = 0; i < branches.size; i++) {
+		const git_oid *upstream = git_array_get(branches, i);
+
+		cl_git_pass(git_graph_ahead_behind_many(aheads, behinds, _repo,
+			locals, count, upstream));
+
+		for (j = 0; j < count; j++) {
+			cl_git_pass(git_graph_ahead_behind(&ahead, &behind, _repo,
+				&locals[j], upstream));
+
+			cl_assert_equal_sz(ahead, aheads[j]);
+			cl_assert_equal_sz(behind, behinds[j]);
+		}
+	}
+
+	git__free(locals);
+	git__free(aheads);
+	git__free(behinds);
+	git_array_clear(branches);
+}
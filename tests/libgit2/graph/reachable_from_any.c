@@ -3,8 +3,10 @@
 #include <git2.h>
 
 #include "commit_graph.h"
+#include "graph.h"
 #include "bitvec.h"
 #include "vector.h"
+#include "oidarray.h"
 
 static git_repository *repo;
 
@@ -234,3 +236,90 @@ void test_graph_reachable_from_any__exhaustive(void)
 	git_vector_dispose(&mc.commits);
 	git_odb_free(mc.db);
 }
+
+/*
+ * Checks that `git_graph_reachable_from_each` agrees with asking
+ * `git_graph_reachable_from_any` about each of the tips on its own, for
+ * every commit that is reachable from a branch against every other.
+ */
+static void assert_reachable_from_each(git_repository *r)
+{
+	git_revwalk *walk;
+	git_array_oid_t commits = GIT_ARRAY_INIT;
+	git_oid id, *tip;
+	int *results;
+	size_t i, j;
+	int error;
+
+	cl_git_pass(git_revwalk_new(&walk, r));
+	cl_git_pass(git_revwalk_push_glob(walk, "refs/heads/*"));
+
+	while ((error = git_revwalk_next(&id, walk)) == 0) {
+		tip = git_array_alloc(commits);
+		cl_assert(tip);
+		git_oid_cpy(tip, &id);
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert(commits.size > 0);
+
+	results = git__calloc(commits.size, sizeof(int));
+	cl_assert(results);
+
+	for (i = 0; i < commits.size; i++) {
+		const git_oid *target = git_array_get(commits, i);
+
+		cl_git_pass(git_graph_reachable_from_each(results, r, target,
+			commits.ptr, commits.size));
+
+		for (j = 0; j < commits.size; j++)
+			cl_assert_equal_i(
+				git_graph_reachable_from_any(r, target, git_array_get(commits, j), 1),
+				results[j]);
+	}
+
+	git__free(results);
+	git_array_clear(commits);
+	git_revwalk_free(walk);
+}
+
+void test_graph_reachable_from_any__each(void)
+{
+	assert_reachable_from_each(repo);
+}
+
+void test_graph_reachable_from_any__each_with_commit_graph(void)
+{
+	git_repository *r;
+
+	/* testrepo.git has a commit-graph, so its walks are pruned */
+	cl_git_pass(git_repository_open(&r, cl_fixture("testrepo.git")));
+	assert_reachable_from_each(r);
+	git_repository_free(r);
+}
+
+void test_graph_reachable_from_any__each_is_bounded_by_generation(void)
+{
+	git_repository *r;
+	git_revwalk *walk;
+	git_commit_list_node *root;
+	git_oid target, tip, root_id;
+	int result;
+
+	cl_git_pass(git_repository_open(&r, cl_fixture("testrepo.git")));
+	cl_git_pass(git_revwalk_new(&walk, r));
+
+	cl_git_pass(git_oid_from_string(&target, "763d71aadf09a7951596c9746c024e7eece7c7af", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&tip, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&root_id, "8496071c1b46c854b31185ea97743be6a8774479", GIT_OID_SHA1));
+
+	cl_git_pass(git_graph__reachable_from_each(&result, walk, &target, &tip, 1));
+	cl_assert_equal_i(0, result);
+
+	/* the walk stops once it is below the target's generation */
+	cl_assert((root = git_revwalk__commit_lookup(walk, &root_id)) != NULL);
+	cl_assert(!root->parsed);
+
+	git_revwalk_free(walk);
+	git_repository_free(r);
+}
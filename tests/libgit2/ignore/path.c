@@ -587,3 +587,90 @@ void test_ignore_path__negative_more_specific(void)
 	assert_is_ignored(false, "dir/test.txt");
 	assert_is_ignored(true, "outer/dir/test.txt");
 }
+
+static void rewrite_with_padding(const char *path, const char *rules)
+{
+	git_str contents = GIT_STR_INIT;
+	int i;
+
+	/* enough unrelated rules for the file to be compiled into buckets */
+	for (i = 0; i < 32; i++)
+		cl_git_pass(git_str_printf(&contents, "padding%d.tmp\n", i));
+
+	cl_git_pass(git_str_puts(&contents, rules));
+	cl_git_rewritefile(path, contents.ptr);
+	git_str_dispose(&contents);
+}
+
+void test_ignore_path__many_rules(void)
+{
+	rewrite_with_padding("attr/.gitignore",
+		"build/\n"
+		"*.o\n"
+		"!keep.o\n"
+		"*.tar.gz\n"
+		"doc/*.html\n"
+		"Makefile.bak\n"
+		"**/logs\n"
+		"tmp*\n");
+
+	cl_must_pass(p_mkdir("attr/build", 0755));
+	cl_must_pass(p_mkdir("attr/sub/build", 0755));
+
+	assert_is_ignored(true, "padding7.tmp");
+	assert_is_ignored(true, "build");
+	assert_is_ignored(true, "build/file");
+	assert_is_ignored(true, "sub/build/file");
+	assert_is_ignored(false, "sub/build.c");
+
+	assert_is_ignored(true, "main.o");
+	assert_is_ignored(true, "sub/.o");
+	assert_is_ignored(false, "keep.o");
+	assert_is_ignored(false, "main.c");
+	assert_is_ignored(true, "release.tar.gz");
+	assert_is_ignored(false, "release.tar");
+
+	assert_is_ignored(true, "doc/index.html");
+	assert_is_ignored(false, "sub/doc/index.html");
+	assert_is_ignored(false, "index.html");
+
+	assert_is_ignored(true, "sub/Makefile.bak");
+	assert_is_ignored(false, "Makefile");
+	assert_is_ignored(true, "a/b/logs");
+	assert_is_ignored(true, "sub/tmpfile");
+}
+
+void test_ignore_path__many_rules_in_subdirectory(void)
+{
+	rewrite_with_padding("attr/sub/.gitignore",
+		"*.log\n"
+		"/only\n"
+		"deep/file\n");
+
+	assert_is_ignored(true, "sub/debug.log");
+	assert_is_ignored(false, "debug.log");
+	assert_is_ignored(true, "sub/only");
+	assert_is_ignored(false, "sub/deeper/only");
+	assert_is_ignored(false, "only");
+	assert_is_ignored(true, "sub/deep/file");
+	assert_is_ignored(false, "deep/file");
+}
+
+void test_ignore_path__many_rules_case_insensitive(void)
+{
+	git_config *cfg;
+
+	cl_git_pass(git_repository_config(&cfg, g_repo));
+	cl_git_pass(git_config_set_bool(cfg, "core.ignorecase", true));
+	git_config_free(cfg);
+
+	rewrite_with_padding("attr/.gitignore",
+		"*.JPG\n"
+		"ReadMe.bak\n"
+		"/Docs/*.pdf\n");
+
+	assert_is_ignored(true, "photo.jpg");
+	assert_is_ignored(true, "sub/README.BAK");
+	assert_is_ignored(true, "docs/manual.pdf");
+	assert_is_ignored(false, "sub/docs/manual.pdf");
+}
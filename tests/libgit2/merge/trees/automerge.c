@@ -1,6 +1,7 @@
 #include "clar_libgit2.h"
 #include "git2/repository.h"
 #include "git2/merge.h"
+#include "git2/sys/index.h"
 #include "merge.h"
 #include "futils.h"
 #include "../merge_helpers.h"
@@ -193,3 +194,118 @@ void test_merge_trees_automerge__unrelated(void)
 
 	git_index_free(index);
 }
+
+#define MANY_MERGES 30
+
+/*
+ * Every file is changed on our side; on their side, a third of the files
+ * merge automatically, a third conflict, and a third are unchanged.
+ */
+static void many_files_tree(git_oid *out, int side)
+{
+	git_treebuilder *builder;
+	git_str path = GIT_STR_INIT, content = GIT_STR_INIT;
+	git_oid blob_id;
+	int i, line;
+
+	cl_git_pass(git_treebuilder_new(&builder, repo, NULL));
+
+	for (i = 0; i < MANY_MERGES; i++) {
+		git_str_clear(&content);
+
+		for (line = 0; line < 20; line++) {
+			if (side == 1 && line == 2)
+				cl_git_pass(git_str_printf(&content, "ours %d\n", i));
+			else if (side == 2 && i % 3 == 0 && line == 17)
+				cl_git_pass(git_str_printf(&content, "theirs %d\n", i));
+			else if (side == 2 && i % 3 == 1 && line == 2)
+				cl_git_pass(git_str_printf(&content, "theirs %d\n", i));
+			else
+				cl_git_pass(git_str_printf(&content, "line %d of file %d\n", line, i));
+		}
+
+		cl_git_pass(git_blob_create_from_buffer(&blob_id, repo, content.ptr, content.size));
+
+		git_str_clear(&path);
+		cl_git_pass(git_str_printf(&path, "file%02d.txt", i));
+		cl_git_pass(git_treebuilder_insert(NULL, builder, path.ptr, &blob_id, GIT_FILEMODE_BLOB));
+	}
+
+	cl_git_pass(git_treebuilder_write(out, builder));
+
+	git_treebuilder_free(builder);
+	git_str_dispose(&content);
+	git_str_dispose(&path);
+}
+
+static git_index *merge_many_files(unsigned int threads)
+{
+	git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+	git_tree *trees[3];
+	git_oid tree_id;
+	git_index *index;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		many_files_tree(&tree_id, i);
+		cl_git_pass(git_tree_lookup(&trees[i], repo, &tree_id));
+	}
+
+	opts.threads = threads;
+	cl_git_pass(git_merge_trees(&index, repo, trees[0], trees[1], trees[2], &opts));
+
+	for (i = 0; i < 3; i++)
+		git_tree_free(trees[i]);
+
+	return index;
+}
+
+void test_merge_trees_automerge__threaded(void)
+{
+	git_index *expected, *actual;
+	const git_index_entry *a, *b;
+	const git_index_reuc_entry *reuc_a, *reuc_b;
+	git_blob *blob;
+	size_t i;
+
+	expected = merge_many_files(0);
+	actual = merge_many_files(4);
+
+	/* the resolved files, plus three stages of each conflict */
+	cl_assert_equal_sz(MANY_MERGES / 3 * 2 + MANY_MERGES / 3 * 3, git_index_entrycount(expected));
+	cl_assert_equal_sz(MANY_MERGES / 3, git_index_reuc_entrycount(expected));
+
+	cl_assert_equal_sz(git_index_entrycount(expected), git_index_entrycount(actual));
+	cl_assert_equal_sz(git_index_reuc_entrycount(expected), git_index_reuc_entrycount(actual));
+
+	for (i = 0; i < git_index_entrycount(expected); i++) {
+		a = git_index_get_byindex(expected, i);
+		b = git_index_get_byindex(actual, i);
+
+		cl_assert_equal_s(a->path, b->path);
+		cl_assert_equal_i(git_index_entry_stage(a), git_index_entry_stage(b));
+		cl_assert_equal_i(a->mode, b->mode);
+		cl_assert_equal_sz(a->file_size, b->file_size);
+		cl_assert_equal_oid(&a->id, &b->id);
+	}
+
+	for (i = 0; i < git_index_reuc_entrycount(expected); i++) {
+		reuc_a = git_index_reuc_get_byindex(expected, i);
+		reuc_b = git_index_reuc_get_byindex(actual, i);
+
+		cl_assert_equal_s(reuc_a->path, reuc_b->path);
+		cl_assert_equal_oid(&reuc_a->oid[0], &reuc_b->oid[0]);
+	}
+
+	cl_assert((a = git_index_get_bypath(actual, "file00.txt", 0)) != NULL);
+	cl_git_pass(git_blob_lookup(&blob, repo, &a->id));
+	cl_assert(strstr(git_blob_rawcontent(blob), "ours 0\n") != NULL);
+	cl_assert(strstr(git_blob_rawcontent(blob), "theirs 0\n") != NULL);
+	git_blob_free(blob);
+
+	cl_assert(git_index_get_bypath(actual, "file01.txt", 2) != NULL);
+	cl_assert(git_index_get_bypath(actual, "file01.txt", 3) != NULL);
+
+	git_index_free(expected);
+	git_index_free(actual);
+}
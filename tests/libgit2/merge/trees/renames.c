@@ -369,3 +369,21 @@ void test_merge_trees_renames__emptyfile_renames(void)
 	cl_assert(merge_test_index(index, merge_index_entries, 4));
 	git_index_free(index);
 }
+
+void test_merge_trees_renames__signature_cache(void)
+{
+	git_str path = GIT_STR_INIT;
+
+	cl_repo_set_bool(repo, "core.hashsigCache", true);
+	repo = cl_git_sandbox_reopen();
+
+	/* once to fill the cache, and once more to use it */
+	test_merge_trees_renames__index();
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(repo), "hashsigs"));
+	cl_assert(git_fs_path_isfile(path.ptr));
+
+	repo = cl_git_sandbox_reopen();
+	test_merge_trees_renames__index();
+
+	git_str_dispose(&path);
+}
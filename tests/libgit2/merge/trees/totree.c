@@ -0,0 +1,226 @@
+#include "clar_libgit2.h"
+#include "git2/repository.h"
+#include "git2/merge.h"
+#include "merge.h"
+#include "vector.h"
+#include "../merge_helpers.h"
+
+static git_repository *repo;
+
+#define TEST_REPO_PATH "merge-resolve"
+
+void test_merge_trees_totree__initialize(void)
+{
+	repo = cl_git_sandbox_init(TEST_REPO_PATH);
+}
+
+void test_merge_trees_totree__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+static void lookup_branch(git_commit **out, const char *name)
+{
+	git_str refname = GIT_STR_INIT;
+	git_oid id;
+
+	cl_git_pass(git_str_printf(&refname, "%s%s", GIT_REFS_HEADS_DIR, name));
+	cl_git_pass(git_reference_name_to_id(&id, repo, refname.ptr));
+	cl_git_pass(git_commit_lookup(out, repo, &id));
+
+	git_str_dispose(&refname);
+}
+
+/*
+ * Replaces the conflicts in the index with our side of them, and returns
+ * the (sorted) paths that were in conflict.
+ */
+static void take_our_side_of_conflicts(git_vector *paths, git_index *index)
+{
+	git_index_conflict_iterator *iter;
+	const git_index_entry *ancestor, *ours, *theirs;
+	git_vector our_entries = GIT_VECTOR_INIT;
+	git_index_entry *entry;
+	size_t i;
+	int error;
+
+	paths->_cmp = git__strcmp_cb;
+
+	cl_git_pass(git_index_conflict_iterator_new(&iter, index));
+
+	while ((error = git_index_conflict_next(&ancestor, &ours, &theirs, iter)) == 0) {
+		if (ancestor)
+			cl_git_pass(git_vector_insert(paths, git__strdup(ancestor->path)));
+
+		if (theirs)
+			cl_git_pass(git_vector_insert(paths, git__strdup(theirs->path)));
+
+		if (ours) {
+			cl_git_pass(git_vector_insert(paths, git__strdup(ours->path)));
+
+			entry = git__calloc(1, sizeof(git_index_entry));
+			cl_assert(entry);
+			memcpy(entry, ours, sizeof(git_index_entry));
+			entry->path = git__strdup(ours->path);
+			cl_git_pass(git_vector_insert(&our_entries, entry));
+		}
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	git_index_conflict_iterator_free(iter);
+
+	git_vector_sort(paths);
+	git_vector_uniq(paths, git__free);
+
+	cl_git_pass(git_index_conflict_cleanup(index));
+
+	git_vector_foreach(&our_entries, i, entry) {
+		GIT_INDEX_ENTRY_STAGE_SET(entry, 0);
+		cl_git_pass(git_index_add(index, entry));
+
+		git__free((char *)entry->path);
+		git__free(entry);
+	}
+
+	git_vector_dispose(&our_entries);
+}
+
+/*
+ * Merges the given branches both to an index and to a tree, and checks
+ * that they agree.
+ */
+static void assert_merge_to_tree(
+	const char *ours_name,
+	const char *theirs_name,
+	uint32_t flags)
+{
+	git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+	git_commit *ours, *theirs;
+	git_index *index;
+	git_oid expected_id, actual_id;
+	git_strarray conflicts;
+	git_vector expected_conflicts = GIT_VECTOR_INIT;
+	char *path;
+	size_t i;
+
+	opts.flags = flags;
+
+	lookup_branch(&ours, ours_name);
+	lookup_branch(&theirs, theirs_name);
+
+	cl_git_pass(git_merge_commits(&index, repo, ours, theirs, &opts));
+	take_our_side_of_conflicts(&expected_conflicts, index);
+	cl_git_pass(git_index_write_tree_to(&expected_id, index, repo));
+
+	cl_git_pass(git_merge_commits_to_tree(&actual_id, &conflicts, repo, ours, theirs, &opts));
+
+	cl_assert_equal_oid(&expected_id, &actual_id);
+	cl_assert_equal_sz(expected_conflicts.length, conflicts.count);
+
+	git_vector_foreach(&expected_conflicts, i, path) {
+		cl_assert_equal_s(path, conflicts.strings[i]);
+		git__free(path);
+	}
+
+	git_strarray_dispose(&conflicts);
+	git_vector_dispose(&expected_conflicts);
+	git_index_free(index);
+	git_commit_free(ours);
+	git_commit_free(theirs);
+}
+
+void test_merge_trees_totree__matches_index(void)
+{
+	static const char *branches[][2] = {
+		{ "master", "branch" },
+		{ "master", "unrelated" },
+		{ "master", "ff_branch" },
+		{ "df_side1", "df_side2" },
+		{ "df_side2", "df_side1" },
+		{ "renames1", "renames2" },
+		{ "rename_conflict_ours", "rename_conflict_theirs" },
+		{ "emptyfile_renames", "emptyfile_renames-branch" },
+		{ "submodules", "submodules-branch" },
+		{ "trivial-2alt", "trivial-2alt-branch" },
+		{ "trivial-5alt-1", "trivial-5alt-1-branch" },
+		{ "trivial-9", "trivial-9-branch" },
+		{ "trivial-14", "trivial-14-branch" },
+	};
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(branches); i++) {
+		assert_merge_to_tree(branches[i][0], branches[i][1], GIT_MERGE_FIND_RENAMES);
+		assert_merge_to_tree(branches[i][0], branches[i][1], 0);
+	}
+}
+
+void test_merge_trees_totree__trees(void)
+{
+	git_commit *ours, *theirs, *ancestor;
+	git_tree *ancestor_tree, *our_tree, *their_tree, *result;
+	git_oid ancestor_id, id;
+	git_strarray conflicts;
+	git_tree_entry *entry;
+
+	lookup_branch(&ours, "master");
+	lookup_branch(&theirs, "branch");
+
+	cl_git_pass(git_merge_base(&ancestor_id, repo, git_commit_id(ours), git_commit_id(theirs)));
+	cl_git_pass(git_commit_lookup(&ancestor, repo, &ancestor_id));
+
+	cl_git_pass(git_commit_tree(&ancestor_tree, ancestor));
+	cl_git_pass(git_commit_tree(&our_tree, ours));
+	cl_git_pass(git_commit_tree(&their_tree, theirs));
+
+	cl_git_pass(git_merge_trees_to_tree(&id, &conflicts, repo,
+		ancestor_tree, our_tree, their_tree, NULL));
+
+	cl_assert_equal_sz(1, conflicts.count);
+	cl_assert_equal_s("conflicting.txt", conflicts.strings[0]);
+	git_strarray_dispose(&conflicts);
+
+	cl_git_pass(git_tree_lookup(&result, repo, &id));
+
+	/* the automerged file, and our side of the conflicting one */
+	cl_git_pass(git_tree_entry_bypath(&entry, result, "automergeable.txt"));
+	cl_assert_equal_oidstr("f2e1550a0c9e53d5811175864a29536642ae3821", git_tree_entry_id(entry));
+	git_tree_entry_free(entry);
+
+	cl_git_pass(git_tree_entry_bypath(&entry, result, "conflicting.txt"));
+	cl_assert_equal_oidstr("4e886e602529caa9ab11d71f86634bd1b6e0de10", git_tree_entry_id(entry));
+	git_tree_entry_free(entry);
+
+	cl_assert_equal_i(GIT_ENOTFOUND, git_tree_entry_bypath(&entry, result, "removed-in-branch.txt"));
+
+	/* a side that is the same as the ancestor takes the other side */
+	cl_git_pass(git_merge_trees_to_tree(&id, &conflicts, repo,
+		ancestor_tree, ancestor_tree, their_tree, NULL));
+	cl_assert_equal_oid(git_tree_id(their_tree), &id);
+	cl_assert_equal_sz(0, conflicts.count);
+
+	git_tree_free(result);
+	git_tree_free(ancestor_tree);
+	git_tree_free(our_tree);
+	git_tree_free(their_tree);
+	git_commit_free(ancestor);
+	git_commit_free(ours);
+	git_commit_free(theirs);
+}
+
+void test_merge_trees_totree__fail_on_conflict(void)
+{
+	git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+	git_commit *ours, *theirs;
+	git_oid id;
+
+	opts.flags |= GIT_MERGE_FAIL_ON_CONFLICT;
+
+	lookup_branch(&ours, "master");
+	lookup_branch(&theirs, "branch");
+
+	cl_assert_equal_i(GIT_EMERGECONFLICT,
+		git_merge_commits_to_tree(&id, NULL, repo, ours, theirs, &opts));
+
+	git_commit_free(ours);
+	git_commit_free(theirs);
+}
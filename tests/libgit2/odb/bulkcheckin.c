@@ -0,0 +1,217 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "posix.h"
+
+static git_repository *_repo;
+static git_odb *_odb;
+
+void test_odb_bulkcheckin__initialize(void)
+{
+	_repo = cl_git_sandbox_init("testrepo.git");
+	cl_git_pass(git_repository_odb(&_odb, _repo));
+}
+
+void test_odb_bulkcheckin__cleanup(void)
+{
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	cl_git_sandbox_cleanup();
+}
+
+static size_t count_packs(void)
+{
+	git_str path = GIT_STR_INIT;
+	git_vector contents = GIT_VECTOR_INIT;
+	char *entry;
+	size_t i, count = 0;
+
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(_repo), "objects/pack"));
+	cl_git_pass(git_fs_path_dirload(&contents, path.ptr, 0, 0));
+
+	git_vector_foreach(&contents, i, entry) {
+		if (git__suffixcmp(entry, ".pack") == 0)
+			count++;
+		git__free(entry);
+	}
+
+	git_vector_dispose(&contents);
+	git_str_dispose(&path);
+	return count;
+}
+
+static void assert_loose(const git_oid *id, bool expected)
+{
+	git_str path = GIT_STR_INIT;
+	char hex[GIT_OID_SHA1_HEXSIZE + 1];
+
+	git_oid_tostr(hex, sizeof(hex), id);
+
+	cl_git_pass(git_str_printf(&path, "%s/objects/%.2s/%s",
+		git_repository_path(_repo), hex, hex + 2));
+	cl_assert_equal_b(expected, git_fs_path_exists(path.ptr));
+
+	git_str_dispose(&path);
+}
+
+static void assert_object(const git_oid *id, const char *expected)
+{
+	git_odb_object *obj;
+
+	cl_git_pass(git_odb_read(&obj, _odb, id));
+	cl_assert_equal_i(GIT_OBJECT_BLOB, git_odb_object_type(obj));
+	cl_assert_equal_i(strlen(expected), git_odb_object_size(obj));
+	cl_assert_equal_strn(expected, git_odb_object_data(obj), strlen(expected));
+	git_odb_object_free(obj);
+}
+
+static const char *contents[] = {
+	"bulk checkin one\n",
+	"bulk checkin two\n",
+	"bulk checkin three\n",
+	"bulk checkin one\n"
+};
+
+void test_odb_bulkcheckin__commit(void)
+{
+	git_oid ids[ARRAY_SIZE(contents)];
+	size_t i, packs = count_packs();
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+	cl_git_fail(git_odb_bulk_checkin_begin(_odb));
+
+	for (i = 0; i < ARRAY_SIZE(contents); i++)
+		cl_git_pass(git_odb_write(&ids[i], _odb, contents[i], strlen(contents[i]), GIT_OBJECT_BLOB));
+
+	/* objects can be read back, but are not written loose */
+	for (i = 0; i < ARRAY_SIZE(contents); i++) {
+		assert_object(&ids[i], contents[i]);
+		assert_loose(&ids[i], false);
+	}
+
+	cl_git_pass(git_odb_bulk_checkin_commit(_odb));
+	cl_git_fail(git_odb_bulk_checkin_commit(_odb));
+
+	cl_assert_equal_i(packs + 1, count_packs());
+
+	for (i = 0; i < ARRAY_SIZE(contents); i++) {
+		assert_object(&ids[i], contents[i]);
+		assert_loose(&ids[i], false);
+	}
+
+	/* a fresh object database sees the new packfile */
+	git_odb_free(_odb);
+	cl_git_pass(git_odb_open_ext(&_odb, "testrepo.git/objects", NULL));
+
+	for (i = 0; i < ARRAY_SIZE(contents); i++)
+		assert_object(&ids[i], contents[i]);
+}
+
+void test_odb_bulkcheckin__abort(void)
+{
+	git_oid id;
+	size_t packs = count_packs();
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+	cl_git_pass(git_odb_write(&id, _odb, contents[0], strlen(contents[0]), GIT_OBJECT_BLOB));
+	assert_object(&id, contents[0]);
+	cl_git_pass(git_odb_bulk_checkin_abort(_odb));
+
+	cl_assert_equal_i(0, git_odb_exists(_odb, &id));
+	cl_assert_equal_i(packs, count_packs());
+	assert_loose(&id, false);
+}
+
+void test_odb_bulkcheckin__empty(void)
+{
+	size_t packs = count_packs();
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+	cl_git_pass(git_odb_bulk_checkin_commit(_odb));
+
+	cl_assert_equal_i(packs, count_packs());
+}
+
+void test_odb_bulkcheckin__fsync_obeys_odb_setting(void)
+{
+	git_oid id;
+
+	p_fsync__cnt = 0;
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+	cl_git_pass(git_odb_write(&id, _odb, contents[0], strlen(contents[0]), GIT_OBJECT_BLOB));
+	cl_git_pass(git_odb_bulk_checkin_commit(_odb));
+	cl_assert_equal_sz(0, p_fsync__cnt);
+
+	_odb->do_fsync = 1;
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+	cl_git_pass(git_odb_write(&id, _odb, contents[1], strlen(contents[1]), GIT_OBJECT_BLOB));
+	cl_git_pass(git_odb_bulk_checkin_commit(_odb));
+	cl_assert(p_fsync__cnt > 0);
+}
+
+#ifdef GIT_THREADS
+# define BULK_THREADS 4
+# define BULK_OBJECTS_PER_THREAD 100
+
+static git_oid thread_ids[BULK_THREADS][BULK_OBJECTS_PER_THREAD];
+
+static void *write_objects(void *arg)
+{
+	size_t thread = (size_t)arg, i;
+	char buf[64];
+
+	for (i = 0; i < BULK_OBJECTS_PER_THREAD; i++) {
+		/* half of the objects are written by every thread */
+		p_snprintf(buf, sizeof(buf), "bulk checkin %d %d\n",
+			(i % 2) ? (int)thread : -1, (int)i);
+
+		if (git_odb_write(&thread_ids[thread][i], _odb, buf, strlen(buf), GIT_OBJECT_BLOB) < 0)
+			return (void *)1;
+	}
+
+	return NULL;
+}
+#endif
+
+void test_odb_bulkcheckin__threads(void)
+{
+#ifndef GIT_THREADS
+	clar__skip();
+#else
+	git_thread threads[BULK_THREADS];
+	git_odb_object *obj;
+	char buf[64];
+	void *result;
+	size_t i, j;
+
+	cl_git_pass(git_odb_bulk_checkin_begin(_odb));
+
+	for (i = 0; i < BULK_THREADS; i++)
+		cl_git_pass(git_thread_create(&threads[i], write_objects, (void *)i));
+
+	for (i = 0; i < BULK_THREADS; i++) {
+		cl_git_pass(git_thread_join(&threads[i], &result));
+		cl_assert_equal_p(NULL, result);
+	}
+
+	cl_git_pass(git_odb_bulk_checkin_commit(_odb));
+
+	/* a fresh object database reads them from the new packfile */
+	git_odb_free(_odb);
+	cl_git_pass(git_odb_open_ext(&_odb, "testrepo.git/objects", NULL));
+
+	for (i = 0; i < BULK_THREADS; i++) {
+		for (j = 0; j < BULK_OBJECTS_PER_THREAD; j++) {
+			p_snprintf(buf, sizeof(buf), "bulk checkin %d %d\n",
+				(j % 2) ? (int)i : -1, (int)j);
+
+			cl_git_pass(git_odb_read(&obj, _odb, &thread_ids[i][j]));
+			cl_assert_equal_strn(buf, git_odb_object_data(obj), strlen(buf));
+			git_odb_object_free(obj);
+			assert_loose(&thread_ids[i][j], false);
+		}
+	}
+#endif
+}
@@ -77,3 +77,45 @@ void test_odb_packed__read_header_1(void)
 	}
 }
 
+static void assert_readstream_matches(const git_oid *id, size_t blocksize)
+{
+	git_odb_object *obj;
+	git_odb_stream *stream;
+	git_str buf = GIT_STR_INIT;
+	char block[4096];
+	size_t len;
+	git_object_t type;
+	int ret;
+
+	cl_git_pass(git_odb_read(&obj, _odb, id));
+	cl_git_pass(git_odb_open_rstream(&stream, &len, &type, _odb, id));
+
+	cl_assert_equal_i(git_odb_object_size(obj), len);
+	cl_assert_equal_i(git_odb_object_type(obj), type);
+
+	while ((ret = git_odb_stream_read(stream, block, blocksize)) > 0)
+		cl_git_pass(git_str_put(&buf, block, ret));
+
+	cl_assert_equal_i(0, ret);
+	cl_assert_equal_i(len, buf.size);
+	cl_assert(memcmp(git_odb_object_data(obj), buf.ptr, len) == 0);
+
+	git_str_dispose(&buf);
+	git_odb_stream_free(stream);
+	git_odb_object_free(obj);
+}
+
+void test_odb_packed__readstream(void)
+{
+	size_t blocksizes[] = { 1, 7, 4096 };
+	unsigned int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(packed_objects); ++i) {
+		git_oid id;
+
+		cl_git_pass(git_oid_from_string(&id, packed_objects[i], GIT_OID_SHA1));
+
+		for (j = 0; j < ARRAY_SIZE(blocksizes); j++)
+			assert_readstream_matches(&id, blocksizes[j]);
+	}
+}
@@ -276,3 +276,79 @@ void test_refs_iterator__concurrent_delete(void)
 
 	cl_assert_equal_i(full_count, concurrent_count);
 }
+
+static void assert_glob_names(const char *glob, const char **expected)
+{
+	git_reference_iterator *iter;
+	const char *name;
+	size_t i = 0;
+	int error;
+
+	cl_git_pass(git_reference_iterator_glob_new(&iter, repo, glob));
+
+	while ((error = git_reference_next_name(&name, iter)) == 0) {
+		cl_assert(expected[i] != NULL);
+		cl_assert_equal_s(expected[i], name);
+		i++;
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert(expected[i] == NULL);
+
+	git_reference_iterator_free(iter);
+}
+
+void test_refs_iterator__glob_reads_sorted_packed_refs(void)
+{
+	static const char *packed[] = {
+		"refs/heads/packed-test",
+		"refs/heads/packed",
+		"refs/heads/packed-zzz",
+		NULL
+	};
+	static const char *tags[] = {
+		"refs/tags/packed-annotated",
+		NULL
+	};
+	static const char *other[] = {
+		"refs/zzz/packed",
+		NULL
+	};
+	static const char *none[] = { NULL };
+	git_reference_iterator *iter;
+	git_reference *ref;
+	git_oid id;
+
+	cl_git_rewritefile("testrepo.git/packed-refs",
+		"# pack-refs with: peeled fully-peeled sorted \n"
+		"41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9 refs/heads/packed\n"
+		"41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9 refs/heads/packed-test\n"
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750 refs/heads/packed-zzz\n"
+		"b25fa35b38051e4ae45d4222e795f9df2e43f1d1 refs/tags/packed-annotated\n"
+		"^e90810b8df3e80c413d903f631643c716887138d\n"
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750 refs/zzz/packed\n");
+
+	/* loose refs come first, and shadow their packed counterpart */
+	assert_glob_names("refs/heads/packed*", packed);
+	assert_glob_names("refs/tags/packed-*", tags);
+	assert_glob_names("refs/heads/zzz*", none);
+	assert_glob_names("refs/zzz/*", other);
+
+	cl_git_pass(git_reference_iterator_glob_new(&iter, repo, "refs/*/packed-[at]*"));
+
+	cl_git_pass(git_reference_next(&ref, iter));
+	cl_assert_equal_s("refs/heads/packed-test", git_reference_name(ref));
+	cl_git_pass(git_oid_from_string(&id, "4a202b346bb0fb0db7eff3cffeb3c70babbd2045", GIT_OID_SHA1));
+	cl_assert_equal_oid(&id, git_reference_target(ref));
+	git_reference_free(ref);
+
+	cl_git_pass(git_reference_next(&ref, iter));
+	cl_assert_equal_s("refs/tags/packed-annotated", git_reference_name(ref));
+	cl_git_pass(git_oid_from_string(&id, "e90810b8df3e80c413d903f631643c716887138d", GIT_OID_SHA1));
+	cl_assert_equal_oid(&id, git_reference_target_peel(ref));
+	git_reference_free(ref);
+
+	cl_assert_equal_i(GIT_ITEROVER, git_reference_next(&ref, iter));
+
+	git_reference_iterator_free(iter);
+}
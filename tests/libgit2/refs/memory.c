@@ -0,0 +1,252 @@
+#include "clar_libgit2.h"
+#include "git2/sys/mempack.h"
+#include "git2/sys/refdb_backend.h"
+#include "git2/sys/repository.h"
+
+static git_repository *g_repo;
+static git_odb *g_odb;
+static git_signature *g_sig;
+static git_oid g_blob_id;
+
+void test_refs_memory__initialize(void)
+{
+	git_odb_backend *mempack;
+	git_refdb_backend *backend;
+	git_refdb *refdb;
+
+	cl_git_pass(git_mempack_new(&mempack));
+	cl_git_pass(git_odb_new(&g_odb));
+	cl_git_pass(git_odb_add_backend(g_odb, mempack, 10));
+	cl_git_pass(git_repository_wrap_odb(&g_repo, g_odb));
+
+	cl_git_pass(git_refdb_new(&refdb, g_repo));
+	cl_git_pass(git_refdb_backend_memory(&backend, g_repo));
+	cl_git_pass(git_refdb_set_backend(refdb, backend));
+	cl_git_pass(git_repository_set_refdb(g_repo, refdb));
+	git_refdb_free(refdb);
+
+	cl_git_pass(git_signature_new(&g_sig, "Tester", "tester@example.com", 1234567890, 0));
+	cl_git_pass(git_blob_create_from_buffer(&g_blob_id, g_repo, "blob", 4));
+}
+
+void test_refs_memory__cleanup(void)
+{
+	git_signature_free(g_sig);
+	git_repository_free(g_repo);
+	git_odb_free(g_odb);
+	g_repo = NULL;
+	g_odb = NULL;
+}
+
+static void create_ref(const char *name)
+{
+	git_reference *ref;
+
+	cl_git_pass(git_reference_create(&ref, g_repo, name, &g_blob_id, 0, NULL));
+	git_reference_free(ref);
+}
+
+static void assert_glob(const char *glob, const char **expected, size_t count)
+{
+	git_reference_iterator *iter;
+	const char *name;
+	size_t i = 0;
+	int error;
+
+	cl_git_pass(git_reference_iterator_glob_new(&iter, g_repo, glob));
+
+	while ((error = git_reference_next_name(&name, iter)) == 0) {
+		cl_assert(i < count);
+		cl_assert_equal_s(expected[i++], name);
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert_equal_sz(count, i);
+	git_reference_iterator_free(iter);
+}
+
+void test_refs_memory__create_and_lookup(void)
+{
+	git_reference *ref, *resolved;
+
+	create_ref("refs/heads/main");
+	cl_git_pass(git_reference_symbolic_create(&ref, g_repo, "HEAD", "refs/heads/main", 1, NULL));
+	git_reference_free(ref);
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "HEAD"));
+	cl_assert_equal_i(GIT_REFERENCE_SYMBOLIC, git_reference_type(ref));
+	cl_git_pass(git_reference_resolve(&resolved, ref));
+	cl_assert_equal_oid(&g_blob_id, git_reference_target(resolved));
+	git_reference_free(resolved);
+	git_reference_free(ref);
+
+	cl_git_fail_with(GIT_EEXISTS,
+		git_reference_create(&ref, g_repo, "refs/heads/main", &g_blob_id, 0, NULL));
+	cl_git_fail_with(GIT_ENOTFOUND,
+		git_reference_lookup(&ref, g_repo, "refs/heads/missing"));
+
+	/* neither a leading path nor a ref beneath an existing one */
+	cl_git_fail(git_reference_create(&ref, g_repo, "refs/heads/main/sub", &g_blob_id, 0, NULL));
+	cl_git_fail(git_reference_create(&ref, g_repo, "refs/heads", &g_blob_id, 0, NULL));
+}
+
+void test_refs_memory__iterates_sorted_by_prefix(void)
+{
+	const char *all[] = {
+		"refs/heads/a", "refs/heads/b/c", "refs/heads/z",
+		"refs/notes/commits", "refs/tags/v1", "refs/tags/v2"
+	};
+	const char *heads[] = { "refs/heads/a", "refs/heads/b/c", "refs/heads/z" };
+	const char *tags[] = { "refs/tags/v2" };
+
+	create_ref("refs/tags/v2");
+	create_ref("refs/heads/z");
+	create_ref("refs/notes/commits");
+	create_ref("refs/heads/a");
+	create_ref("refs/tags/v1");
+	create_ref("refs/heads/b/c");
+
+	assert_glob(NULL, all, ARRAY_SIZE(all));
+	assert_glob("refs/heads/*", heads, ARRAY_SIZE(heads));
+	assert_glob("refs/tags/*2", tags, ARRAY_SIZE(tags));
+	assert_glob("refs/remotes/*", NULL, 0);
+}
+
+void test_refs_memory__iteration_survives_deletion(void)
+{
+	git_reference_iterator *iter;
+	git_reference *ref;
+	const char *name;
+
+	create_ref("refs/heads/a");
+	create_ref("refs/heads/b");
+	create_ref("refs/heads/c");
+
+	cl_git_pass(git_reference_iterator_new(&iter, g_repo));
+	cl_git_pass(git_reference_next_name(&name, iter));
+	cl_assert_equal_s("refs/heads/a", name);
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/a"));
+	cl_git_pass(git_reference_delete(ref));
+	git_reference_free(ref);
+
+	cl_git_pass(git_reference_next_name(&name, iter));
+	cl_assert_equal_s("refs/heads/b", name);
+	cl_git_pass(git_reference_next_name(&name, iter));
+	cl_assert_equal_s("refs/heads/c", name);
+	cl_git_fail_with(GIT_ITEROVER, git_reference_next_name(&name, iter));
+
+	git_reference_iterator_free(iter);
+}
+
+void test_refs_memory__rename_moves_reflog(void)
+{
+	git_reference *ref, *renamed;
+	git_reflog *reflog;
+
+	cl_git_pass(git_reference_ensure_log(g_repo, "refs/heads/topic"));
+	cl_git_pass(git_reference_create(&ref, g_repo, "refs/heads/topic", &g_blob_id, 0, "created"));
+
+	cl_git_pass(git_reference_rename(&renamed, ref, "refs/heads/topic/renamed", 0, "renamed"));
+	cl_assert_equal_s("refs/heads/topic/renamed", git_reference_name(renamed));
+	cl_assert_equal_i(0, git_reference_has_log(g_repo, "refs/heads/topic"));
+
+	cl_git_pass(git_reflog_read(&reflog, g_repo, "refs/heads/topic/renamed"));
+	cl_assert_equal_sz(2, git_reflog_entrycount(reflog));
+	cl_assert_equal_s("renamed", git_reflog_entry_message(git_reflog_entry_byindex(reflog, 0)));
+	cl_assert_equal_s("created", git_reflog_entry_message(git_reflog_entry_byindex(reflog, 1)));
+	git_reflog_free(reflog);
+
+	cl_git_pass(git_reference_delete(renamed));
+	cl_assert_equal_i(0, git_reference_has_log(g_repo, "refs/heads/topic/renamed"));
+
+	git_reference_free(renamed);
+	git_reference_free(ref);
+}
+
+void test_refs_memory__rename_replaces_or_keeps_reference(void)
+{
+	const char *both[] = { "refs/heads/one", "refs/heads/two" };
+	const char *renamed_only[] = { "refs/heads/two" };
+	git_reference *ref, *renamed;
+
+	create_ref("refs/heads/one");
+	create_ref("refs/heads/two");
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/one"));
+
+	/* a failed rename leaves the reference in place */
+	cl_git_fail_with(GIT_EEXISTS, git_reference_rename(&renamed, ref, "refs/heads/two", 0, NULL));
+	assert_glob("refs/heads/*", both, ARRAY_SIZE(both));
+
+	/* renaming a reference onto itself keeps it */
+	cl_git_pass(git_reference_rename(&renamed, ref, "refs/heads/one", 1, NULL));
+	cl_assert_equal_s("refs/heads/one", git_reference_name(renamed));
+	assert_glob("refs/heads/*", both, ARRAY_SIZE(both));
+	git_reference_free(renamed);
+
+	cl_git_pass(git_reference_rename(&renamed, ref, "refs/heads/two", 1, NULL));
+	cl_assert_equal_s("refs/heads/two", git_reference_name(renamed));
+	assert_glob("refs/heads/*", renamed_only, ARRAY_SIZE(renamed_only));
+	git_reference_free(renamed);
+
+	git_reference_free(ref);
+}
+
+void test_refs_memory__transaction(void)
+{
+	git_transaction *tx, *other;
+	git_reference *ref;
+
+	create_ref("refs/heads/old");
+
+	cl_git_pass(git_transaction_new(&tx, g_repo));
+	cl_git_pass(git_transaction_lock_ref(tx, "refs/heads/new"));
+	cl_git_pass(git_transaction_lock_ref(tx, "refs/heads/old"));
+
+	cl_git_pass(git_transaction_new(&other, g_repo));
+	cl_git_fail_with(GIT_ELOCKED, git_transaction_lock_ref(other, "refs/heads/new"));
+	git_transaction_free(other);
+
+	cl_git_fail_with(GIT_ELOCKED,
+		git_reference_create(&ref, g_repo, "refs/heads/new", &g_blob_id, 1, NULL));
+
+	cl_git_pass(git_transaction_set_target(tx, "refs/heads/new", &g_blob_id, g_sig, "new"));
+	cl_git_pass(git_transaction_remove(tx, "refs/heads/old"));
+	cl_git_pass(git_transaction_commit(tx));
+	git_transaction_free(tx);
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/new"));
+	cl_assert_equal_oid(&g_blob_id, git_reference_target(ref));
+	git_reference_free(ref);
+
+	cl_git_fail_with(GIT_ENOTFOUND, git_reference_lookup(&ref, g_repo, "refs/heads/old"));
+}
+
+void test_refs_memory__commit_without_filesystem(void)
+{
+	git_treebuilder *builder;
+	git_reference *ref;
+	git_tree *tree;
+	git_oid tree_id, commit_id;
+
+	cl_git_pass(git_reference_symbolic_create(&ref, g_repo, "HEAD", "refs/heads/main", 1, NULL));
+	git_reference_free(ref);
+
+	cl_git_pass(git_treebuilder_new(&builder, g_repo, NULL));
+	cl_git_pass(git_treebuilder_insert(NULL, builder, "file", &g_blob_id, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(&tree_id, builder));
+	git_treebuilder_free(builder);
+
+	cl_git_pass(git_tree_lookup(&tree, g_repo, &tree_id));
+	cl_git_pass(git_commit_create(&commit_id, g_repo, "HEAD", g_sig, g_sig,
+		NULL, "initial", tree, 0, NULL));
+	git_tree_free(tree);
+
+	cl_assert_equal_p(NULL, git_repository_path(g_repo));
+	cl_assert_equal_i(0, git_repository_head_unborn(g_repo));
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/main"));
+	cl_assert_equal_oid(&commit_id, git_reference_target(ref));
+	git_reference_free(ref);
+}
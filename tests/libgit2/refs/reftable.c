@@ -0,0 +1,148 @@
+#include "clar_libgit2.h"
+#include "futils.h"
+
+#include <system.h>
+
+static git_repository *g_repo;
+
+void test_refs_reftable__cleanup(void)
+{
+	git_repository_free(g_repo);
+	g_repo = NULL;
+
+	cl_git_pass(git_libgit2_opts(GIT_OPT_ENABLE_REFTABLE_BACKGROUND_COMPACTION, 0));
+
+	cl_fixture_cleanup("reftable.git");
+}
+
+static void init_repo(const char *config_name, int config_value)
+{
+	git_repository_init_options opts = GIT_REPOSITORY_INIT_OPTIONS_INIT;
+	git_config *cfg;
+
+	opts.flags = GIT_REPOSITORY_INIT_BARE | GIT_REPOSITORY_INIT_MKPATH;
+	opts.refdb_type = GIT_REFDB_REFTABLE;
+
+	cl_git_pass(git_repository_init_ext(&g_repo, "reftable.git", &opts));
+
+	if (config_name) {
+		cl_git_pass(git_repository_config(&cfg, g_repo));
+		cl_git_pass(git_config_set_bool(cfg, config_name, config_value));
+		git_config_free(cfg);
+
+		/* the backend reads its configuration when it is created */
+		git_repository_free(g_repo);
+		cl_git_pass(git_repository_open(&g_repo, "reftable.git"));
+	}
+}
+
+static void write_refs(size_t count)
+{
+	git_str name = GIT_STR_INIT;
+	git_reference *ref;
+	git_oid id;
+	size_t i;
+
+	cl_git_pass(git_blob_create_from_buffer(&id, g_repo, "target\n", 7));
+
+	for (i = 0; i < count; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/branch-%d", (int)i));
+		cl_git_pass(git_reference_create(&ref, g_repo, name.ptr, &id, 0, NULL));
+		git_reference_free(ref);
+	}
+
+	git_str_dispose(&name);
+}
+
+static size_t count_tables(void)
+{
+	git_str contents = GIT_STR_INIT;
+	size_t i, tables = 0;
+
+	cl_git_pass(git_futils_readbuffer(&contents, "reftable.git/reftable/tables.list"));
+
+	for (i = 0; i < contents.size; i++) {
+		if (contents.ptr[i] == '\n')
+			tables++;
+	}
+
+	git_str_dispose(&contents);
+	return tables;
+}
+
+void test_refs_reftable__auto_compaction_bounds_stack(void)
+{
+	init_repo(NULL, 0);
+	write_refs(64);
+
+	cl_assert(count_tables() <= 8);
+}
+
+void test_refs_reftable__auto_compaction_can_be_disabled(void)
+{
+	init_repo("reftable.autoCompaction", false);
+	write_refs(64);
+
+	cl_assert(count_tables() >= 64);
+}
+
+void test_refs_reftable__background_compaction(void)
+{
+	git_reference *ref;
+
+	cl_git_pass(git_libgit2_opts(GIT_OPT_ENABLE_REFTABLE_BACKGROUND_COMPACTION, 1));
+	init_repo(NULL, 0);
+	write_refs(64);
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/branch-63"));
+	git_reference_free(ref);
+
+	/* freeing the repository waits for outstanding compaction */
+	git_repository_free(g_repo);
+	g_repo = NULL;
+
+	cl_assert(count_tables() <= 8);
+}
+
+void test_refs_reftable__table_maps_are_shared(void)
+{
+	struct reftable_mmap first, second, third;
+	void *data;
+	int fd1, fd2;
+
+	cl_git_mkfile("reftable.git", "this is not really a table\n");
+
+	cl_assert((fd1 = p_open("reftable.git", O_RDONLY)) >= 0);
+	cl_assert((fd2 = p_open("reftable.git", O_RDONLY)) >= 0);
+
+	cl_assert_equal_i(0, reftable_mmap(&first, fd1, 27));
+	cl_assert_equal_i(0, reftable_mmap(&second, fd2, 27));
+	cl_assert(first.data == second.data);
+	data = first.data;
+
+	cl_assert_equal_i(0, reftable_munmap(&first));
+	cl_assert_equal_i(0, reftable_munmap(&second));
+
+#ifndef GIT_WIN32
+	/* an idle mapping is reused by the next reader of the same file */
+	cl_assert_equal_i(0, reftable_mmap(&third, fd1, 27));
+	cl_assert(third.data == data);
+	cl_assert_equal_i(0, reftable_munmap(&third));
+#else
+	GIT_UNUSED(data);
+#endif
+
+	p_close(fd1);
+	p_close(fd2);
+
+	/* a different file must not be served from the cache */
+	cl_git_rewritefile("reftable.git", "this is a different file\n");
+
+	cl_assert((fd1 = p_open("reftable.git", O_RDONLY)) >= 0);
+	cl_assert_equal_i(0, reftable_mmap(&third, fd1, 25));
+	cl_assert_equal_i(25, third.size);
+	cl_assert(memcmp(third.data, "this is a different file\n", 25) == 0);
+	cl_assert_equal_i(0, reftable_munmap(&third));
+	p_close(fd1);
+}
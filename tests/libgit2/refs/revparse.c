@@ -333,6 +333,58 @@ void test_refs_revparse__previous_head(void)
 	test_object("@{-1}", "a4a7dce85cf63874e984719f4fdd239f5145052f");
 }
 
+void test_refs_revparse__ordinal_reads_reflog_from_the_end(void)
+{
+	const char *ids[] = {
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+		"5b5b025afb0b4c913b4c338a42934a3863bf3644",
+		"a4a7dce85cf63874e984719f4fdd239f5145052f"
+	};
+	git_str log_path = GIT_STR_INIT, log = GIT_STR_INIT, spec = GIT_STR_INIT;
+	git_reflog *reflog;
+	size_t i;
+
+	if (!cl_repo_has_ref_format(g_repo, "files"))
+		cl_skip();
+
+	for (i = 0; i < 100; i++) {
+		git_str_printf(&log, "%s %s Tester <t@example.com> %d +0000\tentry %d\n",
+			ids[i % 4], ids[(i + 1) % 4], (int)(1000000000 + i), (int)i);
+
+		/* sprinkle in some lines that do not parse */
+		if (i % 10 == 5)
+			git_str_puts(&log, "garbage\n\n");
+	}
+
+	/* the last entry is missing its newline */
+	git_str_rtrim(&log);
+	cl_assert(!git_str_oom(&log));
+
+	cl_git_pass(git_str_joinpath(&log_path, git_repository_path(g_repo), "logs/refs/heads/master"));
+	cl_git_rewritefile(log_path.ptr, log.ptr);
+
+	cl_git_pass(git_reflog_read(&reflog, g_repo, "refs/heads/master"));
+	cl_assert_equal_sz(100, git_reflog_entrycount(reflog));
+
+	for (i = 1; i < 100; i++) {
+		git_str_clear(&spec);
+		git_str_printf(&spec, "master@{%d}", (int)i);
+
+		cl_git_pass(git_revparse_single(&g_obj, g_repo, spec.ptr));
+		cl_assert_equal_oid(git_reflog_entry_id_new(git_reflog_entry_byindex(reflog, i)),
+			git_object_id(g_obj));
+		git_object_free(g_obj);
+	}
+
+	test_object("master@{100}", NULL);
+
+	git_reflog_free(reflog);
+	git_str_dispose(&spec);
+	git_str_dispose(&log);
+	git_str_dispose(&log_path);
+}
+
 static void create_fake_stash_reference_and_reflog(git_repository *repo)
 {
 	git_reference *master, *new_master;
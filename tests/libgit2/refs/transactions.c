@@ -1,5 +1,6 @@
 #include "clar_libgit2.h"
 #include "git2/transaction.h"
+#include "futils.h"
 
 static git_repository *g_repo;
 static git_transaction *g_tx;
@@ -157,3 +158,196 @@ void test_refs_transactions__free_unlocks_unmodified_ref(void)
 	/* a transaction must now be able to get the lock */
 	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/master"));
 }
+
+void test_refs_transactions__many_refs_are_packed(void)
+{
+	git_reference *ref;
+	git_reflog *reflog;
+	git_str name = GIT_STR_INIT, path = GIT_STR_INIT;
+	git_oid id;
+	size_t i;
+
+	git_oid_from_string(&id, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750", GIT_OID_SHA1);
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_transaction_lock_ref(g_tx, name.ptr));
+		cl_git_pass(git_transaction_set_target(g_tx, name.ptr, &id, NULL, "batch"));
+	}
+
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/master"));
+	cl_git_pass(git_transaction_set_target(g_tx, "refs/heads/master", &id, NULL, NULL));
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/packed"));
+	cl_git_pass(git_transaction_remove(g_tx, "refs/heads/packed"));
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/symbolic"));
+	cl_git_pass(git_transaction_set_symbolic_target(g_tx, "refs/heads/symbolic", "refs/heads/master", NULL, NULL));
+	cl_git_pass(git_transaction_commit(g_tx));
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_reference_lookup(&ref, g_repo, name.ptr));
+		cl_assert_equal_oid(&id, git_reference_target(ref));
+		git_reference_free(ref);
+
+		cl_git_pass(git_reflog_read(&reflog, g_repo, name.ptr));
+		cl_assert_equal_i(1, git_reflog_entrycount(reflog));
+		cl_assert_equal_s("batch", git_reflog_entry_message(git_reflog_entry_byindex(reflog, 0)));
+		git_reflog_free(reflog);
+	}
+
+	/* the updates went into packed-refs rather than into loose files */
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "refs/heads/batch"));
+	cl_assert(!git_fs_path_exists(path.ptr));
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "refs/heads/master"));
+	cl_assert(!git_fs_path_exists(path.ptr));
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/master"));
+	cl_assert_equal_oid(&id, git_reference_target(ref));
+	git_reference_free(ref);
+
+	cl_git_fail_with(GIT_ENOTFOUND, git_reference_lookup(&ref, g_repo, "refs/heads/packed"));
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/symbolic"));
+	cl_assert_equal_s("refs/heads/master", git_reference_symbolic_target(ref));
+	git_reference_free(ref);
+
+	/* and the locks have all been released */
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/batch/00"));
+
+	git_str_dispose(&name);
+	git_str_dispose(&path);
+}
+
+void test_refs_transactions__failed_batch_writes_no_reflog(void)
+{
+	git_reference *ref;
+	git_str name = GIT_STR_INIT;
+	git_oid id;
+	size_t i;
+
+	git_oid_from_string(&id, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750", GIT_OID_SHA1);
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_transaction_lock_ref(g_tx, name.ptr));
+		cl_git_pass(git_transaction_set_target(g_tx, name.ptr, &id, NULL, "batch"));
+	}
+
+	/* removing a reference that doesn't exist fails the whole batch */
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/batch/missing"));
+	cl_git_pass(git_transaction_remove(g_tx, "refs/heads/batch/missing"));
+	cl_git_fail_with(GIT_ENOTFOUND, git_transaction_commit(g_tx));
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_fail_with(GIT_ENOTFOUND, git_reference_lookup(&ref, g_repo, name.ptr));
+		cl_assert(!git_reference_has_log(g_repo, name.ptr));
+	}
+
+	git_str_dispose(&name);
+}
+
+void test_refs_transactions__batch_reflog_has_old_value(void)
+{
+	git_reflog *reflog;
+	git_reference *ref;
+	const git_reflog_entry *entry;
+	git_str name = GIT_STR_INIT;
+	git_oid id, old_id;
+	size_t i;
+
+	git_oid_from_string(&id, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750", GIT_OID_SHA1);
+
+	cl_git_pass(git_reference_name_to_id(&old_id, g_repo, "refs/heads/master"));
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_transaction_lock_ref(g_tx, name.ptr));
+		cl_git_pass(git_transaction_set_target(g_tx, name.ptr, &id, NULL, "batch"));
+	}
+
+	cl_git_pass(git_transaction_lock_ref(g_tx, "refs/heads/master"));
+	cl_git_pass(git_transaction_set_target(g_tx, "refs/heads/master", &id, NULL, "batch"));
+	cl_git_pass(git_transaction_commit(g_tx));
+
+	cl_git_pass(git_reference_lookup(&ref, g_repo, "refs/heads/master"));
+	cl_assert_equal_oid(&id, git_reference_target(ref));
+	git_reference_free(ref);
+
+	/* the reflogs are written after the update, but record the old value */
+	cl_git_pass(git_reflog_read(&reflog, g_repo, "refs/heads/master"));
+	cl_assert((entry = git_reflog_entry_byindex(reflog, 0)) != NULL);
+	cl_assert_equal_oid(&old_id, git_reflog_entry_id_old(entry));
+	cl_assert_equal_oid(&id, git_reflog_entry_id_new(entry));
+	git_reflog_free(reflog);
+
+	cl_git_pass(git_reflog_read(&reflog, g_repo, "HEAD"));
+	cl_assert((entry = git_reflog_entry_byindex(reflog, 0)) != NULL);
+	cl_assert_equal_oid(&old_id, git_reflog_entry_id_old(entry));
+	cl_assert_equal_oid(&id, git_reflog_entry_id_new(entry));
+	git_reflog_free(reflog);
+
+	git_str_dispose(&name);
+}
+
+void test_refs_transactions__batch_failure_still_removes_loose_refs(void)
+{
+	git_reference *ref;
+	git_str name = GIT_STR_INIT, path = GIT_STR_INIT;
+	git_oid old_id, id;
+	size_t i;
+
+	git_oid_from_string(&old_id, "099fabac3a9ea935598528c27f866e34089c2eff", GIT_OID_SHA1);
+	git_oid_from_string(&id, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750", GIT_OID_SHA1);
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_reference_create(&ref, g_repo, name.ptr, &old_id, 0, NULL));
+		git_reference_free(ref);
+	}
+
+	/* a directory in place of a reflog makes writing that reflog fail */
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "logs/refs/heads/batch/05"));
+	cl_must_pass(p_unlink(path.ptr));
+	cl_git_pass(git_str_joinpath(&path, path.ptr, "blocker"));
+	cl_git_pass(git_futils_mkpath2file(path.ptr, 0777));
+	cl_git_mkfile(path.ptr, "");
+
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_transaction_lock_ref(g_tx, name.ptr));
+		cl_git_pass(git_transaction_set_target(g_tx, name.ptr, &id, NULL, "batch"));
+	}
+
+	cl_git_fail(git_transaction_commit(g_tx));
+
+	/* the loose files of the entries after the failure are gone too */
+	for (i = 0; i < 32; i++) {
+		git_str_clear(&name);
+		cl_git_pass(git_str_printf(&name, "refs/heads/batch/%02d", (int)i));
+
+		cl_git_pass(git_reference_lookup(&ref, g_repo, name.ptr));
+		cl_assert_equal_oid(&id, git_reference_target(ref));
+		git_reference_free(ref);
+	}
+
+	cl_git_pass(git_str_joinpath(&path, git_repository_path(g_repo), "refs/heads/batch"));
+	cl_assert(!git_fs_path_exists(path.ptr));
+
+	git_str_dispose(&name);
+	git_str_dispose(&path);
+}
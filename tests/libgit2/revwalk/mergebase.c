@@ -1,5 +1,6 @@
 #include "clar_libgit2.h"
 #include "vector.h"
+#include "merge_base_cache.h"
 #include <stdarg.h>
 
 static git_repository *_repo;
@@ -123,6 +124,52 @@ void test_revwalk_mergebase__no_common_ancestor_returns_ENOTFOUND(void)
 	cl_assert_equal_sz(2, behind);
 }
 
+void test_revwalk_mergebase__cache(void)
+{
+	git_repository *repo;
+	git_merge_base_cache *cache;
+	git_oid result, one, two, unrelated, expected;
+	bool found;
+
+	repo = cl_git_sandbox_init("testrepo.git");
+	cl_repo_set_bool(repo, "core.mergeBaseCache", true);
+
+	cl_git_pass(git_oid_from_string(&one, "c47800c7266a2be04c571c04d5a6614691ea99bd", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&two, "9fd738e8f7967c078dceed8190330fc8648ee56a", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&unrelated, "e90810b8df3e80c413d903f631643c716887138d", GIT_OID_SHA1));
+	cl_git_pass(git_oid_from_string(&expected, "5b5b025afb0b4c913b4c338a42934a3863bf3644", GIT_OID_SHA1));
+
+	cl_git_pass(git_repository__merge_base_cache(&cache, repo));
+	cl_assert(cache != NULL);
+
+	cl_assert_equal_i(GIT_ENOTFOUND, git_merge_base_cache_lookup(&result, &found, cache, &one, &two));
+
+	cl_git_pass(git_merge_base(&result, repo, &one, &two));
+	cl_assert_equal_oid(&expected, &result);
+
+	/* the merge base is cached, for either order of the commits */
+	cl_git_pass(git_merge_base_cache_lookup(&result, &found, cache, &one, &two));
+	cl_assert(found);
+	cl_assert_equal_oid(&expected, &result);
+
+	cl_git_pass(git_merge_base_cache_lookup(&result, &found, cache, &two, &one));
+	cl_assert(found);
+	cl_assert_equal_oid(&expected, &result);
+
+	/* so is the absence of a merge base */
+	cl_assert_equal_i(GIT_ENOTFOUND, git_merge_base(&result, repo, &one, &unrelated));
+
+	cl_git_pass(git_merge_base_cache_lookup(&result, &found, cache, &unrelated, &one));
+	cl_assert(!found);
+
+	/* and a cached merge base is returned without walking the history */
+	cl_git_pass(git_merge_base_cache_add(cache, &two, &unrelated, &expected));
+	cl_git_pass(git_merge_base(&result, repo, &unrelated, &two));
+	cl_assert_equal_oid(&expected, &result);
+
+	cl_git_sandbox_cleanup();
+}
+
 void test_revwalk_mergebase__prefer_youngest_merge_base(void)
 {
 	git_oid result, one, two, expected;
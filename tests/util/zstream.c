@@ -165,3 +165,28 @@ void test_zstream__big_data(void)
 
 	git_str_dispose(&in);
 }
+
+void test_zstream__inflate_oneshot(void)
+{
+	git_str deflated = GIT_STR_INIT;
+	char out[128];
+	size_t len = strlen(data), consumed;
+
+	cl_git_pass(git_zstream_deflatebuf(&deflated, data, len));
+
+	/* trailing data after the stream is left unconsumed */
+	cl_git_pass(git_str_puts(&deflated, "trailer"));
+
+	cl_git_pass(git_zstream_inflate_oneshot(out, len, &consumed, deflated.ptr, deflated.size));
+	cl_assert_equal_i(deflated.size - strlen("trailer"), consumed);
+	cl_assert(memcmp(out, data, len) == 0);
+
+	/* the stream must inflate to exactly the expected size */
+	cl_assert_equal_i(GIT_EBUFS, git_zstream_inflate_oneshot(out, len - 1, NULL, deflated.ptr, consumed));
+	cl_assert_equal_i(GIT_EBUFS, git_zstream_inflate_oneshot(out, len + 1, NULL, deflated.ptr, consumed));
+
+	/* truncated input can be retried by streaming */
+	cl_assert_equal_i(GIT_EBUFS, git_zstream_inflate_oneshot(out, len, NULL, deflated.ptr, consumed / 2));
+
+	git_str_dispose(&deflated);
+}